@@ -0,0 +1,148 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "AdmissionController.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+///////////////////////////////// TokenBucket //////////////////////////////////
+TokenBucket::TokenBucket(double rate, double burst)
+  : rate_(rate)
+  , burst_(std::max(burst, 1.0))
+  , tokens_(burst_)
+  , refilled_(Clock::now()) {
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+  std::chrono::duration<double> elapsed = now - refilled_;
+  tokens_ = std::min(tokens_ + elapsed.count() * rate_, burst_);
+  refilled_ = now;
+}
+
+double TokenBucket::take() {
+  if (rate_ <= 0) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> sl(lock_);
+  refill(Clock::now());
+  tokens_ -= 1;
+  return tokens_ >= 1 ? 0 : (1 - tokens_) / rate_;
+}
+
+///////////////////////////// AdmissionController //////////////////////////////
+AdmissionController::AdmissionController(
+    double acceptRate,
+    double acceptBurst,
+    double authorizeRate,
+    double authorizeBurst,
+    size_t queueSize)
+  : accepts_(acceptRate, acceptBurst)
+  , authorizes_(authorizeRate, authorizeBurst)
+  , maxQueueSize_(queueSize)
+  , running_(false)
+  , acceptPauses_(0)
+  , deferred_(0)
+  , rejected_(0)
+  // 1 ms ~ 65 s
+  , queueLatency_(std::make_shared<prometheus::Histogram>(
+        prometheus::Histogram::exponentialBounds(0.001, 2, 17))) {
+}
+
+AdmissionController::~AdmissionController() {
+  stop();
+}
+
+void AdmissionController::start() {
+  running_ = true;
+  thread_ = std::thread(&AdmissionController::run, this);
+}
+
+void AdmissionController::stop() {
+  {
+    std::lock_guard<std::mutex> sl(lock_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+double AdmissionController::accept() {
+  double pause = accepts_.take();
+  if (pause > 0) {
+    acceptPauses_++;
+  }
+  return pause;
+}
+
+bool AdmissionController::defer(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> sl(lock_);
+    if (queue_.size() >= maxQueueSize_) {
+      rejected_++;
+      return false;
+    }
+    queue_.push_back({std::move(task), Clock::now()});
+  }
+  deferred_++;
+  cond_.notify_one();
+  return true;
+}
+
+size_t AdmissionController::queueSize() const {
+  std::lock_guard<std::mutex> sl(lock_);
+  return queue_.size();
+}
+
+void AdmissionController::run() {
+  LOG(INFO) << "AdmissionController: running";
+  for (;;) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> sl(lock_);
+      cond_.wait(sl, [this]() { return !running_ || !queue_.empty(); });
+      if (!running_) {
+        break;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    std::chrono::duration<double> waited = Clock::now() - task.queued_;
+    queueLatency_->observe(waited.count());
+    task.task_();
+
+    double pause = authorizes_.take();
+    if (pause > 0) {
+      std::unique_lock<std::mutex> sl(lock_);
+      cond_.wait_for(sl, std::chrono::duration<double>(pause), [this]() {
+        return !running_;
+      });
+    }
+  }
+  LOG(INFO) << "AdmissionController: stopped";
+}
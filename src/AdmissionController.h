@@ -0,0 +1,123 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#pragma once
+
+#include "prometheus/Histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//
+// Tokens refilled at a constant rate up to a burst, thread-safe.
+//
+class TokenBucket {
+public:
+  // rate 0: unlimited
+  TokenBucket(double rate, double burst);
+
+  // Take a token, the bucket may go into debt. Returns the seconds until the
+  // bucket has a token again, 0 if it still has one.
+  double take();
+
+  double rate() const { return rate_; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  double rate_;
+  double burst_;
+  double tokens_;
+  Clock::time_point refilled_;
+  std::mutex lock_;
+
+  void refill(Clock::time_point now);
+};
+
+//
+// Keeps the sessions already mining flat while a wave of miners reconnects:
+// meters the accepted connections and moves the expensive steps of
+// authorizing unknown users (the user chain lookup in zookeeper and the auto
+// registration) to a queue drained at a limited rate in its own thread.
+//
+class AdmissionController {
+public:
+  AdmissionController(
+      double acceptRate,
+      double acceptBurst,
+      double authorizeRate,
+      double authorizeBurst,
+      size_t queueSize);
+  ~AdmissionController();
+
+  void start();
+  void stop();
+
+  // Called for each accepted connection, returns the seconds to stop
+  // accepting for, 0 to keep accepting.
+  double accept();
+
+  // Whether the authorizations of unknown users are deferred
+  bool meteringAuthorizations() const { return authorizes_.rate() > 0; }
+  // Run the task in the admission thread, false if the queue is full.
+  bool defer(std::function<void()> task);
+
+  size_t queueSize() const;
+  uint64_t acceptPauses() const { return acceptPauses_; }
+  uint64_t deferred() const { return deferred_; }
+  uint64_t rejected() const { return rejected_; }
+  // seconds the deferred tasks waited in the queue
+  const std::shared_ptr<prometheus::Histogram> &queueLatency() const {
+    return queueLatency_;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Task {
+    std::function<void()> task_;
+    Clock::time_point queued_;
+  };
+
+  TokenBucket accepts_;
+  TokenBucket authorizes_;
+  size_t maxQueueSize_;
+
+  std::deque<Task> queue_;
+  mutable std::mutex lock_;
+  std::condition_variable cond_;
+  bool running_;
+  std::thread thread_;
+
+  std::atomic<uint64_t> acceptPauses_;
+  std::atomic<uint64_t> deferred_;
+  std::atomic<uint64_t> rejected_;
+  std::shared_ptr<prometheus::Histogram> queueLatency_;
+
+  void run();
+};
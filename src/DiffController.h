@@ -124,5 +124,10 @@ public:
 
   // use when handle cmd: mining.suggest_difficulty & mining.suggest_target
   void resetCurDiff(uint64_t curDiff);
+
+  size_t memoryUsage() const {
+    return sizeof(*this) + sharesNum_.getWindowSize() * sizeof(double) +
+        shares_.getWindowSize() * sizeof(uint64_t);
+  }
 };
 #endif
@@ -0,0 +1,267 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "HotRestart.h"
+
+#include "Utils.h"
+
+#include <glog/logging.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+using JSON = nlohmann::json;
+
+static string toHex(const string &bytes) {
+  string hex;
+  Bin2Hex((const uint8_t *)bytes.data(), bytes.size(), hex);
+  return hex;
+}
+
+static string fromHex(const string &hex) {
+  vector<char> bytes;
+  Hex2Bin(hex.data(), hex.size(), bytes);
+  return string(bytes.begin(), bytes.end());
+}
+
+void to_json(JSON &j, const SessionState &state) {
+  j = JSON{{"session_id", state.sessionId_},
+           {"client_ip", state.clientIp_},
+           {"client_agent", state.clientAgent_},
+           {"chain_id", state.chainId_},
+           {"user_ids", state.userIds_},
+           {"worker_hash_id", state.workerHashId_},
+           {"full_name", state.fullName_},
+           {"user_name", state.userName_},
+           {"worker_name", state.workerName_},
+           {"cur_diff", state.curDiff_},
+           {"min_diff", state.minDiff_},
+           {"extra", state.extra_},
+           {"input", toHex(state.input_)},
+           {"output", toHex(state.output_)}};
+}
+
+void from_json(const JSON &j, SessionState &state) {
+  j.at("session_id").get_to(state.sessionId_);
+  j.at("client_ip").get_to(state.clientIp_);
+  j.at("client_agent").get_to(state.clientAgent_);
+  j.at("chain_id").get_to(state.chainId_);
+  j.at("user_ids").get_to(state.userIds_);
+  j.at("worker_hash_id").get_to(state.workerHashId_);
+  j.at("full_name").get_to(state.fullName_);
+  j.at("user_name").get_to(state.userName_);
+  j.at("worker_name").get_to(state.workerName_);
+  j.at("cur_diff").get_to(state.curDiff_);
+  j.at("min_diff").get_to(state.minDiff_);
+  j.at("extra").get_to(state.extra_);
+  state.input_ = fromHex(j.at("input").get<string>());
+  state.output_ = fromHex(j.at("output").get<string>());
+}
+
+static bool writeFully(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      LOG(ERROR) << "hot restart: send failed, errno: " << errno;
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool readFully(int fd, char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = ::recv(fd, data, size, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      LOG_IF(ERROR, n < 0) << "hot restart: recv failed, errno: " << errno;
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static void closeAll(std::vector<int> &fds) {
+  for (int fd : fds) {
+    close(fd);
+  }
+  fds.clear();
+}
+
+HotRestartChannel::HotRestartChannel(int fd)
+  : fd_(fd) {
+  // sockets accepted by libevent are non-blocking
+  int flags = fcntl(fd_, F_GETFL);
+  if (flags >= 0 && (flags & O_NONBLOCK)) {
+    fcntl(fd_, F_SETFL, flags & ~O_NONBLOCK);
+  }
+  timeval timeout{kTimeoutSeconds, 0};
+  setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+HotRestartChannel::~HotRestartChannel() {
+  close(fd_);
+}
+
+std::unique_ptr<HotRestartChannel>
+HotRestartChannel::connect(const std::string &path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    LOG(ERROR) << "hot restart: socket path too long: " << path;
+    return nullptr;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG(ERROR) << "hot restart: cannot create socket, errno: " << errno;
+    return nullptr;
+  }
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    // no running process to take over
+    LOG_IF(ERROR, errno != ENOENT && errno != ECONNREFUSED)
+        << "hot restart: cannot connect to " << path << ", errno: " << errno;
+    close(fd);
+    return nullptr;
+  }
+  return std::make_unique<HotRestartChannel>(fd);
+}
+
+bool HotRestartChannel::send(const JSON &message, const std::vector<int> &fds) {
+  if (fds.size() > kMaxFds) {
+    LOG(ERROR) << "hot restart: too many sockets in a message: " << fds.size();
+    return false;
+  }
+
+  // names may not be valid UTF-8
+  const string payload =
+      message.dump(-1, ' ', false, JSON::error_handler_t::replace);
+  uint32_t length = payload.size();
+  iovec iov{&length, sizeof(length)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  union {
+    cmsghdr header_;
+    char buffer_[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  } control;
+  if (!fds.empty()) {
+    msg.msg_control = control.buffer_;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  }
+
+  // the sockets go along with the length, the payload follows
+  ssize_t n;
+  do {
+    n = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    LOG(ERROR) << "hot restart: sendmsg failed, errno: " << errno;
+    return false;
+  }
+  return writeFully(fd_, (const char *)&length + n, sizeof(length) - n) &&
+      writeFully(fd_, payload.data(), payload.size());
+}
+
+bool HotRestartChannel::receive(JSON &message, std::vector<int> &fds) {
+  fds.clear();
+
+  uint32_t length = 0;
+  iovec iov{&length, sizeof(length)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  union {
+    cmsghdr header_;
+    char buffer_[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  } control;
+  msg.msg_control = control.buffer_;
+  msg.msg_controllen = sizeof(control.buffer_);
+
+  ssize_t n;
+  do {
+    n = recvmsg(fd_, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    LOG_IF(ERROR, n < 0) << "hot restart: recvmsg failed, errno: " << errno;
+    return false;
+  }
+
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *received = (const int *)CMSG_DATA(cmsg);
+      fds.insert(fds.end(), received, received + count);
+    }
+  }
+  if (msg.msg_flags & MSG_CTRUNC) {
+    LOG(ERROR) << "hot restart: sockets of a message truncated";
+    closeAll(fds);
+    return false;
+  }
+
+  string payload;
+  if (!readFully(fd_, (char *)&length + n, sizeof(length) - n) ||
+      length > kMaxMessageSize) {
+    closeAll(fds);
+    return false;
+  }
+  payload.resize(length);
+  if (!readFully(fd_, &payload[0], length)) {
+    closeAll(fds);
+    return false;
+  }
+
+  try {
+    message = JSON::parse(payload);
+  } catch (const std::exception &ex) {
+    LOG(ERROR) << "hot restart: bad message: " << ex.what();
+    closeAll(fds);
+    return false;
+  }
+  return true;
+}
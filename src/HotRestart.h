@@ -0,0 +1,113 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+//
+// Hot restart of sserver. A new sserver started with the same
+// sserver.hot_restart_socket takes over the listening sockets and the
+// authenticated sessions of the running one, so that miners stay connected
+// across a deployment:
+//
+//   1. the new process connects to the socket and gets the listening sockets
+//      while setting up, the old one keeps accepting meanwhile;
+//   2. once it has jobs of every chain, the new process asks for the
+//      sessions. The old one stops accepting and sends the sockets of the
+//      sessions with their state (SessionState), then drains the sessions
+//      which cannot be moved as in a graceful shutdown.
+//
+// Sockets are passed with SCM_RIGHTS over the UNIX socket. Every message is
+// a JSON object preceded by its length, the sockets go along with the length.
+//
+
+// State of a session moved to the new process, see
+// StratumSession::saveState()
+struct SessionState {
+  uint32_t sessionId_ = 0;
+  uint32_t clientIp_ = 0;
+  std::string clientAgent_;
+
+  size_t chainId_ = 0;
+  std::vector<int32_t> userIds_;
+  int64_t workerHashId_ = 0;
+  std::string fullName_;
+  std::string userName_;
+  std::string workerName_;
+
+  uint64_t curDiff_ = 0;
+  uint64_t minDiff_ = 0;
+
+  // chain specific state, e.g. the version mask of BTC sessions
+  std::map<std::string, uint64_t> extra_;
+  uint64_t extra(const std::string &key) const {
+    auto itr = extra_.find(key);
+    return itr == extra_.end() ? 0 : itr->second;
+  }
+
+  // bytes received but not handled yet, and bytes not sent yet
+  std::string input_;
+  std::string output_;
+};
+
+void to_json(nlohmann::json &j, const SessionState &state);
+void from_json(const nlohmann::json &j, SessionState &state);
+
+// Blocking channel between the old and the new process
+class HotRestartChannel {
+public:
+  // Maximum number of sockets in a message, below SCM_MAX_FD
+  static constexpr size_t kMaxFds = 128;
+  static constexpr size_t kMaxMessageSize = 64 * 1024 * 1024;
+  // Neither side waits longer for the other one
+  static constexpr time_t kTimeoutSeconds = 30;
+
+  // Takes the ownership of the socket and makes it blocking
+  explicit HotRestartChannel(int fd);
+  ~HotRestartChannel();
+
+  HotRestartChannel(const HotRestartChannel &) = delete;
+  HotRestartChannel &operator=(const HotRestartChannel &) = delete;
+
+  // Connect to the socket of the running process, returns nullptr if there
+  // is none
+  static std::unique_ptr<HotRestartChannel> connect(const std::string &path);
+
+  int fd() const { return fd_; }
+
+  // Send a message with at most kMaxFds sockets, the sockets are not closed
+  bool send(const nlohmann::json &message, const std::vector<int> &fds = {});
+  // Receive a message and the sockets sent with it, the caller owns them
+  bool receive(nlohmann::json &message, std::vector<int> &fds);
+
+private:
+  int fd_;
+};
@@ -22,6 +22,7 @@
  THE SOFTWARE.
  */
 #include "JobMaker.h"
+#include "Stratum.h"
 #include "Utils.h"
 
 ///////////////////////////////////  JobMaker  /////////////////////////////////
@@ -136,7 +137,13 @@ void JobMaker::produceStratumJob() {
   const string jobMsg = handler_->makeStratumJobMsg();
 
   if (!jobMsg.empty()) {
-    LOG(INFO) << "new " << handler_->def()->jobTopic_ << " job: " << jobMsg;
+    if ((uint8_t)jobMsg[0] == StratumJob::kBinaryMagic) {
+      // the handler logs the jobId and height of the job
+      LOG(INFO) << "new " << handler_->def()->jobTopic_
+                << " binary job, size: " << jobMsg.size();
+    } else {
+      LOG(INFO) << "new " << handler_->def()->jobTopic_ << " job: " << jobMsg;
+    }
     kafkaProducer_.produce(jobMsg.data(), jobMsg.size());
   }
 
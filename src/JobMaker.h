@@ -93,6 +93,9 @@ struct GbtJobMakerDefinition : public JobMakerDefinition {
   uint32_t auxmergedMiningNotifyPolicy_;
   uint32_t rskmergedMiningNotifyPolicy_;
   uint32_t vcashmergedMiningNotifyPolicy_;
+
+  // send jobs in the binary encoding instead of JSON
+  bool binaryJob_;
 };
 
 class JobMakerHandler {
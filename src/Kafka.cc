@@ -693,3 +693,76 @@ bool KafkaProducer::tryProduce(const void *payload, size_t len) {
 
   return res == 0;
 }
+
+///////////////////////////////// KafkaMessageBatch
+///////////////////////////////
+void KafkaMessageBatch::add(const void *payload, size_t len) {
+  const uint32_t size = len;
+  data_.append((const char *)&size, sizeof(size));
+  data_.append((const char *)payload, len);
+  count_++;
+  memcpy(&data_[sizeof(kMagic)], &count_, sizeof(count_));
+}
+
+bool KafkaMessageBatch::isBatch(const void *payload, size_t len) {
+  auto data = static_cast<const uint8_t *>(payload);
+  uint32_t magic = 0;
+  if (len >= kHeaderSize) {
+    memcpy(&magic, data, sizeof(magic));
+  }
+  if (magic != kMagic) {
+    return false;
+  }
+
+  uint32_t count;
+  memcpy(&count, data + sizeof(magic), sizeof(count));
+  size_t offset = kHeaderSize;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t size;
+    if (len - offset < sizeof(size)) {
+      return false;
+    }
+    memcpy(&size, data + offset, sizeof(size));
+    offset += sizeof(size);
+    if (len - offset < size) {
+      return false;
+    }
+    offset += size;
+  }
+  return offset == len;
+}
+
+void KafkaMessageBatch::clear() {
+  count_ = 0;
+  data_.resize(kHeaderSize);
+  const uint32_t magic = kMagic;
+  memcpy(&data_[0], &magic, sizeof(magic));
+  memcpy(&data_[sizeof(magic)], &count_, sizeof(count_));
+}
+
+////////////////////////////// KafkaBatchProducer
+//////////////////////////////
+void KafkaBatchProducer::produce(const void *payload, size_t len) {
+  KafkaMessageBatch full;
+  {
+    ScopeLock sl(lock_);
+    batch_.add(payload, len);
+    if (batch_.count() < maxCount_ && batch_.size() < maxBytes_) {
+      return;
+    }
+    batch_.swap(full);
+  }
+  producer_.produce(full.data().data(), full.size());
+}
+
+void KafkaBatchProducer::flush() {
+  KafkaMessageBatch batch;
+  {
+    ScopeLock sl(lock_);
+    if (batch_.count() == 0) {
+      return;
+    }
+    batch_.swap(batch);
+  }
+  producer_.produce(batch.data().data(), batch.size());
+}
@@ -28,6 +28,8 @@
 
 #include <librdkafka/rdkafka.h>
 
+#include <cstring>
+
 ///////////////////////////////////////////////////////////////////////
 // librdkafka options
 // https://github.com/edenhill/librdkafka/blob/master/CONFIGURATION.md
@@ -216,4 +218,94 @@ public:
   bool tryProduce(const void *payload, size_t len);
 };
 
+///////////////////////////////// KafkaMessageBatch
+///////////////////////////////
+//
+// Many small messages packed into one kafka message, to save the per-message
+// overhead of librdkafka and the brokers. Layout (native byte order, like the
+// version of the shares):
+//
+//   uint32_t kMagic | uint32_t count | count * (uint32_t size | size bytes)
+//
+// kMagic is not the version of any share, consumers call forEach() to accept
+// both batches and single messages. Raw share structs begin with other fields
+// (e.g. the jobId of ShareBitcoinV1) which may match kMagic, so a payload is
+// only taken as a batch if its sizes add up to the payload length.
+//
+class KafkaMessageBatch {
+public:
+  static constexpr uint32_t kMagic = 0xba7c0001u;
+  static constexpr size_t kHeaderSize = sizeof(uint32_t) * 2;
+
+  KafkaMessageBatch() { clear(); }
+
+  void add(const void *payload, size_t len);
+  void clear();
+  void swap(KafkaMessageBatch &other) {
+    data_.swap(other.data_);
+    std::swap(count_, other.count_);
+  }
+
+  size_t count() const { return count_; }
+  size_t size() const { return data_.size(); }
+  const string &data() const { return data_; }
+
+  // Whether the payload is a well-formed batch
+  static bool isBatch(const void *payload, size_t len);
+
+  // Call fn(const uint8_t *payload, size_t len) for every message of the
+  // batch, or once for the payload if it is not a batch (see isBatch()). A
+  // truncated batch is passed as a single message, whose decoding fails.
+  template <typename Fn>
+  static void forEach(const void *payload, size_t len, Fn &&fn) {
+    auto data = static_cast<const uint8_t *>(payload);
+    if (!isBatch(data, len)) {
+      fn(data, len);
+      return;
+    }
+
+    uint32_t count;
+    memcpy(&count, data + sizeof(kMagic), sizeof(count));
+    size_t offset = kHeaderSize;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t size;
+      memcpy(&size, data + offset, sizeof(size));
+      offset += sizeof(size);
+      fn(data + offset, (size_t)size);
+      offset += size;
+    }
+  }
+
+private:
+  string data_;
+  uint32_t count_;
+};
+
+////////////////////////////// KafkaBatchProducer
+//////////////////////////////
+//
+// Packs the messages produced by any thread into KafkaMessageBatch and sends
+// a batch when it reaches maxCount messages or maxBytes bytes. The owner
+// calls flush() every few milliseconds to bound the delay.
+//
+class KafkaBatchProducer {
+public:
+  KafkaBatchProducer(KafkaProducer &producer, size_t maxCount, size_t maxBytes)
+    : producer_(producer)
+    , maxCount_(maxCount)
+    , maxBytes_(maxBytes) {}
+  ~KafkaBatchProducer() { flush(); }
+
+  void produce(const void *payload, size_t len);
+  void flush();
+
+private:
+  KafkaProducer &producer_;
+  const size_t maxCount_;
+  const size_t maxBytes_;
+
+  mutex lock_;
+  KafkaMessageBatch batch_;
+};
+
 #endif
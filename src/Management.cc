@@ -213,7 +213,9 @@ void Management::handleMessage(rd_kafka_message_t *rkmessage) {
       }
 
       if (action == "get_status") {
-        server_.dispatch([this, id]() {
+        // count the sessions in the reactors first, so the status has the
+        // current ones
+        server_.refreshSessionStates([this, id]() {
           JSON response =
               getConfigureAndStatus("sserver_response", "get_status");
           response["id"] = id;
@@ -332,6 +334,8 @@ static const char *FormatSessionStatus(int status) {
     return "connected";
   case StratumSession::SUBSCRIBED:
     return "subscribed";
+  case StratumSession::AUTHORIZING:
+    return "authorizing";
   case StratumSession::AUTO_REGISTING:
     return "registering";
   case StratumSession::AUTHENTICATED:
@@ -357,7 +361,7 @@ JSON Management::getServerBriefDesc(const string &type, const string &action) {
            {"uptime", uptime_},
            {"connections",
             {
-                {"count", server_.connections_.size()},
+                {"count", server_.connectionsCount()},
             }},
        }},
   };
@@ -384,7 +388,7 @@ JSON Management::getConfigureAndStatus(
     };
 
     std::map<string, size_t> shareStats;
-    for (const auto &stats : itr.shareStats_) {
+    for (const auto &stats : server_.shareStats(i)) {
       shareStats[std::to_string(stats.first)] = stats.second;
     }
 
@@ -459,9 +463,10 @@ JSON Management::getConfigureAndStatus(
   };
 
   std::map<string, std::map<string, size_t>> sessions;
-  for (auto &session : server_.connections_) {
-    ++(sessions[server_.chainName(session->getChainId())]
-               [FormatSessionStatus(session->getState())]);
+  time_t sessionsCountedAt = 0;
+  for (auto &s : server_.sessionStates(&sessionsCountedAt)) {
+    sessions[server_.chainName(s.first.first)]
+            [FormatSessionStatus(s.first.second)] += s.second;
   }
 
   JSON json = {
@@ -479,8 +484,9 @@ JSON Management::getConfigureAndStatus(
            {"uptime", uptime_},
            {"connections",
             {
-                {"count", server_.connections_.size()},
+                {"count", server_.connectionsCount()},
                 {"state", sessions},
+                {"state_counted_at", sessionsCountedAt},
             }},
            {"chains", chainStatus},
        }},
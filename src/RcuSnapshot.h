@@ -0,0 +1,175 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//
+// An immutable value read by many threads without locking, in the spirit of
+// RCU: writers publish a new snapshot instead of modifying the current one.
+//
+// Each reader thread caches the last snapshot it has read, so a read only
+// loads the version of the latest snapshot, and the lock is taken once per
+// thread to pick up a new snapshot. The latest snapshot stays cached until it
+// is replaced. Replaced snapshots, and those of destroyed RcuSnapshot<T>s,
+// are dropped by the next read of any RcuSnapshot<T> by the thread (checked
+// with a generation bumped by publish() and the destructor), or by
+// releaseCached(). A replaced snapshot is released when the last thread
+// caching it drops it.
+//
+template <typename T>
+class RcuSnapshot {
+public:
+  RcuSnapshot()
+    : RcuSnapshot(std::make_shared<const T>()) {}
+  explicit RcuSnapshot(std::shared_ptr<const T> value)
+    : id_(nextVersion()) {
+    publish(std::move(value));
+  }
+  RcuSnapshot(const RcuSnapshot &) = delete;
+  RcuSnapshot &operator=(const RcuSnapshot &) = delete;
+  ~RcuSnapshot() {
+    auto &registry = Registry::instance();
+    std::lock_guard<std::mutex> lock(registry.lock_);
+    registry.versions_.erase(id_);
+    registry.generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  void publish(std::shared_ptr<const T> value) {
+    std::lock_guard<std::mutex> lock(lock_);
+    value_ = std::move(value);
+    const uint64_t version = nextVersion();
+    version_.store(version, std::memory_order_release);
+
+    auto &registry = Registry::instance();
+    std::lock_guard<std::mutex> registryLock(registry.lock_);
+    registry.versions_[id_] = version;
+    registry.generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  // The latest snapshot. The reference is valid until this RcuSnapshot
+  // publishes a new snapshot and the calling thread then reads any
+  // RcuSnapshot<T> or calls releaseCached().
+  const T &read() const {
+    Cache &cache = threadCache();
+    const uint64_t generation =
+        Registry::instance().generation_.load(std::memory_order_acquire);
+    if (cache.generation_ != generation) {
+      cache.dropStale(generation);
+    }
+
+    Cached &cached = cache.of(id_);
+    if (cached.version_ != version_.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(lock_);
+      cached.value_ = value_;
+      cached.version_ = version_.load(std::memory_order_relaxed);
+    }
+    return *cached.value_;
+  }
+
+  // The latest snapshot shared with the caller, for keeping it for long
+  std::shared_ptr<const T> get() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return value_;
+  }
+
+  // Drops all the snapshots of RcuSnapshot<T>s cached by the calling thread,
+  // e.g. before it sleeps, so that an idle thread keeps no replaced snapshot
+  // alive. References returned by read() to the thread are invalidated.
+  static void releaseCached() { threadCache().caches_.clear(); }
+
+private:
+  struct Cached {
+    uint64_t id_;
+    uint64_t version_;
+    std::shared_ptr<const T> value_;
+  };
+
+  // The latest versions of the live RcuSnapshot<T>s, only looked up by the
+  // reader threads once per generation
+  struct Registry {
+    std::mutex lock_;
+    std::unordered_map<uint64_t /* id */, uint64_t /* version */> versions_;
+    std::atomic<uint64_t> generation_{0};
+
+    static Registry &instance() {
+      static Registry registry;
+      return registry;
+    }
+  };
+
+  struct Cache {
+    uint64_t generation_ = 0;
+    std::vector<Cached> caches_;
+
+    Cached &of(uint64_t id) {
+      for (auto &cached : caches_) {
+        if (cached.id_ == id) {
+          return cached;
+        }
+      }
+      caches_.push_back({id, 0, nullptr});
+      return caches_.back();
+    }
+
+    void dropStale(uint64_t generation) {
+      auto &registry = Registry::instance();
+      std::lock_guard<std::mutex> lock(registry.lock_);
+      caches_.erase(
+          std::remove_if(
+              caches_.begin(),
+              caches_.end(),
+              [&](const Cached &cached) {
+                auto itr = registry.versions_.find(cached.id_);
+                return itr == registry.versions_.end() ||
+                    itr->second != cached.version_;
+              }),
+          caches_.end());
+      generation_ = generation;
+    }
+  };
+
+  static uint64_t nextVersion() {
+    static std::atomic<uint64_t> version{0};
+    return ++version;
+  }
+
+  static Cache &threadCache() {
+    thread_local Cache cache;
+    return cache;
+  }
+
+  // Versions and ids are unique among all the RcuSnapshot<T>s, so a cache
+  // left by a destroyed one never matches
+  const uint64_t id_;
+  std::atomic<uint64_t> version_{0};
+  mutable std::mutex lock_;
+  std::shared_ptr<const T> value_;
+};
@@ -84,6 +84,7 @@ class ShareLogWriterT : public ShareLogWriter,
   KafkaHighLevelConsumer hlConsumer_; // consume topic: shareLogTopic
 
   void consumeShareLog(rd_kafka_message_t *rkmessage);
+  void consumeShare(const uint8_t *payload, size_t len);
 
 public:
   ShareLogWriterT(
@@ -83,6 +83,8 @@ void ShareLogWriterBase<SHARE>::addShare(SHARE &&share) {
   DLOG(INFO) << share.toString();
 
   if (share.isValid()) {
+    // the binlog keeps the IP as a string
+    share.formatIp();
     shares_.push_back(share);
   } else {
     LOG(ERROR) << "invalid share";
@@ -208,6 +210,17 @@ void ShareLogWriterT<SHARE>::consumeShareLog(rd_kafka_message_t *rkmessage) {
     return;
   }
 
+  // a single share or a batch of shares
+  KafkaMessageBatch::forEach(
+      rkmessage->payload,
+      rkmessage->len,
+      [this](const uint8_t *payload, size_t len) {
+        consumeShare(payload, len);
+      });
+}
+
+template <class SHARE>
+void ShareLogWriterT<SHARE>::consumeShare(const uint8_t *payload, size_t len) {
   SHARE share;
 
   // if (rkmessage->len < sizeof(uint32_t)) {
@@ -231,10 +244,8 @@ void ShareLogWriterT<SHARE>::consumeShareLog(rd_kafka_message_t *rkmessage) {
   //   rkmessage->len ; return;
   // }
 
-  if (!share.UnserializeWithVersion(
-          (const uint8_t *)(rkmessage->payload), rkmessage->len)) {
-    LOG(ERROR) << "parse share from kafka message failed rkmessage->len = "
-               << rkmessage->len;
+  if (!share.UnserializeWithVersion(payload, len)) {
+    LOG(ERROR) << "parse share from kafka message failed len = " << len;
     return;
   }
 
@@ -0,0 +1,224 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#include "SlabAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+thread_local SlabAllocator::FreeList
+    SlabAllocator::threadLists_[SlabAllocator::kNumClasses];
+thread_local bool SlabAllocator::threadExited_ = false;
+
+// Returns the blocks cached by a thread when it exits
+struct SlabAllocator::ThreadCacheFlusher {
+  ~ThreadCacheFlusher() {
+    threadExited_ = true;
+    SlabAllocator::instance().flushThreadCache();
+  }
+};
+
+void SlabAllocator::registerThreadCache() {
+  // constructed on the first use by the thread, so that its destructor runs
+  // when the thread exits
+  static thread_local ThreadCacheFlusher flusher;
+  (void)flusher;
+}
+
+SlabAllocator &SlabAllocator::instance() {
+  // never destroyed, blocks may be freed by static destructors
+  static SlabAllocator *allocator = new SlabAllocator;
+  return *allocator;
+}
+
+size_t SlabAllocator::batchSize(size_t index) {
+  // a batch takes at most a quarter of an arena
+  const size_t blockSize = (index + 1) * kAlignment;
+  return std::max<size_t>(
+      1, std::min(kMaxBatchSize, kArenaSize / 4 / blockSize));
+}
+
+void *SlabAllocator::allocate(size_t size) {
+  if (size > kMaxBlockSize) {
+    return ::operator new(size);
+  }
+  const size_t index = classIndex(size);
+  auto &list = threadLists_[index];
+  if (list.head_ == nullptr) {
+    refill(index, list);
+  }
+  FreeBlock *block = list.head_;
+  list.head_ = block->next_;
+  list.size_--;
+  return block;
+}
+
+void SlabAllocator::deallocate(void *block, size_t size) {
+  if (block == nullptr) {
+    return;
+  }
+  if (size > kMaxBlockSize) {
+    ::operator delete(block);
+    return;
+  }
+  const size_t index = classIndex(size);
+  auto &list = threadLists_[index];
+  if (list.head_ == nullptr && !threadExited_) {
+    registerThreadCache();
+  }
+  auto freeBlock = static_cast<FreeBlock *>(block);
+  freeBlock->next_ = list.head_;
+  list.head_ = freeBlock;
+  list.size_++;
+  if (threadExited_) {
+    release(index, list, list.size_);
+  } else if (list.size_ > 2 * batchSize(index)) {
+    release(index, list, batchSize(index));
+  }
+}
+
+void SlabAllocator::flushThreadCache() {
+  for (size_t index = 0; index < kNumClasses; index++) {
+    auto &list = threadLists_[index];
+    if (list.size_ > 0) {
+      release(index, list, list.size_);
+    }
+  }
+}
+
+void SlabAllocator::refill(size_t index, FreeList &list) {
+  size_t count = 1;
+  if (!threadExited_) {
+    registerThreadCache();
+    count = batchSize(index);
+  }
+
+  const size_t blockSize = (index + 1) * kAlignment;
+  auto &sizeClass = classes_[index];
+  std::lock_guard<std::mutex> lock(sizeClass.lock_);
+  for (size_t i = 0; i < count; i++) {
+    Arena *arena = sizeClass.available_;
+    if (arena == nullptr) {
+      void *memory = std::aligned_alloc(kArenaSize, kArenaSize);
+      if (memory == nullptr) {
+        if (list.head_ != nullptr) {
+          return;
+        }
+        throw std::bad_alloc();
+      }
+      arena = static_cast<Arena *>(memory);
+      arena->freeBlocks_ = nullptr;
+      arena->unused_ = static_cast<char *>(memory) + kArenaHeaderSize;
+      arena->usedBlocks_ = 0;
+      sizeClass.arenas_++;
+      sizeClass.emptyArenas_++;
+      linkArena(sizeClass, arena);
+    }
+
+    FreeBlock *block;
+    if (arena->freeBlocks_ != nullptr) {
+      block = arena->freeBlocks_;
+      arena->freeBlocks_ = block->next_;
+    } else {
+      block = reinterpret_cast<FreeBlock *>(arena->unused_);
+      arena->unused_ += blockSize;
+    }
+    if (arena->usedBlocks_++ == 0) {
+      sizeClass.emptyArenas_--;
+    }
+    sizeClass.usedBlocks_++;
+    if (arena->freeBlocks_ == nullptr &&
+        reinterpret_cast<char *>(arena) + kArenaSize - arena->unused_ <
+            (ptrdiff_t)blockSize) {
+      unlinkArena(sizeClass, arena);
+    }
+
+    block->next_ = list.head_;
+    list.head_ = block;
+    list.size_++;
+  }
+}
+
+void SlabAllocator::release(size_t index, FreeList &list, size_t count) {
+  auto &sizeClass = classes_[index];
+  std::lock_guard<std::mutex> lock(sizeClass.lock_);
+  for (size_t i = 0; i < count; i++) {
+    FreeBlock *block = list.head_;
+    list.head_ = block->next_;
+    list.size_--;
+
+    auto arena = reinterpret_cast<Arena *>(
+        reinterpret_cast<uintptr_t>(block) & ~(uintptr_t)(kArenaSize - 1));
+    block->next_ = arena->freeBlocks_;
+    arena->freeBlocks_ = block;
+    sizeClass.usedBlocks_--;
+    if (!arena->available_) {
+      linkArena(sizeClass, arena);
+    }
+    if (--arena->usedBlocks_ == 0) {
+      if (sizeClass.emptyArenas_ > 0) {
+        unlinkArena(sizeClass, arena);
+        std::free(arena);
+        sizeClass.arenas_--;
+      } else {
+        sizeClass.emptyArenas_++;
+      }
+    }
+  }
+}
+
+void SlabAllocator::linkArena(SizeClass &sizeClass, Arena *arena) {
+  arena->prev_ = nullptr;
+  arena->next_ = sizeClass.available_;
+  if (arena->next_ != nullptr) {
+    arena->next_->prev_ = arena;
+  }
+  sizeClass.available_ = arena;
+  arena->available_ = true;
+}
+
+void SlabAllocator::unlinkArena(SizeClass &sizeClass, Arena *arena) {
+  if (arena->prev_ != nullptr) {
+    arena->prev_->next_ = arena->next_;
+  } else {
+    sizeClass.available_ = arena->next_;
+  }
+  if (arena->next_ != nullptr) {
+    arena->next_->prev_ = arena->prev_;
+  }
+  arena->available_ = false;
+}
+
+std::vector<SlabAllocator::Usage> SlabAllocator::usage() {
+  std::vector<Usage> result;
+  for (size_t i = 0; i < kNumClasses; i++) {
+    auto &sizeClass = classes_[i];
+    std::lock_guard<std::mutex> lock(sizeClass.lock_);
+    if (sizeClass.arenas_ > 0) {
+      result.push_back(
+          {(i + 1) * kAlignment, sizeClass.arenas_, sizeClass.usedBlocks_});
+    }
+  }
+  return result;
+}
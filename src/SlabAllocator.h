@@ -0,0 +1,164 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+//
+// Fixed-size blocks for small long-lived objects such as sessions and their
+// local jobs. Blocks of the same size class (a multiple of 16 bytes) are
+// carved from 64 KB arenas, so there is no per-block malloc header and no
+// fragmentation between size classes. Larger requests go to operator new.
+//
+// Each thread keeps a free list per size class, refilled from and returned
+// to the shared pool in batches, so the reactors don't contend on a lock for
+// every block. An arena is freed once all its blocks are back in the pool,
+// except one empty arena per size class kept for the next blocks.
+//
+class SlabAllocator {
+public:
+  static constexpr size_t kAlignment = 16;
+  static constexpr size_t kMaxBlockSize = 4096;
+  static constexpr size_t kArenaSize = 64 * 1024;
+  // Most blocks moved between a thread and the shared pool at a time
+  static constexpr size_t kMaxBatchSize = 32;
+
+  struct Usage {
+    size_t blockSize_;
+    size_t arenas_;
+    // blocks taken from the shared pool, in use or cached by the threads
+    size_t usedBlocks_;
+  };
+
+  static SlabAllocator &instance();
+
+  void *allocate(size_t size);
+  // The size should be the same as the one passed to allocate()
+  void deallocate(void *block, size_t size);
+
+  // The memory taken by a block of the size
+  static size_t blockSize(size_t size) {
+    return size <= kMaxBlockSize ? (size + kAlignment - 1) & ~(kAlignment - 1)
+                                 : size;
+  }
+
+  // Usage of the size classes that have arenas
+  std::vector<Usage> usage();
+
+  // Return the blocks cached by the calling thread to the shared pool. It's
+  // done when the thread exits.
+  void flushThreadCache();
+
+private:
+  static constexpr size_t kNumClasses = kMaxBlockSize / kAlignment;
+
+  struct FreeBlock {
+    FreeBlock *next_;
+  };
+
+  struct FreeList {
+    FreeBlock *head_;
+    size_t size_;
+  };
+
+  // Header at the beginning of an arena. Arenas are aligned to their size,
+  // so the arena of a block is found by masking its address.
+  struct Arena {
+    // in the list of arenas with free blocks of the size class
+    Arena *prev_;
+    Arena *next_;
+    bool available_;
+    FreeBlock *freeBlocks_;
+    // the uncarved tail
+    char *unused_;
+    size_t usedBlocks_;
+  };
+  static constexpr size_t kArenaHeaderSize =
+      (sizeof(Arena) + kAlignment - 1) & ~(kAlignment - 1);
+
+  struct SizeClass {
+    std::mutex lock_;
+    Arena *available_ = nullptr;
+    size_t arenas_ = 0;
+    size_t emptyArenas_ = 0;
+    size_t usedBlocks_ = 0;
+  };
+
+  static size_t classIndex(size_t size) {
+    return blockSize(size == 0 ? 1 : size) / kAlignment - 1;
+  }
+  static size_t batchSize(size_t index);
+
+  // Move a batch of blocks from the shared pool to the list
+  void refill(size_t index, FreeList &list);
+  // Move count blocks from the list back to the shared pool
+  void release(size_t index, FreeList &list, size_t count);
+  void linkArena(SizeClass &sizeClass, Arena *arena);
+  void unlinkArena(SizeClass &sizeClass, Arena *arena);
+
+  SizeClass classes_[kNumClasses];
+
+  // The free lists of the calling thread, indexed by size class
+  static thread_local FreeList threadLists_[kNumClasses];
+  // Blocks go straight to the shared pool after the thread cache is flushed
+  // at thread exit
+  static thread_local bool threadExited_;
+  struct ThreadCacheFlusher;
+  // Flush the free lists of the calling thread when it exits
+  static void registerThreadCache();
+};
+
+// STL allocator on the slab, for node based containers
+template <typename T>
+class SlabStlAllocator {
+public:
+  using value_type = T;
+
+  SlabStlAllocator() = default;
+  template <typename U>
+  SlabStlAllocator(const SlabStlAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(
+        SlabAllocator::instance().allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    SlabAllocator::instance().deallocate(p, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const SlabStlAllocator<U> &) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const SlabStlAllocator<U> &) const {
+    return false;
+  }
+};
@@ -35,6 +35,12 @@ class StatsWindow {
   int64_t maxRingIdx_; // max ring idx
   int32_t windowSize_;
   std::vector<T> elements_;
+  T total_; // sum of elements_, kept by insert() and map*()
+  // The running total of a floating point T drifts by rounding, it's summed
+  // from elements_ again when maxRingIdx_ reaches this, once per rotation
+  int64_t recountRingIdx_;
+
+  T recount() const;
 
 public:
   StatsWindow(const int windowSize);
@@ -24,26 +24,67 @@
 
 #include "Stratum.h"
 
+#include <type_traits>
+
 ////////////////////////////////// StatsWindow /////////////////////////////////
 template <typename T>
 StatsWindow<T>::StatsWindow(const int windowSize)
   : maxRingIdx_(-1)
   , windowSize_(windowSize)
-  , elements_(windowSize) {
+  , elements_(windowSize)
+  , total_(0)
+  , recountRingIdx_(-1) {
 }
 
+template <typename T>
+T StatsWindow<T>::recount() const {
+  T total = 0;
+  for (const T &element : elements_) {
+    total += element;
+  }
+  return total;
+}
+
+// The sums of integers are exact in any order, so they are vectorized along
+// with the map. Floating point ones are summed in order, like recount().
 template <typename T>
 void StatsWindow<T>::mapMultiply(const T val) {
+  T *elements = elements_.data();
+  if (std::is_floating_point<T>::value) {
+#pragma omp simd
+    for (int32_t i = 0; i < windowSize_; i++) {
+      elements[i] *= val;
+    }
+    total_ = recount();
+    return;
+  }
+  T total = 0;
+#pragma omp simd reduction(+ : total)
   for (int32_t i = 0; i < windowSize_; i++) {
-    elements_[i] *= val;
+    elements[i] *= val;
+    total += elements[i];
   }
+  total_ = total;
 }
 
 template <typename T>
 void StatsWindow<T>::mapDivide(const T val) {
+  T *elements = elements_.data();
+  if (std::is_floating_point<T>::value) {
+#pragma omp simd
+    for (int32_t i = 0; i < windowSize_; i++) {
+      elements[i] /= val;
+    }
+    total_ = recount();
+    return;
+  }
+  T total = 0;
+#pragma omp simd reduction(+ : total)
   for (int32_t i = 0; i < windowSize_; i++) {
-    elements_[i] /= val;
+    elements[i] /= val;
+    total += elements[i];
   }
+  total_ = total;
 }
 
 template <typename T>
@@ -51,6 +92,8 @@ void StatsWindow<T>::clear() {
   maxRingIdx_ = -1;
   elements_.clear();
   elements_.resize(windowSize_);
+  total_ = 0;
+  recountRingIdx_ = -1;
 }
 
 template <typename T>
@@ -67,10 +110,17 @@ bool StatsWindow<T>::insert(const int64_t curRingIdx, const T val) {
 
   while (maxRingIdx_ < curRingIdx) {
     maxRingIdx_++;
-    elements_[maxRingIdx_ % windowSize_] = 0; // reset
+    T &expired = elements_[maxRingIdx_ % windowSize_];
+    total_ -= expired;
+    expired = 0; // reset
+  }
+  if (std::is_floating_point<T>::value && maxRingIdx_ >= recountRingIdx_) {
+    total_ = recount();
+    recountRingIdx_ = maxRingIdx_ + windowSize_;
   }
 
   elements_[curRingIdx % windowSize_] += val;
+  total_ += val;
   return true;
 }
 
@@ -81,7 +131,27 @@ T StatsWindow<T>::sum(int64_t beginRingIdx, int len) {
   if (len <= 0 || beginRingIdx - len >= maxRingIdx_) {
     return 0;
   }
-  int64_t endRingIdx = beginRingIdx - len;
+  // There are no elements before ring idx 0, the ring may not have filled
+  // once yet
+  int64_t endRingIdx = std::max<int64_t>(beginRingIdx - len, -1);
+
+  // The range (endRingIdx, maxRingIdx_] is the tail of the live ring, take
+  // it from the running total and add or subtract the shorter part.
+  if (beginRingIdx >= maxRingIdx_) {
+    const int64_t firstRingIdx =
+        std::max<int64_t>(maxRingIdx_ - windowSize_, -1);
+    if (endRingIdx == firstRingIdx) {
+      return total_;
+    }
+    if (endRingIdx - firstRingIdx < maxRingIdx_ - endRingIdx) {
+      sum = total_;
+      for (int64_t i = endRingIdx; i > firstRingIdx; i--) {
+        sum -= elements_[i % windowSize_];
+      }
+      return sum;
+    }
+  }
+
   if (beginRingIdx > maxRingIdx_) {
     beginRingIdx = maxRingIdx_;
   }
@@ -266,6 +266,7 @@ public:
 protected:
   void runThreadConsume();
   void consumeShareLog(rd_kafka_message_t *rkmessage);
+  void consumeShare(const uint8_t *payload, size_t len);
 
   void runThreadConsumeCommonEvents();
   void consumeCommonEvents(rd_kafka_message_t *rkmessage);
@@ -61,7 +61,7 @@ void WorkerShares<SHARE>::processShare(SHARE &share, bool acceptStale) {
         rejectShareTime(share.timestamp()), share.sharediff());
   }
 
-  lastShareIP_.fromString(share.ip());
+  lastShareIP_ = share.getIp();
   lastShareTime_ = share.timestamp();
 }
 
@@ -1191,12 +1191,21 @@ void StatsServerT<SHARE>::consumeShareLog(rd_kafka_message_t *rkmessage) {
     return;
   }
 
+  // a single share or a batch of shares
+  KafkaMessageBatch::forEach(
+      rkmessage->payload,
+      rkmessage->len,
+      [this](const uint8_t *payload, size_t len) {
+        consumeShare(payload, len);
+      });
+}
+
+template <class SHARE>
+void StatsServerT<SHARE>::consumeShare(const uint8_t *payload, size_t len) {
   SHARE share;
 
-  if (!share.UnserializeWithVersion(
-          (const uint8_t *)(rkmessage->payload), rkmessage->len)) {
-    LOG(ERROR) << "parse share from kafka message failed rkmessage->len = "
-               << rkmessage->len;
+  if (!share.UnserializeWithVersion(payload, len)) {
+    LOG(ERROR) << "parse share from kafka message failed len = " << len;
     return;
   }
 
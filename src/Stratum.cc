@@ -98,6 +98,8 @@ const char *StratumStatus::toString(int err) {
     return "Job not found";
   case STALE_SHARE:
     return "Stale share";
+  case TOO_MANY_SHARES:
+    return "Too many shares";
 
 #ifdef WORK_WITH_STRATUM_SWITCHER
   case CLIENT_IS_NOT_SWITCHER:
@@ -215,3 +217,10 @@ StratumJob::StratumJob()
 
 StratumJob::~StratumJob() {
 }
+
+bool StratumJob::unserialize(const char *s, size_t len) {
+  if (len > 0 && (uint8_t)s[0] == kBinaryMagic) {
+    return unserializeFromBinary(s, len);
+  }
+  return unserializeFromJson(s, len);
+}
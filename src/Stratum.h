@@ -24,11 +24,14 @@
 #ifndef STRATUM_H_
 #define STRATUM_H_
 
+#include <cstring>
 #include <functional>
+#include <type_traits>
 
 #include "Common.h"
 #include "Utils.h"
 #include "Network.h"
+#include "SlabAllocator.h"
 
 // default worker name
 #define DEFAULT_WORKER_NAME "__default__"
@@ -92,6 +95,7 @@ public:
 
     JOB_NOT_FOUND = 36,
     STALE_SHARE = 37,
+    TOO_MANY_SHARES = 38,
 
 #ifdef WORK_WITH_STRATUM_SWITCHER
     CLIENT_IS_NOT_SWITCHER = 400,
@@ -205,6 +209,19 @@ public:
 
   virtual string serializeToJson() const = 0;
   virtual bool unserializeFromJson(const char *s, size_t len) = 0;
+
+  // The binary encoding of a job:
+  //     | kBinaryMagic(1) | version(1) | payload |
+  // It never begins with '{' like the JSON encoding. Chains without one
+  // return an empty string.
+  static constexpr uint8_t kBinaryMagic = 0x00;
+  virtual string serializeToBinary() const { return ""; }
+  virtual bool unserializeFromBinary(const char *s, size_t len) {
+    return false;
+  }
+  // Decode a job in either encoding
+  bool unserialize(const char *s, size_t len);
+
   virtual uint32_t jobTime() const { return jobId2Time(jobId_); }
   virtual uint64_t height() const = 0;
 };
@@ -248,24 +265,300 @@ struct LocalShare {
     }
     return false;
   }
+
+  bool operator==(const LocalShare &r) const {
+    return exNonce2_ == r.exNonce2_ && nonce_ == r.nonce_ &&
+        time_ == r.time_ && versionMask_ == r.versionMask_;
+  }
+
+  // never be 0, which marks an empty slot of LocalShareSet
+  uint64_t fingerprint() const {
+    uint64_t h = exNonce2_ * 0x9E3779B97F4A7C15ULL;
+    h ^= (((uint64_t)nonce_ << 32) | time_) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= versionMask_ * 0x165667B19E3779F9ULL;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 29;
+    return h != 0 ? h : 1;
+  }
+};
+
+// Shares of a local job, for duplicate share check.
+// A flat open addressing (linear probing) hash set over the fingerprints
+// of shares, the shares are kept in the slots for exact verification.
+class LocalShareSet {
+public:
+  // Default memory cap of a job: 2^17 slots * 32 bytes = 4 MB. It's far
+  // more than a normal session needs, see sserver.max_job_shares.
+  static constexpr size_t kMaxSize = 65536;
+  // Default memory cap of the shares of all jobs of a session (see
+  // LocalJobRing), or a session could hold 256 jobs * kMaxSize shares, see
+  // sserver.max_session_shares.
+  static constexpr size_t kMaxSessionSize = 4 * kMaxSize;
+
+  enum class InsertResult { INSERTED, DUPLICATE, FULL };
+
+  // The share is not inserted if it exists or the set already has maxSize
+  // shares.
+  InsertResult insert(const LocalShare &share, size_t maxSize = SIZE_MAX) {
+    const uint64_t fingerprint = share.fingerprint();
+    if (slots_.empty()) {
+      slots_.resize(kInitialSlots);
+    }
+
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = fingerprint & mask;; i = (i + 1) & mask) {
+      const Slot &slot = slots_[i];
+      if (slot.fingerprint_ == 0) {
+        break;
+      }
+      if (slot.fingerprint_ == fingerprint && slot.share_ == share) {
+        return InsertResult::DUPLICATE;
+      }
+    }
+
+    if (size_ >= maxSize) {
+      return InsertResult::FULL;
+    }
+    // keep the load factor <= 3/4
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      grow();
+    }
+    place(fingerprint, share);
+    size_++;
+    return InsertResult::INSERTED;
+  }
+
+  size_t size() const { return size_; }
+  size_t memoryUsage() const { return slots_.capacity() * sizeof(Slot); }
+
+private:
+  static constexpr size_t kInitialSlots = 16;
+
+  struct Slot {
+    uint64_t fingerprint_ = 0; // 0: empty
+    LocalShare share_{0, 0, 0, 0};
+  };
+
+  void place(uint64_t fingerprint, const LocalShare &share) {
+    const size_t mask = slots_.size() - 1;
+    size_t i = fingerprint & mask;
+    while (slots_[i].fingerprint_ != 0) {
+      i = (i + 1) & mask;
+    }
+    slots_[i].fingerprint_ = fingerprint;
+    slots_[i].share_ = share;
+  }
+
+  void grow() {
+    std::vector<Slot> slots(slots_.size() * 2);
+    slots_.swap(slots);
+    for (const auto &slot : slots) {
+      if (slot.fingerprint_ != 0) {
+        place(slot.fingerprint_, slot.share_);
+      }
+    }
+  }
+
+  std::vector<Slot> slots_; // size: 0 or power of 2
+  size_t size_ = 0;
+};
+
+// Caps of the shares kept by the local jobs of a session, the shares beyond
+// them are rejected with TOO_MANY_SHARES. The caps of an agent session are
+// scaled by the number of its sub-sessions, which share its local jobs.
+struct LocalShareQuota {
+  size_t maxJobShares_ = LocalShareSet::kMaxSize;
+  size_t maxSessionShares_ = LocalShareSet::kMaxSessionSize;
+  // The shares of all jobs of the session
+  size_t shares_ = 0;
 };
 
 struct LocalJob {
   size_t chainId_;
   uint64_t jobId_;
-  std::set<LocalShare> submitShares_;
+  LocalShareSet submitShares_;
+  // The quota of the session, set by LocalJobRing
+  LocalShareQuota *quota_ = nullptr;
 
   LocalJob(size_t chainId, uint64_t jobId)
     : chainId_(chainId)
     , jobId_(jobId) {}
 
-  bool addLocalShare(const LocalShare &localShare) {
-    return submitShares_.insert(localShare).second;
-  }
+  // Returns StratumStatus::ACCEPT if the share is added, otherwise the share
+  // should be rejected with the returned status: DUPLICATE_SHARE, or
+  // TOO_MANY_SHARES if the job or the session already has too many shares,
+  // see LocalShareQuota.
+  int32_t addLocalShare(const LocalShare &localShare);
 
   bool operator==(uint64_t jobId) const { return jobId_ == jobId; }
+  uint64_t key() const { return jobId_; }
+};
+
+// Local jobs of a session, oldest first, with constant time lookups.
+// A job is looked up by its key(): the 8-bit short job id of the chains
+// that have one, which indexes the table directly, or the job id / hash of
+// the other chains, which is hashed into a linear probing table.
+// Jobs are never moved, pointers to them are valid until they are popped.
+// Nothing is allocated before the first job, so idle sessions stay small.
+template <typename LocalJobType>
+class LocalJobRing {
+  using Jobs = std::deque<LocalJobType, SlabStlAllocator<LocalJobType>>;
+
+public:
+  using KeyType =
+      std::decay_t<decltype(std::declval<const LocalJobType &>().key())>;
+  using iterator = typename Jobs::iterator;
+
+  explicit LocalJobRing(size_t capacity)
+    : capacity_(capacity) {}
+
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return jobs_ ? jobs_->size() : 0; }
+  bool empty() const { return size() == 0; }
+  bool full() const { return size() >= capacity_; }
+  LocalJobType &front() { return jobs_->front(); }
+  LocalJobType &back() { return jobs_->back(); }
+  // value-initialized iterators of an empty ring compare equal
+  iterator begin() { return jobs_ ? jobs_->begin() : iterator(); }
+  iterator end() { return jobs_ ? jobs_->end() : iterator(); }
+
+  // Approximate heap memory used by the jobs and the index
+  size_t memoryUsage() const {
+    if (!jobs_) {
+      return 0;
+    }
+    size_t usage = sizeof(Jobs) + index_.capacity() * sizeof(LocalJobType *);
+    for (const auto &job : *jobs_) {
+      usage += sizeof(LocalJobType) + job.submitShares_.memoryUsage();
+    }
+    return usage;
+  }
+
+  template <typename Key>
+  LocalJobType *find(const Key &key) {
+    if (index_.empty()) {
+      return nullptr;
+    }
+    const size_t mask = index_.size() - 1;
+    size_t i = slotOf(key) & mask;
+    for (size_t n = 0; n < index_.size() && index_[i] != nullptr; n++) {
+      if (*index_[i] == key) {
+        return index_[i];
+      }
+      i = (i + 1) & mask;
+    }
+    return nullptr;
+  }
+
+  // The caller should pop_front() first if the ring is full
+  template <typename... Args>
+  LocalJobType &emplace_back(Args &&... args) {
+    assert(!full());
+    if (index_.empty()) {
+      index_.resize(indexSize());
+      jobs_ = std::make_unique<Jobs>();
+    }
+    jobs_->emplace_back(std::forward<Args>(args)...);
+    auto &job = jobs_->back();
+    job.quota_ = &quota_;
+    const size_t mask = index_.size() - 1;
+    size_t i = slotOf(job.key()) & mask;
+    while (index_[i] != nullptr) {
+      i = (i + 1) & mask;
+    }
+    index_[i] = &job;
+    return job;
+  }
+
+  void pop_front() {
+    quota_.shares_ -= jobs_->front().submitShares_.size();
+    erase(&jobs_->front());
+    jobs_->pop_front();
+  }
+
+  // The number of shares of all jobs
+  size_t shares() const { return quota_.shares_; }
+
+  // The caps of the shares of a job and of all jobs, the shares already kept
+  // are not evicted if they are lowered.
+  void setShareLimits(size_t maxJobShares, size_t maxSessionShares) {
+    quota_.maxJobShares_ = maxJobShares;
+    quota_.maxSessionShares_ = maxSessionShares;
+  }
+
+private:
+  // Short job ids index the slots directly, other keys keep the load factor
+  // <= 1/2.
+  size_t indexSize() const {
+    size_t minSize = std::is_same<KeyType, uint8_t>::value
+        ? std::max<size_t>(capacity_, 256)
+        : capacity_ * 2;
+    size_t size = 16;
+    while (size < minSize) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  static size_t slotOf(const KeyType &key) { return hashKey(key); }
+  static size_t hashKey(const std::string &key) {
+    return std::hash<std::string>()(key);
+  }
+  template <typename Integer>
+  static size_t hashKey(Integer key) {
+    if (std::is_same<Integer, uint8_t>::value) {
+      return key;
+    }
+    return ((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32;
+  }
+
+  // Backward shift deletion, so there is no tombstone in the table
+  void erase(const LocalJobType *job) {
+    const size_t mask = index_.size() - 1;
+    size_t i = slotOf(job->key()) & mask;
+    while (index_[i] != job) {
+      i = (i + 1) & mask;
+    }
+    index_[i] = nullptr;
+    for (size_t j = (i + 1) & mask; index_[j] != nullptr; j = (j + 1) & mask) {
+      size_t home = slotOf(index_[j]->key()) & mask;
+      // move index_[j] to the hole if its home slot is not in (i, j]
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        index_[i] = index_[j];
+        index_[j] = nullptr;
+        i = j;
+      }
+    }
+  }
+
+  std::unique_ptr<Jobs> jobs_; // created with the first job
+  std::vector<LocalJobType *> index_; // size: 0 or power of 2
+  size_t capacity_;
+  LocalShareQuota quota_;
 };
 
+inline int32_t LocalJob::addLocalShare(const LocalShare &localShare) {
+  size_t maxSize = LocalShareSet::kMaxSize;
+  if (quota_ != nullptr) {
+    // the shares left for the session
+    const size_t left = quota_->maxSessionShares_ -
+        std::min(quota_->shares_, quota_->maxSessionShares_);
+    maxSize = std::min(quota_->maxJobShares_, submitShares_.size() + left);
+  }
+  switch (submitShares_.insert(localShare, maxSize)) {
+  case LocalShareSet::InsertResult::INSERTED:
+    if (quota_ != nullptr) {
+      ++quota_->shares_;
+    }
+    return StratumStatus::ACCEPT;
+  case LocalShareSet::InsertResult::DUPLICATE:
+    return StratumStatus::DUPLICATE_SHARE;
+  default:
+    return StratumStatus::TOO_MANY_SHARES;
+  }
+}
+
 namespace sharebase {
 
 template <typename ShareMsg>
@@ -276,6 +569,35 @@ public:
     *reinterpret_cast<uint32_t *>(&data[0]) = this->version();
     return this->AppendToString(&data);
   }
+
+  // Shares decoded from a fixed-layout record keep the client IP raw and
+  // leave ip() unset, so that consumers which don't write it anywhere never
+  // format it.
+  IpAddress getIp() const {
+    if (hasRawIp_) {
+      return rawIp_;
+    }
+    IpAddress ip;
+    ip.fromString(this->ip());
+    return ip;
+  }
+
+  void setRawIp(const IpAddress &ip) {
+    rawIp_ = ip;
+    hasRawIp_ = true;
+  }
+
+  // Formats the raw IP into ip(), needed before the message is serialized
+  void formatIp() {
+    if (hasRawIp_) {
+      this->set_ip(rawIp_.toString());
+      hasRawIp_ = false;
+    }
+  }
+
+protected:
+  IpAddress rawIp_;
+  bool hasRawIp_ = false;
 };
 
 template <typename Derived, typename ShareMsg>
@@ -292,6 +614,32 @@ public:
   }
 };
 
+// Checksum of a fixed-layout share record (see ShareBitcoinBytesV3): the sum
+// of its 64-bit words, with checkSum_ counted as zero, folded to 32 bits.
+// Records start with uint32_t version_ and checkSum_ and have no padding, so
+// that every byte of them is covered.
+template <typename Bytes>
+uint32_t BytesCheckSum(const Bytes &share) {
+  static_assert(
+      std::has_unique_object_representations_v<Bytes>,
+      "share record should not have padding");
+  static_assert(
+      sizeof(Bytes) % sizeof(uint64_t) == 0,
+      "share record should be made of 64-bit words");
+  static_assert(
+      offsetof(Bytes, version_) == 0 && offsetof(Bytes, checkSum_) == 4,
+      "share record should start with version_ and checkSum_");
+
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&share);
+  uint64_t c = share.version_;
+  for (size_t i = sizeof(uint64_t); i < sizeof(Bytes); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    c += word;
+  }
+  return ((uint32_t)c) + ((uint32_t)(c >> 32));
+}
+
 } // namespace sharebase
 
 #endif
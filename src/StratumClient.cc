@@ -284,6 +284,9 @@ StratumClientWrapper::StratumClientWrapper(
   , host_(host)
   , port_(port)
   , base_(event_base_new())
+  , connectTimer_(nullptr)
+  , connectStarted_(0)
+  , lastConnected_(0)
   , numConnections_(numConnections)
   , userName_(userName)
   , minerNamePrefix_(minerNamePrefix)
@@ -301,6 +304,9 @@ StratumClientWrapper::~StratumClientWrapper() {
   event_free(sigint_);
   event_free(sigterm_);
   event_free(timer_);
+  if (connectTimer_) {
+    event_free(connectTimer_);
+  }
 
   // It has to be cleared here to free client events before event base
   connections_.clear();
@@ -352,7 +358,35 @@ void StratumClientWrapper::signalCallback(
   wrapper->stop();
 }
 
+void StratumClientWrapper::connectTimerCallback(
+    evutil_socket_t fd, short event, void *ptr) {
+  auto wrapper = static_cast<StratumClientWrapper *>(ptr);
+  wrapper->logConnectRate();
+}
+
+void StratumClientWrapper::logConnectRate() {
+  size_t connected = 0;
+  for (auto &client : connections_) {
+    if (client->state_ != StratumClient::INIT) {
+      connected++;
+    }
+  }
+  LOG(INFO) << "connected: " << connected << "/" << connections_.size()
+            << ", " << (connected - lastConnected_) << " per second";
+  lastConnected_ = connected;
+
+  if (connected == connections_.size()) {
+    time_t seconds = std::max<time_t>(time(nullptr) - connectStarted_, 1);
+    LOG(INFO) << "all clients connected in " << seconds << " seconds, "
+              << connected / seconds << (enableTLS_ ? " TLS handshakes" : "")
+              << " per second";
+    event_del(connectTimer_);
+  }
+}
+
 void StratumClientWrapper::run() {
+  connectStarted_ = time(nullptr);
+
   //
   // create clients
   //
@@ -380,6 +414,13 @@ void StratumClientWrapper::run() {
   };
   event_add(timer_, &interval);
 
+  connectTimer_ = event_new(
+      base_, -1, EV_PERSIST, StratumClientWrapper::connectTimerCallback, this);
+  struct timeval second {
+    1, 0
+  };
+  event_add(connectTimer_, &second);
+
   // create signals
   sigterm_ = event_new(
       base_,
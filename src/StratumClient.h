@@ -128,6 +128,10 @@ class StratumClientWrapper {
   struct event *timer_;
   struct event *sigterm_;
   struct event *sigint_;
+  // logs the connection (TLS handshake) rate until all clients are connected
+  struct event *connectTimer_;
+  time_t connectStarted_;
+  size_t lastConnected_;
   uint32_t numConnections_;
   string userName_; // miner usename
   string minerNamePrefix_;
@@ -137,6 +141,7 @@ class StratumClientWrapper {
   std::vector<unique_ptr<StratumClient>> connections_;
 
   void submitShares();
+  void logConnectRate();
 
 public:
   StratumClientWrapper(
@@ -155,6 +160,7 @@ public:
   static void eventCallback(struct bufferevent *bev, short events, void *ptr);
   static void timerCallback(evutil_socket_t fd, short event, void *ptr);
   static void signalCallback(evutil_socket_t fd, short event, void *ptr);
+  static void connectTimerCallback(evutil_socket_t fd, short event, void *ptr);
 
   void stop();
   void run();
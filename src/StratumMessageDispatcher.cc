@@ -31,6 +31,8 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+
 using namespace std;
 
 #define NULL_DISPATCHER_LOG \
@@ -74,7 +76,8 @@ void StratumMessageNullDispatcher::addLocalJob(LocalJob &localJob) {
   NULL_DISPATCHER_LOG;
 }
 
-void StratumMessageNullDispatcher::removeLocalJob(LocalJob &localJob) {
+void StratumMessageNullDispatcher::removeLocalJobs(
+    const std::vector<LocalJob *> &localJobs) {
   NULL_DISPATCHER_LOG;
 }
 
@@ -98,6 +101,11 @@ void StratumMessageMinerDispatcher::handleExMessage(const string &exMessage) {
   LOG(ERROR) << "Agent message shall not reach here";
 }
 
+bool StratumMessageMinerDispatcher::handleRawRequest(
+    const char *begin, const char *end) {
+  return miner_->handleRawRequest(begin, end);
+}
+
 void StratumMessageMinerDispatcher::responseShareAccepted(const string &idStr) {
   session_.responseTrue(idStr);
 }
@@ -120,6 +128,13 @@ void StratumMessageMinerDispatcher::resetCurDiff(uint64_t curDiff) {
   miner_->resetCurDiff(curDiff);
 }
 
+bool StratumMessageMinerDispatcher::getDiff(
+    uint64_t &curDiff, uint64_t &minDiff) const {
+  curDiff = miner_->getCurDiff();
+  minDiff = miner_->getMinDiff();
+  return true;
+}
+
 void StratumMessageMinerDispatcher::addLocalJob(LocalJob &localJob) {
   auto oldDiff = miner_->getCurDiff();
   auto newDiff = miner_->addLocalJob(localJob);
@@ -128,8 +143,13 @@ void StratumMessageMinerDispatcher::addLocalJob(LocalJob &localJob) {
   }
 }
 
-void StratumMessageMinerDispatcher::removeLocalJob(LocalJob &localJob) {
-  miner_->removeLocalJob(localJob);
+void StratumMessageMinerDispatcher::removeLocalJobs(
+    const std::vector<LocalJob *> &localJobs) {
+  miner_->removeLocalJobs(localJobs);
+}
+
+size_t StratumMessageMinerDispatcher::memoryUsage() const {
+  return sizeof(*this) + miner_->memoryUsage();
 }
 
 struct StratumMessageExSessionSpecific {
@@ -139,6 +159,37 @@ struct StratumMessageExSessionSpecific {
   boost::endian::little_uint16_buf_t sessionId;
 };
 
+struct StratumMessageExSubmitBatch {
+  boost::endian::little_uint8_buf_t magic;
+  boost::endian::little_uint8_buf_t command;
+  boost::endian::little_uint16_buf_t length;
+  boost::endian::little_uint16_buf_t batchId;
+  boost::endian::little_uint16_buf_t count;
+};
+
+struct StratumMessageExSubmitBatchShare {
+  boost::endian::little_uint8_buf_t jobId;
+  boost::endian::little_uint16_buf_t sessionId;
+  boost::endian::little_uint32_buf_t exNonce2;
+  boost::endian::little_uint32_buf_t nonce;
+  boost::endian::little_uint32_buf_t nTime;
+  boost::endian::little_uint32_buf_t versionMask;
+};
+
+struct StratumMessageExSubmitBatchResult {
+  boost::endian::little_uint8_buf_t magic;
+  boost::endian::little_uint8_buf_t command;
+  boost::endian::little_uint16_buf_t length;
+  boost::endian::little_uint16_buf_t batchId;
+  boost::endian::little_uint16_buf_t count;
+  boost::endian::little_uint16_buf_t accepted;
+};
+
+struct StratumMessageExSubmitBatchReject {
+  boost::endian::little_uint16_buf_t index;
+  boost::endian::little_int32_buf_t status;
+};
+
 struct StratumMessageExMiningSetDiff {
   boost::endian::little_uint8_buf_t magic;
   boost::endian::little_uint8_buf_t command;
@@ -151,12 +202,30 @@ StratumMessageAgentDispatcher::StratumMessageAgentDispatcher(
     IStratumSession &session, const DiffController &diffController)
   : session_(session)
   , diffController_(new DiffController(diffController))
-  , curDiff_(0) {
+  , curDiff_(0)
+  , nextBatchSeq_(0) {
 }
 
 StratumMessageAgentDispatcher::~StratumMessageAgentDispatcher() {
-  while (!miners_.empty()) {
-    unregisterWorker(miners_.begin()->first);
+  for (size_t sessionId = 0; sessionId < miners_.size(); sessionId++) {
+    unregisterWorker(sessionId);
+  }
+  while (!sparseMiners_.empty()) {
+    unregisterWorker(sparseMiners_.begin()->first);
+  }
+}
+
+template <typename F>
+void StratumMessageAgentDispatcher::forEachMiner(F f) {
+  for (size_t sessionId = 0; sessionId < miners_.size(); sessionId++) {
+    if (miners_[sessionId].miner_) {
+      f(sessionId, miners_[sessionId]);
+    }
+  }
+  for (auto &p : sparseMiners_) {
+    if (p.second.miner_) {
+      f(p.first, p.second);
+    }
   }
 }
 
@@ -185,21 +254,24 @@ void StratumMessageAgentDispatcher::handleExMessage(const string &exMessage) {
   case StratumCommandEx::SUBMIT_SHARE_WITH_TIME_VER:
     handleExMessage_SessionSpecific(exMessage);
     break;
+  case StratumCommandEx::SUBMIT_SHARE_BATCH:
+    handleExMessage_SubmitShareBatch(exMessage);
+    break;
   default:
     break;
   }
 }
 
 void StratumMessageAgentDispatcher::setMinDiff(uint64_t minDiff) {
-  for (auto &p : miners_) {
-    p.second->setMinDiff(minDiff);
-  }
+  forEachMiner([minDiff](size_t, AgentMiner &m) {
+    m.miner_->setMinDiff(minDiff);
+  });
 }
 
 void StratumMessageAgentDispatcher::resetCurDiff(uint64_t curDiff) {
-  for (auto &p : miners_) {
-    p.second->resetCurDiff(curDiff);
-  }
+  forEachMiner([curDiff](size_t, AgentMiner &m) {
+    m.miner_->resetCurDiff(curDiff);
+  });
 }
 
 void StratumMessageAgentDispatcher::addLocalJob(LocalJob &localJob) {
@@ -209,59 +281,77 @@ void StratumMessageAgentDispatcher::addLocalJob(LocalJob &localJob) {
     curDiff_ = agentDiff;
   }
 
-  map<uint8_t, vector<uint16_t>> newDiffs;
-  for (auto &p : miners_) {
-    uint64_t curDiff = p.second->getCurDiff();
-    uint8_t oldDiff = curDiff ? log2(curDiff) : 0;
-    uint8_t newDiff = log2(p.second->addLocalJob(localJob));
-    if (newDiff != oldDiff) {
-      newDiffs[newDiff].push_back(p.first);
+  // Only the diffs differing from the ones last sent to the agent are sent,
+  // grouped by the diff
+  bool changed = false;
+  forEachMiner([&](size_t sessionId, AgentMiner &m) {
+    uint8_t newDiffExp = log2(m.miner_->addLocalJob(localJob));
+    if (newDiffExp != m.sentDiffExp_) {
+      diffChanges_[newDiffExp].push_back(sessionId);
+      m.sentDiffExp_ = newDiffExp;
+      changed = true;
     }
-  }
+  });
 
-  if (!newDiffs.empty()) {
-    //
-    // CMD_MINING_SET_DIFF:
-    // | magic_number(1) | cmd(1) | len (2) | diff_2_exp(1) | count(2) |
-    // session_id (2) ... |
-    //
-    //
-    // max session id count is 32,764, each message's max length is UINT16_MAX.
-    //     65535 -1-1-2-1-2 = 65,528
-    //     65,528 / 2 = 32,764
-    //
+  if (changed) {
     string data;
-    getSetDiffCommand(newDiffs, data);
+    for (size_t diffExp = 0; diffExp < diffChanges_.size(); diffExp++) {
+      auto &sessionIds = diffChanges_[diffExp];
+      if (!sessionIds.empty()) {
+        appendSetDiffCommand(
+            diffExp, sessionIds.data(), sessionIds.size(), data);
+        sessionIds.clear();
+      }
+    }
     session_.sendData(data);
   }
 }
 
-void StratumMessageAgentDispatcher::removeLocalJob(LocalJob &localJob) {
-  for (auto &p : miners_) {
-    p.second->removeLocalJob(localJob);
+void StratumMessageAgentDispatcher::removeLocalJobs(
+    const std::vector<LocalJob *> &localJobs) {
+  forEachMiner([&localJobs](size_t, AgentMiner &m) {
+    m.miner_->removeLocalJobs(localJobs);
+  });
+}
+
+size_t StratumMessageAgentDispatcher::memoryUsage() const {
+  size_t usage = sizeof(*this) + diffController_->memoryUsage() +
+      miners_.capacity() * sizeof(AgentMiner) +
+      sparseMiners_.size() * (4 * sizeof(void *) + sizeof(AgentMiner));
+  for (auto &m : miners_) {
+    if (m.miner_) {
+      usage += m.miner_->memoryUsage();
+    }
+  }
+  for (auto &p : sparseMiners_) {
+    if (p.second.miner_) {
+      usage += p.second.miner_->memoryUsage();
+    }
+  }
+  for (auto &sessionIds : diffChanges_) {
+    usage += sessionIds.capacity() * sizeof(uint16_t);
+  }
+  for (auto &p : submitBatches_) {
+    usage += 4 * sizeof(void *) + sizeof(p) +
+        p.second.statuses_.capacity() * sizeof(int32_t);
   }
+  return usage;
 }
 
 void StratumMessageAgentDispatcher::beforeSwitchChain() {
   // remove worker from the old chain
-  for (auto &itr : miners_) {
-    auto &miner = itr.second;
-    if (miner) {
-      session_.removeWorker(
-          miner->clientAgent(), miner->workerName(), miner->workerId());
-    }
-  }
+  forEachMiner([this](size_t, AgentMiner &m) {
+    session_.removeWorker(
+        m.miner_->clientAgent(), m.miner_->workerName(), m.miner_->workerId());
+  });
 }
 
 void StratumMessageAgentDispatcher::afterSwitchChain() {
   // add worker to the new chain
-  for (auto &itr : miners_) {
-    auto &miner = itr.second;
-    if (miner) {
-      session_.addWorker(
-          miner->clientAgent(), miner->workerName(), miner->workerId());
-    }
-  }
+  forEachMiner([this](size_t, AgentMiner &m) {
+    session_.addWorker(
+        m.miner_->clientAgent(), m.miner_->workerName(), m.miner_->workerId());
+  });
 }
 
 void StratumMessageAgentDispatcher::handleExMessage_RegisterWorker(
@@ -315,6 +405,7 @@ void StratumMessageAgentDispatcher::handleExMessage_UnregisterWorker(
       exMessage.data());
   auto sessionId = header->sessionId.value();
   unregisterWorker(sessionId);
+  session_.setAgentSessions(numMiners_);
 }
 
 void StratumMessageAgentDispatcher::handleExMessage_SessionSpecific(
@@ -323,10 +414,153 @@ void StratumMessageAgentDispatcher::handleExMessage_SessionSpecific(
   // Session specific messages
   // | magic_number(1) | cmd(1) | len (2) | ... | session_id(2) | ...
   //
-  auto sessionId = session_.decodeSessionId(exMessage);
-  auto iter = miners_.find(sessionId);
-  if (iter != miners_.end()) {
-    iter->second->handleExMessage(exMessage);
+  auto miner = findMiner(session_.decodeSessionId(exMessage));
+  if (miner) {
+    miner->handleExMessage(exMessage);
+  }
+}
+
+void StratumMessageAgentDispatcher::handleExMessage_SubmitShareBatch(
+    const string &exMessage) {
+  //
+  // SUBMIT_SHARE_BATCH:
+  // | magic_number(1) | cmd(1) | len (2) | batch_id(2) | count(2) |
+  // { jobId(1) | session_id(2) | extra_nonce2(4) | nNonce(4) | nTime(4) |
+  // nVersionMask(4) } * count |
+  //
+  // nTime and nVersionMask are 0 if not used by the share.
+  //
+  auto header =
+      reinterpret_cast<const StratumMessageExSubmitBatch *>(exMessage.data());
+  size_t count = exMessage.size() < sizeof(*header) ? 0 : header->count.value();
+  if (count == 0 ||
+      exMessage.size() !=
+          sizeof(*header) + count * sizeof(StratumMessageExSubmitBatchShare)) {
+    LOG(WARNING) << "[agent] invalid share batch, size: " << exMessage.size();
+    return;
+  }
+
+  // answer the batches which have waited for too long
+  time_t now = time(nullptr);
+  for (auto itr = submitBatches_.begin(); itr != submitBatches_.end();) {
+    if (itr->second.received_ + kSubmitBatchTimeout > now) {
+      break;
+    }
+    sendSubmitBatchResult(itr->second);
+    itr = submitBatches_.erase(itr);
+  }
+
+  // the results may be reported while submitting
+  uint32_t seq = nextBatchSeq_++;
+  auto &batch = submitBatches_[seq];
+  batch.batchId_ = header->batchId.value();
+  batch.received_ = now;
+  batch.pending_ = count;
+  batch.statuses_.assign(count, StratumStatus::UNKNOWN);
+
+  auto shares = reinterpret_cast<const StratumMessageExSubmitBatchShare *>(
+      exMessage.data() + sizeof(*header));
+  for (size_t i = 0; i < count; i++) {
+    auto &share = shares[i];
+    string idStr = Strings::Format("%u.%u", seq, i);
+    auto miner = findMiner(share.sessionId.value());
+    if (!miner ||
+        !miner->handleExSubmit(
+            idStr,
+            share.jobId.value(),
+            share.sessionId.value(),
+            share.exNonce2.value(),
+            share.nonce.value(),
+            share.nTime.value(),
+            share.versionMask.value())) {
+      onBatchShareResult(idStr, StratumStatus::UNAUTHORIZED);
+    }
+  }
+}
+
+void StratumMessageAgentDispatcher::responseShareAccepted(const string &idStr) {
+  onBatchShareResult(idStr, StratumStatus::ACCEPT);
+}
+
+void StratumMessageAgentDispatcher::responseShareAcceptedWithStatus(
+    const string &idStr, int32_t status) {
+  onBatchShareResult(idStr, status);
+}
+
+void StratumMessageAgentDispatcher::responseShareError(
+    const string &idStr, int32_t status) {
+  onBatchShareResult(idStr, status);
+}
+
+void StratumMessageAgentDispatcher::onBatchShareResult(
+    const string &idStr, int32_t status) {
+  // "null": a share of a single SUBMIT_SHARE* message
+  if (idStr.empty() || !isdigit(idStr[0])) {
+    return;
+  }
+  char *end = nullptr;
+  uint32_t seq = strtoul(idStr.c_str(), &end, 10);
+  if (*end != '.') {
+    return;
+  }
+  size_t index = strtoul(end + 1, nullptr, 10);
+
+  auto itr = submitBatches_.find(seq);
+  if (itr == submitBatches_.end()) {
+    return;
+  }
+  auto &batch = itr->second;
+  if (index >= batch.statuses_.size() ||
+      batch.statuses_[index] != StratumStatus::UNKNOWN) {
+    return;
+  }
+  batch.statuses_[index] = status;
+  if (--batch.pending_ == 0) {
+    sendSubmitBatchResult(batch);
+    submitBatches_.erase(itr);
+  }
+}
+
+void StratumMessageAgentDispatcher::sendSubmitBatchResult(
+    const SubmitBatch &batch) {
+  string data;
+  getSubmitBatchResult(batch.batchId_, batch.statuses_, data);
+  session_.sendData(data);
+}
+
+void StratumMessageAgentDispatcher::getSubmitBatchResult(
+    uint16_t batchId, const vector<int32_t> &statuses, string &exMessage) {
+  //
+  // SUBMIT_SHARE_BATCH_RESULT:
+  // | magic_number(1) | cmd(1) | len (2) | batch_id(2) | count(2) |
+  // accepted(2) | { index(2) | status(4) } * (count - accepted) |
+  //
+  // The shares not listed are accepted (StratumStatus::ACCEPT).
+  //
+  size_t accepted = std::count(
+      statuses.begin(), statuses.end(), (int32_t)StratumStatus::ACCEPT);
+  exMessage.resize(
+      sizeof(StratumMessageExSubmitBatchResult) +
+      (statuses.size() - accepted) * sizeof(StratumMessageExSubmitBatchReject));
+
+  auto header =
+      reinterpret_cast<StratumMessageExSubmitBatchResult *>(&exMessage.front());
+  header->magic = StratumMessageEx::CMD_MAGIC_NUMBER;
+  header->command =
+      static_cast<uint8_t>(StratumCommandEx::SUBMIT_SHARE_BATCH_RESULT);
+  header->length = exMessage.size();
+  header->batchId = batchId;
+  header->count = statuses.size();
+  header->accepted = accepted;
+
+  auto reject = reinterpret_cast<StratumMessageExSubmitBatchReject *>(
+      &exMessage.front() + sizeof(*header));
+  for (size_t i = 0; i < statuses.size(); i++) {
+    if (statuses[i] != StratumStatus::ACCEPT) {
+      reject->index = i;
+      reject->status = statuses[i];
+      reject++;
+    }
   }
 }
 
@@ -338,23 +572,71 @@ void StratumMessageAgentDispatcher::registerWorker(
   DLOG(INFO) << "[agent] clientAgent: " << clientAgent
              << ", workerName: " << workerName << ", workerId: " << workerId
              << ", session id:" << sessionId;
-  miners_.emplace(
-      sessionId, session_.createMiner(clientAgent, workerName, workerId));
+  if (sessionId > StratumMessageEx::AGENT_MAX_SESSION_ID) {
+    return;
+  }
+  // the session id is reused
+  unregisterWorker(sessionId);
+  if (sessionId >= miners_.size() &&
+      sessionId < std::max(kMinDenseMiners, 2 * (numMiners_ + 1))) {
+    miners_.resize(sessionId + 1);
+    // the array reached the ids of sparse miners
+    while (!sparseMiners_.empty() &&
+           sparseMiners_.begin()->first < miners_.size()) {
+      auto itr = sparseMiners_.begin();
+      miners_[itr->first] = std::move(itr->second);
+      sparseMiners_.erase(itr);
+    }
+  }
+  auto &m = sessionId < miners_.size() ? miners_[sessionId]
+                                       : sparseMiners_[sessionId];
+  m.miner_ = session_.createMiner(clientAgent, workerName, workerId);
+  m.sentDiffExp_ = 0;
   session_.addWorker(clientAgent, workerName, workerId);
+  if (m.miner_) {
+    ++numMiners_;
+  }
+  session_.setAgentSessions(numMiners_);
 }
 
 void StratumMessageAgentDispatcher::unregisterWorker(uint32_t sessionId) {
-  auto &miner = miners_[sessionId];
+  std::map<uint16_t, AgentMiner>::iterator sparse;
+  AgentMiner *m;
+  if (sessionId < miners_.size()) {
+    m = &miners_[sessionId];
+  } else {
+    sparse = sparseMiners_.find(sessionId);
+    if (sparse == sparseMiners_.end()) {
+      return;
+    }
+    m = &sparse->second;
+  }
+  auto &miner = m->miner_;
   if (miner) {
     session_.removeWorker(
         miner->clientAgent(), miner->workerName(), miner->workerId());
+    miner.reset();
+    --numMiners_;
+  }
+  if (sessionId >= miners_.size()) {
+    sparseMiners_.erase(sparse);
   }
-  miners_.erase(sessionId);
 }
 
 void StratumMessageAgentDispatcher::getSetDiffCommand(
     std::map<uint8_t, std::vector<uint16_t>> &diffSessionIds,
     std::string &exMessage) {
+  exMessage.clear();
+  for (auto &p : diffSessionIds) {
+    appendSetDiffCommand(p.first, p.second.data(), p.second.size(), exMessage);
+  }
+}
+
+void StratumMessageAgentDispatcher::appendSetDiffCommand(
+    uint8_t diffExp,
+    const uint16_t *sessionIds,
+    size_t count,
+    std::string &exMessage) {
   //
   // CMD_MINING_SET_DIFF:
   // | magic_number(1) | cmd(1) | len (2) | diff_2_exp(1) | count(2) |
@@ -366,44 +648,26 @@ void StratumMessageAgentDispatcher::getSetDiffCommand(
   //     65,528 / 2 = 32,764
   //
   static const size_t kMaxCount = 32764;
-  exMessage.clear();
-
-  for (auto &p : diffSessionIds) {
-    auto iter = p.second.begin();
-    auto iend = p.second.end();
-    while (iter != iend) {
-      size_t count = distance(iter, iend);
-      if (count > kMaxCount)
-        count = kMaxCount;
-
-      string buf;
-      uint16_t len = 1 + 1 + 2 + 1 + 2 + count * 2;
-      buf.resize(len);
-      auto start = &buf.front();
-      auto header = reinterpret_cast<StratumMessageExMiningSetDiff *>(start);
-
-      // cmd
-      header->magic = StratumMessageEx::CMD_MAGIC_NUMBER;
-      header->command = static_cast<uint8_t>(StratumCommandEx::MINING_SET_DIFF);
-
-      // len
-      header->length = len;
-
-      // diff, 2 exp
-      header->diffExp = p.first;
-
-      // count
-      header->count = count;
-      auto p = reinterpret_cast<boost::endian::little_uint16_buf_t *>(
-          start + 1 + 1 + 2 + 1 + 2);
-
-      // session ids
-      for (size_t j = 0; j < count; j++) {
-        *(p++) = *(iter++);
-      }
 
-      exMessage.append(buf);
-
-    } /* /while */
-  } /* /for */
+  while (count > 0) {
+    size_t n = std::min(count, kMaxCount);
+    uint16_t len = sizeof(StratumMessageExMiningSetDiff) + n * 2;
+    size_t offset = exMessage.size();
+    exMessage.resize(offset + len);
+
+    auto start = &exMessage.front() + offset;
+    auto header = reinterpret_cast<StratumMessageExMiningSetDiff *>(start);
+    header->magic = StratumMessageEx::CMD_MAGIC_NUMBER;
+    header->command = static_cast<uint8_t>(StratumCommandEx::MINING_SET_DIFF);
+    header->length = len;
+    header->diffExp = diffExp;
+    header->count = n;
+
+    auto p = reinterpret_cast<boost::endian::little_uint16_buf_t *>(
+        start + sizeof(*header));
+    for (size_t j = 0; j < n; j++) {
+      *(p++) = *(sessionIds++);
+    }
+    count -= n;
+  }
 }
@@ -27,6 +27,7 @@
 
 #include "utilities_js.hpp"
 
+#include <array>
 #include <cstdint>
 #include <map>
 #include <memory>
@@ -49,6 +50,11 @@ public:
       const JsonNode &jparams,
       const JsonNode &jroot) = 0;
   virtual void handleExMessage(const std::string &exMessage) = 0;
+  // Fast path for hot requests that skips the generic JSON parser,
+  // returns false if the line is not handled.
+  virtual bool handleRawRequest(const char *begin, const char *end) {
+    return false;
+  }
   virtual void responseShareAccepted(const std::string &idStr) = 0;
   virtual void
   responseShareAcceptedWithStatus(const std::string &idStr, int32_t status) = 0;
@@ -56,12 +62,24 @@ public:
   virtual void setMinDiff(uint64_t minDiff) = 0;
   virtual void resetCurDiff(uint64_t curDiff) = 0;
   virtual void addLocalJob(LocalJob &localJob) = 0;
-  virtual void removeLocalJob(LocalJob &localJob) = 0;
+  // Jobs evicted from the session together, oldest first
+  virtual void removeLocalJobs(const std::vector<LocalJob *> &localJobs) = 0;
 
   // Some states (such as agent workers) may need to be updated after
   // switching chain
   virtual void beforeSwitchChain(){};
   virtual void afterSwitchChain(){};
+
+  // Approximate memory used by the dispatcher and its miners
+  virtual size_t memoryUsage() const { return sizeof(*this); }
+  // For the memory accounting report
+  virtual const char *typeName() const = 0;
+
+  // Difficulty of the miner for hot restart, minDiff is 0 if the miner did
+  // not set it. Returns false if the dispatcher has no single miner.
+  virtual bool getDiff(uint64_t &curDiff, uint64_t &minDiff) const {
+    return false;
+  }
 };
 
 class StratumMessageNullDispatcher : public StratumMessageDispatcher {
@@ -79,7 +97,8 @@ public:
   void setMinDiff(uint64_t minDiff) override;
   void resetCurDiff(uint64_t curDiff) override;
   void addLocalJob(LocalJob &localJob) override;
-  void removeLocalJob(LocalJob &localJob) override;
+  void removeLocalJobs(const std::vector<LocalJob *> &localJobs) override;
+  const char *typeName() const override { return "unauthorized"; }
 };
 
 class StratumMessageMinerDispatcher : public StratumMessageDispatcher {
@@ -93,6 +112,7 @@ public:
       const JsonNode &jparams,
       const JsonNode &jroot) override;
   void handleExMessage(const std::string &exMessage) override;
+  bool handleRawRequest(const char *begin, const char *end) override;
   void responseShareAccepted(const std::string &idStr) override;
   void responseShareAcceptedWithStatus(
       const std::string &idStr, int32_t status) override;
@@ -100,7 +120,10 @@ public:
   void setMinDiff(uint64_t minDiff) override;
   void resetCurDiff(uint64_t curDiff) override;
   void addLocalJob(LocalJob &localJob) override;
-  void removeLocalJob(LocalJob &localJob) override;
+  void removeLocalJobs(const std::vector<LocalJob *> &localJobs) override;
+  size_t memoryUsage() const override;
+  const char *typeName() const override { return "miner"; }
+  bool getDiff(uint64_t &curDiff, uint64_t &minDiff) const override;
 
 protected:
   IStratumSession &session_;
@@ -119,22 +142,29 @@ public:
       const JsonNode &jparams,
       const JsonNode &jroot) override;
   void handleExMessage(const std::string &exMessage) override;
-  void responseShareAccepted(const std::string &idStr) override {}
+  // Only the shares of SUBMIT_SHARE_BATCH messages are answered
+  void responseShareAccepted(const std::string &idStr) override;
   void responseShareAcceptedWithStatus(
-      const std::string &idStr, int32_t status) override {}
-  void responseShareError(const std::string &idStr, int32_t status) override {}
+      const std::string &idStr, int32_t status) override;
+  void responseShareError(const std::string &idStr, int32_t status) override;
   void setMinDiff(uint64_t minDiff) override;
   void resetCurDiff(uint64_t curDiff) override;
   void addLocalJob(LocalJob &localJob) override;
-  void removeLocalJob(LocalJob &localJob) override;
+  void removeLocalJobs(const std::vector<LocalJob *> &localJobs) override;
 
   void beforeSwitchChain() override;
   void afterSwitchChain() override;
+  size_t memoryUsage() const override;
+  const char *typeName() const override { return "agent"; }
 
 protected:
   void handleExMessage_RegisterWorker(const std::string &exMessage);
   void handleExMessage_UnregisterWorker(const std::string &exMessage);
   void handleExMessage_SessionSpecific(const std::string &exMessage);
+  void handleExMessage_SubmitShareBatch(const std::string &exMessage);
+
+  // Record the result of a share of a batch, idStr is "<seq>.<index>"
+  void onBatchShareResult(const std::string &idStr, int32_t status);
 
 public:
   // These are public for unittests...
@@ -143,16 +173,76 @@ public:
       const std::string &clientAgent,
       const std::string &workerName,
       int64_t workerId);
+  // Doesn't update the share limits of the session, see setAgentSessions()
   void unregisterWorker(uint32_t sessionId);
   static void getSetDiffCommand(
       std::map<uint8_t, std::vector<uint16_t>> &diffSessionIds,
       std::string &exMessage);
+  // Append MINING_SET_DIFF commands setting the diff of the sessions to
+  // 2^diffExp
+  static void appendSetDiffCommand(
+      uint8_t diffExp,
+      const uint16_t *sessionIds,
+      size_t count,
+      std::string &exMessage);
 
 protected:
+  StratumMiner *findMiner(uint16_t sessionId) const {
+    if (sessionId < miners_.size()) {
+      return miners_[sessionId].miner_.get();
+    }
+    auto itr = sparseMiners_.find(sessionId);
+    return itr != sparseMiners_.end() ? itr->second.miner_.get() : nullptr;
+  }
+
   IStratumSession &session_;
   std::unique_ptr<DiffController> diffController_;
   uint64_t curDiff_;
-  std::map<uint16_t, std::unique_ptr<StratumMiner>> miners_;
+
+  // The miners of the sub-sessions indexed by the session id. The agent
+  // allocates the ids from 0, so the array only grows to twice the number of
+  // registered miners (at least kMinDenseMiners), the miners of higher ids
+  // are kept in sparseMiners_ until the array reaches them. A few high ids
+  // can't make the array large.
+  struct AgentMiner {
+    std::unique_ptr<StratumMiner> miner_;
+    // log2 of the diff last sent to the agent, 0 if not sent yet
+    uint8_t sentDiffExp_ = 0;
+  };
+  static constexpr size_t kMinDenseMiners = 64;
+  std::vector<AgentMiner> miners_;
+  std::map<uint16_t, AgentMiner> sparseMiners_;
+  // Calls f(sessionId, agentMiner) for the registered miners in the order of
+  // the session ids
+  template <typename F>
+  void forEachMiner(F f);
+  // The number of registered miners
+  size_t numMiners_ = 0;
+  // Scratch of addLocalJob(), the sessions whose diff changed to 2^index
+  std::array<std::vector<uint16_t>, 64> diffChanges_;
+
+  // SUBMIT_SHARE_BATCH messages waiting for the results of their shares,
+  // indexed by a sequence number of the dispatcher
+  struct SubmitBatch {
+    uint16_t batchId_;
+    time_t received_;
+    size_t pending_;
+    // StratumStatus::UNKNOWN until reported
+    std::vector<int32_t> statuses_;
+  };
+  std::map<uint32_t, SubmitBatch> submitBatches_;
+  uint32_t nextBatchSeq_;
+
+  void sendSubmitBatchResult(const SubmitBatch &batch);
+
+public:
+  // Batches are answered anyway after the timeout, the shares not reported
+  // until then (e.g. of unregistered workers) as UNKNOWN
+  static const time_t kSubmitBatchTimeout = 60;
+  static void getSubmitBatchResult(
+      uint16_t batchId,
+      const std::vector<int32_t> &statuses,
+      std::string &exMessage);
 };
 
 #endif // #ifndef STRATUM_MESSAGE_DISPATCHER_H
@@ -50,6 +50,12 @@ StratumMiner::StratumMiner(
   , alive_(std::make_shared<bool>(true)) {
 }
 
+size_t StratumMiner::memoryUsage() const {
+  return sizeof(StratumMiner) + diffController_->memoryUsage() +
+      stringMemoryUsage(clientAgent_) + stringMemoryUsage(workerName_) +
+      invalidSharesCounter_.getWindowSize() * sizeof(int64_t);
+}
+
 void StratumMiner::setMinDiff(uint64_t minDiff) {
   overrideDifficulty_ = true;
   diffController_->setMinDiff(minDiff);
@@ -59,6 +65,10 @@ void StratumMiner::resetCurDiff(uint64_t curDiff) {
   diffController_->resetCurDiff(curDiff);
 }
 
+uint64_t StratumMiner::getMinDiff() const {
+  return overrideDifficulty_ ? diffController_->minDiff_ : 0;
+}
+
 uint64_t StratumMiner::calcCurDiff() {
   if (!overrideDifficulty_ &&
       (session_.niceHashForced() || isNiceHashClient_)) {
@@ -94,3 +104,9 @@ bool StratumMiner::handleShare(
   }
   return accepted;
 }
+
+void StratumMiner::countInvalidShare(int32_t status) {
+  if (status != StratumStatus::TOO_MANY_SHARES) {
+    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+  }
+}
@@ -24,6 +24,7 @@
 #ifndef STRATUM_MINER_H_
 #define STRATUM_MINER_H_
 
+#include "SlabAllocator.h"
 #include "Statistics.h"
 #include "utilities_js.hpp"
 
@@ -60,23 +61,49 @@ public:
       const JsonNode &jroot) = 0;
   virtual void handleExMessage(
       const std::string &exMessage){}; // No agent support by default
+  // A share of a SUBMIT_SHARE_BATCH ex-message, its result is reported with
+  // idStr. nTime and versionMask are 0 if not given. Returns false if not
+  // supported.
+  virtual bool handleExSubmit(
+      const std::string &idStr,
+      uint8_t shortJobId,
+      uint16_t sessionId,
+      uint32_t exNonce2,
+      uint32_t nonce,
+      uint32_t nTime,
+      uint32_t versionMask) {
+    return false;
+  }
+  // Fast path for hot requests, see StratumMessageDispatcher
+  virtual bool handleRawRequest(const char *begin, const char *end) {
+    return false;
+  }
   void setMinDiff(uint64_t minDiff);
   void resetCurDiff(uint64_t curDiff);
   uint64_t getCurDiff() const { return curDiff_; };
+  // The min difficulty set by setMinDiff(), 0 if not set
+  uint64_t getMinDiff() const;
   uint64_t calcCurDiff();
   virtual uint64_t addLocalJob(LocalJob &localJob) = 0;
-  virtual void removeLocalJob(LocalJob &localJob) = 0;
+  virtual void removeLocalJobs(const std::vector<LocalJob *> &localJobs) = 0;
 
   const int64_t workerId() { return workerId_; }
   const std::string &workerName() { return workerName_; }
   const std::string &clientAgent() { return clientAgent_; }
 
+  // Approximate memory used by the miner
+  virtual size_t memoryUsage() const;
+
 protected:
   bool handleShare(
       const std::string &idStr,
       int32_t status,
       uint64_t shareDiff,
       size_t chainId);
+  // Counts a rejected share for the invalid share spamming check. Shares
+  // rejected as TOO_MANY_SHARES are not counted, they may be valid work of a
+  // busy session.
+  void countInvalidShare(int32_t status);
 
   IStratumSession &session_;
   std::unique_ptr<DiffController> diffController_;
@@ -121,12 +148,27 @@ public:
     return curDiff;
   }
 
-  void removeLocalJob(LocalJob &localJob) override {
-    jobDiffs_.erase(&localJob);
+  void removeLocalJobs(const std::vector<LocalJob *> &localJobs) override {
+    for (auto localJob : localJobs) {
+      jobDiffs_.erase(localJob);
+    }
+  }
+
+  size_t memoryUsage() const override {
+    // a tree node has 3 pointers and a color besides the value
+    const size_t nodeSize = SlabAllocator::blockSize(
+        4 * sizeof(void *) + sizeof(typename JobDiffs::value_type));
+    return StratumMiner::memoryUsage() - sizeof(StratumMiner) +
+        sizeof(*this) + jobDiffs_.size() * nodeSize;
   }
 
 protected:
-  std::map<const LocalJob *, JobDiffType> jobDiffs_;
+  using JobDiffs = std::map<
+      const LocalJob *,
+      JobDiffType,
+      std::less<const LocalJob *>,
+      SlabStlAllocator<std::pair<const LocalJob *const, JobDiffType>>>;
+  JobDiffs jobDiffs_;
 };
 
 #endif // #define STRATUM_MINER_H_
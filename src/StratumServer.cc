@@ -27,18 +27,41 @@
 #include "StratumSession.h"
 #include "DiffController.h"
 #include "Management.h"
+#include "HotRestart.h"
+#include "AdmissionController.h"
 
 #include <boost/thread.hpp>
 #include <event2/thread.h>
 
 #include "ssl/SSLUtils.h"
+#include "ssl/TLSHandshaker.h"
 
 #include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace std;
 
 static const uint32_t MIN_SHARE_WORKER_QUEUE_SIZE = 256;
 static const uint32_t MIN_SHARE_WORKER_THREADS = 1;
+static const uint32_t MIN_REACTOR_THREADS = 1;
+static const uint32_t MIN_NOTIFY_BATCH_SIZE = 1;
+// seconds to wait for the jobs of all chains before taking over the sessions
+static const time_t HOT_RESTART_JOB_WAIT_SECONDS = 10;
+
+namespace {
+// The reactor driving the current thread. Threads without a reactor (share
+// workers, kafka consumers, zookeeper callbacks, etc.) dispatch their tasks to
+// the main reactor.
+thread_local StratumServer::Reactor *tlsReactor = nullptr;
+// Whether the current thread is running a share work on behalf of a reactor
+thread_local bool tlsOnBehalfOf = false;
+// See StratumServer::requestTime()
+thread_local std::chrono::steady_clock::time_point tlsRequestTime;
+// The share works collected by StratumServer::beginShareWorkBatch()
+thread_local std::vector<WorkerTask> *tlsShareWorkBatch = nullptr;
+} // namespace
 
 //////////////////////////////// SessionIDManagerT
 /////////////////////////////////
@@ -49,7 +72,67 @@ SessionIDManagerT<IBITS>::SessionIDManagerT(const uint8_t serverId)
   , allocIdx_(0)
   , allocInterval_(0) {
   static_assert(IBITS <= 24, "IBITS cannot large than 24");
-  sessionIds_.reset();
+  static_assert(IBITS >= 6, "IBITS cannot less than 6");
+
+  // all ids are free
+  size_t bits = kSessionIdMask + 1;
+  do {
+    vector<uint64_t> level((bits + 63) / 64, ~0ULL);
+    if (bits % 64 != 0) {
+      level.back() = (1ULL << (bits % 64)) - 1;
+    }
+    bits = level.size();
+    freeIds_.push_back(std::move(level));
+  } while (bits > 1);
+}
+
+template <uint8_t IBITS>
+bool SessionIDManagerT<IBITS>::isFree(uint32_t idx) const {
+  return (freeIds_[0][idx / 64] >> (idx % 64)) & 1;
+}
+
+template <uint8_t IBITS>
+void SessionIDManagerT<IBITS>::setFree(uint32_t idx, bool free) {
+  for (auto &level : freeIds_) {
+    uint64_t &word = level[idx / 64];
+    const bool wasEmpty = word == 0;
+    if (free) {
+      word |= 1ULL << (idx % 64);
+    } else {
+      word &= ~(1ULL << (idx % 64));
+    }
+    // the upper levels only change when the word becomes (non-)empty
+    if (wasEmpty == (word == 0)) {
+      break;
+    }
+    idx /= 64;
+  }
+}
+
+template <uint8_t IBITS>
+uint32_t SessionIDManagerT<IBITS>::findFree(uint32_t idx) const {
+  // go up until a word has a free bit at or after the position
+  size_t level = 0;
+  while (true) {
+    if (level == freeIds_.size() || idx / 64 >= freeIds_[level].size()) {
+      return kSessionIdMask + 1;
+    }
+    uint64_t word = freeIds_[level][idx / 64] & (~0ULL << (idx % 64));
+    if (word != 0) {
+      idx = (idx / 64) * 64 + __builtin_ctzll(word);
+      break;
+    }
+    // the next word of this level is the next bit of the upper level
+    idx = idx / 64 + 1;
+    level++;
+  }
+
+  // go down to the first free id under the bit
+  while (level > 0) {
+    level--;
+    idx = idx * 64 + __builtin_ctzll(freeIds_[level][idx]);
+  }
+  return idx;
 }
 
 template <uint8_t IBITS>
@@ -78,13 +161,13 @@ bool SessionIDManagerT<IBITS>::allocSessionId(uint32_t *sessionID) {
   if (_ifFull())
     return false;
 
-  // find an empty bit
-  while (sessionIds_.test(allocIdx_) == true) {
-    allocIdx_ = (allocIdx_ + 1) & kSessionIdMask;
+  // find a free id, roll back to the beginning if none after allocIdx_
+  allocIdx_ = findFree(allocIdx_);
+  if (allocIdx_ > kSessionIdMask) {
+    allocIdx_ = findFree(0);
   }
 
-  // set to true
-  sessionIds_.set(allocIdx_, true);
+  setFree(allocIdx_, false);
   count_++;
 
   *sessionID = (((uint32_t)serverId_ << IBITS) | allocIdx_);
@@ -97,8 +180,23 @@ void SessionIDManagerT<IBITS>::freeSessionId(uint32_t sessionId) {
   ScopeLock sl(lock_);
 
   const uint32_t idx = (sessionId & kSessionIdMask);
-  sessionIds_.set(idx, false);
-  count_--;
+  if (!isFree(idx)) {
+    setFree(idx, true);
+    count_--;
+  }
+}
+
+template <uint8_t IBITS>
+bool SessionIDManagerT<IBITS>::reserveSessionId(uint32_t sessionId) {
+  ScopeLock sl(lock_);
+
+  const uint32_t idx = (sessionId & kSessionIdMask);
+  if ((sessionId >> IBITS) != serverId_ || !isFree(idx)) {
+    return false;
+  }
+  setFree(idx, false);
+  count_++;
+  return true;
 }
 
 // Class template instantiation
@@ -167,22 +265,38 @@ void JobRepository::setMiningNotifyInterval(time_t miningNotifyInterval) {
   kMiningNotifyInterval_ = miningNotifyInterval;
 }
 
-shared_ptr<StratumJobEx> JobRepository::getStratumJobEx(const uint64_t jobId) {
-  auto itr = exJobs_.find(jobId);
-  if (itr != exJobs_.end()) {
-    return itr->second;
+StratumJobEx *JobRepository::getStratumJobEx(const uint64_t jobId) {
+  auto &jobs = jobTable_.read();
+  auto itr = std::lower_bound(
+      jobs.begin(), jobs.end(), jobId, [](const auto &job, uint64_t id) {
+        return job.first < id;
+      });
+  if (itr != jobs.end() && itr->first == jobId) {
+    return itr->second.get();
   }
   return nullptr;
 }
 
 shared_ptr<StratumJobEx> JobRepository::getLatestStratumJobEx() {
-  if (exJobs_.size()) {
-    return exJobs_.rbegin()->second;
+  auto &jobs = jobTable_.read();
+  if (!jobs.empty()) {
+    return jobs.back().second;
   }
   LOG(WARNING) << "getLatestStratumJobEx fail";
   return nullptr;
 }
 
+void JobRepository::addStratumJobEx(
+    uint64_t jobId, shared_ptr<StratumJobEx> exJob) {
+  exJobs_[jobId] = std::move(exJob);
+  publishJobTable();
+}
+
+void JobRepository::publishJobTable() {
+  auto jobs = std::make_shared<JobTable>(exJobs_.begin(), exJobs_.end());
+  jobTable_.publish(std::move(jobs));
+}
+
 void JobRepository::stop() {
   if (!running_) {
     return;
@@ -283,7 +397,7 @@ void JobRepository::consumeStratumJob(rd_kafka_message_t *rkmessage) {
   }
 
   shared_ptr<StratumJob> sjob = createStratumJob();
-  bool res = sjob->unserializeFromJson(
+  bool res = sjob->unserialize(
       (const char *)rkmessage->payload, rkmessage->len);
   if (res == false) {
     LOG(ERROR) << "unserialize stratum job fail";
@@ -300,8 +414,8 @@ void JobRepository::consumeStratumJob(rd_kafka_message_t *rkmessage) {
   }
   DLOG(INFO) << "received jobId : " << sjob->jobId_;
   server_->dispatch([this, sjob]() {
-    // here you could use Map.find() without lock, it's sure
-    // that everyone is using this Map readonly now
+    // the main reactor is the only writer of the map, so it's sure
+    // that no one is modifying it now
     auto existingJob = getStratumJobEx(sjob->jobId_);
     if (existingJob != nullptr) {
       LOG(ERROR) << "jobId already existed jobId " << sjob->jobId_;
@@ -318,7 +432,8 @@ JobRepository::createStratumJobEx(shared_ptr<StratumJob> sjob, bool isClean) {
 }
 
 void JobRepository::markAllJobsAsStale(uint64_t height) {
-  for (auto it : exJobs_) {
+  // It may be called from any reactor
+  for (auto &it : jobTable_.read()) {
     auto &exjob = it.second;
     if (exjob->sjob_ && exjob->sjob_->height() <= height) {
       exjob->markStale();
@@ -357,6 +472,7 @@ void JobRepository::sendMiningNotify(shared_ptr<StratumJobEx> exJob) {
 
 void JobRepository::tryCleanExpiredJobs() {
   const uint32_t nowTs = (uint32_t)time(nullptr);
+  bool removed = false;
   // Keep at least one job to keep normal mining when the jobmaker fails
   while (exJobs_.size() > 1) {
     // Maps (and sets) are sorted, so the first element is the smallest,
@@ -371,8 +487,12 @@ void JobRepository::tryCleanExpiredJobs() {
     LOG(INFO) << "remove expired stratum job, id: " << itr->first
               << ", time: " << date("%F %T", jobTime);
 
-    // remove expired job
+    // remove expired job, it's released when no thread is using it
     exJobs_.erase(itr);
+    removed = true;
+  }
+  if (removed) {
+    publishJobTable();
   }
 }
 
@@ -403,18 +523,98 @@ bool StratumJobEx::isStale() {
 //////////////////////////////////////
 
 SSL_CTX *StratumServer::getSSLCTX(const libconfig::Config &config) {
-  return get_server_SSL_CTX(
+  auto sslCTX = get_server_SSL_CTX(
       config.lookup("sserver.tls_cert_file").c_str(),
       config.lookup("sserver.tls_key_file").c_str());
+
+  // resumed sessions skip the key exchange when miners reconnect
+  int cacheSize = 20480;
+  int timeout = 86400;
+  bool enableTickets = true;
+  string ticketKeyFile;
+  config.lookupValue("sserver.tls_session_cache_size", cacheSize);
+  config.lookupValue("sserver.tls_session_timeout", timeout);
+  config.lookupValue("sserver.tls_session_tickets", enableTickets);
+  config.lookupValue("sserver.tls_ticket_key_file", ticketKeyFile);
+  set_server_SSL_session_cache(
+      sslCTX, cacheSize, timeout, enableTickets, ticketKeyFile);
+
+  return sslCTX;
 }
 
-StratumServer::StratumServer()
-  : enableTLS_(false)
+StratumServer::Reactor::Reactor(StratumServer &server, size_t index)
+  : server_(server)
+  , index_(index)
   , base_(nullptr)
   , listener_(nullptr)
+  , disconnectTimer_(nullptr)
+  , acceptTimer_(nullptr)
+  , tasks_(nullptr)
+  , tasksFd_(-1)
+  , tasksEvent_(nullptr)
+  , fanoutTimer_(nullptr)
+  , shareStats_(server.chains_.size()) {
+}
+
+StratumServer::Reactor::~Reactor() {
+  // Destroy connections before event base
+  connections_.clear();
+
+  if (disconnectTimer_ != nullptr) {
+    event_free(disconnectTimer_);
+  }
+  if (acceptTimer_ != nullptr) {
+    event_free(acceptTimer_);
+  }
+  if (tasksEvent_ != nullptr) {
+    event_free(tasksEvent_);
+  }
+  if (fanoutTimer_ != nullptr) {
+    event_free(fanoutTimer_);
+  }
+  if (tasksFd_ >= 0) {
+    close(tasksFd_);
+  }
+  // Tasks dispatched after the loop exited are dropped
+  for (Task *task = tasks_.exchange(nullptr); task != nullptr;) {
+    Task *next = task->next_;
+    delete task;
+    task = next;
+  }
+  if (listener_ != nullptr) {
+    evconnlistener_free(listener_);
+  }
+  if (base_ != nullptr) {
+    event_base_free(base_);
+  }
+}
+
+std::set<unique_ptr<StratumSession>>::iterator
+StratumServer::Reactor::eraseConnection(
+    std::set<unique_ptr<StratumSession>>::iterator itr) {
+  auto next = std::next(itr);
+  for (auto &fanout : fanouts_) {
+    if (fanout.started_ && fanout.next_ == itr) {
+      fanout.next_ = next;
+    }
+  }
+  connections_.erase(itr);
+  return next;
+}
+
+StratumServer::StratumServer()
+  : enableTLS_(false)
   , tcpReadTimeout_(600)
   , shutdownGracePeriod_(3600)
-  , disconnectTimer_(nullptr)
+  , drainingReactors_(0)
+  , notifyBatchSize_(1000)
+  , notifyHighWatermark_(1024 * 1024)
+  , maxJobShares_(LocalShareSet::kMaxSize)
+  , maxSessionShares_(LocalShareSet::kMaxSessionSize)
+  , latency_(LATENCY_STAGES)
+  , hotRestartListener_(nullptr)
+  , hotRestartEvent_(nullptr)
+  , hotRestartStarted_(0)
   , acceptStale_(true)
   , isEnableSimulator_(false)
   , isSubmitInvalidBlock_(false)
@@ -425,12 +625,25 @@ StratumServer::StratumServer()
 #endif
   , userIdManager_(nullptr)
   , userInfo_(nullptr)
-  , serverId_(0) {
+  , serverId_(0)
+  , sessionStates_(std::make_shared<SessionStatesCache>())
+  , shareLogFlushTimer_(nullptr) {
+  for (auto &histogram : latency_) {
+    // 10 us ~ 10 s
+    histogram = std::make_shared<prometheus::Histogram>(
+        prometheus::Histogram::exponentialBounds(0.00001, 2, 21));
+  }
 }
 
 StratumServer::~StratumServer() {
   // Destroy connections before event base
-  connections_.clear();
+  for (auto &reactor : reactors_) {
+    reactor->connections_.clear();
+  }
+
+  // Their callbacks dispatch to the reactors
+  tlsHandshaker_.reset();
+  admission_.reset();
 
   if (statsExporter_) {
     if (statsExporter_) {
@@ -441,20 +654,29 @@ StratumServer::~StratumServer() {
     statsExporter_.reset();
   }
 
-  if (disconnectTimer_ != nullptr) {
-    event_free(disconnectTimer_);
+  if (shareLogFlushTimer_ != nullptr) {
+    event_free(shareLogFlushTimer_);
   }
-
-  if (listener_ != nullptr) {
-    evconnlistener_free(listener_);
+  if (hotRestartEvent_ != nullptr) {
+    event_free(hotRestartEvent_);
   }
-  if (base_ != nullptr) {
-    event_base_free(base_);
+  if (hotRestartListener_ != nullptr) {
+    evconnlistener_free(hotRestartListener_);
+  }
+  for (int fd : inheritedListeners_) {
+    close(fd);
   }
+
+  reactors_.clear();
+
   if (userInfo_ != nullptr) {
     delete userInfo_;
   }
   for (ChainVars &chain : chains_) {
+    // flushes the remaining shares
+    if (chain.shareLogBatch_ != nullptr) {
+      delete chain.shareLogBatch_;
+    }
     if (chain.kafkaProducerShareLog_ != nullptr) {
       delete chain.kafkaProducerShareLog_;
     }
@@ -640,7 +862,6 @@ bool StratumServer::setup(const libconfig::Config &config) {
              niceHashForced,
              niceHashMinDiff,
              niceHashMinDiffZookeeperPath),
-         {},
          singleUserId});
   };
 
@@ -745,6 +966,9 @@ bool StratumServer::setup(const libconfig::Config &config) {
   config.lookupValue("sserver.proxy_protocol", proxyProtocol_);
   LOG_IF(INFO, proxyProtocol_) << "PROXY protocol support enabled";
 
+  config.lookupValue("sserver.use_share_bytes", useShareBytes_);
+  LOG_IF(INFO, useShareBytes_) << "sending shares as fixed-layout records";
+
   // ------------------- user info -------------------
   // It should at below of addChainVars() or sserver may crashed
   // because of IndexOutOfBoundsException in chains_.
@@ -870,12 +1094,6 @@ bool StratumServer::setup(const libconfig::Config &config) {
   // BEV_OPT_THREADSAFE.
   evthread_use_pthreads();
 
-  base_ = event_base_new();
-  if (!base_) {
-    LOG(ERROR) << "server: cannot create base";
-    return false;
-  }
-
   memset(&sin_, 0, sizeof(sin_));
   sin_.sin_family = AF_INET;
   sin_.sin_port = htons(listenPort);
@@ -886,23 +1104,87 @@ bool StratumServer::setup(const libconfig::Config &config) {
     return false;
   }
 
-  listener_ = evconnlistener_new_bind(
-      base_,
-      StratumServer::listenerCallback,
-      (void *)this,
-      LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE_PORT,
-      -1,
-      (struct sockaddr *)&sin_,
-      sizeof(sin_));
-  if (!listener_) {
-    LOG(ERROR) << "cannot create listener: " << listenIP << ":" << listenPort;
-    return false;
+  // Take over the listening sockets of the running process if any, the
+  // sessions are taken over once running.
+  config.lookupValue("sserver.hot_restart_socket", hotRestartSocket_);
+  if (!hotRestartSocket_.empty()) {
+    hotRestartFrom_ = HotRestartChannel::connect(hotRestartSocket_);
+    if (hotRestartFrom_ && !takeOverListeners()) {
+      LOG(WARNING) << "hot restart: cannot take over the running process, "
+                      "starting anew";
+      hotRestartFrom_.reset();
+      for (int fd : inheritedListeners_) {
+        close(fd);
+      }
+      inheritedListeners_.clear();
+    }
+  }
+
+  // Every reactor has its own event base and listener, connections are
+  // spread among them by the kernel (SO_REUSEPORT).
+  uint32_t reactorThreads = 0;
+  config.lookupValue("sserver.reactor_threads", reactorThreads);
+  reactorThreads = std::max(reactorThreads, MIN_REACTOR_THREADS);
+  for (size_t i = 0; i < reactorThreads; i++) {
+    reactors_.push_back(std::make_unique<Reactor>(*this, i));
+    if (!setupReactor(*reactors_.back())) {
+      LOG(ERROR) << "cannot create listener: " << listenIP << ":" << listenPort;
+      return false;
+    }
+  }
+  LOG(INFO) << "reactor threads: " << reactorThreads;
+  if (inheritedListeners_.size() > reactors_.size()) {
+    LOG(WARNING) << "hot restart: the old process has more reactors, the "
+                    "connections queued on "
+                 << inheritedListeners_.size() - reactors_.size()
+                 << " of its listening sockets are dropped";
+    for (size_t i = reactors_.size(); i < inheritedListeners_.size(); i++) {
+      close(inheritedListeners_[i]);
+    }
+  }
+  inheritedListeners_.clear();
+
+  // Pack shares into batches, flushed by count, size or time
+  uint32_t shareLogBatchSize = 0;
+  uint32_t shareLogBatchBytes = 64 * 1024;
+  uint32_t shareLogBatchMs = 5;
+  config.lookupValue("sserver.share_log_batch_size", shareLogBatchSize);
+  config.lookupValue("sserver.share_log_batch_bytes", shareLogBatchBytes);
+  config.lookupValue("sserver.share_log_batch_ms", shareLogBatchMs);
+  if (shareLogBatchSize > 1) {
+    for (ChainVars &chain : chains_) {
+      chain.shareLogBatch_ = new KafkaBatchProducer(
+          *chain.kafkaProducerShareLog_, shareLogBatchSize, shareLogBatchBytes);
+    }
+    shareLogFlushTimer_ = event_new(
+        mainReactor().base_,
+        -1,
+        EV_PERSIST,
+        &StratumServer::shareLogFlushCallback,
+        this);
+    timeval interval{shareLogBatchMs / 1000, shareLogBatchMs % 1000 * 1000};
+    event_add(shareLogFlushTimer_, &interval);
+    LOG(INFO) << "share log batch: " << shareLogBatchSize << " shares, "
+              << shareLogBatchBytes << " bytes, " << shareLogBatchMs << " ms";
   }
 
-  // initialize but don't activate the graceful shutdown disconnect timer event
   config.lookupValue("sserver.shutdown_grace_period", shutdownGracePeriod_);
-  disconnectTimer_ = event_new(
-      base_, -1, EV_PERSIST, &StratumServer::disconnectCallback, this);
+
+  config.lookupValue("sserver.notify_batch_size", notifyBatchSize_);
+  notifyBatchSize_ = std::max(notifyBatchSize_, MIN_NOTIFY_BATCH_SIZE);
+  config.lookupValue("sserver.notify_high_watermark", notifyHighWatermark_);
+  config.lookupValue("sserver.max_job_shares", maxJobShares_);
+  config.lookupValue("sserver.max_session_shares", maxSessionShares_);
+  maxJobShares_ = std::max(maxJobShares_, 1u);
+  maxSessionShares_ = std::max(maxSessionShares_, maxJobShares_);
+  LOG(INFO) << "max shares per job: " << maxJobShares_
+            << ", per session: " << maxSessionShares_;
+  jobNotifySeconds_.resize(chains_.size());
+  for (size_t i = 0; i < chains_.size(); i++) {
+    // 1 ms ~ 33 s
+    jobNotifyLatency_.push_back(std::make_shared<prometheus::Histogram>(
+        prometheus::Histogram::exponentialBounds(0.001, 2, 16)));
+  }
 
   // check if TLS enabled
   config.lookupValue("sserver.enable_tls", enableTLS_);
@@ -911,6 +1193,38 @@ bool StratumServer::setup(const libconfig::Config &config) {
     // try get SSL CTX (load SSL cert and key)
     // any error will abort the process
     sslCTX_ = getSSLCTX(config);
+
+    uint32_t handshakeThreads = 0;
+    uint32_t handshakeTimeout = 15;
+    config.lookupValue("sserver.tls_handshake_threads", handshakeThreads);
+    config.lookupValue("sserver.tls_handshake_timeout", handshakeTimeout);
+    if (handshakeThreads > 0) {
+      tlsHandshaker_ =
+          std::make_unique<TLSHandshaker>(handshakeThreads, handshakeTimeout);
+      if (!tlsHandshaker_->start()) {
+        return false;
+      }
+    }
+  }
+
+  // admission control, rates per second of the whole server
+  double acceptRate = 0;
+  double authorizeRate = 0;
+  config.lookupValue("sserver.admission_accept_rate", acceptRate);
+  config.lookupValue("sserver.admission_authorize_rate", authorizeRate);
+  if (acceptRate > 0 || authorizeRate > 0) {
+    double acceptBurst = acceptRate;
+    double authorizeBurst = authorizeRate;
+    uint32_t queueSize = 10000;
+    config.lookupValue("sserver.admission_accept_burst", acceptBurst);
+    config.lookupValue("sserver.admission_authorize_burst", authorizeBurst);
+    config.lookupValue("sserver.admission_queue_size", queueSize);
+    admission_ = std::make_unique<AdmissionController>(
+        acceptRate, acceptBurst, authorizeRate, authorizeBurst, queueSize);
+    admission_->start();
+    LOG(INFO) << "admission control enabled, accepts: " << acceptRate
+              << "/s, authorizations of unknown users: " << authorizeRate
+              << "/s";
   }
 
   // setup promethues exporter
@@ -931,15 +1245,24 @@ bool StratumServer::setup(const libconfig::Config &config) {
     if (!statsExporter_->registerCollector(statsCollector_)) {
       LOG(WARNING) << "Failed to register stratum server statistics collector";
     }
-    if (!statsExporter_->run(base_)) {
+    if (!statsExporter_->run(mainReactor().base_)) {
       LOG(WARNING) << "Failed to run stratum server statistics exporter";
     }
   }
 
   uint32_t shareWorkerQueueSize = 0;
   config.lookupValue("sserver.share_worker_queue_size", shareWorkerQueueSize);
-  shareWorker_ = std::make_unique<WorkerPool>(
-      std::max(shareWorkerQueueSize, MIN_SHARE_WORKER_QUEUE_SIZE));
+  shareWorkerQueueSize =
+      std::max(shareWorkerQueueSize, MIN_SHARE_WORKER_QUEUE_SIZE);
+  bool shareWorkerStealing = false;
+  config.lookupValue("sserver.share_worker_stealing", shareWorkerStealing);
+  if (shareWorkerStealing) {
+    shareWorker_ = std::make_unique<StealingWorkerPool>(shareWorkerQueueSize);
+  } else {
+    shareWorker_ = std::make_unique<WorkerPool>(shareWorkerQueueSize);
+  }
+  // so that idle share workers keep no replaced job alive
+  shareWorker_->setIdleHook([]() { JobRepository::releaseCachedJobTables(); });
 
   uint32_t shareWorkerThreads = 0;
   config.lookupValue("sserver.share_worker_threads", shareWorkerThreads);
@@ -959,25 +1282,152 @@ bool StratumServer::setup(const libconfig::Config &config) {
   return setupInternal(config);
 }
 
+bool StratumServer::setupReactor(Reactor &reactor) {
+  reactor.base_ = event_base_new();
+  if (!reactor.base_) {
+    LOG(ERROR) << "server: cannot create base";
+    return false;
+  }
+
+  if (inheritedListeners_.empty()) {
+    reactor.listener_ = evconnlistener_new_bind(
+        reactor.base_,
+        StratumServer::listenerCallback,
+        (void *)&reactor,
+        LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE_PORT,
+        -1,
+        (struct sockaddr *)&sin_,
+        sizeof(sin_));
+  } else {
+    // Listen on the sockets of the old process, the reactors beyond them
+    // share the first one
+    int fd = reactor.index_ < inheritedListeners_.size()
+        ? inheritedListeners_[reactor.index_]
+        : dup(inheritedListeners_.front());
+    if (fd < 0) {
+      LOG(ERROR) << "hot restart: cannot dup listening socket, errno: "
+                 << errno;
+      return false;
+    }
+    evutil_make_socket_nonblocking(fd);
+    // backlog 0: the socket is listening already
+    reactor.listener_ = evconnlistener_new(
+        reactor.base_,
+        StratumServer::listenerCallback,
+        (void *)&reactor,
+        LEV_OPT_REUSEABLE | LEV_OPT_CLOSE_ON_FREE,
+        0,
+        fd);
+  }
+  if (!reactor.listener_) {
+    return false;
+  }
+  if (hotRestartFrom_) {
+    // The old process keeps accepting until the sessions are taken over, so
+    // that the session ids do not collide
+    evconnlistener_disable(reactor.listener_);
+  }
+
+  reactor.acceptTimer_ =
+      evtimer_new(reactor.base_, &StratumServer::acceptCallback, &reactor);
+
+  // initialize but don't activate the graceful shutdown disconnect timer event
+  reactor.disconnectTimer_ = event_new(
+      reactor.base_,
+      -1,
+      EV_PERSIST,
+      &StratumServer::disconnectCallback,
+      &reactor);
+
+  reactor.tasksFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (reactor.tasksFd_ < 0) {
+    LOG(ERROR) << "server: cannot create eventfd, errno: " << errno;
+    return false;
+  }
+  reactor.tasksEvent_ = event_new(
+      reactor.base_,
+      reactor.tasksFd_,
+      EV_READ | EV_PERSIST,
+      &StratumServer::tasksCallback,
+      &reactor);
+  event_add(reactor.tasksEvent_, nullptr);
+
+  // job broadcasts continue from a timer, so that the loop polls the sockets
+  // between the slices
+  reactor.fanoutTimer_ =
+      evtimer_new(reactor.base_, &StratumServer::fanoutCallback, &reactor);
+  return true;
+}
+
+void StratumServer::runReactor(Reactor &reactor) {
+  tlsReactor = &reactor;
+  // Keep running while the listener is disabled during graceful shutdown,
+  // tasks may still be dispatched to this reactor.
+  event_base_loop(reactor.base_, EVLOOP_NO_EXIT_ON_EMPTY);
+  tlsReactor = nullptr;
+}
+
 void StratumServer::run() {
   if (management_) {
     management_->run();
   }
   LOG(INFO) << "stratum server running";
-  if (base_ != NULL) {
-    //    event_base_loop(base_, EVLOOP_NONBLOCK);
-    event_base_dispatch(base_);
+  if (reactors_.empty()) {
+    return;
+  }
+
+  for (size_t i = 1; i < reactors_.size(); i++) {
+    auto &reactor = *reactors_[i];
+    reactor.thread_ = std::thread([this, &reactor]() { runReactor(reactor); });
+  }
+
+  if (hotRestartFrom_) {
+    // take over the sessions once there are jobs to send to them
+    hotRestartStarted_ = time(nullptr);
+    hotRestartEvent_ = event_new(
+        mainReactor().base_,
+        -1,
+        EV_PERSIST,
+        &StratumServer::hotRestartTimerCallback,
+        this);
+    timeval interval{0, 100000};
+    event_add(hotRestartEvent_, &interval);
+  } else if (!hotRestartSocket_.empty()) {
+    listenHotRestart();
+  }
+
+  // a first count of the sessions, so the stats have one before any refresh
+  refreshSessionStates();
+
+  tlsReactor = &mainReactor();
+  event_base_dispatch(mainReactor().base_);
+  tlsReactor = nullptr;
+
+  for (size_t i = 1; i < reactors_.size(); i++) {
+    auto &reactor = *reactors_[i];
+    event_base_loopexit(reactor.base_, NULL);
+    if (reactor.thread_.joinable()) {
+      reactor.thread_.join();
+    }
   }
 }
 
 void StratumServer::stop() {
   LOG(INFO) << "stop stratum server";
-  event_base_loopexit(base_, NULL);
+  for (auto &reactor : reactors_) {
+    event_base_loopexit(reactor->base_, NULL);
+  }
   for (ChainVars &chain : chains_) {
     chain.jobRepository_->stop();
   }
   userInfo_->stop();
   shareWorker_->stop();
+  if (tlsHandshaker_) {
+    tlsHandshaker_->stop();
+  }
+  if (admission_) {
+    admission_->stop();
+  }
   if (management_) {
     management_->stop();
   }
@@ -986,53 +1436,65 @@ void StratumServer::stop() {
 void StratumServer::stopGracefully() {
   LOG(INFO) << "stop stratum server gracefully";
 
-  // Stop listening & trigger gracefully disconnecting timer
-  evconnlistener_disable(listener_);
-  if (connections_.empty()) {
-    dispatch([this]() { stop(); });
+  // Stop listening & trigger gracefully disconnecting timers, the server
+  // stops after all reactors are drained.
+  drainingReactors_ = reactors_.size();
+  for (auto &reactor : reactors_) {
+    auto r = reactor.get();
+    dispatch(*r, [this, r]() { drainReactor(*r); });
+  }
+}
+
+void StratumServer::drainReactor(Reactor &reactor) {
+  evconnlistener_disable(reactor.listener_);
+  event_del(reactor.acceptTimer_);
+  auto &connections = reactor.connections_;
+  if (connections.empty()) {
+    reactorDrained();
   } else {
     timeval timeout;
-    timeout.tv_sec = shutdownGracePeriod_ / connections_.size();
+    timeout.tv_sec = shutdownGracePeriod_ / connections.size();
     timeout.tv_usec =
-        (shutdownGracePeriod_ - timeout.tv_sec * connections_.size()) *
-        1000000 / connections_.size();
-    event_add(disconnectTimer_, &timeout);
+        (shutdownGracePeriod_ - timeout.tv_sec * connections.size()) *
+        1000000 / connections.size();
+    event_add(reactor.disconnectTimer_, &timeout);
   }
 }
 
-namespace {
-
-class StratumServerTask {
-public:
-  StratumServerTask(event_base *base, std::function<void()> task)
-    : task_{move(task)}
-    , event_{event_new(base, -1, 0, &StratumServerTask::execute, this)} {
-    event_add(event_, nullptr);
-    event_active(event_, EV_TIMEOUT, 0);
+void StratumServer::reactorDrained() {
+  if (--drainingReactors_ == 0) {
+    dispatch(mainReactor(), [this]() { stop(); });
   }
+}
 
-  static void execute(evutil_socket_t, short, void *context) {
-    delete static_cast<StratumServerTask *>(context);
-  }
-
-private:
-  ~StratumServerTask() {
-    task_();
-    event_free(event_);
-  }
-
-  std::function<void()> task_;
-  struct event *event_;
-};
-
-} // namespace
+StratumServer::Reactor &StratumServer::currentReactor() {
+  return tlsReactor != nullptr ? *tlsReactor : mainReactor();
+}
 
 void StratumServer::dispatch(std::function<void()> task) {
+  dispatch(currentReactor(), move(task));
+}
+
+void StratumServer::dispatch(Reactor &reactor, std::function<void()> task) {
   if (!task) {
     return;
   }
-
-  new StratumServerTask{base_, move(task)};
+  auto node = new Reactor::Task{move(task), reactor.tasks_.load()};
+  if (tlsOnBehalfOf) {
+    // a result of a share work, see tasksCallback()
+    node->dispatched_ = chrono::steady_clock::now();
+  }
+  while (!reactor.tasks_.compare_exchange_weak(node->next_, node)) {
+  }
+  // Only the first task of a batch wakes the loop, the others are picked up
+  // by the same wakeup
+  if (node->next_ == nullptr) {
+    uint64_t one = 1;
+    if (write(reactor.tasksFd_, &one, sizeof(one)) != sizeof(one)) {
+      LOG(ERROR) << "failed to wake up reactor " << reactor.index_
+                 << ", errno: " << errno;
+    }
+  }
 }
 
 void StratumServer::dispatchSafely(
@@ -1048,46 +1510,206 @@ void StratumServer::dispatchSafely(
   });
 }
 
-void StratumServer::dispatchToShareWorker(std::function<void()> work) {
-  shareWorker_->dispatch(std::move(work));
+StratumServer::Reactor *StratumServer::callerReactor() const {
+  return tlsReactor;
 }
 
-size_t StratumServer::switchChain(string userName, size_t newChainId) {
-  size_t onlineSessions = 0;
-  for (auto &itr : connections_) {
-    if (itr->getUserName() == userName) {
-      onlineSessions++;
-      if (itr->getChainId() != newChainId) {
-        itr->switchChain(newChainId);
-      }
+StratumServer::Reactor *StratumServer::swapCallerReactor(Reactor *reactor) {
+  tlsOnBehalfOf = reactor != nullptr;
+  std::swap(tlsReactor, reactor);
+  return reactor;
+}
+
+void StratumServer::dispatchShareTask(WorkerTask task) {
+  if (tlsShareWorkBatch != nullptr) {
+    tlsShareWorkBatch->push_back(std::move(task));
+  } else {
+    shareWorker_->dispatch(std::move(task));
+  }
+}
+
+void StratumServer::beginShareWorkBatch() {
+  if (tlsShareWorkBatch == nullptr) {
+    tlsShareWorkBatch = new std::vector<WorkerTask>;
+  }
+}
+
+void StratumServer::endShareWorkBatch() {
+  std::unique_ptr<std::vector<WorkerTask>> batch{tlsShareWorkBatch};
+  tlsShareWorkBatch = nullptr;
+  if (!batch || batch->empty()) {
+    return;
+  }
+  if (batch->size() == 1) {
+    shareWorker_->dispatch(std::move(batch->front()));
+    return;
+  }
+  shareWorker_->dispatch([batch = std::move(batch)]() {
+    for (auto &task : *batch) {
+      task();
     }
+  });
+}
+
+const char *StratumServer::latencyStageName(LatencyStage stage) {
+  switch (stage) {
+  case LATENCY_READ_TO_PARSE:
+    return "read_to_parse";
+  case LATENCY_PARSE_TO_ENQUEUE:
+    return "parse_to_enqueue";
+  case LATENCY_WORKER_QUEUE:
+    return "worker_queue";
+  case LATENCY_VERIFY:
+    return "verify";
+  case LATENCY_WORKER_TO_LOOP:
+    return "worker_to_loop";
+  case LATENCY_WRITE:
+    return "write";
+  default:
+    return "unknown";
   }
-  return onlineSessions;
 }
 
-size_t StratumServer::autoSwitchChain(size_t newChainId) {
-  size_t switchedSessions = 0;
-  for (auto &itr : connections_) {
-    if (userInfo_->userAutoSwitchChainEnabled(itr->getUserName()) &&
-        itr->getChainId() != newChainId) {
-      switchedSessions++;
-      itr->switchChain(newChainId);
+void StratumServer::setRequestTime(chrono::steady_clock::time_point time) {
+  tlsRequestTime = time;
+}
+
+chrono::steady_clock::time_point StratumServer::requestTime() {
+  return tlsRequestTime;
+}
+
+void StratumServer::forEachReactor(
+    std::function<size_t(Reactor &)> task,
+    std::function<void(size_t)> callback) {
+  struct Context {
+    std::function<size_t(Reactor &)> task_;
+    std::function<void(size_t)> callback_;
+    atomic<size_t> pending_;
+    atomic<size_t> result_;
+  };
+  auto context = std::make_shared<Context>();
+  context->task_ = std::move(task);
+  context->callback_ = std::move(callback);
+  context->pending_ = reactors_.size();
+  context->result_ = 0;
+
+  for (auto &reactor : reactors_) {
+    auto r = reactor.get();
+    dispatch(*r, [this, r, context]() {
+      context->result_ += context->task_(*r);
+      if (--context->pending_ == 0 && context->callback_) {
+        dispatch(mainReactor(), [context]() {
+          context->callback_(context->result_);
+        });
+      }
+    });
+  }
+}
+
+void StratumServer::switchChain(
+    string userName,
+    size_t newChainId,
+    std::function<void(size_t)> callback) {
+  forEachReactor(
+      [userName, newChainId](Reactor &reactor) {
+        size_t onlineSessions = 0;
+        for (auto &itr : reactor.connections_) {
+          if (itr->getUserName() == userName) {
+            onlineSessions++;
+            if (itr->getChainId() != newChainId) {
+              itr->switchChain(newChainId);
+            }
+          }
+        }
+        return onlineSessions;
+      },
+      std::move(callback));
+}
+
+void StratumServer::autoSwitchChain(
+    size_t newChainId, std::function<void(size_t)> callback) {
+  forEachReactor(
+      [this, newChainId](Reactor &reactor) {
+        size_t switchedSessions = 0;
+        for (auto &itr : reactor.connections_) {
+          if (userInfo_->userAutoSwitchChainEnabled(itr->getUserName()) &&
+              itr->getChainId() != newChainId) {
+            switchedSessions++;
+            itr->switchChain(newChainId);
+          }
+        }
+        return switchedSessions;
+      },
+      std::move(callback));
+}
+
+void StratumServer::autoRegCallback(
+    const string &userName, std::function<void(size_t)> callback) {
+  forEachReactor(
+      [userName](Reactor &reactor) {
+        size_t sessions = 0;
+        for (auto &itr : reactor.connections_) {
+          if (itr->autoRegCallback(userName)) {
+            sessions++;
+          }
+        }
+        return sessions;
+      },
+      std::move(callback));
+}
+
+void StratumServer::sendMiningNotifyToAll(shared_ptr<StratumJobEx> exJobPtr) {
+  auto broadcast = std::make_shared<JobBroadcast>();
+  broadcast->received_ = std::chrono::steady_clock::now();
+  broadcast->pendingReactors_ = reactors_.size();
+  broadcast->superseded_ = false;
+
+  for (auto &reactor : reactors_) {
+    auto r = reactor.get();
+    if (r == &mainReactor()) {
+      scheduleFanout(*r, exJobPtr, broadcast);
+    } else {
+      dispatch(*r, [this, r, exJobPtr, broadcast]() {
+        scheduleFanout(*r, exJobPtr, broadcast);
+      });
     }
   }
-  return switchedSessions;
 }
 
-size_t StratumServer::autoRegCallback(const string &userName) {
-  size_t sessions = 0;
-  for (auto &itr : connections_) {
-    if (itr->autoRegCallback(userName)) {
-      sessions++;
+void StratumServer::scheduleFanout(
+    Reactor &reactor,
+    shared_ptr<StratumJobEx> exJobPtr,
+    shared_ptr<JobBroadcast> broadcast) {
+  auto &fanouts = reactor.fanouts_;
+  for (auto itr = fanouts.begin(); itr != fanouts.end();) {
+    if (itr->exJob_->chainId_ == exJobPtr->chainId_ &&
+        (exJobPtr->isClean_ || !itr->exJob_->isClean_)) {
+      finishFanout(*itr, false);
+      itr = fanouts.erase(itr);
+    } else {
+      ++itr;
     }
   }
-  return sessions;
+
+  Reactor::Fanout fanout{exJobPtr, std::move(broadcast), false, {}};
+  if (exJobPtr->isClean_) {
+    // preempt the refreshes, including the one being sent
+    auto itr = std::find_if(
+        fanouts.begin(), fanouts.end(), [](const Reactor::Fanout &f) {
+          return !f.exJob_->isClean_;
+        });
+    fanouts.insert(itr, std::move(fanout));
+  } else {
+    fanouts.push_back(std::move(fanout));
+  }
+
+  if (!evtimer_pending(reactor.fanoutTimer_, nullptr)) {
+    timeval now{0, 0};
+    evtimer_add(reactor.fanoutTimer_, &now);
+  }
 }
 
-void StratumServer::sendMiningNotifyToAll(shared_ptr<StratumJobEx> exJobPtr) {
+void StratumServer::continueFanout(Reactor &reactor) {
   //
   // http://www.sgi.com/tech/stl/Map.html
   //
@@ -1097,25 +1719,68 @@ void StratumServer::sendMiningNotifyToAll(shared_ptr<StratumJobEx> exJobPtr) {
   // of course, for iterators that actually point to the element that is
   // being erased.
   //
-  auto itr = connections_.begin();
-  while (itr != connections_.end()) {
-    auto &conn = *itr;
-    if (conn->isDead()) {
+  auto &connections = reactor.connections_;
+  auto &fanouts = reactor.fanouts_;
+  size_t budget = notifyBatchSize_;
+  while (!fanouts.empty() && budget > 0) {
+    auto &fanout = fanouts.front();
+    if (!fanout.started_) {
+      fanout.next_ = connections.begin();
+      fanout.started_ = true;
+    }
+
+    for (; fanout.next_ != connections.end() && budget > 0; budget--) {
+      auto &conn = *fanout.next_;
+      if (conn->isDead()) {
 #ifndef WORK_WITH_STRATUM_SWITCHER
-      sessionIDManager_->freeSessionId(conn->getSessionId());
+        sessionIDManager_->freeSessionId(conn->getSessionId());
 #endif
-      itr = connections_.erase(itr);
-    } else {
-      if (conn->getChainId() == exJobPtr->chainId_) {
-        conn->sendMiningNotify(exJobPtr);
+        ScopeLock sl(reactor.lock_);
+        reactor.eraseConnection(fanout.next_);
+      } else {
+        if (conn->getChainId() == fanout.exJob_->chainId_) {
+          conn->notifyJob(fanout.exJob_, notifyHighWatermark_);
+        }
+        ++fanout.next_;
       }
-      ++itr;
+    }
+
+    if (fanout.next_ == connections.end()) {
+      finishFanout(fanout, true);
+      fanouts.pop_front();
     }
   }
+
+  if (!fanouts.empty()) {
+    timeval now{0, 0};
+    evtimer_add(reactor.fanoutTimer_, &now);
+  }
+}
+
+void StratumServer::finishFanout(
+    const Reactor::Fanout &fanout, bool completed) {
+  auto &broadcast = *fanout.broadcast_;
+  if (!completed) {
+    broadcast.superseded_ = true;
+  }
+  if (--broadcast.pendingReactors_ == 0 && !broadcast.superseded_) {
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - broadcast.received_;
+    jobNotifyLatency_[fanout.exJob_->chainId_]->observe(seconds.count());
+    ScopeLock sl(jobNotifySecondsLock_);
+    jobNotifySeconds_[fanout.exJob_->chainId_] = seconds.count();
+  }
+}
+
+double StratumServer::jobNotifySeconds(size_t chainId) const {
+  ScopeLock sl(jobNotifySecondsLock_);
+  return jobNotifySeconds_[chainId];
 }
 
 void StratumServer::addConnection(unique_ptr<StratumSession> connection) {
-  connections_.insert(move(connection));
+  auto &reactor = currentReactor();
+  ScopeLock sl(reactor.lock_);
+  reactor.connections_.insert(move(connection));
 }
 
 void StratumServer::removeConnection(StratumSession &connection) {
@@ -1132,11 +1797,24 @@ void StratumServer::listenerCallback(
     struct sockaddr *saddr,
     int socklen,
     void *data) {
-  StratumServer *server = static_cast<StratumServer *>(data);
-  struct event_base *base = (struct event_base *)server->base_;
+  auto &reactor = *static_cast<Reactor *>(data);
+  StratumServer *server = &reactor.server_;
+  struct event_base *base = reactor.base_;
   struct bufferevent *bev;
   uint32_t sessionID = 0u;
 
+  if (server->admission_) {
+    double pause = server->admission_->accept();
+    if (pause > 0) {
+      // leave the next connections in the backlog until the bucket refills
+      evconnlistener_disable(listener);
+      struct timeval timeout;
+      timeout.tv_sec = (time_t)pause;
+      timeout.tv_usec = (suseconds_t)((pause - timeout.tv_sec) * 1000000);
+      event_add(reactor.acceptTimer_, &timeout);
+    }
+  }
+
 #ifndef WORK_WITH_STRATUM_SWITCHER
   // can't alloc session Id
   if (server->sessionIDManager_->allocSessionId(&sessionID) == false) {
@@ -1163,6 +1841,12 @@ void StratumServer::listenerCallback(
       return;
     }
 
+    if (server->tlsHandshaker_) {
+      server->acceptTLSInBackground(
+          reactor, fd, ssl, saddr, socklen, sessionID);
+      return;
+    }
+
     bev = bufferevent_openssl_socket_new(
         base,
         fd,
@@ -1183,8 +1867,79 @@ void StratumServer::listenerCallback(
     return;
   }
 
+  server->setupConnection(bev, saddr, sessionID);
+}
+
+void StratumServer::acceptCallback(evutil_socket_t, short, void *context) {
+  auto &reactor = *static_cast<Reactor *>(context);
+  evconnlistener_enable(reactor.listener_);
+}
+
+bool StratumServer::deferAuthorization(const string &userName) {
+  return admission_ && admission_->meteringAuthorizations() &&
+      !userInfo_->isKnownUser(userName);
+}
+
+bool StratumServer::deferAdmission(
+    std::function<void()> step,
+    std::function<void()> then,
+    std::weak_ptr<bool> alive) {
+  auto r = &currentReactor();
+  return admission_->defer([this, r, step, then, alive]() {
+    step();
+    dispatch(*r, [then, alive]() {
+      if (!alive.expired()) {
+        then();
+      }
+    });
+  });
+}
+
+void StratumServer::acceptTLSInBackground(
+    Reactor &reactor,
+    evutil_socket_t fd,
+    SSL *ssl,
+    struct sockaddr *saddr,
+    int socklen,
+    uint32_t sessionID) {
+  struct sockaddr_storage addr;
+  memset(&addr, 0, sizeof(addr));
+  memcpy(&addr, saddr, std::min(sizeof(addr), (size_t)socklen));
+
+  auto r = &reactor;
+  tlsHandshaker_->handshake(
+      fd, ssl, [this, r, fd, ssl, addr, sessionID](bool success) {
+        // back to the reactor which accepted the connection
+        dispatch(*r, [this, r, fd, ssl, addr, sessionID, success]() {
+          struct bufferevent *bev = nullptr;
+          if (success) {
+            bev = bufferevent_openssl_socket_new(
+                r->base_,
+                fd,
+                ssl,
+                BUFFEREVENT_SSL_OPEN,
+                BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+            if (bev == nullptr) {
+              LOG(ERROR) << "Error constructing bufferevent!";
+              SSL_free(ssl);
+              close(fd);
+            }
+          }
+          if (bev == nullptr) {
+#ifndef WORK_WITH_STRATUM_SWITCHER
+            sessionIDManager_->freeSessionId(sessionID);
+#endif
+            return;
+          }
+          setupConnection(bev, (struct sockaddr *)&addr, sessionID);
+        });
+      });
+}
+
+void StratumServer::setupConnection(
+    struct bufferevent *bev, struct sockaddr *saddr, uint32_t sessionID) {
   // create stratum session
-  auto conn = server->createConnection(bev, saddr, sessionID);
+  auto conn = createConnection(bev, saddr, sessionID);
   if (!conn->initialize()) {
     return;
   }
@@ -1192,35 +1947,426 @@ void StratumServer::listenerCallback(
   bufferevent_setcb(
       bev,
       StratumServer::readCallback,
-      nullptr,
+      StratumServer::writeCallback,
       StratumServer::eventCallback,
       conn.get());
   // By default, a newly created bufferevent has writing enabled.
   bufferevent_enable(bev, EV_READ | EV_WRITE);
 
-  server->addConnection(move(conn));
+  addConnection(move(conn));
+}
+
+bool StratumServer::takeOverListeners() {
+  JSON chains = JSON::array();
+  for (auto &chain : chains_) {
+    chains.push_back(chain.name_);
+  }
+  JSON request{{"action", "listeners"},
+               {"server_id", serverId_},
+               {"chains", chains}};
+  JSON reply;
+  if (!hotRestartFrom_->send(request) ||
+      !hotRestartFrom_->receive(reply, inheritedListeners_)) {
+    return false;
+  }
+  if (inheritedListeners_.empty()) {
+    LOG(ERROR) << "hot restart: refused by the running process: "
+               << reply.dump();
+    return false;
+  }
+  LOG(INFO) << "hot restart: took over " << inheritedListeners_.size()
+            << " listening sockets";
+  return true;
+}
+
+void StratumServer::takeOverSessions() {
+  size_t sessions = 0;
+  bool done = false;
+  if (hotRestartFrom_->send({{"action", "sessions"}})) {
+    JSON message;
+    vector<int> fds;
+    while (!done && hotRestartFrom_->receive(message, fds)) {
+      vector<SessionState> states;
+      try {
+        done = message.value("done", false);
+        if (!done) {
+          message.at("sessions").get_to(states);
+        }
+      } catch (const JSONException &ex) {
+        LOG(ERROR) << "hot restart: bad sessions: " << ex.what();
+      }
+
+      // spread the sessions among the reactors
+      for (size_t i = 0; i < fds.size(); i++) {
+        if (i >= states.size()) {
+          close(fds[i]);
+          continue;
+        }
+        auto &reactor = *reactors_[sessions++ % reactors_.size()];
+        dispatch(
+            reactor,
+            [this, state = std::move(states[i]), fd = fds[i]]() mutable {
+              restoreSession(state, fd);
+            });
+      }
+    }
+  }
+  LOG_IF(ERROR, !done) << "hot restart: the old process did not hand over "
+                          "all sessions";
+  LOG(INFO) << "hot restart: took over " << sessions << " sessions";
+  hotRestartFrom_.reset();
+
+  // Accept new sessions after the ids of the taken over ones are reserved,
+  // the tasks of a reactor run in order
+  for (auto &reactor : reactors_) {
+    auto r = reactor.get();
+    dispatch(*r, [r]() { evconnlistener_enable(r->listener_); });
+  }
+  listenHotRestart();
+}
+
+void StratumServer::restoreSession(SessionState &state, int fd) {
+  auto &reactor = currentReactor();
+
+#ifndef WORK_WITH_STRATUM_SWITCHER
+  if (!sessionIDManager_->reserveSessionId(state.sessionId_)) {
+    LOG(ERROR) << "hot restart: session id " << state.sessionId_
+               << " is not available, disconnect " << state.fullName_;
+    close(fd);
+    return;
+  }
+#endif
+
+  evutil_make_socket_nonblocking(fd);
+  auto bev = bufferevent_socket_new(
+      reactor.base_, fd, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
+  if (bev == nullptr) {
+    LOG(ERROR) << "hot restart: error constructing bufferevent";
+    close(fd);
+#ifndef WORK_WITH_STRATUM_SWITCHER
+    sessionIDManager_->freeSessionId(state.sessionId_);
+#endif
+    return;
+  }
+
+  struct sockaddr_in sin;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = state.clientIp_;
+  auto conn = createConnection(bev, (struct sockaddr *)&sin, state.sessionId_);
+  if (!conn->initialize() || !conn->restoreState(state)) {
+#ifndef WORK_WITH_STRATUM_SWITCHER
+    sessionIDManager_->freeSessionId(state.sessionId_);
+#endif
+    return;
+  }
+  bufferevent_setcb(
+      bev,
+      StratumServer::readCallback,
+      StratumServer::writeCallback,
+      StratumServer::eventCallback,
+      conn.get());
+  bufferevent_enable(bev, EV_READ | EV_WRITE);
+
+  addConnection(move(conn));
+}
+
+void StratumServer::listenHotRestart() {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (hotRestartSocket_.size() >= sizeof(addr.sun_path)) {
+    LOG(ERROR) << "hot restart: socket path too long: " << hotRestartSocket_;
+    return;
+  }
+  memcpy(addr.sun_path, hotRestartSocket_.data(), hotRestartSocket_.size());
+
+  // replaces the socket of the old process, if any
+  unlink(hotRestartSocket_.c_str());
+  hotRestartListener_ = evconnlistener_new_bind(
+      mainReactor().base_,
+      StratumServer::hotRestartListenerCallback,
+      this,
+      LEV_OPT_CLOSE_ON_FREE | LEV_OPT_CLOSE_ON_EXEC,
+      -1,
+      (struct sockaddr *)&addr,
+      sizeof(addr));
+  if (hotRestartListener_ == nullptr) {
+    LOG(ERROR) << "hot restart: cannot listen on " << hotRestartSocket_
+               << ", errno: " << errno;
+    return;
+  }
+  LOG(INFO) << "hot restart: listening on " << hotRestartSocket_;
+}
+
+void StratumServer::handOverListeners() {
+  JSON request;
+  vector<int> fds;
+  if (!hotRestartTo_->receive(request, fds)) {
+    closeHotRestartChannel();
+    return;
+  }
+  for (int fd : fds) {
+    close(fd);
+  }
+
+  JSON chains = JSON::array();
+  for (auto &chain : chains_) {
+    chains.push_back(chain.name_);
+  }
+  string error;
+  try {
+    if (request.value("action", "") != "listeners") {
+      error = "unexpected request";
+    } else if (request.value("server_id", -1) != serverId_) {
+      error = "server id mismatched";
+    } else if (request.value("chains", JSON()) != chains) {
+      error = "chains mismatched";
+    }
+  } catch (const JSONException &ex) {
+    error = ex.what();
+  }
+  if (!error.empty()) {
+    LOG(ERROR) << "hot restart: refused the new process, " << error;
+    hotRestartTo_->send({{"error", error}});
+    closeHotRestartChannel();
+    return;
+  }
+
+  vector<int> listeners;
+  for (auto &reactor : reactors_) {
+    if (listeners.size() < HotRestartChannel::kMaxFds) {
+      listeners.push_back(evconnlistener_get_fd(reactor->listener_));
+    }
+  }
+  if (!hotRestartTo_->send({{"listeners", listeners.size()}}, listeners)) {
+    closeHotRestartChannel();
+    return;
+  }
+  LOG(INFO) << "hot restart: handed over the listening sockets, waiting for "
+               "the new process";
+
+  hotRestartEvent_ = event_new(
+      mainReactor().base_,
+      hotRestartTo_->fd(),
+      EV_READ,
+      &StratumServer::hotRestartRequestCallback,
+      this);
+  event_add(hotRestartEvent_, nullptr);
+}
+
+void StratumServer::handOverSessions() {
+  LOG(INFO) << "hot restart: handing over the sessions";
+  // neither another new process nor new sessions from now on
+  evconnlistener_free(hotRestartListener_);
+  hotRestartListener_ = nullptr;
+
+  struct Handover {
+    mutex lock_;
+    vector<SessionState> states_;
+    vector<int> fds_;
+  };
+  auto handover = std::make_shared<Handover>();
+  forEachReactor(
+      [this, handover](Reactor &reactor) {
+        evconnlistener_disable(reactor.listener_);
+        event_del(reactor.acceptTimer_);
+        // the TLS state cannot be moved
+        if (enableTLS_) {
+          return size_t(0);
+        }
+
+        size_t moved = 0;
+        ScopeLock sl(reactor.lock_);
+        auto &connections = reactor.connections_;
+        for (auto itr = connections.begin(); itr != connections.end();) {
+          SessionState state;
+          if (!(*itr)->saveState(state)) {
+            ++itr;
+            continue;
+          }
+          // the session closes its own descriptor
+          int fd = dup((*itr)->getSocket());
+          if (fd < 0) {
+            LOG(ERROR) << "hot restart: cannot dup socket, errno: " << errno;
+            ++itr;
+            continue;
+          }
+          {
+            ScopeLock hl(handover->lock_);
+            handover->states_.push_back(std::move(state));
+            handover->fds_.push_back(fd);
+          }
+          itr = reactor.eraseConnection(itr);
+          moved++;
+        }
+        return moved;
+      },
+      [this, handover](size_t moved) {
+        auto &states = handover->states_;
+        auto &fds = handover->fds_;
+        bool success = true;
+        for (size_t i = 0; success && i < states.size();
+             i += HotRestartChannel::kMaxFds) {
+          size_t end = std::min(states.size(), i + HotRestartChannel::kMaxFds);
+          JSON message{{"sessions",
+                        vector<SessionState>(
+                            states.begin() + i, states.begin() + end)}};
+          success = hotRestartTo_->send(
+              message, vector<int>(fds.begin() + i, fds.begin() + end));
+        }
+        success = success && hotRestartTo_->send({{"done", true}});
+        for (int fd : fds) {
+          close(fd);
+        }
+        if (success) {
+          LOG(INFO) << "hot restart: handed over " << moved << " sessions";
+        } else {
+          LOG(ERROR) << "hot restart: failed to hand over " << moved
+                     << " sessions, they are disconnected";
+        }
+        closeHotRestartChannel();
+
+        // the sessions left are disconnected as in a graceful shutdown
+        stopGracefully();
+      });
+}
+
+void StratumServer::closeHotRestartChannel() {
+  if (hotRestartEvent_ != nullptr) {
+    event_free(hotRestartEvent_);
+    hotRestartEvent_ = nullptr;
+  }
+  hotRestartTo_.reset();
+}
+
+void StratumServer::hotRestartListenerCallback(
+    struct evconnlistener *listener,
+    evutil_socket_t fd,
+    struct sockaddr *saddr,
+    int socklen,
+    void *data) {
+  auto server = static_cast<StratumServer *>(data);
+  if (server->hotRestartTo_) {
+    LOG(WARNING) << "hot restart: another new process is taking over, "
+                    "refused";
+    close(fd);
+    return;
+  }
+  server->hotRestartTo_ = std::make_unique<HotRestartChannel>(fd);
+  server->handOverListeners();
+}
+
+void StratumServer::hotRestartRequestCallback(
+    evutil_socket_t, short, void *data) {
+  auto server = static_cast<StratumServer *>(data);
+  JSON request;
+  vector<int> fds;
+  bool received = server->hotRestartTo_->receive(request, fds);
+  for (int fd : fds) {
+    close(fd);
+  }
+
+  bool sessionsRequested = false;
+  try {
+    sessionsRequested =
+        received && request.value("action", "") == string("sessions");
+  } catch (const JSONException &ex) {
+    LOG(ERROR) << "hot restart: bad request: " << ex.what();
+  }
+  if (!sessionsRequested) {
+    LOG(WARNING) << "hot restart: the new process gave up";
+    server->closeHotRestartChannel();
+    return;
+  }
+  server->handOverSessions();
+}
+
+void StratumServer::hotRestartTimerCallback(
+    evutil_socket_t, short, void *data) {
+  auto server = static_cast<StratumServer *>(data);
+  bool ready = true;
+  for (auto &chain : server->chains_) {
+    if (!chain.jobRepository_->getLatestStratumJobEx()) {
+      ready = false;
+    }
+  }
+  if (!ready && time(nullptr) - server->hotRestartStarted_ <
+          HOT_RESTART_JOB_WAIT_SECONDS) {
+    return;
+  }
+  LOG_IF(WARNING, !ready) << "hot restart: no job of some chains yet, taking "
+                             "over the sessions anyway";
+
+  event_free(server->hotRestartEvent_);
+  server->hotRestartEvent_ = nullptr;
+  server->takeOverSessions();
 }
 
 void StratumServer::disconnectCallback(int, short, void *context) {
-  auto server = static_cast<StratumServer *>(context);
-  if (server->connections_.empty()) {
-    server->stop();
+  auto &reactor = *static_cast<Reactor *>(context);
+  auto &connections = reactor.connections_;
+  if (connections.empty()) {
+    event_del(reactor.disconnectTimer_);
+    reactor.server_.reactorDrained();
   } else {
-    auto iter = server->connections_.begin();
-    auto iend = server->connections_.end();
+    ScopeLock sl(reactor.lock_);
+    auto iter = connections.begin();
+    auto iend = connections.end();
     StratumSession::State state;
     do {
       state = (*iter)->getState();
-      iter = server->connections_.erase(iter);
+      iter = reactor.eraseConnection(iter);
     } while (state < StratumSession::AUTHENTICATED && iter != iend);
   }
 }
 
+void StratumServer::tasksCallback(int fd, short, void *context) {
+  auto &reactor = *static_cast<Reactor *>(context);
+  uint64_t count;
+  if (read(fd, &count, sizeof(count)) != sizeof(count) && errno != EAGAIN) {
+    LOG(ERROR) << "failed to read eventfd of reactor " << reactor.index_
+               << ", errno: " << errno;
+  }
+
+  // Take all pending tasks at once, the list is in reverse dispatch order.
+  // Tasks dispatched by these tasks wake the loop again.
+  Reactor::Task *tasks = reactor.tasks_.exchange(nullptr);
+  Reactor::Task *ordered = nullptr;
+  while (tasks != nullptr) {
+    Reactor::Task *next = tasks->next_;
+    tasks->next_ = ordered;
+    ordered = tasks;
+    tasks = next;
+  }
+  while (ordered != nullptr) {
+    unique_ptr<Reactor::Task> task{ordered};
+    ordered = ordered->next_;
+    if (task->dispatched_ != chrono::steady_clock::time_point{}) {
+      reactor.server_.observeLatency(
+          LATENCY_WORKER_TO_LOOP, task->dispatched_);
+    }
+    task->task_();
+  }
+}
+
+void StratumServer::fanoutCallback(int, short, void *context) {
+  auto &reactor = *static_cast<Reactor *>(context);
+  reactor.server_.continueFanout(reactor);
+}
+
 void StratumServer::readCallback(struct bufferevent *bev, void *connection) {
   auto conn = static_cast<StratumSession *>(connection);
   conn->readBuf(bufferevent_get_input(bev));
 }
 
+void StratumServer::writeCallback(struct bufferevent *, void *connection) {
+  // the output buffer is empty
+  auto conn = static_cast<StratumSession *>(connection);
+  conn->outputWritten();
+  conn->flushDeferredJob();
+}
+
 void StratumServer::eventCallback(
     struct bufferevent *bev, short events, void *connection) {
   auto conn = static_cast<StratumSession *>(connection);
@@ -1252,9 +2398,99 @@ void StratumServer::eventCallback(
   conn->getServer().removeConnection(*conn);
 }
 
+size_t StratumServer::connectionsCount() const {
+  size_t count = 0;
+  for (auto &reactor : reactors_) {
+    ScopeLock sl(reactor->lock_);
+    count += reactor->connections_.size();
+  }
+  return count;
+}
+
+StratumServer::SessionStates
+StratumServer::sessionStates(time_t *countedAt) const {
+  std::lock_guard<std::mutex> lock(sessionStates_->lock_);
+  if (countedAt) {
+    *countedAt = sessionStates_->countedAt_;
+  }
+  return sessionStates_->states_;
+}
+
+void StratumServer::refreshSessionStates(std::function<void()> callback) {
+  auto cache = sessionStates_;
+  auto states = std::make_shared<SessionStates>();
+  auto statesLock = std::make_shared<std::mutex>();
+  forEachReactor(
+      [states, statesLock](Reactor &reactor) -> size_t {
+        SessionStates reactorStates;
+        for (auto &session : reactor.connections_) {
+          ++reactorStates[{session->getChainId(), session->getState()}];
+        }
+        std::lock_guard<std::mutex> lock(*statesLock);
+        for (auto &s : reactorStates) {
+          (*states)[s.first] += s.second;
+        }
+        return 0;
+      },
+      [cache, states, callback = std::move(callback)](size_t) {
+        {
+          std::lock_guard<std::mutex> lock(cache->lock_);
+          cache->states_.swap(*states);
+          cache->countedAt_ = time(nullptr);
+        }
+        if (callback) {
+          callback();
+        }
+      });
+}
+
+std::map<int32_t, size_t> StratumServer::shareStats(size_t chainId) const {
+  std::map<int32_t, size_t> stats;
+  for (auto &reactor : reactors_) {
+    ScopeLock sl(reactor->lock_);
+    for (auto &p : reactor->shareStats_[chainId]) {
+      stats[p.first] += p.second;
+    }
+  }
+  return stats;
+}
+
+void StratumServer::addShareStats(size_t chainId, int32_t status) {
+  auto &reactor = currentReactor();
+  ScopeLock sl(reactor.lock_);
+  ++reactor.shareStats_[chainId][status];
+}
+
 void StratumServer::sendShare2Kafka(
     size_t chainId, const char *data, size_t len) {
-  chains_[chainId].kafkaProducerShareLog_->produce(data, len);
+  auto &chain = chains_[chainId];
+  if (chain.shareLogBatch_ != nullptr) {
+    chain.shareLogBatch_->produce(data, len);
+  } else {
+    chain.kafkaProducerShareLog_->produce(data, len);
+  }
+}
+
+void StratumServer::disableShareLogBatch() {
+  if (shareLogFlushTimer_ != nullptr) {
+    event_free(shareLogFlushTimer_);
+    shareLogFlushTimer_ = nullptr;
+  }
+  for (ChainVars &chain : chains_) {
+    if (chain.shareLogBatch_ != nullptr) {
+      delete chain.shareLogBatch_;
+      chain.shareLogBatch_ = nullptr;
+    }
+  }
+}
+
+void StratumServer::shareLogFlushCallback(int, short, void *context) {
+  auto server = static_cast<StratumServer *>(context);
+  for (ChainVars &chain : server->chains_) {
+    if (chain.shareLogBatch_ != nullptr) {
+      chain.shareLogBatch_->flush();
+    }
+  }
 }
 
 void StratumServer::sendSolvedShare2Kafka(
@@ -35,9 +35,12 @@
 #include "prometheus/Collector.h"
 #include "prometheus/Metric.h"
 
+#include "RcuSnapshot.h"
 #include "WorkerPool.h"
 
 #include <bitset>
+#include <chrono>
+#include <deque>
 #include <regex>
 
 #include <openssl/ssl.h>
@@ -58,6 +61,10 @@ class StratumServerWrapper;
 class StratumSession;
 class DiffController;
 class Management;
+class HotRestartChannel;
+class TLSHandshaker;
+class AdmissionController;
+struct SessionState;
 
 //////////////////////////////// SessionIDManager //////////////////////////////
 
@@ -75,6 +82,9 @@ public:
   virtual void setAllocInterval(uint32_t interval) = 0;
   virtual bool allocSessionId(uint32_t *sessionID) = 0;
   virtual void freeSessionId(uint32_t sessionId) = 0;
+  // Mark the id of a session taken over from another process as used,
+  // returns false if it is already used or belongs to another server
+  virtual bool reserveSessionId(uint32_t sessionId) = 0;
 };
 
 // thread-safe
@@ -94,7 +104,11 @@ class SessionIDManagerT : public SessionIDManager {
       (1 << IBITS) - 1; // example: 0x00FFFFFF;
 
   uint8_t serverId_;
-  std::bitset<kSessionIdMask + 1> sessionIds_;
+  // Free session ids in a hierarchy of bitmaps. A bit of level 0 is set if
+  // the id is free, a bit of level N + 1 is set if the word of level N has
+  // any bit set. The top level is a single word, so searching for a free id
+  // takes a count trailing zeros per level.
+  vector<vector<uint64_t>> freeIds_;
 
   uint32_t count_; // how many ids are used now
   uint32_t allocIdx_;
@@ -102,6 +116,10 @@ class SessionIDManagerT : public SessionIDManager {
   mutex lock_;
 
   bool _ifFull();
+  bool isFree(uint32_t idx) const;
+  void setFree(uint32_t idx, bool free);
+  // The first free id not less than idx, or kSessionIdMask + 1 if not found
+  uint32_t findFree(uint32_t idx) const;
 
 public:
   SessionIDManagerT(const uint8_t serverId);
@@ -110,6 +128,7 @@ public:
   void setAllocInterval(uint32_t interval) override;
   bool allocSessionId(uint32_t *sessionID) override;
   void freeSessionId(uint32_t sessionId) override;
+  bool reserveSessionId(uint32_t sessionId) override;
 };
 
 ////////////////////////////////// JobRepository ///////////////////////////////
@@ -117,7 +136,14 @@ class JobRepository {
 protected:
   atomic<bool> running_;
   size_t chainId_;
+  // Written and read only by the main reactor, other threads look jobs up in
+  // jobTable_.
   std::map<uint64_t /* jobId */, shared_ptr<StratumJobEx>> exJobs_;
+  // A copy of exJobs_ sorted by job id, republished whenever exJobs_ changes,
+  // so share workers find jobs without locking
+  using JobTable = std::vector<std::pair<uint64_t, shared_ptr<StratumJobEx>>>;
+  RcuSnapshot<JobTable> jobTable_;
+  void publishJobTable();
 
   KafkaSimpleConsumer kafkaConsumer_; // consume topic: 'StratumJob'
   StratumServer *server_; // call server to send new job
@@ -145,6 +171,9 @@ private:
   void tryCleanExpiredJobs();
   void checkAndSendMiningNotify();
 
+protected:
+  void addStratumJobEx(uint64_t jobId, shared_ptr<StratumJobEx> exJob);
+
 public:
   JobRepository(
       size_t chainId,
@@ -165,8 +194,18 @@ public:
   void setMiningNotifyInterval(time_t miningNotifyInterval);
   void sendMiningNotify(shared_ptr<StratumJobEx> exJob);
   void sendLatestMiningNotify();
-  shared_ptr<StratumJobEx> getStratumJobEx(const uint64_t jobId);
+  // The job is kept alive by the job table cached by the calling thread, so
+  // the pointer stays valid until the thread reads a job table again after a
+  // new one is published, or releases them (see RcuSnapshot::read()). It's
+  // enough for handling a share without touching the reference counts, a
+  // task keeping the job for later should look it up again in its thread or
+  // copy the shared_ptr of what it needs (e.g. sjob_).
+  StratumJobEx *getStratumJobEx(const uint64_t jobId);
   shared_ptr<StratumJobEx> getLatestStratumJobEx();
+  // Drops the job tables cached by the calling thread, for idle threads
+  static void releaseCachedJobTables() {
+    RcuSnapshot<JobTable>::releaseCached();
+  }
 
   virtual shared_ptr<StratumJob> createStratumJob() = 0;
   virtual shared_ptr<StratumJobEx>
@@ -223,19 +262,149 @@ public:
 ///////////////////////////////////// StratumServer
 //////////////////////////////////////
 class StratumServer {
+public:
+  // A job sent to all reactors
+  struct JobBroadcast {
+    std::chrono::steady_clock::time_point received_;
+    std::atomic<size_t> pendingReactors_;
+    // replaced by a newer job in some reactor before all sessions got it
+    std::atomic<bool> superseded_;
+  };
+
+  // An event loop serving a part of the sessions. Every reactor has its own
+  // listener bound to the same address with SO_REUSEPORT, so the kernel
+  // spreads incoming connections among them. The first reactor runs on the
+  // main thread and also drives the job repositories, the management and the
+  // statistics exporter.
+  struct Reactor {
+    StratumServer &server_;
+    size_t index_;
+
+    struct event_base *base_;
+    struct evconnlistener *listener_;
+    struct event *disconnectTimer_;
+    // resumes the listener paused by the admission control
+    struct event *acceptTimer_;
+
+    // Tasks dispatched to the reactor from any thread. Dispatchers push them
+    // to a lock-free list and wake the loop with tasksFd_ (an eventfd) when
+    // the list was empty. The loop runs all of them at each wakeup.
+    struct Task {
+      std::function<void()> task_;
+      Task *next_;
+      // when a result of a share work was dispatched, default (epoch) for
+      // other tasks
+      std::chrono::steady_clock::time_point dispatched_;
+    };
+    std::atomic<Task *> tasks_;
+    int tasksFd_;
+    struct event *tasksEvent_;
+
+    // Only modified in the reactor thread, readers from other threads
+    // should hold lock_.
+    std::set<unique_ptr<StratumSession>> connections_;
+
+    // Jobs being sent to the sessions, a slice of the sessions per loop
+    // iteration so that submits are still handled during a broadcast. Clean
+    // jobs are sent before refreshes. A newer job of the same chain replaces
+    // a pending one, but a refresh never replaces a clean job.
+    struct Fanout {
+      shared_ptr<StratumJobEx> exJob_;
+      shared_ptr<JobBroadcast> broadcast_;
+      bool started_;
+      // the next session to notify, valid once started
+      std::set<unique_ptr<StratumSession>>::iterator next_;
+    };
+    std::deque<Fanout> fanouts_;
+    struct event *fanoutTimer_;
+
+    // share status counters, indexed by chain id
+    vector<std::map<int32_t, size_t>> shareStats_;
+    mutable mutex lock_;
+
+    thread thread_;
+
+    Reactor(StratumServer &server, size_t index);
+    ~Reactor();
+
+    // Erase the session and move the fan-outs pointing to it to the next one.
+    // The caller should hold lock_.
+    std::set<unique_ptr<StratumSession>>::iterator
+    eraseConnection(std::set<unique_ptr<StratumSession>>::iterator itr);
+  };
+
+private:
   // NetIO
   bool enableTLS_;
   SSL_CTX *sslCTX_;
+  // runs the TLS handshakes out of the reactors if enabled
+  unique_ptr<TLSHandshaker> tlsHandshaker_;
+  // meters the accepts and authorizations if enabled
+  unique_ptr<AdmissionController> admission_;
   struct sockaddr_in sin_;
-  struct event_base *base_;
-  struct evconnlistener *listener_;
-  std::set<unique_ptr<StratumSession>> connections_;
+  vector<unique_ptr<Reactor>> reactors_;
   uint32_t tcpReadTimeout_; // seconds
   uint32_t shutdownGracePeriod_;
-  struct event *disconnectTimer_;
+  // reactors which still have sessions during graceful shutdown
+  atomic<size_t> drainingReactors_;
+
+  // sessions notified per loop iteration during a job broadcast
+  uint32_t notifyBatchSize_;
+  // the output buffer size (bytes) above which a session only keeps the
+  // latest job until the buffer drains, 0: disabled
+  uint32_t notifyHighWatermark_;
+  // caps of the shares kept for the duplicate share check, per job and per
+  // session, see LocalShareQuota
+  uint32_t maxJobShares_;
+  uint32_t maxSessionShares_;
+  // seconds from receiving a job to its last notify, of the latest job
+  // broadcast to all sessions, indexed by chain id
+  vector<double> jobNotifySeconds_;
+  mutable mutex jobNotifySecondsLock_;
+  // histograms of the same, indexed by chain id
+  vector<shared_ptr<prometheus::Histogram>> jobNotifyLatency_;
+  // indexed by LatencyStage
+  vector<shared_ptr<prometheus::Histogram>> latency_;
 
   unique_ptr<Management> management_;
 
+  // Hot restart, see HotRestart.h
+  string hotRestartSocket_;
+  // the channel to the old process while taking over from it
+  unique_ptr<HotRestartChannel> hotRestartFrom_;
+  // listening sockets received from the old process
+  vector<int> inheritedListeners_;
+  // the listener for a new process and the channel to it
+  struct evconnlistener *hotRestartListener_;
+  unique_ptr<HotRestartChannel> hotRestartTo_;
+  // the request of the new process in the old one, the wait for the jobs
+  // before taking over the sessions in the new one
+  struct event *hotRestartEvent_;
+  time_t hotRestartStarted_;
+
+  bool takeOverListeners();
+  void takeOverSessions();
+  void restoreSession(SessionState &state, int fd);
+  void listenHotRestart();
+  void handOverListeners();
+  void handOverSessions();
+  void closeHotRestartChannel();
+  static void hotRestartListenerCallback(
+      struct evconnlistener *listener,
+      evutil_socket_t socket,
+      struct sockaddr *saddr,
+      int socklen,
+      void *server);
+  static void hotRestartRequestCallback(evutil_socket_t, short, void *server);
+  static void hotRestartTimerCallback(evutil_socket_t, short, void *server);
+
+  bool setupReactor(Reactor &reactor);
+  void runReactor(Reactor &reactor);
+  void drainReactor(Reactor &reactor);
+  void reactorDrained();
+  Reactor &mainReactor() { return *reactors_.front(); }
+  Reactor &currentReactor();
+
 public:
   struct ChainVars {
     string name_;
@@ -246,9 +415,11 @@ public:
     KafkaProducer *kafkaProducerCommonEvents_;
 
     JobRepository *jobRepository_;
-    std::map<int32_t, size_t> shareStats_;
 
     int32_t singleUserId_;
+
+    // packs the shares into batches for kafkaProducerShareLog_ if enabled
+    KafkaBatchProducer *shareLogBatch_ = nullptr;
   };
 
   bool acceptStale_;
@@ -275,6 +446,7 @@ public:
   // in anonymous-mode, we need produce userid only used in this proccess
   SessionIDManager *userIdManager_;
   std::unordered_map<string, int32_t> anonymousNameIds_;
+  mutex anonymousNameIdsLock_;
   uint32_t miningModel_;
 
   UserInfo *userInfo_;
@@ -287,6 +459,9 @@ public:
 
   bool proxyProtocol_ = false;
 
+  // send shares as fixed-layout records instead of protobuf messages
+  bool useShareBytes_ = false;
+
   shared_ptr<Zookeeper> zk_;
 
   friend class StratumServerStats;
@@ -296,7 +471,18 @@ public:
 
   std::regex longTimeoutPattern_;
 
-  unique_ptr<WorkerPool> shareWorker_;
+  unique_ptr<IWorkerPool> shareWorker_;
+
+  struct SessionStatesCache {
+    mutable std::mutex lock_;
+    std::map<std::pair<size_t, int>, size_t> states_;
+    time_t countedAt_ = 0;
+  };
+  shared_ptr<SessionStatesCache> sessionStates_;
+
+  // flushes the share log batches every share_log_batch_ms in the main reactor
+  struct event *shareLogFlushTimer_;
+  static void shareLogFlushCallback(evutil_socket_t, short, void *context);
 
 protected:
   SSL_CTX *getSSLCTX(const libconfig::Config &config);
@@ -307,6 +493,20 @@ protected:
   virtual bool setupInternal(const libconfig::Config &config) { return true; };
   void initZookeeper(const libconfig::Config &config);
 
+  // The reactor running the caller, nullptr if the caller is not running in
+  // a reactor
+  Reactor *callerReactor() const;
+  // Run the work on behalf of the reactor, so dispatch() in the work goes
+  // back to the reactor even if it's called by another thread
+  template <typename Work>
+  static void runOnBehalfOf(Reactor *reactor, Work &&work) {
+    Reactor *previous = swapCallerReactor(reactor);
+    work();
+    swapCallerReactor(previous);
+  }
+  static Reactor *swapCallerReactor(Reactor *reactor);
+  void dispatchShareTask(WorkerTask task);
+
 public:
   virtual ~StratumServer();
 
@@ -315,12 +515,94 @@ public:
   void stop();
   void stopGracefully();
 
-  // Dispatch the task to the libevent loop
+  // Dispatch the task to the libevent loop of the current reactor, or to the
+  // main reactor if the caller is not running in a reactor
   void dispatch(std::function<void()> task);
+  // Dispatch the task to the libevent loop of the given reactor
+  void dispatch(Reactor &reactor, std::function<void()> task);
   // Dispatch the task with alive check
   void dispatchSafely(std::function<void()> task, std::weak_ptr<bool> alive);
+  // The task running a work dispatched to the share worker, the results of
+  // the work go back to the reactor of the session
+  template <typename Work>
+  struct ShareWork {
+    StratumServer *server_;
+    Reactor *reactor_;
+    std::chrono::steady_clock::time_point enqueued_;
+    Work work_;
+
+    void operator()() {
+      auto started = std::chrono::steady_clock::now();
+      server_->observeLatency(LATENCY_WORKER_QUEUE, enqueued_, started);
+      runOnBehalfOf(reactor_, work_);
+      server_->observeLatency(LATENCY_VERIFY, started);
+    }
+  };
+  // Whether dispatching the work to the share worker doesn't allocate
+  template <typename Work>
+  static constexpr bool isInlineShareWork() {
+    return WorkerTask::isInline<ShareWork<std::decay_t<Work>>>();
+  }
   // Dispatch the work to the share worker
-  void dispatchToShareWorker(std::function<void()> work);
+  template <typename Work>
+  void dispatchToShareWorker(Work &&work) {
+    auto enqueued = std::chrono::steady_clock::now();
+    auto requested = requestTime();
+    if (requested != std::chrono::steady_clock::time_point{}) {
+      observeLatency(LATENCY_PARSE_TO_ENQUEUE, requested, enqueued);
+    }
+    dispatchShareTask(ShareWork<std::decay_t<Work>>{
+        this, callerReactor(), enqueued, std::forward<Work>(work)});
+  }
+  // Collect the works dispatched to the share worker by the calling thread
+  // until endShareWorkBatch(), which dispatches them as a single task, e.g.
+  // for the shares of a batched submission
+  void beginShareWorkBatch();
+  void endShareWorkBatch();
+  // Collects the share works of its scope as a batch if enabled
+  class ShareWorkBatch {
+  public:
+    ShareWorkBatch(StratumServer &server, bool enabled)
+      : server_(enabled ? &server : nullptr) {
+      if (server_ != nullptr) {
+        server_->beginShareWorkBatch();
+      }
+    }
+    ~ShareWorkBatch() {
+      if (server_ != nullptr) {
+        server_->endShareWorkBatch();
+      }
+    }
+    ShareWorkBatch(const ShareWorkBatch &) = delete;
+    ShareWorkBatch &operator=(const ShareWorkBatch &) = delete;
+
+  private:
+    StratumServer *server_;
+  };
+
+  // Stages of handling requests, their latency is exported as histograms
+  enum LatencyStage {
+    LATENCY_READ_TO_PARSE, // bytes read -> parsing the request
+    LATENCY_PARSE_TO_ENQUEUE, // parsing -> the work queued to a share worker
+    LATENCY_WORKER_QUEUE, // queued -> taken by a share worker
+    LATENCY_VERIFY, // the work in the share worker
+    LATENCY_WORKER_TO_LOOP, // a result of the work -> handled in the reactor
+    LATENCY_WRITE, // output queued -> all written to the socket
+    LATENCY_STAGES
+  };
+  static const char *latencyStageName(LatencyStage stage);
+  void observeLatency(
+      LatencyStage stage,
+      std::chrono::steady_clock::time_point since,
+      std::chrono::steady_clock::time_point until =
+          std::chrono::steady_clock::now()) {
+    latency_[stage]->observe(
+        std::chrono::duration<double>(until - since).count());
+  }
+  // The time the request handled by the caller thread started to be parsed,
+  // default (epoch) if none
+  static void setRequestTime(std::chrono::steady_clock::time_point time);
+  static std::chrono::steady_clock::time_point requestTime();
 
   shared_ptr<Zookeeper> getZookeeper(const libconfig::Config &config) {
     initZookeeper(config);
@@ -329,35 +611,92 @@ public:
 
   const uint32_t tcpReadTimeout() { return tcpReadTimeout_; }
   const string &chainName(size_t chainId) { return chains_[chainId].name_; }
-  size_t /* online sessions */
-  switchChain(string userName, size_t newChainId);
-  size_t /* switched sessions */
-  autoSwitchChain(size_t newChainId);
-  size_t /* auto reg sessions */
-  autoRegCallback(const string &userName);
+  // Run the task in every reactor, the callback is called in the main reactor
+  // with the sum of the task results once all reactors are done.
+  void forEachReactor(
+      std::function<size_t(Reactor &)> task,
+      std::function<void(size_t)> callback);
+
+  // The callbacks receive the number of the online / switched / auto reg
+  // sessions of all reactors.
+  void switchChain(
+      string userName,
+      size_t newChainId,
+      std::function<void(size_t /* online sessions */)> callback);
+  void autoSwitchChain(
+      size_t newChainId,
+      std::function<void(size_t /* switched sessions */)> callback);
+  void autoRegCallback(
+      const string &userName,
+      std::function<void(size_t /* auto reg sessions */)> callback);
 
   void sendMiningNotifyToAll(shared_ptr<StratumJobEx> exJobPtr);
+  void scheduleFanout(
+      Reactor &reactor,
+      shared_ptr<StratumJobEx> exJobPtr,
+      shared_ptr<JobBroadcast> broadcast);
+  void continueFanout(Reactor &reactor);
+  void finishFanout(const Reactor::Fanout &fanout, bool completed);
+  double jobNotifySeconds(size_t chainId) const;
 
   void addConnection(unique_ptr<StratumSession> connection);
   void removeConnection(StratumSession &connection);
 
+  // Thread-safe accessors of the sessions and share counters of all reactors
+  size_t connectionsCount() const;
+  // The number of sessions per {chain id, session state}. Sessions can only
+  // be inspected in their own reactors, so refreshSessionStates() counts them
+  // there and then calls callback in the main reactor. sessionStates()
+  // returns the last result and the time it was counted (0 if never).
+  using SessionStates = std::map<std::pair<size_t, int>, size_t>;
+  SessionStates sessionStates(time_t *countedAt = nullptr) const;
+  void refreshSessionStates(std::function<void()> callback = nullptr);
+  std::map<int32_t, size_t> shareStats(size_t chainId) const;
+  void addShareStats(size_t chainId, int32_t status);
+
   static void listenerCallback(
       struct evconnlistener *listener,
       evutil_socket_t socket,
       struct sockaddr *saddr,
       int socklen,
-      void *server);
+      void *reactor);
+  void acceptTLSInBackground(
+      Reactor &reactor,
+      evutil_socket_t fd,
+      SSL *ssl,
+      struct sockaddr *saddr,
+      int socklen,
+      uint32_t sessionID);
+  // Create the session of an accepted connection in the current reactor.
+  void setupConnection(
+      struct bufferevent *bev, struct sockaddr *saddr, uint32_t sessionID);
   static void disconnectCallback(evutil_socket_t, short, void *context);
+  static void acceptCallback(evutil_socket_t, short, void *context);
+  static void tasksCallback(evutil_socket_t, short, void *context);
+  static void fanoutCallback(evutil_socket_t, short, void *context);
   static void readCallback(struct bufferevent *, void *connection);
+  static void writeCallback(struct bufferevent *, void *connection);
   static void eventCallback(struct bufferevent *, short, void *connection);
 
   void sendShare2Kafka(size_t chainId, const char *data, size_t len);
+  // Send every share as a kafka message, for legacy consumers of the share
+  // topic which cannot unpack batches
+  void disableShareLogBatch();
   void sendSolvedShare2Kafka(size_t chainId, const char *data, size_t len);
   void sendCommonEvents2Kafka(size_t chainId, const string &message);
 
   virtual unique_ptr<StratumSession> createConnection(
       struct bufferevent *bev, struct sockaddr *saddr, uint32_t sessionID) = 0;
 
+  // Whether the authorization of the user should wait in the admission queue
+  bool deferAuthorization(const string &userName);
+  // Run step in the admission thread, then the continuation in the reactor of
+  // the caller if alive has not expired. False if the queue is full.
+  bool deferAdmission(
+      std::function<void()> step,
+      std::function<void()> then,
+      std::weak_ptr<bool> alive);
+
   bool singleUserMode() const { return singleUserMode_; }
   string singleUserName() const { return singleUserName_; }
   int32_t singleUserId(size_t chainId) {
@@ -368,6 +707,11 @@ public:
 
   bool proxyProtocol() const { return proxyProtocol_; }
 
+  bool useShareBytes() const { return useShareBytes_; }
+
+  uint32_t maxJobShares() const { return maxJobShares_; }
+  uint32_t maxSessionShares() const { return maxSessionShares_; }
+
   bool logHideIpPrefix(const string &ip);
 
 protected:
@@ -28,6 +28,8 @@
 
 #include "prometheus/Metric.h"
 #include "StratumSession.h"
+#include "SlabAllocator.h"
+#include "AdmissionController.h"
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <algorithm>
@@ -45,6 +47,8 @@ static const char *FormatSessionStatus(int status) {
     return "connected";
   case StratumSession::SUBSCRIBED:
     return "subscribed";
+  case StratumSession::AUTHORIZING:
+    return "authorizing";
   case StratumSession::AUTO_REGISTING:
     return "registering";
   case StratumSession::AUTHENTICATED:
@@ -56,7 +60,8 @@ static const char *FormatSessionStatus(int status) {
 
 StratumServerStats::StratumServerStats(StratumServer &server)
   : server_{server}
-  , lastScrape_{std::chrono::steady_clock::now()} {
+  , lastScrape_{std::chrono::steady_clock::now()}
+  , sessionMemory_{std::make_shared<SessionMemory>()} {
   metrics_.push_back(prometheus::CreateMetricFn(
       "sserver_identity",
       prometheus::Metric::Type::Gauge,
@@ -80,6 +85,31 @@ StratumServerStats::StratumServerStats(StratumServer &server)
         {{"chain", chain.name_}},
         [&chain]() { return chain.jobRepository_->lastJobHeight_; }));
   }
+
+  for (size_t i = 0; i < server_.chains_.size(); i++) {
+    metrics_.push_back(prometheus::CreateMetricHistogram(
+        "sserver_job_notify_latency_seconds",
+        "Seconds from receiving a broadcast job to its last notify",
+        {{"chain", server_.chains_[i].name_}},
+        server_.jobNotifyLatency_[i]));
+  }
+  for (size_t i = 0; i < StratumServer::LATENCY_STAGES; i++) {
+    auto stage = static_cast<StratumServer::LatencyStage>(i);
+    metrics_.push_back(prometheus::CreateMetricHistogram(
+        "sserver_request_latency_seconds",
+        "Seconds spent in the stages of handling requests",
+        {{"stage", StratumServer::latencyStageName(stage)}},
+        server_.latency_[i]));
+  }
+  if (server_.admission_) {
+    metrics_.push_back(prometheus::CreateMetricHistogram(
+        "sserver_admission_queue_latency_seconds",
+        "Seconds the deferred authorizations waited in the admission queue",
+        {},
+        server_.admission_->queueLatency()));
+  }
+  // a first sum, so the first scrape has one
+  refreshSessionMemory();
 }
 
 std::vector<std::shared_ptr<prometheus::Metric>>
@@ -94,7 +124,8 @@ StratumServerStats::collectMetrics() {
   for (size_t i = 0; i < server_.chains_.size(); i++) {
     auto const &chain = server_.chains_[i];
     auto &lastStats = lastShareStats_[i];
-    for (auto p : chain.shareStats_) {
+    auto shareStats = server_.shareStats(i);
+    for (auto p : shareStats) {
       metrics.push_back(prometheus::CreateMetricValue(
           "sserver_shares_per_second_since_last_scrape",
           prometheus::Metric::Type::Gauge,
@@ -102,14 +133,18 @@ StratumServerStats::collectMetrics() {
           {{"chain", chain.name_}, {"status", FormatStratumStatus(p.first)}},
           static_cast<double>(p.second - lastStats[p.first]) / duration));
     }
-    lastShareStats_[i] = chain.shareStats_;
-  }
+    lastShareStats_[i] = std::move(shareStats);
 
-  std::map<std::pair<size_t, StratumSession::State>, size_t> sessions;
-  for (auto &session : server_.connections_) {
-    ++sessions[{session->getChainId(), session->getState()}];
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_job_notify_seconds",
+        prometheus::Metric::Type::Gauge,
+        "Seconds from receiving the latest broadcast job to its last notify",
+        {{"chain", chain.name_}},
+        server_.jobNotifySeconds(i)));
   }
-  for (auto &s : sessions) {
+
+  time_t sessionsCountedAt = 0;
+  for (auto &s : server_.sessionStates(&sessionsCountedAt)) {
     metrics.push_back(prometheus::CreateMetricValue(
         "sserver_sessions_total",
         prometheus::Metric::Type::Gauge,
@@ -118,6 +153,117 @@ StratumServerStats::collectMetrics() {
          {"status", FormatSessionStatus(s.first.second)}},
         s.second));
   }
+  if (sessionsCountedAt != 0) {
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_sessions_age_seconds",
+        prometheus::Metric::Type::Gauge,
+        "Seconds since the sessions of sserver_sessions_total were counted",
+        {},
+        time(nullptr) - sessionsCountedAt));
+  }
+  server_.refreshSessionStates();
+
+  {
+    std::lock_guard<std::mutex> lock(sessionMemory_->lock_);
+    for (auto &m : sessionMemory_->bytes_) {
+      metrics.push_back(prometheus::CreateMetricValue(
+          "sserver_session_memory_bytes",
+          prometheus::Metric::Type::Gauge,
+          "Approximate memory used by sserver sessions per chain and type",
+          {{"chain", server_.chains_[m.first.first].name_},
+           {"type", m.first.second}},
+          m.second));
+    }
+  }
+  refreshSessionMemory();
+
+  size_t slabUsed = 0, slabTotal = 0;
+  for (const auto &usage : SlabAllocator::instance().usage()) {
+    slabUsed += usage.usedBlocks_ * usage.blockSize_;
+    slabTotal += usage.arenas_ * SlabAllocator::kArenaSize;
+  }
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_slab_memory_bytes",
+      prometheus::Metric::Type::Gauge,
+      "Memory of the slab allocator of sessions",
+      {{"state", "used"}},
+      slabUsed));
+  metrics.push_back(prometheus::CreateMetricValue(
+      "sserver_slab_memory_bytes",
+      prometheus::Metric::Type::Gauge,
+      "Memory of the slab allocator of sessions",
+      {{"state", "free"}},
+      slabTotal - slabUsed));
+
+  if (server_.shareWorker_) {
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_share_worker_queue_depth",
+        prometheus::Metric::Type::Gauge,
+        "The number of shares waiting for the share worker",
+        {},
+        server_.shareWorker_->queueDepth()));
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_share_worker_steals_total",
+        prometheus::Metric::Type::Counter,
+        "The number of works taken from the queues of other share workers",
+        {},
+        server_.shareWorker_->steals()));
+  }
+
+  if (server_.admission_) {
+    auto &admission = *server_.admission_;
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_admission_queue_depth",
+        prometheus::Metric::Type::Gauge,
+        "The number of authorizations waiting in the admission queue",
+        {},
+        admission.queueSize()));
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_admission_deferred_total",
+        prometheus::Metric::Type::Counter,
+        "The number of authorizations deferred to the admission queue",
+        {},
+        admission.deferred()));
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_admission_rejected_total",
+        prometheus::Metric::Type::Counter,
+        "The number of authorizations rejected by the full admission queue",
+        {},
+        admission.rejected()));
+    metrics.push_back(prometheus::CreateMetricValue(
+        "sserver_admission_accept_pauses_total",
+        prometheus::Metric::Type::Counter,
+        "The number of times a listener paused for the accept rate limit",
+        {},
+        admission.acceptPauses()));
+  }
 
   return metrics;
 }
+
+void StratumServerStats::refreshSessionMemory() {
+  using Bytes = std::map<std::pair<size_t, std::string>, size_t>;
+  auto sessionMemory = sessionMemory_;
+  auto bytes = std::make_shared<Bytes>();
+  auto bytesLock = std::make_shared<std::mutex>();
+  server_.forEachReactor(
+      [bytes, bytesLock](StratumServer::Reactor &reactor) -> size_t {
+        Bytes reactorBytes;
+        {
+          ScopeLock sl(reactor.lock_);
+          for (auto &session : reactor.connections_) {
+            reactorBytes[{session->getChainId(), session->dispatcherType()}] +=
+                session->memoryUsage();
+          }
+        }
+        std::lock_guard<std::mutex> lock(*bytesLock);
+        for (auto &b : reactorBytes) {
+          (*bytes)[b.first] += b.second;
+        }
+        return 0;
+      },
+      [sessionMemory, bytes](size_t) {
+        std::lock_guard<std::mutex> lock(sessionMemory->lock_);
+        sessionMemory->bytes_.swap(*bytes);
+      });
+}
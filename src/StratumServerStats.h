@@ -28,6 +28,9 @@
 
 #include <chrono>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 class StratumServer;
 
@@ -38,9 +41,19 @@ public:
   std::vector<std::shared_ptr<prometheus::Metric>> collectMetrics() override;
 
 private:
+  void refreshSessionMemory();
+
   StratumServer &server_;
   std::vector<std::shared_ptr<prometheus::Metric>> metrics_;
   std::chrono::steady_clock::time_point lastScrape_;
 
   std::map<size_t, std::map<int32_t, size_t>> lastShareStats_;
+
+  // Sessions can only be inspected in their own reactors, so the memory of
+  // sessions is summed there and exported by the next scrape.
+  struct SessionMemory {
+    std::mutex lock_;
+    std::map<std::pair<size_t, std::string>, size_t> bytes_;
+  };
+  std::shared_ptr<SessionMemory> sessionMemory_;
 };
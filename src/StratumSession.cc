@@ -29,6 +29,7 @@
 #include "StratumServer.h"
 #include "Stratum.h"
 #include "DiffController.h"
+#include "HotRestart.h"
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -92,6 +93,7 @@ StratumSession::StratumSession(
   , isDead_(false)
   , isLongTimeout_(false)
   , savedAuthorizeInfo_(nullptr)
+  , alive_(std::make_shared<bool>(true))
   , proxyStrategy_(std::make_unique<ProxyStrategy>()) {
   assert(saddr->sa_family == AF_INET);
   auto ipv4 = reinterpret_cast<struct sockaddr_in *>(saddr);
@@ -120,6 +122,15 @@ StratumSession::~StratumSession() {
   bufferevent_free(bev_);
 }
 
+size_t StratumSession::memoryUsage() const {
+  return sizeof(StratumSession) + stringMemoryUsage(clientIp_) +
+      stringMemoryUsage(clientAgent_) + stringMemoryUsage(worker_.fullName_) +
+      stringMemoryUsage(worker_.userName_) +
+      stringMemoryUsage(worker_.workerName_) +
+      worker_.userIds_.capacity() * sizeof(int32_t) +
+      evbuffer_get_length(buffer_) + dispatcher_->memoryUsage();
+}
+
 void StratumSession::setup() {
   setReadTimeout(ReadTimeout);
   if (getServer().proxyProtocol()) {
@@ -177,7 +188,12 @@ bool StratumSession::handleMessage() {
     string exMessage;
     exMessage.resize(len);
     evbuffer_remove(buffer_, &exMessage.front(), exMessage.size());
+    startRequest();
     if (dispatcher_) {
+      // verify the shares of a batch in a single share work
+      StratumServer::ShareWorkBatch batch(
+          server_,
+          cmd == static_cast<uint8_t>(StratumCommandEx::SUBMIT_SHARE_BATCH));
       dispatcher_->handleExMessage(exMessage);
     }
     return true; // read message success, return true
@@ -186,45 +202,72 @@ bool StratumSession::handleMessage() {
   //
   // handle stratum message
   //
-  string line;
-  if (tryReadLine(line)) {
-    handleLine(line);
-    return true;
-  }
-
-  return false; // read message failure
+  return handleLines();
 }
 
-bool StratumSession::tryReadLine(std::string &line) {
-  line.clear();
+bool StratumSession::handleLines() {
+  // peek the first contiguous segment of the buffer
+  struct evbuffer_iovec vec;
+  if (evbuffer_peek(buffer_, -1, nullptr, &vec, 1) < 1 || vec.iov_len == 0) {
+    return false;
+  }
+  const char *begin = static_cast<const char *>(vec.iov_base);
+  const char *end = begin + vec.iov_len;
+  auto eol = static_cast<const char *>(memchr(begin, '\n', vec.iov_len));
+
+  if (eol == nullptr) {
+    // The first line spans multiple segments, make it contiguous.
+    struct evbuffer_ptr loc;
+    loc = evbuffer_search_eol(buffer_, nullptr, nullptr, EVBUFFER_EOL_LF);
+    if (loc.pos < 0) {
+      return false; // not found
+    }
 
-  // find eol
-  struct evbuffer_ptr loc;
-  loc = evbuffer_search_eol(buffer_, nullptr, nullptr, EVBUFFER_EOL_LF);
-  if (loc.pos < 0) {
-    return false; // not found
+    size_t lineSize = loc.pos + 1; // containing "\n"
+    begin = reinterpret_cast<const char *>(evbuffer_pullup(buffer_, lineSize));
+    handleLine(begin, begin + lineSize);
+    evbuffer_drain(buffer_, lineSize);
+    return true;
   }
 
-  // copies and removes the first datlen bytes from the front of buf
-  // into the memory at data
-  line.resize(loc.pos + 1); // containing "\n"
-  evbuffer_remove(buffer_, &line.front(), line.size());
+  // Handle all complete lines of the segment in place and drain them at once.
+  const char *pos = begin;
+  do {
+    handleLine(pos, eol + 1);
+    pos = eol + 1;
+
+    // leave the following ex-message to handleMessage()
+    if (pos == end || static_cast<uint8_t>(*pos) ==
+                          StratumMessageEx::CMD_MAGIC_NUMBER) {
+      break;
+    }
+    eol = static_cast<const char *>(memchr(pos, '\n', end - pos));
+  } while (eol != nullptr);
+
+  evbuffer_drain(buffer_, pos - begin);
   return true;
 }
 
-void StratumSession::handleLine(const std::string &line) {
-  DLOG(INFO) << "recv(" << line.size() << "): " << line;
+void StratumSession::handleLine(const char *begin, const char *end) {
+  startRequest();
+  DLOG(INFO) << "recv(" << end - begin << "): " << string(begin, end);
 
-  if (state_ == CONNECTED && proxyStrategy_->check(line)) {
+  if (state_ == CONNECTED && proxyStrategy_->check(string(begin, end))) {
     // PROXY header shall appear only once
     proxyStrategy_ = std::make_unique<ProxyStrategy>();
     return;
   }
 
+  // Try the fast path of the miner first (mining.submit etc.)
+  if (dispatcher_->handleRawRequest(begin, end)) {
+    return;
+  }
+
+  // The nodes point into the line, nothing is copied
   JsonNode jnode;
-  if (!JsonNode::parse(line.data(), line.data() + line.size(), jnode)) {
+  if (!JsonNode::parse(begin, end, jnode)) {
     LOG(ERROR) << "decode line fail, not a json string. string value: \""
-               << line << "\"";
+               << string(begin, end) << "\"";
     return;
   }
   JsonNode jid = jnode["id"];
@@ -318,9 +361,11 @@ void StratumSession::checkUserAndPwd(
     const string &idStr,
     const string &fullName,
     const string &password,
-    bool isAutoRegCallback) {
+    bool isAutoRegCallback,
+    const ChainLookup *chainLookup) {
   if (isAutoRegCallback) {
-    if (isDead_ || state_ != AUTO_REGISTING) {
+    // the registration may complete before a deferred authorization
+    if (isDead_ || (state_ != AUTO_REGISTING && state_ != AUTHORIZING)) {
       LOG(INFO) << "cannot authorized from auto registing, "
                 << (isDead_ ? "session dead" : "state wrong")
                 << ", worker: " << fullName;
@@ -345,8 +390,21 @@ void StratumSession::checkUserAndPwd(
     return;
   }
 
+  // back from deferAuthorize() if AUTHORIZING
+  if (!isAutoRegCallback && state_ != AUTHORIZING &&
+      server_.deferAuthorization(worker_.userName_)) {
+    deferAuthorize(idStr, fullName, password);
+    return;
+  }
+
   size_t chainId = 0;
-  bool found = server_.userInfo_->getChainId(worker_.userName_, chainId);
+  bool found = false;
+  if (chainLookup != nullptr) {
+    found = chainLookup->found_;
+    chainId = chainLookup->chainId_;
+  } else {
+    found = server_.userInfo_->getChainId(worker_.userName_, chainId);
+  }
   if (!found) {
     DLOG(INFO) << "cannot find user " << worker_.userName_ << " in any chain";
 
@@ -358,7 +416,9 @@ void StratumSession::checkUserAndPwd(
   }
 
   if (!found || !switchChain(chainId)) {
-    if (!isAutoRegCallback && server_.userInfo_->autoRegEnabled()) {
+    // a deferred authorization has tried auto registing already
+    if (!isAutoRegCallback && state_ != AUTHORIZING &&
+        server_.userInfo_->autoRegEnabled()) {
       DLOG(INFO) << "try auto registing user " << worker_.userName_;
 
       savedAuthorizeInfo_ = shared_ptr<AuthorizeInfo>(
@@ -401,6 +461,61 @@ void StratumSession::checkUserAndPwd(
       true /* is first job */);
 }
 
+void StratumSession::deferAuthorize(
+    const string &idStr, const string &fullName, const string &password) {
+  // runs in the admission thread, the session may be gone
+  auto autoRegRequested = std::make_shared<bool>(false);
+  // handed to checkUserAndPwd(), so the reactor doesn't look it up again
+  auto chainLookup = std::make_shared<ChainLookup>();
+  auto step = [userInfo = server_.userInfo_,
+               userName = worker_.userName_,
+               workerName = worker_.fullName_,
+               sessionId = sessionId_,
+               autoRegRequested,
+               chainLookup]() {
+    chainLookup->found_ = userInfo->getChainId(userName, chainLookup->chainId_);
+    bool found = chainLookup->found_ &&
+        userInfo->getUserId(chainLookup->chainId_, userName) > 0;
+    if (!found && userInfo->autoRegEnabled()) {
+      *autoRegRequested = userInfo->tryAutoReg(userName, sessionId, workerName);
+    }
+  };
+  auto then = [this,
+               autoRegRequested,
+               chainLookup,
+               idStr,
+               fullName,
+               password]() {
+    if (state_ != AUTHORIZING || !savedAuthorizeInfo_) {
+      // authorized by autoRegCallback() already
+      return;
+    }
+    if (*autoRegRequested) {
+      // waiting for autoRegCallback()
+      state_ = AUTO_REGISTING;
+      return;
+    }
+    savedAuthorizeInfo_ = nullptr;
+    checkUserAndPwd(idStr, fullName, password, false, chainLookup.get());
+    if (state_ == AUTHORIZING) {
+      // failed, the miner may try again
+      state_ = SUBSCRIBED;
+    }
+  };
+
+  DLOG(INFO) << "defer authorizing user " << worker_.userName_;
+  savedAuthorizeInfo_ = shared_ptr<AuthorizeInfo>(
+      new AuthorizeInfo({idStr, worker_.userName_, fullName, password}));
+  state_ = AUTHORIZING;
+  if (!server_.deferAdmission(std::move(step), std::move(then), alive_)) {
+    LOG(WARNING) << "admission queue is full, worker: " << fullName;
+    savedAuthorizeInfo_ = nullptr;
+    state_ = SUBSCRIBED;
+    logAuthorizeResult(false, password);
+    responseError(idStr, StratumStatus::INTERNAL_ERROR);
+  }
+}
+
 void StratumSession::AnonymousAuthorize(
     const string &idStr, const string &fullName, const string &password) {
 
@@ -423,19 +538,24 @@ void StratumSession::AnonymousAuthorize(
   }
 
   uint32_t userid = 0u;
-  if (server_.anonymousNameIds_.find(worker_.userName_) ==
-      server_.anonymousNameIds_.end()) {
-    // assign tenp
-    if (server_.userIdManager_->allocSessionId(&userid) == false) {
-      LOG(ERROR) << "alloc userid failed,";
-      logAuthorizeResult(false, password);
-      responseError(idStr, StratumStatus::INVALID_USERNAME);
-      return;
+  {
+    // sessions of different reactors may authorize at the same time
+    ScopeLock sl(server_.anonymousNameIdsLock_);
+    auto itr = server_.anonymousNameIds_.find(worker_.userName_);
+    if (itr == server_.anonymousNameIds_.end()) {
+      // assign tenp
+      if (server_.userIdManager_->allocSessionId(&userid) == false) {
+        LOG(ERROR) << "alloc userid failed,";
+        logAuthorizeResult(false, password);
+        responseError(idStr, StratumStatus::INVALID_USERNAME);
+        return;
+      } else {
+        server_.anonymousNameIds_.insert({worker_.userName_, userid});
+      }
     } else {
-      server_.anonymousNameIds_.insert({worker_.userName_, userid});
+      userid = itr->second;
     }
   }
-  userid = server_.anonymousNameIds_[worker_.userName_];
   worker_.setChainIdAndUserId(0, userid); //所有币种通用一个userid
   logAuthorizeResult(true, password);
   responseAuthorizeSuccess(idStr);
@@ -568,6 +688,86 @@ unique_ptr<StratumMessageDispatcher> StratumSession::createDispatcher() {
       createMiner(clientAgent_, worker_.workerName_, worker_.workerHashId_));
 }
 
+static string copyOutBuffer(struct evbuffer *buf) {
+  string data;
+  data.resize(evbuffer_get_length(buf));
+  if (!data.empty()) {
+    evbuffer_copyout(buf, &data.front(), data.size());
+  }
+  return data;
+}
+
+bool StratumSession::saveCommonState(SessionState &state) const {
+  if (state_ != AUTHENTICATED || isDead() ||
+      !dispatcher_->getDiff(state.curDiff_, state.minDiff_)) {
+    return false;
+  }
+
+  state.sessionId_ = sessionId_;
+  state.clientIp_ = clientIpInt_;
+  state.clientAgent_ = clientAgent_;
+  state.chainId_ = worker_.chainId_;
+  state.userIds_ = worker_.userIds_;
+  state.workerHashId_ = worker_.workerHashId_;
+  state.fullName_ = worker_.fullName_;
+  state.userName_ = worker_.userName_;
+  state.workerName_ = worker_.workerName_;
+
+  state.input_ =
+      copyOutBuffer(buffer_) + copyOutBuffer(bufferevent_get_input(bev_));
+  state.output_ = copyOutBuffer(bufferevent_get_output(bev_));
+  return true;
+}
+
+bool StratumSession::restoreCommonState(const SessionState &state) {
+  if (state.sessionId_ != sessionId_ ||
+      state.chainId_ >= server_.chains_.size() ||
+      state.userIds_.size() != server_.chains_.size()) {
+    LOG(ERROR) << "cannot restore session " << state.fullName_
+               << ", the chains are different";
+    return false;
+  }
+
+  setClientAgent(state.clientAgent_);
+  worker_.chainId_ = state.chainId_;
+  worker_.userIds_ = state.userIds_;
+  worker_.workerHashId_ = state.workerHashId_;
+  worker_.fullName_ = state.fullName_;
+  worker_.userName_ = state.userName_;
+  worker_.workerName_ = state.workerName_;
+
+  state_ = AUTHENTICATED;
+  dispatcher_ = createDispatcher();
+  if (state.minDiff_ != 0) {
+    dispatcher_->setMinDiff(state.minDiff_);
+  }
+  dispatcher_->resetCurDiff(state.curDiff_);
+  setReadTimeout(isLongTimeout_ ? 86400 * 7 : getServer().tcpReadTimeout());
+
+  // Finish the response the old process was sending before anything else
+  sendData(state.output_);
+
+  // The local jobs stayed in the old process, shares of them are rejected
+  // as stale, so give the miner a new job at once
+  auto exJob =
+      server_.chains_[state.chainId_].jobRepository_->getLatestStratumJobEx();
+  if (exJob) {
+    sendMiningNotify(exJob, true /* is first job */);
+  }
+
+  if (!state.input_.empty()) {
+    readTime_ = std::chrono::steady_clock::now();
+    evbuffer_add(buffer_, state.input_.data(), state.input_.size());
+    while (handleMessage()) {
+    }
+    StratumServer::setRequestTime({});
+  }
+
+  LOG(INFO) << "restored session, ip: " << clientIp_
+            << ", name: " << worker_.fullName_ << ", agent: " << clientAgent_;
+  return true;
+}
+
 bool StratumSession::isDead() const {
   return isDead_.load();
 }
@@ -617,19 +817,105 @@ void StratumSession::markAsDead() {
   }
 }
 
+void StratumSession::notifyJob(
+    shared_ptr<StratumJobEx> exJobPtr, size_t highWatermark) {
+  if (highWatermark > 0 &&
+      evbuffer_get_length(bufferevent_get_output(bev_)) > highWatermark) {
+    // A slow or dead peer, only keep the latest job. A refresh never replaces
+    // the clean job of a new block, the miner should drop its work.
+    if (!deferredJob_ || exJobPtr->isClean_ || !deferredJob_->isClean_ ||
+        deferredJob_->chainId_ != exJobPtr->chainId_) {
+      deferredJob_ = std::move(exJobPtr);
+    }
+    return;
+  }
+
+  if (deferredJob_) {
+    if (deferredJob_->isClean_ && !exJobPtr->isClean_) {
+      flushDeferredJob();
+    } else {
+      deferredJob_.reset();
+    }
+  }
+  sendMiningNotify(exJobPtr);
+}
+
+void StratumSession::flushDeferredJob() {
+  if (!deferredJob_) {
+    return;
+  }
+  auto exJobPtr = std::move(deferredJob_);
+  deferredJob_.reset();
+  // the session may have switched to another chain
+  if (exJobPtr->chainId_ == worker_.chainId_) {
+    sendMiningNotify(exJobPtr);
+  }
+}
+
+void StratumSession::outputWritten() {
+  if (writeTime_ != std::chrono::steady_clock::time_point{}) {
+    server_.observeLatency(StratumServer::LATENCY_WRITE, writeTime_);
+    writeTime_ = {};
+  }
+}
+
 void StratumSession::sendData(const char *data, size_t len) {
+  if (writeTime_ == std::chrono::steady_clock::time_point{}) {
+    writeTime_ = std::chrono::steady_clock::now();
+  }
   // add data to a bufferevent’s output buffer
   // it is automatically locked so we don't need to lock
   bufferevent_write(bev_, data, len);
   DLOG(INFO) << "send(" << len << ") to " << worker_.fullName_ << " : " << data;
 }
 
+void StratumSession::sendDataWithSharedChunk(
+    const std::string &data,
+    const std::string &chunk,
+    std::shared_ptr<const void> holder) {
+  auto holderPtr = new std::shared_ptr<const void>(std::move(holder));
+  if (writeTime_ == std::chrono::steady_clock::time_point{}) {
+    writeTime_ = std::chrono::steady_clock::now();
+  }
+
+  bufferevent_lock(bev_);
+  struct evbuffer *output = bufferevent_get_output(bev_);
+  evbuffer_add(output, data.data(), data.size());
+  int res = evbuffer_add_reference(
+      output,
+      chunk.data(),
+      chunk.size(),
+      [](const void *, size_t, void *extra) {
+        delete static_cast<std::shared_ptr<const void> *>(extra);
+      },
+      holderPtr);
+  bufferevent_unlock(bev_);
+
+  if (res != 0) {
+    // the cleanup callback is not called on failure
+    delete holderPtr;
+    LOG(ERROR) << "failed to add shared chunk to the output buffer of "
+               << worker_.fullName_;
+    return;
+  }
+  DLOG(INFO) << "send(" << data.size() + chunk.size() << ") to "
+             << worker_.fullName_ << " : " << data << chunk;
+}
+
 void StratumSession::readBuf(struct evbuffer *buf) {
+  readTime_ = std::chrono::steady_clock::now();
   // moves all data from src to the end of dst
   evbuffer_add_buffer(buffer_, buf);
 
   while (handleMessage()) {
   }
+  StratumServer::setRequestTime({});
+}
+
+void StratumSession::startRequest() {
+  auto now = std::chrono::steady_clock::now();
+  server_.observeLatency(StratumServer::LATENCY_READ_TO_PARSE, readTime_, now);
+  StratumServer::setRequestTime(now);
 }
 
 void StratumSession::responseTrue(const string &idStr) {
@@ -738,7 +1024,7 @@ void StratumSession::responseAuthorizeSuccess(const std::string &idStr) {
 
 void StratumSession::reportShare(
     size_t chainId, int32_t status, uint64_t shareDiff) {
-  ++server_.chains_[chainId].shareStats_[status];
+  server_.addShareStats(chainId, status);
 }
 
 bool StratumSession::acceptStale() const {
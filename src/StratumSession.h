@@ -33,6 +33,7 @@
 
 #include <event2/bufferevent.h>
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
@@ -42,13 +43,17 @@
 class DiffController;
 class StratumServer;
 class StratumJobEx;
+struct SessionState;
 
 // Supported BTCAgent features / capabilities, a JSON array.
 // Sent within the request / response of agent.get_capabilities for protocol
 // negotiation. Known capabilities:
 //     verrol: version rolling (shares with a version mask can be submitted
 //     through a BTCAgent session).
-#define BTCAGENT_PROTOCOL_CAPABILITIES "[\"verrol\"]"
+//     submitbatch: the shares of many sub-sessions can be submitted in one
+//     SUBMIT_SHARE_BATCH message, answered by a SUBMIT_SHARE_BATCH_RESULT.
+//     Not advertised by ZEC, whose miner doesn't implement handleExSubmit().
+#define BTCAGENT_PROTOCOL_CAPABILITIES "[\"verrol\",\"submitbatch\"]"
 
 enum class StratumCommandEx : uint8_t {
   REGISTER_WORKER = 0x01u, // Agent -> Pool
@@ -60,6 +65,8 @@ enum class StratumCommandEx : uint8_t {
       0x12u, // Agent -> Pool,  mining.submit(..., nVersionMask)
   SUBMIT_SHARE_WITH_TIME_VER =
       0x13u, // Agent -> Pool,  mining.submit(..., nTime, nVersionMask)
+  SUBMIT_SHARE_BATCH = 0x14u, // Agent -> Pool,  mining.submit(...) * count
+  SUBMIT_SHARE_BATCH_RESULT = 0x15u, // Pool  -> Agent, results of a batch
 };
 
 struct StratumMessageEx {
@@ -103,6 +110,8 @@ public:
   virtual bool acceptStale() const = 0;
   virtual bool niceHashForced() const = 0;
   virtual uint64_t niceHashMinDiff() const = 0;
+  // The number of sub-sessions registered by the agent of the session
+  virtual void setAgentSessions(size_t count) = 0;
 };
 
 class ProxyStrategy {
@@ -119,7 +128,13 @@ public:
   // Otherwise code like this will go wrong:
   // <code>if (state_ < AUTHENTICATED || exJobPtr == nullptr)</code>
   //
-  enum State { CONNECTED, SUBSCRIBED, AUTO_REGISTING, AUTHENTICATED };
+  enum State {
+    CONNECTED,
+    SUBSCRIBED,
+    AUTHORIZING,
+    AUTO_REGISTING,
+    AUTHENTICATED
+  };
 
 protected:
   StratumServer &server_;
@@ -148,25 +163,52 @@ protected:
   };
 
   shared_ptr<AuthorizeInfo> savedAuthorizeInfo_;
+  // expires with the session, for the continuations of deferred steps
+  shared_ptr<bool> alive_;
+
+  // The latest job held back by notifyJob() while the output buffer is above
+  // the high watermark
+  shared_ptr<StratumJobEx> deferredJob_;
 
   std::unique_ptr<ProxyStrategy> proxyStrategy_;
 
+  // when the input being handled was read, and when the output not written
+  // yet was queued (default if all written), for the latency histograms
+  std::chrono::steady_clock::time_point readTime_;
+  std::chrono::steady_clock::time_point writeTime_;
+
   void setup();
   void setReadTimeout(int32_t readTimeout);
 
   bool handleMessage(); // handle all messages: ex-message and stratum message
-  bool tryReadLine(std::string &line);
-  void handleLine(const std::string &line);
+  // Handle the complete lines at the front of buffer_ without copying them
+  bool handleLines();
+  void handleLine(const char *begin, const char *end);
+  // Observe the latency from reading to handling a request and note the
+  // time, see StratumServer::requestTime()
+  void startRequest();
   virtual void handleRequest(
       const std::string &idStr,
       const std::string &method,
       const JsonNode &jparams,
       const JsonNode &jroot) = 0;
+  // The chain of a user looked up by deferAuthorize() out of the reactor
+  struct ChainLookup {
+    bool found_ = false;
+    size_t chainId_ = 0;
+  };
+  // The chain of the user is looked up unless chainLookup is given, which
+  // may block on ZooKeeper
   void checkUserAndPwd(
       const string &idStr,
       const string &fullName,
       const string &password,
-      bool isAutoRegCallback = false);
+      bool isAutoRegCallback = false,
+      const ChainLookup *chainLookup = nullptr);
+  // Look the user up and auto register it in the admission queue, then
+  // continue checkUserAndPwd()
+  void deferAuthorize(
+      const string &idStr, const string &fullName, const string &password);
   void AnonymousAuthorize(
       const string &idStr, const string &fullName, const string &password);
   virtual void setDefaultDifficultyFromPassword(const string &password);
@@ -184,6 +226,10 @@ protected:
       const JsonNode &jmethod, const JsonNode &jparams, const JsonNode &jroot);
   virtual std::unique_ptr<StratumMessageDispatcher> createDispatcher();
 
+  // The part of saveState() / restoreState() common to all chains
+  bool saveCommonState(SessionState &state) const;
+  bool restoreCommonState(const SessionState &state);
+
   StratumSession(
       StratumServer &server,
       struct bufferevent *bev,
@@ -205,6 +251,7 @@ public:
   StratumMessageDispatcher &getDispatcher() override { return *dispatcher_; }
   uint32_t getClientIp() const { return clientIpInt_; };
   uint32_t getSessionId() const { return sessionId_; }
+  evutil_socket_t getSocket() const { return bufferevent_getfd(bev_); }
   size_t getChainId() const { return worker_.chainId_; }
   State getState() const { return state_; }
   string getUserName() const { return worker_.userName_; }
@@ -224,6 +271,13 @@ public:
   void sendData(const std::string &str) override {
     sendData(str.data(), str.size());
   }
+  // Send data followed by a chunk shared among sessions. The chunk is
+  // referenced by the output buffer instead of being copied, holder keeps it
+  // alive until it has been written to the socket.
+  void sendDataWithSharedChunk(
+      const std::string &data,
+      const std::string &chunk,
+      std::shared_ptr<const void> holder);
   void readBuf(struct evbuffer *buf);
 
   // Please keep them in here and be virtual or you have to refactor
@@ -244,12 +298,40 @@ public:
 
   virtual void sendMiningNotify(
       shared_ptr<StratumJobEx> exJobPtr, bool isFirstJob = false) = 0;
+  // Send a broadcast job. If more than highWatermark bytes are waiting in the
+  // output buffer, the job is held back (replacing the one held back before)
+  // until the buffer drains. highWatermark 0 sends the job at once.
+  void notifyJob(shared_ptr<StratumJobEx> exJobPtr, size_t highWatermark);
+  // Send the job held back by notifyJob()
+  void flushDeferredJob();
+  // All output is written to the socket
+  void outputWritten();
 
   void reportShare(size_t chainId, int32_t status, uint64_t shareDiff) override;
   bool niceHashForced() const override;
   uint64_t niceHashMinDiff() const override;
 
   void setIpAddress(const struct in_addr &address);
+
+  // Sessions are allocated from the slab, see SlabAllocator
+  static void *operator new(size_t size) {
+    return SlabAllocator::instance().allocate(size);
+  }
+  static void operator delete(void *block, size_t size) {
+    SlabAllocator::instance().deallocate(block, size);
+  }
+
+  // Approximate memory used by the session, for the memory accounting report
+  virtual size_t memoryUsage() const;
+  const char *dispatcherType() const { return dispatcher_->typeName(); }
+
+  // Hot restart, see HotRestart.h. Saves the state of the session to move it
+  // to a new process, returns false if it cannot be moved. Only authenticated
+  // sessions of a single miner can be moved, on the chains overriding these.
+  virtual bool saveState(SessionState &state) const { return false; }
+  // Restores the session in the new process, then sends the latest job and
+  // handles the input received by the old process
+  virtual bool restoreState(const SessionState &state) { return false; }
 };
 
 //  This base class is to help type safety of accessing server_ member variable.
@@ -265,48 +347,74 @@ protected:
       struct sockaddr *saddr,
       uint32_t sessionId)
     : StratumSession(server, bev, saddr, sessionId)
-    , kMaxNumLocalJobs_(256) {}
+    , kMaxNumLocalJobs_(256)
+    , localJobs_(kMaxNumLocalJobs_) {
+    localJobs_.setShareLimits(
+        server.maxJobShares(), server.maxSessionShares());
+  }
 
   using LocalJobType = typename StratumTraits::LocalJobType;
   static_assert(
       std::is_base_of<LocalJob, LocalJobType>::value,
       "Local job type is not derived from LocalJob");
-  std::deque<LocalJobType> localJobs_;
-  size_t kMaxNumLocalJobs_;
+  const size_t kMaxNumLocalJobs_;
+  LocalJobRing<LocalJobType> localJobs_;
   static constexpr size_t kNumLocalJobsToKeep_ = 4;
 
+  // Release the oldest jobs until at most numOfJobsToKeep jobs are left
+  void popLocalJobs(size_t numOfJobsToKeep) {
+    if (localJobs_.size() <= numOfJobsToKeep) {
+      return;
+    }
+    std::vector<LocalJob *> jobs(localJobs_.size() - numOfJobsToKeep);
+    auto iter = localJobs_.begin();
+    for (auto &job : jobs) {
+      job = &*iter++;
+    }
+    dispatcher_->removeLocalJobs(jobs);
+    for (size_t i = 0; i < jobs.size(); i++) {
+      localJobs_.pop_front();
+    }
+  }
+
 public:
   size_t maxNumLocalJobs() const { return kMaxNumLocalJobs_; }
 
   template <typename Key>
   LocalJobType *findLocalJob(const Key &key) {
-    auto iter = localJobs_.rbegin();
-    auto iend = localJobs_.rend();
-    for (; iter != iend; ++iter) {
-      if (*iter == key) {
-        return &(*iter);
-      }
-    }
-    return nullptr;
+    return localJobs_.find(key);
   }
 
+  // The oldest job is evicted if there are already kMaxNumLocalJobs_ jobs
   template <typename... Args>
   LocalJobType &addLocalJob(size_t chainId, uint64_t jobId, Args &&... args) {
-    localJobs_.emplace_back(chainId, jobId, std::forward<Args>(args)...);
-    auto &localJob = localJobs_.back();
+    popLocalJobs(kMaxNumLocalJobs_ - 1);
+    auto &localJob =
+        localJobs_.emplace_back(chainId, jobId, std::forward<Args>(args)...);
     dispatcher_->addLocalJob(localJob);
     return localJob;
   }
 
   void clearLocalJobs(bool isClean) {
-    size_t numOfJobsToKeep = isClean ? kNumLocalJobsToKeep_ : kMaxNumLocalJobs_;
-    while (localJobs_.size() > numOfJobsToKeep) {
-      dispatcher_->removeLocalJob(localJobs_.front());
-      localJobs_.pop_front();
-    }
+    popLocalJobs(isClean ? kNumLocalJobsToKeep_ : kMaxNumLocalJobs_);
+  }
+
+  LocalJobRing<LocalJobType> &getLocalJobs() { return localJobs_; }
+
+  // The sub-sessions of an agent share the local jobs of the session
+  void setAgentSessions(size_t count) override {
+    auto &server = getServer();
+    count = std::max<size_t>(count, 1);
+    localJobs_.setShareLimits(
+        server.maxJobShares() * count, server.maxSessionShares() * count);
   }
 
-  std::deque<LocalJobType> &getLocalJobs() { return localJobs_; }
+  size_t memoryUsage() const override {
+    using SessionType = typename StratumTraits::SessionType;
+    return StratumSession::memoryUsage() - sizeof(StratumSession) +
+        SlabAllocator::blockSize(sizeof(SessionType)) +
+        localJobs_.memoryUsage();
+  }
 
   inline ServerType &getServer() const {
     return static_cast<ServerType &>(server_);
@@ -290,10 +290,11 @@ void UserInfo::handleSwitchChainEvent(const string &userName) {
     return;
   }
 
-  server_->dispatch(
-      [this, userName, currentChainId, newChainId, newAutoChainStatus]() {
-        size_t onlineSessions = server_->switchChain(userName, newChainId);
-
+  server_->switchChain(
+      userName,
+      newChainId,
+      [this, userName, currentChainId, newChainId, newAutoChainStatus](
+          size_t onlineSessions) {
         if (onlineSessions == 0) {
           LOG(INFO) << (newAutoChainStatus ? "[auto chain] " : "")
                     << "No workers of user " << userName
@@ -336,19 +337,21 @@ void UserInfo::autoSwitchChain(
   }
 
   // do the switch
-  server_->dispatch([this, oldChainId, newChainId, users, callback]() {
-    size_t switchedSessions = server_->autoSwitchChain(newChainId);
-
-    LOG(INFO) << "[auto chain] " << users << " users (" << switchedSessions
-              << " miners) switched chain: " << server_->chainName(oldChainId)
-              << " -> " << server_->chainName(newChainId);
+  server_->autoSwitchChain(
+      newChainId,
+      [this, oldChainId, newChainId, users, callback](size_t switchedSessions) {
+        LOG(INFO) << "[auto chain] " << users << " users (" << switchedSessions
+                  << " miners) switched chain: "
+                  << server_->chainName(oldChainId) << " -> "
+                  << server_->chainName(newChainId);
 
-    callback(oldChainId, newChainId, users, switchedSessions);
+        callback(oldChainId, newChainId, users, switchedSessions);
 
-    if (switchedSessions > 0) {
-      server_->chains_[newChainId].jobRepository_->sendLatestMiningNotify();
-    }
-  });
+        if (switchedSessions > 0) {
+          server_->chains_[newChainId]
+              .jobRepository_->sendLatestMiningNotify();
+        }
+      });
 }
 
 bool UserInfo::getChainId(const string &userName, size_t &chainId) {
@@ -392,6 +395,19 @@ bool UserInfo::getChainId(const string &userName, size_t &chainId) {
   return false;
 }
 
+bool UserInfo::isKnownUser(const string &userName) {
+  size_t chainId = 0;
+  if (chains_.size() > 1) {
+    std::shared_lock<std::shared_timed_mutex> l{nameChainlock_};
+    auto itr = nameChains_.find(userName);
+    if (itr == nameChains_.end()) {
+      return false;
+    }
+    chainId = itr->second.chainId_;
+  }
+  return getUserId(chainId, userName) > 0;
+}
+
 int32_t UserInfo::getUserId(size_t chainId, const string &userName) {
   ChainVars &chain = chains_[chainId];
 
@@ -613,9 +629,7 @@ void UserInfo::handleAutoRegEvent(
     userInfo->autoRegPendingUsers_.erase(userName);
   }
 
-  userInfo->server_->dispatch([userInfo, userName]() {
-    size_t sessions = userInfo->server_->autoRegCallback(userName);
-
+  userInfo->server_->autoRegCallback(userName, [userName](size_t sessions) {
     LOG(INFO) << "Auto Reg: User '" << userName << "' (" << sessions
               << " miners online) registered";
   });
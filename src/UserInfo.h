@@ -131,6 +131,9 @@ public:
   // If only one chain, chainId=0 and true will always be returned.
   bool getChainId(const string &userName, size_t &chainId);
   int32_t getUserId(size_t chainId, const string &userName);
+  // The chain and id of the user are both in the memory, so getChainId() and
+  // getUserId() will not block.
+  bool isKnownUser(const string &userName);
 
   bool autoRegEnabled() const { return enableAutoReg_; }
   bool tryAutoReg(string userName, uint32_t sessionId, string fullWorkerName);
@@ -193,6 +193,11 @@ uint64_t getAlphaNumRank(const string &str, size_t significand = 9);
 // Check if a worker is a NiceHash client.
 bool isNiceHashAgent(const string &clientAgent);
 
+// Heap memory of the string, 0 if it's stored inline (short string)
+inline size_t stringMemoryUsage(const string &str) {
+  return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
 /////////////////// A map that can clean up expired items //////////////////////
 template <typename K, typename V>
 class SeqMap {
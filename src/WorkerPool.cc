@@ -24,6 +24,9 @@
 
 #include "WorkerPool.h"
 
+#include <algorithm>
+#include <cassert>
+
 WorkerPool::WorkerPool(size_t queueCapacity)
   : works_{queueCapacity}
   , stop_{false} {
@@ -55,7 +58,7 @@ void WorkerPool::stop() {
   }
 }
 
-void WorkerPool::dispatch(std::function<void()> work) {
+void WorkerPool::dispatch(WorkerTask work) {
   if (!work) {
     return;
   }
@@ -68,9 +71,19 @@ void WorkerPool::dispatch(std::function<void()> work) {
   }
 }
 
+size_t WorkerPool::queueDepth() {
+  std::unique_lock<std::mutex> l{worksMutex_};
+  return works_.size();
+}
+
 void WorkerPool::runWorker() {
   while (true) {
     std::unique_lock<std::mutex> l{worksMutex_};
+    if (works_.empty() && !stop_ && idleHook_) {
+      l.unlock();
+      idleHook_();
+      l.lock();
+    }
     worksNotEmpty_.wait(l, [this]() { return !works_.empty() || stop_; });
     if (stop_) {
       break;
@@ -82,4 +95,224 @@ void WorkerPool::runWorker() {
       work();
     }
   }
-}
\ No newline at end of file
+}
+
+StealingWorkerPool::Queue::Queue(size_t capacity)
+  : pushPos_{0}
+  , popPos_{0} {
+  size_t size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+  cells_ = std::make_unique<Cell[]>(size);
+  mask_ = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    cells_[i].sequence_.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool StealingWorkerPool::Queue::tryPush(WorkerTask &work) {
+  size_t pos = pushPos_.load(std::memory_order_relaxed);
+  Cell *cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff == 0) {
+      if (pushPos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // full
+    } else {
+      pos = pushPos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->work_ = std::move(work);
+  cell->sequence_.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool StealingWorkerPool::Queue::tryPop(WorkerTask &work) {
+  size_t pos = popPos_.load(std::memory_order_relaxed);
+  Cell *cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (popPos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; // empty
+    } else {
+      pos = popPos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  work = std::move(cell->work_);
+  cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+size_t StealingWorkerPool::Queue::size() const {
+  size_t popPos = popPos_.load(std::memory_order_relaxed);
+  size_t pushPos = pushPos_.load(std::memory_order_relaxed);
+  return pushPos > popPos ? pushPos - popPos : 0;
+}
+
+StealingWorkerPool::StealingWorkerPool(size_t queueCapacity)
+  : queueCapacity_{queueCapacity}
+  , stop_{false}
+  , steals_{0}
+  , idleWorkers_{0}
+  , blockedDispatchers_{0} {
+}
+
+StealingWorkerPool::~StealingWorkerPool() {
+  stop();
+}
+
+void StealingWorkerPool::start(size_t numOfWorkers) {
+  assert(queues_.empty() && numOfWorkers > 0);
+  for (size_t i = 0; i < numOfWorkers; ++i) {
+    queues_.push_back(std::make_unique<Queue>(
+        std::max<size_t>(queueCapacity_ / numOfWorkers, kBatchSize)));
+  }
+  for (size_t i = 0; i < numOfWorkers; ++i) {
+    workers_.emplace_back([this, i]() { runWorker(i); });
+  }
+}
+
+void StealingWorkerPool::stop() {
+  if (!stop_.exchange(true)) {
+    {
+      std::lock_guard<std::mutex> l{idleMutex_};
+      idle_.notify_all();
+    }
+    {
+      std::lock_guard<std::mutex> l{fullMutex_};
+      notFull_.notify_all();
+    }
+  }
+
+  for (auto &worker : workers_) {
+    if (worker.joinable())
+      worker.join();
+  }
+}
+
+bool StealingWorkerPool::tryPush(WorkerTask &work) {
+  // Every dispatcher walks the queues round robin from its own position
+  static thread_local size_t next = 0;
+  for (size_t i = 0; i < queues_.size(); i++) {
+    size_t index = next++ % queues_.size();
+    if (queues_[index]->tryPush(work)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void StealingWorkerPool::dispatch(WorkerTask work) {
+  if (!work || stop_) {
+    return;
+  }
+
+  if (!tryPush(work)) {
+    // All queues are full, block until a worker makes room
+    std::unique_lock<std::mutex> l{fullMutex_};
+    blockedDispatchers_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    notFull_.wait(l, [&]() { return stop_ || tryPush(work); });
+    blockedDispatchers_--;
+    if (stop_) {
+      return;
+    }
+  }
+
+  // Pairs with the fence in runWorker(): either the worker sees the work
+  // before sleeping or the dispatcher sees the worker sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idleWorkers_ > 0) {
+    std::lock_guard<std::mutex> l{idleMutex_};
+    idle_.notify_one();
+  }
+}
+
+size_t StealingWorkerPool::queueDepth() {
+  size_t depth = 0;
+  for (const auto &queue : queues_) {
+    depth += queue->size();
+  }
+  return depth;
+}
+
+size_t StealingWorkerPool::popBatch(size_t index, WorkerTask *works) {
+  size_t count = 0;
+  while (count < kBatchSize && queues_[index]->tryPop(works[count])) {
+    count++;
+  }
+  if (count > 0) {
+    return count;
+  }
+
+  // Steal up to half of the works of another worker
+  for (size_t i = 1; i < queues_.size(); i++) {
+    auto &victim = queues_[(index + i) % queues_.size()];
+    size_t limit =
+        std::min(kBatchSize, std::max<size_t>(victim->size() / 2, 1));
+    while (count < limit && victim->tryPop(works[count])) {
+      count++;
+    }
+    if (count > 0) {
+      steals_ += count;
+      return count;
+    }
+  }
+  return 0;
+}
+
+bool StealingWorkerPool::hasWorks() const {
+  for (const auto &queue : queues_) {
+    if (queue->size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void StealingWorkerPool::runWorker(size_t index) {
+  WorkerTask works[kBatchSize];
+  while (!stop_) {
+    size_t count = popBatch(index, works);
+    if (count == 0) {
+      if (idleHook_) {
+        idleHook_();
+      }
+      std::unique_lock<std::mutex> l{idleMutex_};
+      idleWorkers_++;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!stop_ && !hasWorks()) {
+        idle_.wait(l);
+      }
+      idleWorkers_--;
+      continue;
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (blockedDispatchers_ > 0) {
+      std::lock_guard<std::mutex> l{fullMutex_};
+      notFull_.notify_all();
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      works[i]();
+      works[i].reset();
+    }
+  }
+}
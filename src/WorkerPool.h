@@ -26,30 +26,231 @@
 
 #include <boost/circular_buffer.hpp>
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <queue>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-class WorkerPool {
+//
+// A move-only callable. Closures fitting in InlineSize bytes are stored in
+// the task itself, so creating, moving and calling them doesn't allocate.
+//
+template <size_t InlineSize, typename... Args>
+class InlineTask {
+public:
+  static constexpr size_t kInlineSize = InlineSize;
+
+  // Whether a closure of type Fn is stored in the task
+  template <typename Fn>
+  static constexpr bool isInline() {
+    return sizeof(Fn) <= kInlineSize &&
+        alignof(Fn) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<Fn>::value;
+  }
+
+  InlineTask() = default;
+
+  template <
+      typename F,
+      typename = std::enable_if_t<
+          !std::is_same<std::decay_t<F>, InlineTask>::value>>
+  InlineTask(F &&f) {
+    using Fn = std::decay_t<F>;
+    if constexpr (isInline<Fn>()) {
+      new (storage_) Fn(std::forward<F>(f));
+      ops_ = &InlineOps<Fn>::ops_;
+    } else {
+      new (storage_) Fn *(new Fn(std::forward<F>(f)));
+      ops_ = &HeapOps<Fn>::ops_;
+    }
+  }
+
+  InlineTask(InlineTask &&other) noexcept { moveFrom(other); }
+  InlineTask &operator=(InlineTask &&other) noexcept {
+    if (this != &other) {
+      reset();
+      moveFrom(other);
+    }
+    return *this;
+  }
+  InlineTask(const InlineTask &) = delete;
+  InlineTask &operator=(const InlineTask &) = delete;
+  ~InlineTask() { reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+  void operator()(Args... args) {
+    ops_->invoke_(storage_, std::forward<Args>(args)...);
+  }
+
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy_(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  struct Ops {
+    void (*invoke_)(void *storage, Args... args);
+    // move the closure to uninitialized storage and destroy the source
+    void (*relocate_)(void *from, void *to);
+    void (*destroy_)(void *storage);
+  };
+
+  template <typename Fn>
+  struct InlineOps {
+    static void invoke(void *p, Args... args) {
+      (*static_cast<Fn *>(p))(std::forward<Args>(args)...);
+    }
+    static void relocate(void *from, void *to) {
+      new (to) Fn(std::move(*static_cast<Fn *>(from)));
+      static_cast<Fn *>(from)->~Fn();
+    }
+    static void destroy(void *p) { static_cast<Fn *>(p)->~Fn(); }
+    static constexpr Ops ops_ = {invoke, relocate, destroy};
+  };
+
+  template <typename Fn>
+  struct HeapOps {
+    static Fn *&fn(void *p) { return *static_cast<Fn **>(p); }
+    static void invoke(void *p, Args... args) {
+      (*fn(p))(std::forward<Args>(args)...);
+    }
+    static void relocate(void *from, void *to) { new (to) Fn *(fn(from)); }
+    static void destroy(void *p) { delete fn(p); }
+    static constexpr Ops ops_ = {invoke, relocate, destroy};
+  };
+
+  void moveFrom(InlineTask &other) {
+    if (other.ops_ != nullptr) {
+      other.ops_->relocate_(other.storage_, storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+  const Ops *ops_ = nullptr;
+};
+
+// The tasks of the share workers. The size fits the share checks of the
+// chains with the largest block headers (ZEC, see ServerBitcoin::checkShare),
+// the dispatch sites of the share paths static_assert they are inline.
+using WorkerTask = InlineTask<384>;
+
+class IWorkerPool {
+public:
+  virtual ~IWorkerPool() = default;
+
+  virtual void start(size_t numOfWorkers) = 0;
+  virtual void stop() = 0;
+  // Blocks while the queue is full
+  virtual void dispatch(WorkerTask work) = 0;
+
+  // The number of works waiting for a worker
+  virtual size_t queueDepth() = 0;
+  // The number of works taken from the queues of other workers
+  virtual uint64_t steals() const { return 0; }
+
+  // Called by a worker before it waits for works, e.g. to release what the
+  // worker thread caches. Set it before start().
+  void setIdleHook(std::function<void()> hook) { idleHook_ = std::move(hook); }
+
+protected:
+  std::function<void()> idleHook_;
+};
+
+// All workers share one queue guarded by a mutex
+class WorkerPool : public IWorkerPool {
 public:
   explicit WorkerPool(size_t queueCapacity);
   WorkerPool(const WorkerPool &&) = delete;
   ~WorkerPool();
 
-  void start(size_t numOfWorkers);
-  void stop();
-  void dispatch(std::function<void()> work);
+  void start(size_t numOfWorkers) override;
+  void stop() override;
+  void dispatch(WorkerTask work) override;
+  size_t queueDepth() override;
 
 private:
   void runWorker();
 
-  boost::circular_buffer<std::function<void()>> works_;
+  boost::circular_buffer<WorkerTask> works_;
   std::mutex worksMutex_;
   std::condition_variable worksNotEmpty_;
   std::condition_variable worksNotFull_;
   std::vector<std::thread> workers_;
   bool stop_;
 };
+
+//
+// Every worker has its own bounded lock-free queue. Dispatchers spread works
+// among the queues, a worker pops works from its queue in batches and steals
+// from the others when its queue is empty. Locks are only taken to put idle
+// workers to sleep and to block dispatchers while all queues are full.
+//
+class StealingWorkerPool : public IWorkerPool {
+public:
+  // queueCapacity is the total capacity of all queues
+  explicit StealingWorkerPool(size_t queueCapacity);
+  StealingWorkerPool(const StealingWorkerPool &&) = delete;
+  ~StealingWorkerPool();
+
+  void start(size_t numOfWorkers) override;
+  void stop() override;
+  void dispatch(WorkerTask work) override;
+  size_t queueDepth() override;
+  uint64_t steals() const override { return steals_; }
+
+private:
+  static constexpr size_t kBatchSize = 16;
+
+  // Bounded multi-producer multi-consumer queue, each cell has a sequence
+  // number telling whether it's ready for push or pop
+  class Queue {
+  public:
+    explicit Queue(size_t capacity);
+
+    bool tryPush(WorkerTask &work);
+    bool tryPop(WorkerTask &work);
+    size_t size() const;
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence_;
+      WorkerTask work_;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> pushPos_;
+    alignas(64) std::atomic<size_t> popPos_;
+  };
+
+  bool tryPush(WorkerTask &work);
+  size_t popBatch(size_t index, WorkerTask *works);
+  bool hasWorks() const;
+  void runWorker(size_t index);
+
+  size_t queueCapacity_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<bool> stop_;
+  std::atomic<uint64_t> steals_;
+
+  std::mutex idleMutex_;
+  std::condition_variable idle_;
+  std::atomic<size_t> idleWorkers_;
+
+  std::mutex fullMutex_;
+  std::condition_variable notFull_;
+  std::atomic<size_t> blockedDispatchers_;
+};
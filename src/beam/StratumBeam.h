@@ -29,6 +29,37 @@
 #include "beam/beam.pb.h"
 #include <uint256.h>
 
+// Fixed-layout share record, sent instead of the protobuf message with
+// sserver.use_share_bytes. sserver fills it while checking the share.
+// extUserId_ and bitsReached_ are 0 when not set.
+struct ShareBeamBytes {
+  uint32_t version_ = 0; // 0
+  uint32_t checkSum_ = 0; // 4
+
+  int64_t workerHashId_ = 0; // 8
+  int32_t userId_ = 0; // 16
+  int32_t status_ = 0; // 20
+  int64_t timestamp_ = 0; // 24
+  IpAddress ip_ = 0; // 32
+
+  uint64_t inputPrefix_ = 0; // 48
+  uint64_t shareDiff_ = 0; // 56
+  uint64_t blockBits_ = 0; // 64
+  uint64_t nonce_ = 0; // 72
+  uint32_t height_ = 0; // 80
+  uint32_t sessionId_ = 0; // 84
+  uint32_t outputHash_ = 0; // 88
+  int32_t extUserId_ = 0; // 92
+  uint32_t bitsReached_ = 0; // 96
+  uint32_t reserved_ = 0; // 100
+
+  uint32_t checkSum() const { return sharebase::BytesCheckSum(*this); }
+  string toString() const;
+};
+
+static_assert(
+    sizeof(ShareBeamBytes) == 104, "ShareBeamBytes should be 104 bytes");
+
 // [[[[ IMPORTANT REMINDER! ]]]]
 // Please keep the Share structure forward compatible.
 // That is: don't change it unless you add code so that
@@ -43,6 +74,8 @@ class ShareBeam
 public:
   const static uint32_t CURRENT_VERSION =
       0x0bea0001u; // first 0bea: BEAM, second 0001: version 1
+  const static uint32_t BYTES_VERSION =
+      0x0bea0002u; // first 0bea: BEAM, second 0002: version 2
 
   ShareBeam() {
     set_version(0);
@@ -61,6 +94,46 @@ public:
   ShareBeam(const ShareBeam &r) = default;
   ShareBeam &operator=(const ShareBeam &r) = default;
 
+  // The IP is kept raw, see getIp()
+  void fromBytes(const ShareBeamBytes &share) {
+    set_version(CURRENT_VERSION);
+    set_workerhashid(share.workerHashId_);
+    set_userid(share.userId_);
+    set_status(share.status_);
+    set_timestamp(share.timestamp_);
+    setRawIp(share.ip_);
+    set_inputprefix(share.inputPrefix_);
+    set_sharediff(share.shareDiff_);
+    set_blockbits(share.blockBits_);
+    set_nonce(share.nonce_);
+    set_height(share.height_);
+    set_sessionid(share.sessionId_);
+    set_outputhash(share.outputHash_);
+    if (share.extUserId_ != 0) {
+      set_extuserid(share.extUserId_);
+    }
+    if (share.bitsReached_ != 0) {
+      set_bitsreached(share.bitsReached_);
+    }
+  }
+
+  bool UnserializeWithVersion(const uint8_t *data, uint32_t size) {
+    if (nullptr == data || size != sizeof(ShareBeamBytes) ||
+        *reinterpret_cast<const uint32_t *>(data) != BYTES_VERSION) {
+      return Unserializable::UnserializeWithVersion(data, size);
+    }
+
+    auto share = reinterpret_cast<const ShareBeamBytes *>(data);
+    if (share->checkSum() != share->checkSum_) {
+      DLOG(INFO) << "checkSum mismatched! checkSum_: " << share->checkSum_
+                 << ", checkSum(): " << share->checkSum();
+      return false;
+    }
+
+    fromBytes(*share);
+    return true;
+  }
+
   double score() const {
 
     if (!StratumStatus::isAccepted(status()) || sharediff() == 0 ||
@@ -97,7 +170,7 @@ public:
         "nonce: %016x, sessionId: %08x, status: %d/%s)",
         height(),
         inputprefix(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -111,6 +184,12 @@ public:
   }
 };
 
+inline string ShareBeamBytes::toString() const {
+  ShareBeam share;
+  share.fromBytes(*this);
+  return share.toString();
+}
+
 class StratumJobBeam : public StratumJob {
 public:
   StratumJobBeam();
@@ -153,6 +232,7 @@ struct StratumTraitsBeam {
     bool operator==(uint32_t inputHash) const {
       return inputHash_ == inputHash;
     }
+    uint32_t key() const { return inputHash_; }
 
     uint32_t inputHash_;
   };
@@ -84,14 +84,14 @@ void StratumMinerBeam::handleRequest_Submit(
   auto &worker = session.getWorker();
   auto sessionId = session.getSessionId();
 
-  shared_ptr<StratumJobEx> exjob = server.GetJobRepository(localJob->chainId_)
-                                       ->getStratumJobEx(localJob->jobId_);
+  StratumJobEx *exjob = server.GetJobRepository(localJob->chainId_)
+                              ->getStratumJobEx(localJob->jobId_);
   // can't find stratum job
-  if (exjob.get() == nullptr) {
+  if (exjob == nullptr) {
     handleShare(idStr, StratumStatus::JOB_NOT_FOUND, 0, session.getChainId());
     return;
   }
-  auto sjob = std::static_pointer_cast<StratumJobBeam>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobBeam *>(exjob->sjob_.get());
 
   // Used to prevent duplicate shares.
   // Note: The same (input, nonce) may have multiple different and valid
@@ -107,33 +107,34 @@ void StratumMinerBeam::handleRequest_Submit(
   }
   auto &jobDiff = iter->second;
 
-  ShareBeam share;
-  share.set_version(ShareBeam::CURRENT_VERSION);
-  share.set_inputprefix(inputPrefix);
-  share.set_workerhashid(workerId_);
-  share.set_userid(worker.userId(localJob->chainId_));
-  share.set_sharediff(jobDiff.currentJobDiff_);
-  share.set_blockbits(sjob->blockBits_);
-  share.set_timestamp((uint64_t)time(nullptr));
-  share.set_status(StratumStatus::REJECT_NO_REASON);
-  share.set_height(sjob->height_);
-  share.set_nonce(nonce);
-  share.set_sessionid(sessionId);
-  share.set_outputhash(outputHash);
-  IpAddress ip;
-  ip.fromIpv4Int(session.getClientIp());
-  share.set_ip(ip.toString());
+  // the share is kept in its fixed-layout record until it is sent, the
+  // protobuf message is only built with the protobuf share format
+  ShareBeamBytes share;
+  share.version_ = ShareBeam::BYTES_VERSION;
+  share.inputPrefix_ = inputPrefix;
+  share.workerHashId_ = workerId_;
+  share.userId_ = worker.userId(localJob->chainId_);
+  share.shareDiff_ = jobDiff.currentJobDiff_;
+  share.blockBits_ = sjob->blockBits_;
+  share.timestamp_ = (uint64_t)time(nullptr);
+  share.status_ = StratumStatus::REJECT_NO_REASON;
+  share.height_ = sjob->height_;
+  share.nonce_ = nonce;
+  share.sessionId_ = sessionId;
+  share.outputHash_ = outputHash;
+  share.ip_.fromIpv4Int(session.getClientIp());
 
   LocalShare localShare(nonce, outputHash, 0);
   // can't add local share
-  if (!localJob->addLocalShare(localShare)) {
+  const int32_t localShareStatus = localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
     handleShare(
         idStr,
-        StratumStatus::DUPLICATE_SHARE,
+        localShareStatus,
         jobDiff.currentJobDiff_,
         localJob->chainId_);
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(localShareStatus);
     return;
   }
 
@@ -147,17 +148,17 @@ void StratumMinerBeam::handleRequest_Submit(
       worker.fullName_,
       blockHash);
 
-  if (StratumStatus::isAccepted(share.status())) {
-    DLOG(INFO) << "share reached the diff: " << share.sharediff();
+  if (StratumStatus::isAccepted(share.status_)) {
+    DLOG(INFO) << "share reached the diff: " << share.shareDiff_;
   } else {
-    DLOG(INFO) << "share not reached the diff: " << share.sharediff();
+    DLOG(INFO) << "share not reached the diff: " << share.shareDiff_;
   }
 
   // we send share to kafka by default, but if there are lots of invalid
   // shares in a short time, we just drop them.
   if (handleShare(
-          idStr, share.status(), share.sharediff(), localJob->chainId_)) {
-    if (StratumStatus::isSolved(share.status())) {
+          idStr, share.status_, share.shareDiff_, localJob->chainId_)) {
+    if (StratumStatus::isSolved(share.status_)) {
       server.sendSolvedShare2Kafka(
           localJob->chainId_, share, sjob->input_, output, worker, blockHash);
       // mark jobs as stale
@@ -178,12 +179,21 @@ void StratumMinerBeam::handleRequest_Submit(
 
   DLOG(INFO) << share.toString();
 
-  std::string message;
-  if (!share.SerializeToStringWithVersion(message)) {
+  if (server.useShareBytes()) {
+    share.checkSum_ = share.checkSum();
+    server.sendShare2Kafka(localJob->chainId_, (char *)&share, sizeof(share));
+    return;
+  }
+
+  ShareBeam message;
+  message.fromBytes(share);
+  message.formatIp();
+  std::string data;
+  if (!message.SerializeToStringWithVersion(data)) {
     LOG(ERROR) << "share SerializeToStringWithVersion failed!"
-               << share.toString();
+               << message.toString();
     return;
   }
 
-  server.sendShare2Kafka(localJob->chainId_, message.data(), message.size());
+  server.sendShare2Kafka(localJob->chainId_, data.data(), data.size());
 }
@@ -88,7 +88,7 @@ void JobRepositoryBeam::broadcastStratumJob(shared_ptr<StratumJob> sjob) {
   }
 
   // insert new job
-  exJobs_[sjobBeam->jobId_] = exJob;
+  addStratumJobEx(sjobBeam->jobId_, exJob);
 
   // send job
   if (isClean) {
@@ -127,43 +127,43 @@ bool ServerBeam::setupInternal(const libconfig::Config &config) {
 
 void ServerBeam::checkAndUpdateShare(
     size_t chainId,
-    ShareBeam &share,
-    shared_ptr<StratumJobEx> exjob,
+    ShareBeamBytes &share,
+    StratumJobEx *exjob,
     const string &output,
     const std::set<uint64_t> &jobDiffs,
     const string &workFullName,
     uint256 &computedShareHash) {
-  auto sjob = static_pointer_cast<StratumJobBeam>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobBeam *>(exjob->sjob_.get());
 
-  DLOG(INFO) << "checking share nonce: " << hex << share.nonce()
+  DLOG(INFO) << "checking share nonce: " << hex << share.nonce_
              << ", input: " << sjob->input_ << ", output: " << output;
 
   if (exjob->isStale()) {
-    share.set_status(StratumStatus::STALE_SHARE);
+    share.status_ = StratumStatus::STALE_SHARE;
     return;
   }
 
-  if (noncePrefixCheck_ && (share.nonce() >> 40) != share.sessionid()) {
-    share.set_status(StratumStatus::WRONG_NONCE_PREFIX);
+  if (noncePrefixCheck_ && (share.nonce_ >> 40) != share.sessionId_) {
+    share.status_ = StratumStatus::WRONG_NONCE_PREFIX;
     return;
   }
 
   beam::Difficulty::Raw shareHash;
   bool isValidSulution = Beam_ComputeHash(
       sjob->input_,
-      share.nonce(),
+      share.nonce_,
       output,
       shareHash,
-      share.height() < beamHash2ForkHeight_ ? 1 : 2);
+      share.height_ < beamHash2ForkHeight_ ? 1 : 2);
   if (!isValidSulution && !isEnableSimulator_) {
-    share.set_status(StratumStatus::INVALID_SOLUTION);
+    share.status_ = StratumStatus::INVALID_SOLUTION;
     return;
   }
   computedShareHash = SwapUint(Beam_Uint256Conv(shareHash));
-  share.set_bitsreached(UintToArith256(computedShareHash).GetCompact());
+  share.bitsReached_ = UintToArith256(computedShareHash).GetCompact();
 
-  beam::Difficulty networkDiff(share.blockbits());
-  uint256 networkTarget = Beam_BitsToTarget(share.blockbits());
+  beam::Difficulty networkDiff(share.blockBits_);
+  uint256 networkTarget = Beam_BitsToTarget(share.blockBits_);
 
   DLOG(INFO) << "comapre share hash: " << computedShareHash.GetHex()
              << ", network target: " << networkTarget.GetHex();
@@ -186,7 +186,7 @@ void ServerBeam::checkAndUpdateShare(
               << ", network target: " << networkTarget.GetHex()
               << ", worker: " << workFullName;
 
-    share.set_status(StratumStatus::SOLVED);
+    share.status_ = StratumStatus::SOLVED;
     LOG(INFO) << "solved share: " << share.toString();
     return;
   }
@@ -201,19 +201,19 @@ void ServerBeam::checkAndUpdateShare(
                << ", job target: " << jobTarget.GetHex();
 
     if (isEnableSimulator_ || jobDiff.IsTargetReached(shareHash)) {
-      share.set_sharediff(*itr);
-      share.set_status(StratumStatus::ACCEPT);
+      share.shareDiff_ = *itr;
+      share.status_ = StratumStatus::ACCEPT;
       return;
     }
   }
 
-  share.set_status(StratumStatus::LOW_DIFFICULTY);
+  share.status_ = StratumStatus::LOW_DIFFICULTY;
   return;
 }
 
 void ServerBeam::sendSolvedShare2Kafka(
     size_t chainId,
-    const ShareBeam &share,
+    const ShareBeamBytes &share,
     const string &input,
     const string &output,
     const StratumWorker &worker,
@@ -225,11 +225,11 @@ void ServerBeam::sendSolvedShare2Kafka(
       "\"workerId\":%d"
       ",\"workerFullName\":\"%s\","
       "\"blockHash\":\"%s\",\"chain\":\"%s\"}",
-      share.nonce(),
+      share.nonce_,
       input,
       output,
-      share.height(),
-      share.blockbits(),
+      share.height_,
+      share.blockBits_,
       worker.userId(chainId),
       worker.workerHashId_,
       filterWorkerName(worker.fullName_),
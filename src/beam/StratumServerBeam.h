@@ -39,15 +39,15 @@ public:
   bool setupInternal(const libconfig::Config &config) override;
   void checkAndUpdateShare(
       size_t chainId,
-      ShareBeam &share,
-      shared_ptr<StratumJobEx> exjob,
+      ShareBeamBytes &share,
+      StratumJobEx *exjob,
       const string &output,
       const std::set<uint64_t> &jobDiffs,
       const string &workFullName,
       uint256 &computedShareHash);
   void sendSolvedShare2Kafka(
       size_t chainId,
-      const ShareBeam &share,
+      const ShareBeamBytes &share,
       const string &input,
       const string &output,
       const StratumWorker &worker,
@@ -45,8 +45,14 @@ std::string EncodeHexBlockHeader(const CBlockHeader &blkHeader) {
 
 uint256 ComputeCoinbaseMerkleRoot(
     const std::vector<char> &coinbaseBin, const vector<uint256> &merkleBranch) {
+  return ComputeCoinbaseMerkleRoot(
+      Hash(coinbaseBin.begin(), coinbaseBin.end()), merkleBranch);
+}
+
+uint256 ComputeCoinbaseMerkleRoot(
+    const uint256 &coinbaseHash, const vector<uint256> &merkleBranch) {
 
-  uint256 hashMerkleRoot = Hash(coinbaseBin.begin(), coinbaseBin.end());
+  uint256 hashMerkleRoot = coinbaseHash;
   for (const uint256 &step : merkleBranch) {
     hashMerkleRoot = Hash(
         BEGIN(hashMerkleRoot), END(hashMerkleRoot), BEGIN(step), END(step));
@@ -125,6 +125,8 @@ std::vector<uint256> BlockMerkleBranch(const CBlock &block, uint32_t position);
 uint256 ComputeCoinbaseMerkleRoot(
     const std::vector<char> &coinbaseBin,
     const std::vector<uint256> &merkleBranch);
+uint256 ComputeCoinbaseMerkleRoot(
+    const uint256 &coinbaseHash, const std::vector<uint256> &merkleBranch);
 
 std::string EncodeHexBlock(const CBlock &block);
 std::string EncodeHexBlockHeader(const CBlockHeader &blkHeader);
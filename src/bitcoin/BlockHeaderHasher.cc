@@ -0,0 +1,436 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "BlockHeaderHasher.h"
+
+#include <string.h>
+
+// The x86 kernels are compiled with function target attributes, so the rest
+// of the code does not need -msse4.1 / -mavx2 / -msha.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define BLOCK_HEADER_HASHER_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint32_t kInitState[8] = {0x6a09e667,
+                                0xbb67ae85,
+                                0x3c6ef372,
+                                0xa54ff53a,
+                                0x510e527f,
+                                0x9b05688c,
+                                0x1f83d9ab,
+                                0x5be0cd19};
+
+const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t readBE32(const unsigned char *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+      ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline void writeBE32(unsigned char *p, uint32_t x) {
+  p[0] = (unsigned char)(x >> 24);
+  p[1] = (unsigned char)(x >> 16);
+  p[2] = (unsigned char)(x >> 8);
+  p[3] = (unsigned char)x;
+}
+
+//
+// Multi-buffer SHA-256: lane i of every word belongs to the i-th header.
+// Written with GCC vector extensions, the same code is compiled to plain
+// scalar, SSE (4 lanes) and AVX2 (8 lanes) instructions. It's always inlined
+// into the kernels so it takes the instruction set of each kernel.
+//
+typedef uint32_t Lanes1 __attribute__((vector_size(4)));
+#ifdef BLOCK_HEADER_HASHER_X86
+typedef uint32_t Lanes4 __attribute__((vector_size(16)));
+typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+#endif
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+// Vectors are not passed to or returned from functions, which would depend
+// on the instruction set (-Wpsabi).
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SPLAT(V, x) (V{} + (uint32_t)(x))
+
+// One SHA-256 compression of the 16 message words w into state s
+template <typename V>
+ALWAYS_INLINE void transform(V *s, V *w) {
+  V a = s[0], b = s[1], c = s[2], d = s[3];
+  V e = s[4], f = s[5], g = s[6], h = s[7];
+
+  for (int i = 0; i < 64; i++) {
+    V wi;
+    if (i < 16) {
+      wi = w[i];
+    } else {
+      V w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+      wi = w[i & 15] += (ROR(w15, 7) ^ ROR(w15, 18) ^ (w15 >> 3)) +
+          w[(i - 7) & 15] + (ROR(w2, 17) ^ ROR(w2, 19) ^ (w2 >> 10));
+    }
+    V t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) +
+        SPLAT(V, kRoundConstants[i]) + wi;
+    V t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  s[0] += a;
+  s[1] += b;
+  s[2] += c;
+  s[3] += d;
+  s[4] += e;
+  s[5] += f;
+  s[6] += g;
+  s[7] += h;
+}
+
+// Double SHA-256 of N headers, lane by lane
+template <typename V, int N>
+ALWAYS_INLINE void hashLanes(unsigned char *out, const unsigned char *in) {
+  V s[8], w[16];
+
+  // the first 64 bytes
+  for (int i = 0; i < 8; i++) {
+    s[i] = SPLAT(V, kInitState[i]);
+  }
+  for (int i = 0; i < 16; i++) {
+    for (int lane = 0; lane < N; lane++) {
+      w[i][lane] = readBE32(in + lane * BlockHeaderHasher::kHeaderSize + i * 4);
+    }
+  }
+  transform(s, w);
+
+  // the last 16 bytes and the padding of 80 bytes
+  for (int i = 0; i < 4; i++) {
+    for (int lane = 0; lane < N; lane++) {
+      w[i][lane] =
+          readBE32(in + lane * BlockHeaderHasher::kHeaderSize + 64 + i * 4);
+    }
+  }
+  w[4] = SPLAT(V, 0x80000000);
+  for (int i = 5; i < 15; i++) {
+    w[i] = SPLAT(V, 0);
+  }
+  w[15] = SPLAT(V, 80 * 8);
+  transform(s, w);
+
+  // the second SHA-256 over the 32 bytes hash
+  for (int i = 0; i < 8; i++) {
+    w[i] = s[i];
+    s[i] = SPLAT(V, kInitState[i]);
+  }
+  w[8] = SPLAT(V, 0x80000000);
+  for (int i = 9; i < 15; i++) {
+    w[i] = SPLAT(V, 0);
+  }
+  w[15] = SPLAT(V, 32 * 8);
+  transform(s, w);
+
+  for (int i = 0; i < 8; i++) {
+    for (int lane = 0; lane < N; lane++) {
+      writeBE32(out + lane * BlockHeaderHasher::kHashSize + i * 4, s[i][lane]);
+    }
+  }
+}
+
+void hashGeneric(unsigned char *out, const unsigned char *in, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    hashLanes<Lanes1, 1>(
+        out + i * BlockHeaderHasher::kHashSize,
+        in + i * BlockHeaderHasher::kHeaderSize);
+  }
+}
+
+#ifdef BLOCK_HEADER_HASHER_X86
+
+__attribute__((target("sse4.1"))) void
+hashSse41(unsigned char *out, const unsigned char *in, size_t count) {
+  for (; count >= 4; count -= 4) {
+    hashLanes<Lanes4, 4>(out, in);
+    out += 4 * BlockHeaderHasher::kHashSize;
+    in += 4 * BlockHeaderHasher::kHeaderSize;
+  }
+  hashGeneric(out, in, count);
+}
+
+__attribute__((target("avx2"))) void
+hashAvx2(unsigned char *out, const unsigned char *in, size_t count) {
+  for (; count >= 8; count -= 8) {
+    hashLanes<Lanes8, 8>(out, in);
+    out += 8 * BlockHeaderHasher::kHashSize;
+    in += 8 * BlockHeaderHasher::kHeaderSize;
+  }
+  if (count >= 4) {
+    hashLanes<Lanes4, 4>(out, in);
+    out += 4 * BlockHeaderHasher::kHashSize;
+    in += 4 * BlockHeaderHasher::kHeaderSize;
+    count -= 4;
+  }
+  hashGeneric(out, in, count);
+}
+
+//
+// SHA extensions: four rounds per two SHA256RNDS2, the state is kept as
+// ABEF / CDGH and the message schedule is computed by SHA256MSG1/MSG2.
+// K independent blocks are interleaved to hide the latency of SHA256RNDS2.
+//
+template <int K>
+__attribute__((target("sha,sse4.1"))) ALWAYS_INLINE void shaNiTransform(
+    __m128i *state0, __m128i *state1, const unsigned char *const *blocks) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i abef[K], cdgh[K], msgs[K][4];
+
+  for (int k = 0; k < K; k++) {
+    abef[k] = state0[k];
+    cdgh[k] = state1[k];
+  }
+
+  for (int i = 0; i < 16; i++) {
+    const __m128i roundConstants =
+        _mm_loadu_si128((const __m128i *)&kRoundConstants[i * 4]);
+    for (int k = 0; k < K; k++) {
+      __m128i *m = msgs[k];
+      if (i < 4) {
+        m[i] = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *)(blocks[k] + i * 16)), kByteSwap);
+      }
+      __m128i msg = _mm_add_epi32(m[i & 3], roundConstants);
+      state1[k] = _mm_sha256rnds2_epu32(state1[k], state0[k], msg);
+      if (i >= 3 && i < 15) {
+        // finish the message words of the next four rounds
+        __m128i &next = m[(i + 1) & 3];
+        next = _mm_add_epi32(next, _mm_alignr_epi8(m[i & 3], m[(i - 1) & 3], 4));
+        next = _mm_sha256msg2_epu32(next, m[i & 3]);
+      }
+      msg = _mm_shuffle_epi32(msg, 0x0e);
+      state0[k] = _mm_sha256rnds2_epu32(state0[k], state1[k], msg);
+      if (i >= 1 && i < 13) {
+        m[(i - 1) & 3] = _mm_sha256msg1_epu32(m[(i - 1) & 3], m[i & 3]);
+      }
+    }
+  }
+
+  for (int k = 0; k < K; k++) {
+    state0[k] = _mm_add_epi32(state0[k], abef[k]);
+    state1[k] = _mm_add_epi32(state1[k], cdgh[k]);
+  }
+}
+
+// Write the state as a big endian hash
+__attribute__((target("sha,sse4.1"))) ALWAYS_INLINE void
+shaNiStore(unsigned char *out, __m128i state0, __m128i state1) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i feba = _mm_shuffle_epi32(state0, 0x1b);
+  __m128i dchg = _mm_shuffle_epi32(state1, 0xb1);
+  __m128i dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+  __m128i hgfe = _mm_alignr_epi8(dchg, feba, 8);
+  _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(dcba, kByteSwap));
+  _mm_storeu_si128((__m128i *)(out + 16), _mm_shuffle_epi8(hgfe, kByteSwap));
+}
+
+// Double SHA-256 of K headers
+template <int K>
+__attribute__((target("sha,sse4.1"))) ALWAYS_INLINE void
+shaNiHashHeaders(unsigned char *out, const unsigned char *in) {
+  // ABEF, CDGH
+  const __m128i initState0 =
+      _mm_set_epi32(kInitState[0], kInitState[1], kInitState[4], kInitState[5]);
+  const __m128i initState1 =
+      _mm_set_epi32(kInitState[2], kInitState[3], kInitState[6], kInitState[7]);
+  __m128i state0[K], state1[K];
+  // the last 16 bytes of a header or the 32 bytes hash, with their padding
+  unsigned char tails[K][64];
+  const unsigned char *blocks[K];
+
+  for (int k = 0; k < K; k++) {
+    state0[k] = initState0;
+    state1[k] = initState1;
+    blocks[k] = in + k * BlockHeaderHasher::kHeaderSize;
+  }
+  shaNiTransform<K>(state0, state1, blocks);
+
+  for (int k = 0; k < K; k++) {
+    memcpy(tails[k], blocks[k] + 64, 16);
+    memset(tails[k] + 16, 0, 48);
+    tails[k][16] = 0x80;
+    writeBE32(tails[k] + 60, 80 * 8);
+    blocks[k] = tails[k];
+  }
+  shaNiTransform<K>(state0, state1, blocks);
+
+  for (int k = 0; k < K; k++) {
+    shaNiStore(tails[k], state0[k], state1[k]);
+    memset(tails[k] + 32, 0, 32);
+    tails[k][32] = 0x80;
+    writeBE32(tails[k] + 60, 32 * 8);
+    state0[k] = initState0;
+    state1[k] = initState1;
+  }
+  shaNiTransform<K>(state0, state1, blocks);
+
+  for (int k = 0; k < K; k++) {
+    shaNiStore(
+        out + k * BlockHeaderHasher::kHashSize, state0[k], state1[k]);
+  }
+}
+
+__attribute__((target("sha,sse4.1"))) void
+hashShaNi(unsigned char *out, const unsigned char *in, size_t count) {
+  for (; count >= 2; count -= 2) {
+    shaNiHashHeaders<2>(out, in);
+    out += 2 * BlockHeaderHasher::kHashSize;
+    in += 2 * BlockHeaderHasher::kHeaderSize;
+  }
+  if (count > 0) {
+    shaNiHashHeaders<1>(out, in);
+  }
+}
+
+struct CpuFeatures {
+  bool sse41_ = false;
+  bool avx2_ = false;
+  bool sha_ = false;
+
+  CpuFeatures() {
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+      return;
+    }
+    sse41_ = (ecx & bit_SSE4_1) != 0;
+
+    // AVX registers must be enabled by the OS
+    bool avx = false;
+    if ((ecx & bit_OSXSAVE) != 0 && (ecx & bit_AVX) != 0) {
+      uint32_t xcr0, xcr0High;
+      __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+      avx = (xcr0 & 6) == 6;
+    }
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+      avx2_ = avx && (ebx & bit_AVX2) != 0;
+      sha_ = sse41_ && (ebx & bit_SHA) != 0;
+    }
+  }
+};
+
+const CpuFeatures &cpuFeatures() {
+  static const CpuFeatures features;
+  return features;
+}
+
+#endif // BLOCK_HEADER_HASHER_X86
+
+} // namespace
+
+BlockHeaderHasher::Kernel BlockHeaderHasher::bestKernel() {
+  static const Kernel kernel = []() {
+    const Kernel kernels[] = {SHANI, AVX2, SSE41};
+    for (Kernel k : kernels) {
+      if (isSupported(k)) {
+        return k;
+      }
+    }
+    return GENERIC;
+  }();
+  return kernel;
+}
+
+bool BlockHeaderHasher::isSupported(Kernel kernel) {
+  switch (kernel) {
+  case GENERIC:
+    return true;
+#ifdef BLOCK_HEADER_HASHER_X86
+  case SSE41:
+    return cpuFeatures().sse41_;
+  case AVX2:
+    return cpuFeatures().avx2_;
+  case SHANI:
+    return cpuFeatures().sha_;
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *BlockHeaderHasher::kernelName(Kernel kernel) {
+  switch (kernel) {
+  case GENERIC:
+    return "generic";
+  case SSE41:
+    return "sse4.1";
+  case AVX2:
+    return "avx2";
+  case SHANI:
+    return "sha-ni";
+  }
+  return "unknown";
+}
+
+void BlockHeaderHasher::hash(
+    unsigned char *out, const unsigned char *in, size_t count) {
+  hash(bestKernel(), out, in, count);
+}
+
+void BlockHeaderHasher::hash(
+    Kernel kernel, unsigned char *out, const unsigned char *in, size_t count) {
+  switch (kernel) {
+#ifdef BLOCK_HEADER_HASHER_X86
+  case SSE41:
+    hashSse41(out, in, count);
+    return;
+  case AVX2:
+    hashAvx2(out, in, count);
+    return;
+  case SHANI:
+    hashShaNi(out, in, count);
+    return;
+#endif
+  default:
+    hashGeneric(out, in, count);
+    return;
+  }
+}
@@ -0,0 +1,62 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#ifndef BLOCK_HEADER_HASHER_H_
+#define BLOCK_HEADER_HASHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Double SHA-256 of serialized (80 bytes) block headers, many at a time.
+//
+// Headers are hashed by multi-buffer kernels (several independent headers
+// in the lanes of SIMD registers) or by the SHA extensions of the CPU. The
+// fastest kernel supported by the CPU is detected by CPUID at runtime.
+//
+class BlockHeaderHasher {
+public:
+  enum Kernel {
+    GENERIC, // portable C++, one header at a time
+    SSE41, // 4 headers at a time
+    AVX2, // 8 headers at a time
+    SHANI, // SHA extensions, one header at a time
+  };
+
+  static const size_t kHeaderSize = 80;
+  static const size_t kHashSize = 32;
+
+  // The fastest kernel supported by the CPU
+  static Kernel bestKernel();
+  static bool isSupported(Kernel kernel);
+  static const char *kernelName(Kernel kernel);
+
+  // Hash count headers in `in` (80 bytes each) to `out` (32 bytes each).
+  // The hashes are the same as CBlockHeader::GetHash(), in memory order.
+  static void hash(unsigned char *out, const unsigned char *in, size_t count);
+  // The same as above with the given kernel, which must be supported
+  static void
+  hash(Kernel kernel, unsigned char *out, const unsigned char *in, size_t count);
+};
+
+#endif // BLOCK_HEADER_HASHER_H_
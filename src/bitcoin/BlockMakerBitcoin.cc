@@ -1028,7 +1028,7 @@ void BlockMakerBitcoin::consumeStratumJob(rd_kafka_message_t *rkmessage) {
   LOG(INFO) << "received StratumJob message, len: " << rkmessage->len;
 
   shared_ptr<StratumJobBitcoin> sjob = std::make_shared<StratumJobBitcoin>();
-  bool res = sjob->unserializeFromJson(
+  bool res = sjob->unserialize(
       (const char *)rkmessage->payload, rkmessage->len);
   if (res == false) {
     LOG(ERROR) << "unserialize stratum job fail";
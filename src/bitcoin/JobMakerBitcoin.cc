@@ -573,7 +573,8 @@ string JobMakerHandlerBitcoin::makeStratumJob(const string &gbt) {
     return "";
   }
   sjob.jobId_ = gen_->next();
-  const string jobMsg = sjob.serializeToJson();
+  const string jobMsg =
+      def()->binaryJob_ ? sjob.serializeToBinary() : sjob.serializeToJson();
 
   // set last send time
   // TODO: fix Y2K38 issue
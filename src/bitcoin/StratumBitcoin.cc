@@ -281,6 +281,7 @@ bool StratumJobBitcoin::unserializeFromJson(const char *s, size_t len) {
   //
   // namecoin, optional
   //
+  bool hasNmcWork = false;
   if (j["nmcBlockHash"].type() == Utilities::JS::type::Str &&
       j["nmcBits"].type() == Utilities::JS::type::Int &&
       j["nmcHeight"].type() == Utilities::JS::type::Int &&
@@ -291,7 +292,7 @@ bool StratumJobBitcoin::unserializeFromJson(const char *s, size_t len) {
     nmcHeight_ = j["nmcHeight"].int32();
     nmcRpcAddr_ = j["nmcRpcAddr"].str();
     nmcRpcUserpass_ = j["nmcRpcUserpass"].str();
-    BitsToTarget(nmcAuxBits_, nmcNetworkTarget_);
+    hasNmcWork = true;
   }
 
   //
@@ -312,6 +313,7 @@ bool StratumJobBitcoin::unserializeFromJson(const char *s, size_t len) {
   //
   // Vcash, optional
   //
+  bool hasVcashWork = false;
   if (j["vcashBlockHashForMergedMining"].type() == Utilities::JS::type::Str &&
       j["vcashNetworkTarget"].type() == Utilities::JS::type::Str &&
       j["vcashHeight"].type() == Utilities::JS::type::Int &&
@@ -322,11 +324,7 @@ bool StratumJobBitcoin::unserializeFromJson(const char *s, size_t len) {
     vcashHeight_ = j["vcashHeight"].uint64();
     vcashdRpcAddress_ = j["vcashdRpcAddress"].str();
     vcashdRpcUserPwd_ = j["vcashdRpcUserPwd"].str();
-
-    nmcNetworkTarget_ = (UintToArith256(nmcNetworkTarget_) >
-                         UintToArith256(vcashNetworkTarget_))
-        ? nmcNetworkTarget_
-        : vcashNetworkTarget_;
+    hasVcashWork = true;
   }
 
   const string merkleBranchStr = j["merkleBranch"].str();
@@ -336,13 +334,188 @@ bool StratumJobBitcoin::unserializeFromJson(const char *s, size_t len) {
     merkleBranch_[i] = uint256S(merkleBranchStr.substr(i * 64, 64));
   }
 
+  initTargets(hasNmcWork, hasVcashWork);
+  return true;
+}
+
+static string Uint256ToBytes(const uint256 &hash) {
+  return string((const char *)hash.begin(), hash.size());
+}
+
+// An empty string is decoded as zero
+static bool BytesToUint256(const string &bytes, uint256 &hash) {
+  if (bytes.empty()) {
+    hash.SetNull();
+    return true;
+  }
+  if (bytes.size() != hash.size()) {
+    return false;
+  }
+  memcpy(hash.begin(), bytes.data(), hash.size());
+  return true;
+}
+
+string StratumJobBitcoin::serializeToBinary() const {
+  sharebase::StratumJobBitcoinMsg msg;
+  msg.set_jobid(jobId_);
+  msg.set_gbthash(gbtHash_);
+  msg.set_prevhash(Uint256ToBytes(prevHash_));
+  msg.set_prevhashbestr(prevHashBeStr_);
+  msg.set_height(height_);
+
+  vector<char> bin;
+  Hex2Bin(coinbase1_.data(), coinbase1_.size(), bin);
+  msg.set_coinbase1(bin.data(), bin.size());
+  Hex2Bin(coinbase2_.data(), coinbase2_.size(), bin);
+  msg.set_coinbase2(bin.data(), bin.size());
+
+  string *merkleBranch = msg.mutable_merklebranch();
+  merkleBranch->reserve(merkleBranch_.size() * 32);
+  for (const auto &hash : merkleBranch_) {
+    merkleBranch->append((const char *)hash.begin(), hash.size());
+  }
+
+  msg.set_nversion(nVersion_);
+  msg.set_nbits(nBits_);
+  msg.set_ntime(nTime_);
+  msg.set_mintime(minTime_);
+  msg.set_coinbasevalue(coinbaseValue_);
+  msg.set_witnesscommitment(witnessCommitment_);
+#ifdef CHAIN_TYPE_UBTC
+  msg.set_rootstatehash(rootStateHash_);
+#endif
+#ifdef CHAIN_TYPE_ZEC
+  msg.set_merkleroot(Uint256ToBytes(merkleRoot_));
+  msg.set_finalsaplingroot(Uint256ToBytes(finalSaplingRoot_));
+#endif
+
+  // proxy stratum job
+  msg.set_proxyextranonce2size(proxyExtraNonce2Size_);
+  msg.set_proxyjobdifficulty(proxyJobDifficulty_);
+  msg.set_mergedminingclean(isMergedMiningCleanJob_);
+
+  // nmc
+  msg.set_nmcblockhash(Uint256ToBytes(nmcAuxBlockHash_));
+  msg.set_nmcbits(nmcAuxBits_);
+  msg.set_nmcheight(nmcHeight_);
+  msg.set_nmcrpcaddr(nmcRpcAddr_);
+  msg.set_nmcrpcuserpass(nmcRpcUserpass_);
+
+  // rsk
+  msg.set_rskblockhashformergedmining(blockHashForMergedMining_);
+  msg.set_rsknetworktarget(Uint256ToBytes(rskNetworkTarget_));
+  msg.set_rskfeesforminer(feesForMiner_);
+  msg.set_rskdrpcaddress(rskdRpcAddress_);
+  msg.set_rskdrpcuserpwd(rskdRpcUserPwd_);
+
+  // vcash
+  msg.set_vcashblockhashformergedmining(vcashBlockHashForMergedMining_);
+  msg.set_vcashnetworktarget(Uint256ToBytes(vcashNetworkTarget_));
+  msg.set_vcashheight(vcashHeight_);
+  msg.set_vcashdrpcaddress(vcashdRpcAddress_);
+  msg.set_vcashdrpcuserpwd(vcashdRpcUserPwd_);
+
+  string data;
+  data.reserve(2 + msg.ByteSizeLong());
+  data.push_back(kBinaryMagic);
+  data.push_back(kBinaryVersion);
+  msg.AppendToString(&data);
+  return data;
+}
+
+bool StratumJobBitcoin::unserializeFromBinary(const char *s, size_t len) {
+  if (len < 2 || (uint8_t)s[0] != kBinaryMagic) {
+    return false;
+  }
+  if ((uint8_t)s[1] != kBinaryVersion) {
+    LOG(ERROR) << "unknown stratum job encoding version: " << (int)s[1];
+    return false;
+  }
+
+  sharebase::StratumJobBitcoinMsg msg;
+  if (!msg.ParseFromArray(s + 2, len - 2) ||
+      !BytesToUint256(msg.prevhash(), prevHash_) ||
+      msg.merklebranch().size() % 32 != 0 ||
+#ifdef CHAIN_TYPE_ZEC
+      !BytesToUint256(msg.merkleroot(), merkleRoot_) ||
+      !BytesToUint256(msg.finalsaplingroot(), finalSaplingRoot_) ||
+#endif
+      !BytesToUint256(msg.nmcblockhash(), nmcAuxBlockHash_) ||
+      !BytesToUint256(msg.rsknetworktarget(), rskNetworkTarget_) ||
+      !BytesToUint256(msg.vcashnetworktarget(), vcashNetworkTarget_)) {
+    LOG(ERROR) << "parse binary stratum job failure, size: " << len;
+    return false;
+  }
+
+  jobId_ = msg.jobid();
+  gbtHash_ = msg.gbthash();
+  prevHashBeStr_ = msg.prevhashbestr();
+  height_ = msg.height();
+  Bin2Hex(
+      (const uint8_t *)msg.coinbase1().data(),
+      msg.coinbase1().size(),
+      coinbase1_);
+  Bin2Hex(
+      (const uint8_t *)msg.coinbase2().data(),
+      msg.coinbase2().size(),
+      coinbase2_);
+
+  const string &merkleBranch = msg.merklebranch();
+  merkleBranch_.resize(merkleBranch.size() / 32);
+  for (size_t i = 0; i < merkleBranch_.size(); i++) {
+    memcpy(merkleBranch_[i].begin(), merkleBranch.data() + i * 32, 32);
+  }
+
+  nVersion_ = msg.nversion();
+  nBits_ = msg.nbits();
+  nTime_ = msg.ntime();
+  minTime_ = msg.mintime();
+  coinbaseValue_ = msg.coinbasevalue();
+  witnessCommitment_ = msg.witnesscommitment();
+#ifdef CHAIN_TYPE_UBTC
+  rootStateHash_ = msg.rootstatehash();
+#endif
+
+  proxyExtraNonce2Size_ = msg.proxyextranonce2size();
+  proxyJobDifficulty_ = msg.proxyjobdifficulty();
+  isMergedMiningCleanJob_ = msg.mergedminingclean();
+
+  nmcAuxBits_ = msg.nmcbits();
+  nmcHeight_ = msg.nmcheight();
+  nmcRpcAddr_ = msg.nmcrpcaddr();
+  nmcRpcUserpass_ = msg.nmcrpcuserpass();
+
+  blockHashForMergedMining_ = msg.rskblockhashformergedmining();
+  feesForMiner_ = msg.rskfeesforminer();
+  rskdRpcAddress_ = msg.rskdrpcaddress();
+  rskdRpcUserPwd_ = msg.rskdrpcuserpwd();
+
+  vcashBlockHashForMergedMining_ = msg.vcashblockhashformergedmining();
+  vcashHeight_ = msg.vcashheight();
+  vcashdRpcAddress_ = msg.vcashdrpcaddress();
+  vcashdRpcUserPwd_ = msg.vcashdrpcuserpwd();
+
+  // the merged mining fields are always present like in the JSON encoding
+  initTargets(true, true);
+  return true;
+}
+
+void StratumJobBitcoin::initTargets(bool hasNmcWork, bool hasVcashWork) {
+  if (hasNmcWork) {
+    BitsToTarget(nmcAuxBits_, nmcNetworkTarget_);
+  }
+  if (hasVcashWork) {
+    nmcNetworkTarget_ = (UintToArith256(nmcNetworkTarget_) >
+                         UintToArith256(vcashNetworkTarget_))
+        ? nmcNetworkTarget_
+        : vcashNetworkTarget_;
+  }
+
   if (proxyJobDifficulty_ > 0) {
     BitcoinDifficulty::DiffToTarget(proxyJobDifficulty_, networkTarget_);
   } else {
     BitsToTarget(nBits_, networkTarget_);
   }
-
-  return true;
 }
 
 bool StratumJobBitcoin::initFromGbt(
@@ -937,3 +1110,206 @@ false // is clean
 bool StratumJobBitcoin::isEmptyBlock() {
   return merkleBranch_.size() == 0 ? true : false;
 }
+
+///////////////////////////////// StratumSubmitBitcoin
+///////////////////////////////////
+namespace {
+
+inline const char *skipSpaces(const char *p, const char *end) {
+  while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+    ++p;
+  }
+  return p;
+}
+
+// Find a string without escapes, p should point to the opening quote.
+// Returns the position after the closing quote or nullptr.
+inline const char *parseString(
+    const char *p, const char *end, const char **strBegin, const char **strEnd) {
+  if (p == end || *p != '"') {
+    return nullptr;
+  }
+  *strBegin = ++p;
+  while (p != end && *p != '"') {
+    if (*p == '\\') {
+      return nullptr;
+    }
+    ++p;
+  }
+  if (p == end) {
+    return nullptr;
+  }
+  *strEnd = p;
+  return p + 1;
+}
+
+inline bool isString(const char *begin, const char *end, const char *str) {
+  const size_t len = strlen(str);
+  return (size_t)(end - begin) == len && memcmp(begin, str, len) == 0;
+}
+
+template <typename T>
+inline bool parseHexValue(const char *begin, const char *end, T *value) {
+  const size_t len = end - begin;
+  if (len == 0 || len > sizeof(T) * 2) {
+    return false;
+  }
+  T v = 0;
+  for (const char *p = begin; p != end; ++p) {
+    const char c = *p;
+    if (c >= '0' && c <= '9') {
+      v = (v << 4) | (c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      v = (v << 4) | (c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+      v = (v << 4) | (c - 'A' + 10);
+    } else {
+      return false;
+    }
+  }
+  *value = v;
+  return true;
+}
+
+inline bool parseDecValue(const char *begin, const char *end, uint64_t *value) {
+  const size_t len = end - begin;
+  // 19 digits never overflow uint64_t
+  if (len == 0 || len > 19) {
+    return false;
+  }
+  uint64_t v = 0;
+  for (const char *p = begin; p != end; ++p) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    v = v * 10 + (*p - '0');
+  }
+  *value = v;
+  return true;
+}
+
+} // namespace
+
+bool StratumSubmitBitcoin::parse(const char *begin, const char *end) {
+  const char *p = skipSpaces(begin, end);
+  if (p == end || *p != '{') {
+    return false;
+  }
+
+  bool hasId = false;
+  bool hasMethod = false;
+  bool hasParams = false;
+  // params[0] = Worker Name
+  // params[1] = Job ID
+  // params[2] = ExtraNonce 2
+  // params[3] = nTime
+  // params[4] = nonce
+  // params[5] = version mask (optional)
+  const char *paramBegin[6], *paramEnd[6];
+  size_t paramsSize = 0;
+
+  p = skipSpaces(p + 1, end);
+  while (true) {
+    const char *keyBegin, *keyEnd;
+    if ((p = parseString(p, end, &keyBegin, &keyEnd)) == nullptr) {
+      return false;
+    }
+    p = skipSpaces(p, end);
+    if (p == end || *p != ':') {
+      return false;
+    }
+    p = skipSpaces(p + 1, end);
+    if (p == end) {
+      return false;
+    }
+
+    if (!hasId && isString(keyBegin, keyEnd, "id")) {
+      hasId = true;
+      if (*p == '"') {
+        const char *idBegin, *idEnd;
+        if ((p = parseString(p, end, &idBegin, &idEnd)) == nullptr) {
+          return false;
+        }
+        idStr_.assign(idBegin - 1, idEnd + 1); // with the quotes
+      } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        const char *idBegin = p++;
+        while (p != end && *p >= '0' && *p <= '9') {
+          ++p;
+        }
+        // a lone minus sign is not a number
+        if (*idBegin == '-' && p - idBegin == 1) {
+          return false;
+        }
+        idStr_.assign(idBegin, p);
+      } else if (end - p >= 4 && memcmp(p, "null", 4) == 0) {
+        idStr_ = "null";
+        p += 4;
+      } else {
+        return false;
+      }
+    } else if (!hasMethod && isString(keyBegin, keyEnd, "method")) {
+      hasMethod = true;
+      const char *methodBegin, *methodEnd;
+      if ((p = parseString(p, end, &methodBegin, &methodEnd)) == nullptr ||
+          !isString(methodBegin, methodEnd, "mining.submit")) {
+        return false;
+      }
+    } else if (!hasParams && isString(keyBegin, keyEnd, "params")) {
+      hasParams = true;
+      if (*p != '[') {
+        return false;
+      }
+      p = skipSpaces(p + 1, end);
+      while (true) {
+        if (paramsSize == 6) {
+          return false;
+        }
+        p = parseString(
+            p, end, &paramBegin[paramsSize], &paramEnd[paramsSize]);
+        if (p == nullptr) {
+          return false;
+        }
+        paramsSize++;
+        p = skipSpaces(p, end);
+        if (p == end) {
+          return false;
+        }
+        if (*p == ']') {
+          ++p;
+          break;
+        }
+        if (*p != ',') {
+          return false;
+        }
+        p = skipSpaces(p + 1, end);
+      }
+    } else {
+      return false;
+    }
+
+    p = skipSpaces(p, end);
+    if (p == end) {
+      return false;
+    }
+    if (*p == '}') {
+      break;
+    }
+    if (*p != ',') {
+      return false;
+    }
+    p = skipSpaces(p + 1, end);
+  }
+
+  if (skipSpaces(p + 1, end) != end || !hasId || !hasMethod || !hasParams ||
+      paramsSize < 5) {
+    return false;
+  }
+
+  versionMask_ = 0;
+  return parseDecValue(paramBegin[1], paramEnd[1], &jobId_) &&
+      parseHexValue(paramBegin[2], paramEnd[2], &extraNonce2_) &&
+      parseHexValue(paramBegin[3], paramEnd[3], &nTime_) &&
+      parseHexValue(paramBegin[4], paramEnd[4], &nonce_) &&
+      (paramsSize < 6 ||
+       parseHexValue(paramBegin[5], paramEnd[5], &versionMask_));
+}
@@ -163,6 +163,40 @@ struct ShareBitcoinBytesV2 {
   }
 };
 
+// Fixed-layout share record, written by sserver instead of the protobuf
+// message with sserver.use_share_bytes. sserver fills it on the stack while
+// checking the share, consumers read it in place by a pointer cast and keep
+// the IP as raw bytes (see ShareBitcoin::fromBytes()).
+// extUserId_ and bitsReached_ are 0 when not set.
+struct ShareBitcoinBytesV3 {
+  uint32_t version_ = 0; // 0
+  uint32_t checkSum_ = 0; // 4
+
+  int64_t workerHashId_ = 0; // 8
+  int32_t userId_ = 0; // 16
+  int32_t status_ = 0; // 20
+  int64_t timestamp_ = 0; // 24
+  IpAddress ip_ = 0; // 32
+
+  uint64_t jobId_ = 0; // 48
+  uint64_t shareDiff_ = 0; // 56
+  uint32_t blkBits_ = 0; // 64
+  uint32_t height_ = 0; // 68
+  uint32_t nonce_ = 0; // 72
+  uint32_t sessionId_ = 0; // 76
+  uint32_t versionMask_ = 0; // 80
+  int32_t extUserId_ = 0; // 84
+  uint32_t bitsReached_ = 0; // 88
+  uint32_t reserved_ = 0; // 92
+
+  uint32_t checkSum() const { return sharebase::BytesCheckSum(*this); }
+  std::string toString() const;
+};
+
+static_assert(
+    sizeof(ShareBitcoinBytesV3) == 96,
+    "ShareBitcoinBytesV3 should be 96 bytes");
+
 class ShareBitcoin : public sharebase::Serializable<sharebase::BitcoinMsg> {
 public:
   ShareBitcoin() {
@@ -234,7 +268,7 @@ public:
         "versionMask: %08x, "
         "status: %d/%s)",
         jobid(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -250,6 +284,29 @@ public:
         StratumStatus::toString(status()));
   }
 
+  // The IP is kept raw, see getIp()
+  void fromBytes(const ShareBitcoinBytesV3 &share) {
+    set_version(CURRENT_VERSION);
+    set_workerhashid(share.workerHashId_);
+    set_userid(share.userId_);
+    set_status(share.status_);
+    set_timestamp(share.timestamp_);
+    setRawIp(share.ip_);
+    set_jobid(share.jobId_);
+    set_sharediff(share.shareDiff_);
+    set_blkbits(share.blkBits_);
+    set_height(share.height_);
+    set_nonce(share.nonce_);
+    set_sessionid(share.sessionId_);
+    set_versionmask(share.versionMask_);
+    if (share.extUserId_ != 0) {
+      set_extuserid(share.extUserId_);
+    }
+    if (share.bitsReached_ != 0) {
+      set_bitsreached(share.bitsReached_);
+    }
+  }
+
   bool UnserializeWithVersion(const uint8_t *data, uint32_t size) {
 
     if (nullptr == data || size <= 0) {
@@ -266,6 +323,19 @@ public:
         DLOG(INFO) << "share ParseFromArray failed!";
         return false;
       }
+    } else if (
+        version == BYTES_V3_VERSION && size == sizeof(ShareBitcoinBytesV3)) {
+
+      auto share = (const ShareBitcoinBytesV3 *)payload;
+
+      if (share->checkSum() != share->checkSum_) {
+        DLOG(INFO) << "checkSum mismatched! checkSum_: " << share->checkSum_
+                   << ", checkSum(): " << share->checkSum();
+        return false;
+      }
+
+      fromBytes(*share);
+
     } else if (
         version == BYTES_VERSION && size == sizeof(ShareBitcoinBytesV2)) {
 
@@ -282,7 +352,7 @@ public:
       set_userid(share->userId_);
       set_status(share->status_);
       set_timestamp(share->timestamp_);
-      set_ip(share->ip_.toString());
+      setRawIp(share->ip_);
       set_jobid(share->jobId_);
       set_sharediff(share->shareDiff_);
       set_blkbits(share->blkBits_);
@@ -293,8 +363,8 @@ public:
     } else if (size == sizeof(ShareBitcoinBytesV1)) {
       ShareBitcoinBytesV1 *share = (ShareBitcoinBytesV1 *)payload;
 
-      char ipStr[INET_ADDRSTRLEN];
-      inet_ntop(AF_INET, &(share->ip_), ipStr, INET_ADDRSTRLEN);
+      IpAddress ip;
+      ip.fromIpv4Int(share->ip_);
 
       set_version(CURRENT_VERSION);
       set_workerhashid(share->workerHashId_);
@@ -304,7 +374,7 @@ public:
               ? StratumStatus::ACCEPT
               : StratumStatus::REJECT_NO_REASON);
       set_timestamp(share->timestamp_);
-      set_ip(ipStr);
+      setRawIp(ip);
       set_jobid(share->jobId_);
       set_sharediff(share->shareDiff_);
       set_blkbits(share->blkBits_);
@@ -332,8 +402,15 @@ public:
 public:
   const static uint32_t BYTES_VERSION = 0x00010003u;
   const static uint32_t CURRENT_VERSION = 0x00010004u;
+  const static uint32_t BYTES_V3_VERSION = 0x00010005u;
 };
 
+inline std::string ShareBitcoinBytesV3::toString() const {
+  ShareBitcoin share;
+  share.fromBytes(*this);
+  return share.toString();
+}
+
 class StratumJobBitcoin : public StratumJob {
 public:
   string gbtHash_; // gbt hash id
@@ -412,8 +489,37 @@ public:
       uint32_t extraNonce2Size);
   string serializeToJson() const override;
   bool unserializeFromJson(const char *s, size_t len) override;
+  // version 1: sharebase::StratumJobBitcoinMsg
+  static constexpr uint8_t kBinaryVersion = 1;
+  string serializeToBinary() const override;
+  bool unserializeFromBinary(const char *s, size_t len) override;
   bool isEmptyBlock();
   uint64_t height() const override { return height_; }
+
+private:
+  // The targets derived from the decoded fields
+  void initTargets(bool hasNmcWork, bool hasVcashWork);
+};
+
+//
+// A mining.submit request decoded straight from the raw line, e.g.
+//   {"id": 4, "method": "mining.submit",
+//    "params": ["worker", "1f", "0000000012345678", "5c39a313", "07ba7929"]}
+// An optional 6th param is the version mask. Keys may appear in any order.
+//
+// parse() only accepts this exact shape (no escapes, no extra keys, all
+// params are strings) and returns false on any deviation, the caller should
+// fall back to the generic JSON parser then.
+//
+struct StratumSubmitBitcoin {
+  string idStr_; // same as the idStr produced by StratumSession::handleLine()
+  uint64_t jobId_ = 0;
+  uint64_t extraNonce2_ = 0;
+  uint32_t nTime_ = 0;
+  uint32_t nonce_ = 0;
+  uint32_t versionMask_ = 0;
+
+  bool parse(const char *begin, const char *end);
 };
 
 class ServerBitcoin;
@@ -432,6 +538,7 @@ struct StratumTraitsBitcoin {
     bool operator==(uint8_t shortJobId) const {
       return shortJobId_ == shortJobId;
     }
+    uint8_t key() const { return shortJobId_; }
     uint8_t shortJobId_;
     uint32_t blkBits_;
   };
@@ -71,6 +71,32 @@ void StratumMinerBitcoin::handleExMessage(const std::string &exMessage) {
   }
 }
 
+bool StratumMinerBitcoin::handleRawRequest(
+    const char *begin, const char *end) {
+#ifdef CHAIN_TYPE_ZEC
+  // ZCash's submit has a different shape
+  return false;
+#else
+  StratumSubmitBitcoin submit;
+  if (!submit.parse(begin, end) ||
+      getSession().getState() != StratumSession::AUTHENTICATED) {
+    return false; // let the generic path handle it
+  }
+
+  const uint8_t shortJobId = isNiceHashClient_
+      ? (uint8_t)(submit.jobId_ % getSession().maxNumLocalJobs())
+      : (uint8_t)submit.jobId_;
+  handleRequest_Submit(
+      submit.idStr_,
+      shortJobId,
+      submit.extraNonce2_,
+      submit.nonce_,
+      submit.nTime_,
+      submit.versionMask_);
+  return true;
+#endif
+}
+
 void StratumMinerBitcoin::handleRequest_Submit(
     const string &idStr, const JsonNode &jparams) {
   auto &session = getSession();
@@ -180,6 +206,22 @@ void StratumMinerBitcoin::handleExMessage_SubmitShare(
   const uint32_t versionMask =
       (isWithVersion == false ? 0 : *(uint32_t *)(p + msgSize - 4));
 
+  handleExSubmit(
+      "null", shortJobId, sessionId, exNonce2, nonce, timestamp, versionMask);
+#endif
+}
+
+bool StratumMinerBitcoin::handleExSubmit(
+    const std::string &idStr,
+    uint8_t shortJobId,
+    uint16_t sessionId,
+    uint32_t exNonce2,
+    uint32_t nonce,
+    uint32_t timestamp,
+    uint32_t versionMask) {
+#ifdef CHAIN_TYPE_ZEC
+  return false;
+#else
   const uint64_t fullExtraNonce2 =
       ((uint64_t)sessionId << 32) | (uint64_t)exNonce2;
 
@@ -195,7 +237,8 @@ void StratumMinerBitcoin::handleExMessage_SubmitShare(
       versionMask);
 
   handleRequest_Submit(
-      "null", shortJobId, fullExtraNonce2, nonce, timestamp, versionMask);
+      idStr, shortJobId, fullExtraNonce2, nonce, timestamp, versionMask);
+  return true;
 #endif
 }
 
@@ -215,10 +258,6 @@ void StratumMinerBitcoin::handleRequest_Submit(
     extraNonce2 &= (1ull << server.extraNonce2Size() * 8) - 1;
   }
 
-  const string extraNonce2Hex = Strings::Format(
-      "%0" + std::to_string(server.extraNonce2Size() * 2) + "x", extraNonce2);
-  assert(extraNonce2Hex.size() == server.extraNonce2Size() * 2);
-
   // a function to log rejected stale share
   auto rejectJobNotFound = [&](size_t chainId) {
     handleShare(idStr, StratumStatus::JOB_NOT_FOUND, 0, chainId);
@@ -254,7 +293,7 @@ void StratumMinerBitcoin::handleRequest_Submit(
     return;
   }
 
-  auto sjobBitcoin = std::static_pointer_cast<StratumJobBitcoin>(exjob->sjob_);
+  auto sjobBitcoin = static_cast<StratumJobBitcoin *>(exjob->sjob_.get());
 
   // 0 means miner use stratum job's default block time
   if (nTime == 0) {
@@ -268,38 +307,37 @@ void StratumMinerBitcoin::handleRequest_Submit(
     return;
   }
 
-  ShareBitcoin share;
-  share.set_version(ShareBitcoin::CURRENT_VERSION);
-  share.set_jobid(localJob->jobId_);
-  share.set_workerhashid(workerId_);
-  share.set_userid(worker.userId(localJob->chainId_));
-  share.set_sharediff(iter->second);
-  share.set_blkbits(localJob->blkBits_);
-  share.set_timestamp((uint64_t)time(nullptr));
-  share.set_height(sjobBitcoin->height_);
-  share.set_versionmask(versionMask);
-  share.set_sessionid(session.getSessionId());
-  share.set_status(StratumStatus::REJECT_NO_REASON);
-  // set IP
-  IpAddress ip;
-  ip.fromIpv4Int(session.getClientIp());
-  share.set_ip(ip.toString());
+  // the share is kept in its fixed-layout record until it is sent, the
+  // protobuf message is only built with the protobuf share format
+  ShareBitcoinBytesV3 share;
+  share.version_ = ShareBitcoin::BYTES_V3_VERSION;
+  share.jobId_ = localJob->jobId_;
+  share.workerHashId_ = workerId_;
+  share.userId_ = worker.userId(localJob->chainId_);
+  share.shareDiff_ = iter->second;
+  share.blkBits_ = localJob->blkBits_;
+  share.timestamp_ = (uint64_t)time(nullptr);
+  share.height_ = sjobBitcoin->height_;
+  share.versionMask_ = versionMask;
+  share.sessionId_ = session.getSessionId();
+  share.status_ = StratumStatus::REJECT_NO_REASON;
+  share.ip_.fromIpv4Int(session.getClientIp());
 // set nonce
 #ifdef CHAIN_TYPE_ZEC
   uint32_t nonceHash = djb2(nonce.nonce.ToString().c_str());
-  share.set_nonce(nonceHash);
+  share.nonce_ = nonceHash;
 #else
-  share.set_nonce(nonce);
+  share.nonce_ = nonce;
 #endif
 
   if (server.singleUserMode()) {
-    share.set_extuserid(share.userid());
-    share.set_userid(server.singleUserId(localJob->chainId_));
+    share.extUserId_ = share.userId_;
+    share.userId_ = server.singleUserId(localJob->chainId_);
   }
 
   // calc jobTarget
   uint256 jobTarget;
-  BitcoinDifficulty::DiffToTarget(share.sharediff(), jobTarget);
+  BitcoinDifficulty::DiffToTarget(share.shareDiff_, jobTarget);
 
 #ifdef CHAIN_TYPE_ZEC
   LocalShare localShare(
@@ -312,8 +350,9 @@ void StratumMinerBitcoin::handleRequest_Submit(
 #endif
 
   // can't find local share
-  if (!localJob->addLocalShare(localShare)) {
-    share.set_status(StratumStatus::DUPLICATE_SHARE);
+  const int32_t localShareStatus = localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
+    share.status_ = localShareStatus;
     handleCheckedShare(idStr, localJob->chainId_, share);
   } else {
     // check block header
@@ -321,7 +360,7 @@ void StratumMinerBitcoin::handleRequest_Submit(
         localJob->chainId_,
         share,
         session.getSessionId(),
-        extraNonce2Hex,
+        extraNonce2,
         nTime,
         nonce,
         versionMask,
@@ -331,38 +370,41 @@ void StratumMinerBitcoin::handleRequest_Submit(
          alive = std::weak_ptr<bool>{alive_},
          idStr,
          chainId = localJob->chainId_,
-         ip = session.getClientIp(),
          share,
          &server](int32_t status, uint32_t bitsReached) mutable {
-          share.set_status(status);
-          if (bitsReached > 0) {
-            share.set_bitsreached(bitsReached);
-          }
+          share.status_ = status;
+          share.bitsReached_ = bitsReached;
 
           if (alive.expired() || handleCheckedShare(idStr, chainId, share)) {
             if (server.useShareV1()) {
               ShareBitcoinBytesV1 sharev1;
-              sharev1.jobId_ = share.jobid();
-              sharev1.workerHashId_ = share.workerhashid();
-              sharev1.ip_ = ip;
-              sharev1.userId_ = share.userid();
-              sharev1.shareDiff_ = share.sharediff();
-              sharev1.timestamp_ = share.timestamp();
-              sharev1.blkBits_ = share.blkbits();
-              sharev1.result_ = StratumStatus::isAccepted(share.status())
+              sharev1.jobId_ = share.jobId_;
+              sharev1.workerHashId_ = share.workerHashId_;
+              sharev1.ip_ = share.ip_.toIpv4Int();
+              sharev1.userId_ = share.userId_;
+              sharev1.shareDiff_ = share.shareDiff_;
+              sharev1.timestamp_ = share.timestamp_;
+              sharev1.blkBits_ = share.blkBits_;
+              sharev1.result_ = StratumStatus::isAccepted(share.status_)
                   ? ShareBitcoinBytesV1::ACCEPT
                   : ShareBitcoinBytesV1::REJECT;
 
               server.sendShare2Kafka(
                   chainId, (char *)&sharev1, sizeof(sharev1));
+            } else if (server.useShareBytes()) {
+              share.checkSum_ = share.checkSum();
+              server.sendShare2Kafka(chainId, (char *)&share, sizeof(share));
             } else {
-              std::string message;
-              if (!share.SerializeToStringWithVersion(message)) {
+              ShareBitcoin message;
+              message.fromBytes(share);
+              message.formatIp();
+              std::string data;
+              if (!message.SerializeToStringWithVersion(data)) {
                 LOG(ERROR) << "share SerializeToStringWithVersion failed!"
-                           << share.toString();
+                           << message.toString();
                 return;
               }
-              server.sendShare2Kafka(chainId, message.data(), message.size());
+              server.sendShare2Kafka(chainId, data.data(), data.size());
             }
           }
         });
@@ -370,7 +412,9 @@ void StratumMinerBitcoin::handleRequest_Submit(
 }
 
 bool StratumMinerBitcoin::handleCheckedShare(
-    const std::string &idStr, size_t chainId, const ShareBitcoin &share) {
+    const std::string &idStr,
+    size_t chainId,
+    const ShareBitcoinBytesV3 &share) {
   DLOG(INFO) << share.toString();
 
   // we send share to kafka by default, but if there are lots of invalid
@@ -379,15 +423,15 @@ bool StratumMinerBitcoin::handleCheckedShare(
   auto &session = getSession();
   auto &worker = session.getWorker();
 
-  if (!handleShare(idStr, share.status(), share.sharediff(), chainId)) {
+  if (!handleShare(idStr, share.status_, share.shareDiff_, chainId)) {
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(share.status_);
 
     // log all rejected share to answer "Why the rejection rate of my miner
     // increased?"
-    LOG(INFO) << "rejected share: " << StratumStatus::toString(share.status())
+    LOG(INFO) << "rejected share: " << StratumStatus::toString(share.status_)
               << ", worker: " << worker.fullName_ << ", versionMask: "
-              << Strings::Format("%08x", share.versionmask()) << ", "
+              << Strings::Format("%08x", share.versionMask_) << ", "
               << share.toString();
 
     // check if thers is invalid share spamming
@@ -46,8 +46,19 @@ public:
       const JsonNode &jparams,
       const JsonNode &jroot) override;
   void handleExMessage(const std::string &exMessage) override;
+  bool handleExSubmit(
+      const std::string &idStr,
+      uint8_t shortJobId,
+      uint16_t sessionId,
+      uint32_t exNonce2,
+      uint32_t nonce,
+      uint32_t timestamp,
+      uint32_t versionMask) override;
+  bool handleRawRequest(const char *begin, const char *end) override;
   bool handleCheckedShare(
-      const std::string &idStr, size_t chainId, const ShareBitcoin &share);
+      const std::string &idStr,
+      size_t chainId,
+      const ShareBitcoinBytesV3 &share);
 
 private:
   void handleRequest_Submit(const std::string &idStr, const JsonNode &jparams);
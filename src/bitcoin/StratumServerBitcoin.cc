@@ -27,10 +27,12 @@
 #include "StratumMiner.h"
 #include "StratumMinerBitcoin.h"
 #include "BitcoinUtils.h"
+#include "BlockHeaderHasher.h"
 
 #include "rsk/RskSolvedShareData.h"
 
 #include "arith_uint256.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "primitives/block.h"
 
@@ -117,7 +119,7 @@ void JobRepositoryBitcoin::broadcastStratumJob(
   }
 
   // insert new job
-  exJobs_[sjob->jobId_] = exJob;
+  addStratumJobEx(sjob->jobId_, exJob);
 
   // if job has clean flag, call server to send job
   if (isClean || isMergedMiningClean) {
@@ -149,6 +151,7 @@ StratumJobExBitcoin::StratumJobExBitcoin(
 
 void StratumJobExBitcoin::init(uint32_t extraNonce2Size) {
   auto sjob = std::static_pointer_cast<StratumJobBitcoin>(sjob_);
+  extraNonce2Size_ = extraNonce2Size;
 
 #ifdef CHAIN_TYPE_ZEC
   //
@@ -257,32 +260,78 @@ void StratumJobExBitcoin::init(uint32_t extraNonce2Size) {
       sjob->nBits_,
       sjob->nTime_);
 #endif
+
+  miningNotifyTail_ = miningNotify2_ + coinbase1_ + miningNotify3_;
+  miningNotifyTailClean_ = miningNotify2_ + coinbase1_ + miningNotify3Clean_;
+
+#ifndef CHAIN_TYPE_ZEC
+  // the same coinbase1 as the miners got from mining.notify
+  Hex2Bin(coinbase1_.data(), coinbase1_.size(), coinbase1Bin_);
+  Hex2Bin(sjob->coinbase2_.data(), sjob->coinbase2_.size(), coinbase2Bin_);
+  coinbase1Midstate_.Write(
+      (const unsigned char *)coinbase1Bin_.data(), coinbase1Bin_.size());
+#endif
+}
+
+// extraNonce1 and extraNonce2 are big endian in the coinbase, the same as
+// their hex strings
+static void putExtraNonces(
+    unsigned char *p,
+    uint32_t extraNonce1,
+    uint64_t extraNonce2,
+    size_t extraNonce2Size) {
+  for (size_t i = 0; i < 4; i++) {
+    p[i] = (unsigned char)(extraNonce1 >> (8 * (3 - i)));
+  }
+  for (size_t i = 0; i < extraNonce2Size; i++) {
+    p[4 + i] = (unsigned char)(extraNonce2 >> (8 * (extraNonce2Size - 1 - i)));
+  }
 }
 
 void StratumJobExBitcoin::generateCoinbaseTx(
     std::vector<char> *coinbaseBin,
     const uint32_t extraNonce1,
-    const string &extraNonce2Hex,
-    string *userCoinbaseInfo) {
-  string coinbaseHex;
-  const string extraNonceStr =
-      Strings::Format("%08x%s", extraNonce1, extraNonce2Hex);
+    const uint64_t extraNonce2,
+    string *userCoinbaseInfo) const {
+#ifdef CHAIN_TYPE_ZEC
   auto sjob = std::static_pointer_cast<StratumJobBitcoin>(sjob_);
-  string coinbase1 = sjob->coinbase1_;
-
-  coinbaseHex.append(coinbase1);
-  coinbaseHex.append(extraNonceStr);
-  coinbaseHex.append(sjob->coinbase2_);
+  Hex2Bin(sjob->coinbase1_.c_str(), sjob->coinbase1_.size(), *coinbaseBin);
+#else
+  const size_t extraNoncesSize = 4 + extraNonce2Size_;
+  coinbaseBin->resize(
+      coinbase1Bin_.size() + extraNoncesSize + coinbase2Bin_.size());
+
+  char *p = coinbaseBin->data();
+  memcpy(p, coinbase1Bin_.data(), coinbase1Bin_.size());
+  p += coinbase1Bin_.size();
+  putExtraNonces(
+      (unsigned char *)p, extraNonce1, extraNonce2, extraNonce2Size_);
+  p += extraNoncesSize;
+  memcpy(p, coinbase2Bin_.data(), coinbase2Bin_.size());
+#endif
+}
 
-  // DLOG(INFO) << "coinbase tx: " << coinbaseHex;
-  Hex2Bin((const char *)coinbaseHex.c_str(), *coinbaseBin);
+#ifndef CHAIN_TYPE_ZEC
+uint256 StratumJobExBitcoin::getCoinbaseHash(
+    uint32_t extraNonce1, uint64_t extraNonce2) const {
+  unsigned char extraNonces[4 + 8];
+  putExtraNonces(extraNonces, extraNonce1, extraNonce2, extraNonce2Size_);
+
+  // Hash(coinbase) = SHA256(SHA256(coinbase))
+  uint256 hash;
+  CSHA256 sha(coinbase1Midstate_);
+  sha.Write(extraNonces, 4 + extraNonce2Size_)
+      .Write((const unsigned char *)coinbase2Bin_.data(), coinbase2Bin_.size())
+      .Finalize(hash.begin());
+  CSHA256().Write(hash.begin(), hash.size()).Finalize(hash.begin());
+  return hash;
 }
+#endif
 
 void StratumJobExBitcoin::generateBlockHeader(
     CBlockHeader *header,
-    std::vector<char> *coinbaseBin,
     const uint32_t extraNonce1,
-    const string &extraNonce2Hex,
+    const uint64_t extraNonce2,
     const vector<uint256> &merkleBranch,
     const uint256 &hashPrevBlock,
     const uint32_t nBits,
@@ -290,7 +339,7 @@ void StratumJobExBitcoin::generateBlockHeader(
     const uint32_t nTime,
     const BitcoinNonceType nonce,
     const uint32_t versionMask,
-    string *userCoinbaseInfo) {
+    string *userCoinbaseInfo) const {
 
   header->hashPrevBlock = hashPrevBlock;
   header->nVersion = (nVersion ^ versionMask);
@@ -307,16 +356,12 @@ void StratumJobExBitcoin::generateBlockHeader(
   header->hashMerkleRoot = sjob->merkleRoot_;
   header->hashFinalSaplingRoot = sjob->finalSaplingRoot_;
 
-  Hex2Bin(sjob->coinbase1_.c_str(), sjob->coinbase1_.size(), *coinbaseBin);
-
 #else
   header->nNonce = nonce;
 
   // compute merkle root
-  generateCoinbaseTx(
-      coinbaseBin, extraNonce1, extraNonce2Hex, userCoinbaseInfo);
-  header->hashMerkleRoot =
-      ComputeCoinbaseMerkleRoot(*coinbaseBin, merkleBranch);
+  header->hashMerkleRoot = ComputeCoinbaseMerkleRoot(
+      getCoinbaseHash(extraNonce1, extraNonce2), merkleBranch);
 #endif
 }
 
@@ -334,6 +379,10 @@ ServerBitcoin::~ServerBitcoin() {
 
 bool ServerBitcoin::setupInternal(const libconfig::Config &config) {
   config.lookupValue("sserver.use_share_v1", useShareV1_);
+  if (useShareV1_) {
+    // the legacy consumers of ShareBitcoinBytesV1 cannot unpack batches
+    disableShareLogBatch();
+  }
 
   config.lookupValue("sserver.version_mask", versionMask_);
   config.lookupValue("sserver.extra_nonce2_size", extraNonce2Size_);
@@ -343,6 +392,15 @@ bool ServerBitcoin::setupInternal(const libconfig::Config &config) {
     return false;
   }
 
+#if !defined(CHAIN_TYPE_LTC) && !defined(CHAIN_TYPE_ZEC)
+  uint32_t headerHashBatchSize = headerHashBatchSize_;
+  config.lookupValue("sserver.share_hash_batch_size", headerHashBatchSize);
+  headerHashBatchSize_ = std::max<uint32_t>(headerHashBatchSize, 1);
+  LOG(INFO) << "hash block headers with the "
+            << BlockHeaderHasher::kernelName(BlockHeaderHasher::bestKernel())
+            << " kernel, batch size: " << headerHashBatchSize_;
+#endif
+
   auto addChainVars = [&](const string &kafkaBrokers,
                           const string &auxSolvedShareTopic,
                           const string &rskSolvedShareTopic) {
@@ -463,9 +521,9 @@ void ServerBitcoin::sendSolvedShare2Kafka(
 
 void ServerBitcoin::checkShare(
     size_t chainId,
-    const ShareBitcoin &share,
+    const ShareBitcoinBytesV3 &share,
     uint32_t extraNonce1,
-    const string &extraNonce2Hex,
+    uint64_t extraNonce2,
     const uint32_t nTime,
     const BitcoinNonceType nonce,
     const uint32_t versionMask,
@@ -474,8 +532,8 @@ void ServerBitcoin::checkShare(
     std::function<void(int32_t status, uint32_t bitsReached)> returnFn,
     string *userCoinbaseInfo) {
 
-  auto exJobPtr = std::static_pointer_cast<StratumJobExBitcoin>(
-      GetJobRepository(chainId)->getStratumJobEx(share.jobid()));
+  auto exJobPtr = static_cast<StratumJobExBitcoin *>(
+      GetJobRepository(chainId)->getStratumJobEx(share.jobId_));
   int32_t shareStatus = StratumStatus::UNKNOWN; // init shareStatus
 
   if (exJobPtr == nullptr) {
@@ -487,7 +545,7 @@ void ServerBitcoin::checkShare(
     shareStatus = StratumStatus::STALE_SHARE;
   }
 
-  auto sjob = std::static_pointer_cast<StratumJobBitcoin>(exJobPtr->sjob_);
+  auto sjob = static_cast<StratumJobBitcoin *>(exJobPtr->sjob_.get());
 
   if (StratumStatus::UNKNOWN == shareStatus && nTime < sjob->minTime_) {
     shareStatus = StratumStatus::TIME_TOO_OLD;
@@ -503,12 +561,10 @@ void ServerBitcoin::checkShare(
   }
 
   CBlockHeader header;
-  std::vector<char> coinbaseBin;
   exJobPtr->generateBlockHeader(
       &header,
-      &coinbaseBin,
       extraNonce1,
-      extraNonce2Hex,
+      extraNonce2,
       sjob->merkleBranch_,
       sjob->prevHash_,
       sjob->nBits_,
@@ -518,26 +574,49 @@ void ServerBitcoin::checkShare(
       versionMask,
       userCoinbaseInfo);
 
-  dispatchToShareWorker([this,
+  // Only the fields of the share used by the check are captured, so the
+  // closure is stored inline in the share worker task (see WorkerTask).
+  // workFullName is captured as a non-const string, a const one is copied
+  // when the closure is moved, which may throw. The job is looked up again
+  // by the share worker rather than captured, so no reference count of it is
+  // touched per share.
+  auto checkBlockHash = [this,
                          chainId,
-                         share,
+                         jobId = share.jobId_,
+                         workerHashId = share.workerHashId_,
+                         userId = share.userId_,
                          jobTarget,
                          shareStatus,
-                         workFullName,
+                         workFullName = workFullName,
                          returnFn = std::move(returnFn),
-                         sjob,
-                         header,
-                         coinbaseBin]() {
+                         extraNonce1,
+                         extraNonce2](
+                            const CBlockHeader &header,
+                            const uint256 &blkHash) mutable {
+    auto exJobPtr = static_cast<StratumJobExBitcoin *>(
+        GetJobRepository(chainId)->getStratumJobEx(jobId));
+    if (exJobPtr == nullptr) {
+      // expired while the share was waiting for a share worker
+      dispatch([returnFn = std::move(returnFn)]() {
+        returnFn(StratumStatus::JOB_NOT_FOUND, 0);
+      });
+      return;
+    }
+    auto sjob = static_cast<StratumJobBitcoin *>(exJobPtr->sjob_.get());
     int32_t shareStatusReturn = shareStatus;
-#ifdef CHAIN_TYPE_LTC
-    uint256 blkHash = header.GetPoWHash();
-#else
-    uint256 blkHash = header.GetHash();
-#endif
     arith_uint256 bnBlockHash = UintToArith256(blkHash);
     arith_uint256 bnNetworkTarget = UintToArith256(sjob->networkTarget_);
     uint32_t bitsReached = bnBlockHash.GetCompact();
 
+    // the coinbase tx is only needed by solved shares
+    std::vector<char> coinbaseBin;
+    auto getCoinbaseBin = [&]() -> const std::vector<char> & {
+      if (coinbaseBin.empty()) {
+        exJobPtr->generateCoinbaseTx(&coinbaseBin, extraNonce1, extraNonce2);
+      }
+      return coinbaseBin;
+    };
+
 #ifdef CHAIN_TYPE_ZEC
     DLOG(INFO) << Strings::Format(
         "CBlockHeader nVersion: %08x, hashPrevBlock: %s, hashMerkleRoot: %s, "
@@ -573,10 +652,10 @@ void ServerBitcoin::checkShare(
       // found new block
       //
       FoundBlock foundBlock;
-      foundBlock.jobId_ = share.jobid();
-      foundBlock.workerId_ = share.workerhashid();
+      foundBlock.jobId_ = jobId;
+      foundBlock.workerId_ = workerHashId;
       foundBlock.userId_ =
-          singleUserMode() ? singleUserId(chainId) : share.userid();
+          singleUserMode() ? singleUserId(chainId) : userId;
       foundBlock.height_ = sjob->height_;
       foundBlock.headerData_.set(header);
       snprintf(
@@ -586,12 +665,12 @@ void ServerBitcoin::checkShare(
           workFullName.c_str());
 
       // send
-      sendSolvedShare2Kafka(chainId, &foundBlock, coinbaseBin);
+      sendSolvedShare2Kafka(chainId, &foundBlock, getCoinbaseBin());
 
       if (sjob->proxyJobDifficulty_ > 0) {
         LOG(INFO) << ">>>> solution found: " << blkHash.ToString()
-                  << ", jobId: " << share.jobid()
-                  << ", userId: " << share.userid() << ", by: " << workFullName
+                  << ", jobId: " << jobId
+                  << ", userId: " << userId << ", by: " << workFullName
                   << " <<<<";
       } else {
         dispatch([this, chainId, height = sjob->height_]() {
@@ -600,8 +679,8 @@ void ServerBitcoin::checkShare(
         });
 
         LOG(INFO) << ">>>> found a new block: " << blkHash.ToString()
-                  << ", jobId: " << share.jobid()
-                  << ", userId: " << share.userid() << ", by: " << workFullName
+                  << ", jobId: " << jobId
+                  << ", userId: " << userId << ", by: " << workFullName
                   << " <<<<";
       }
     }
@@ -626,9 +705,9 @@ void ServerBitcoin::checkShare(
       // build data needed to submit block to RSK
       //
       RskSolvedShareData shareData;
-      shareData.jobId_ = share.jobid();
-      shareData.workerId_ = share.workerhashid();
-      shareData.userId_ = share.userid();
+      shareData.jobId_ = jobId;
+      shareData.workerId_ = workerHashId;
+      shareData.userId_ = userId;
       // height = matching bitcoin block height
       shareData.height_ = sjob->height_;
       snprintf(
@@ -656,8 +735,9 @@ void ServerBitcoin::checkShare(
       //
       // send to kafka topic
       //
+      const auto &coinbaseTx = getCoinbaseBin();
       string buf;
-      buf.resize(sizeof(RskSolvedShareData) + coinbaseBin.size());
+      buf.resize(sizeof(RskSolvedShareData) + coinbaseTx.size());
       uint8_t *p = (uint8_t *)buf.data();
 
       // RskSolvedShareData
@@ -665,7 +745,7 @@ void ServerBitcoin::checkShare(
       p += sizeof(RskSolvedShareData);
 
       // coinbase TX
-      memcpy(p, coinbaseBin.data(), coinbaseBin.size());
+      memcpy(p, coinbaseTx.data(), coinbaseTx.size());
 
       sendRskSolvedShare2Kafka(chainId, buf.data(), buf.size());
 
@@ -673,8 +753,8 @@ void ServerBitcoin::checkShare(
       // log the finding
       //
       LOG(INFO) << ">>>> found a new RSK block: " << blkHash.ToString()
-                << ", jobId: " << share.jobid()
-                << ", userId: " << share.userid() << ", by: " << workFullName
+                << ", jobId: " << jobId
+                << ", userId: " << userId << ", by: " << workFullName
                 << " <<<<";
     }
 
@@ -691,10 +771,11 @@ void ServerBitcoin::checkShare(
       Bin2Hex((const uint8_t *)&header, sizeof(CBlockHeader), blockHeaderHex);
       DLOG(INFO) << "blockHeaderHex: " << blockHeaderHex;
 
+      const auto &coinbaseTx = getCoinbaseBin();
       string coinbaseTxHex;
       Bin2Hex(
-          (const uint8_t *)coinbaseBin.data(),
-          coinbaseBin.size(),
+          (const uint8_t *)coinbaseTx.data(),
+          coinbaseTx.size(),
           coinbaseTxHex);
       DLOG(INFO) << "coinbaseTxHex: " << coinbaseTxHex;
 
@@ -707,7 +788,7 @@ void ServerBitcoin::checkShare(
           "\"rpc_addr\":\"%s\","
           "\"rpc_userpass\":\"%s\""
           "}",
-          share.jobid(),
+          jobId,
           sjob->nmcAuxBlockHash_.ToString(),
           blockHeaderHex,
           coinbaseTxHex,
@@ -719,8 +800,8 @@ void ServerBitcoin::checkShare(
 
       LOG(INFO) << ">>>> found namecoin block: " << sjob->nmcHeight_ << ", "
                 << sjob->nmcAuxBlockHash_.ToString()
-                << ", jobId: " << share.jobid()
-                << ", userId: " << share.userid() << ", by: " << workFullName
+                << ", jobId: " << jobId
+                << ", userId: " << userId << ", by: " << workFullName
                 << " <<<<";
     }
 
@@ -744,9 +825,121 @@ void ServerBitcoin::checkShare(
           returnFn(shareStatusReturn, bitsReached);
         });
     return;
-  });
+  };
+
+#if defined(CHAIN_TYPE_LTC) || defined(CHAIN_TYPE_ZEC)
+  auto work = [header, checkBlockHash = std::move(checkBlockHash)]() mutable {
+#ifdef CHAIN_TYPE_LTC
+    checkBlockHash(header, header.GetPoWHash());
+#else
+    checkBlockHash(header, header.GetHash());
+#endif
+  };
+  static_assert(
+      isInlineShareWork<decltype(work)>(),
+      "the share check doesn't fit in WorkerTask");
+  dispatchToShareWorker(std::move(work));
+#else
+  static_assert(
+      HeaderCheck::isInline<decltype(checkBlockHash)>(),
+      "the share check doesn't fit in HeaderCheck");
+  hashBlockHeaderInBatch(header, std::move(checkBlockHash));
+#endif
+}
+
+#if !defined(CHAIN_TYPE_LTC) && !defined(CHAIN_TYPE_ZEC)
+void ServerBitcoin::hashBlockHeaderInBatch(
+    const CBlockHeader &header, HeaderCheck check) {
+  PendingHeader pending;
+  unsigned char *p = pending.header_.data();
+  WriteLE32(p, header.nVersion);
+  memcpy(p + 4, header.hashPrevBlock.begin(), 32);
+  memcpy(p + 36, header.hashMerkleRoot.begin(), 32);
+  WriteLE32(p + 68, header.nTime);
+  WriteLE32(p + 72, header.nBits);
+  WriteLE32(p + 76, header.nNonce);
+  pending.reactor_ = callerReactor();
+  pending.enqueued_ = std::chrono::steady_clock::now();
+  pending.check_ = std::move(check);
+  auto requested = requestTime();
+  if (requested != std::chrono::steady_clock::time_point{}) {
+    observeLatency(LATENCY_PARSE_TO_ENQUEUE, requested, pending.enqueued_);
+  }
+
+  size_t pendingSize;
+  {
+    lock_guard<mutex> lock(pendingHeadersLock_);
+    if (pendingHeaders_.full()) {
+      pendingHeaders_.set_capacity(
+          std::max<size_t>(pendingHeaders_.capacity() * 2, 64));
+    }
+    pendingHeaders_.push_back(std::move(pending));
+    pendingSize = pendingHeaders_.size();
+  }
+
+  // One worker task per batch. Headers queued while the workers are busy
+  // are hashed together, so batches only form under load. The task is not
+  // a ShareWork, hashPendingHeaders() observes the latencies of each share.
+  if (pendingSize % headerHashBatchSize_ == 1 || headerHashBatchSize_ == 1) {
+    dispatchShareTask([this]() { hashPendingHeaders(); });
+  }
 }
 
+void ServerBitcoin::hashPendingHeaders() {
+  vector<PendingHeader> batch;
+  {
+    lock_guard<mutex> lock(pendingHeadersLock_);
+    size_t size = std::min(pendingHeaders_.size(), headerHashBatchSize_);
+    batch.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+      batch.push_back(std::move(pendingHeaders_.front()));
+      pendingHeaders_.pop_front();
+    }
+  }
+  if (batch.empty()) {
+    return;
+  }
+  auto started = std::chrono::steady_clock::now();
+  for (const auto &pending : batch) {
+    observeLatency(LATENCY_WORKER_QUEUE, pending.enqueued_, started);
+  }
+
+  vector<unsigned char> headers(batch.size() * BlockHeaderHasher::kHeaderSize);
+  vector<unsigned char> hashes(batch.size() * BlockHeaderHasher::kHashSize);
+  for (size_t i = 0; i < batch.size(); i++) {
+    memcpy(
+        headers.data() + i * BlockHeaderHasher::kHeaderSize,
+        batch[i].header_.data(),
+        BlockHeaderHasher::kHeaderSize);
+  }
+  BlockHeaderHasher::hash(hashes.data(), headers.data(), batch.size());
+
+  for (size_t i = 0; i < batch.size(); i++) {
+    uint256 blkHash;
+    memcpy(
+        blkHash.begin(),
+        hashes.data() + i * BlockHeaderHasher::kHashSize,
+        BlockHeaderHasher::kHashSize);
+    CBlockHeader header;
+    const unsigned char *p = batch[i].header_.data();
+    header.nVersion = ReadLE32(p);
+    memcpy(header.hashPrevBlock.begin(), p + 4, 32);
+    memcpy(header.hashMerkleRoot.begin(), p + 36, 32);
+    header.nTime = ReadLE32(p + 68);
+    header.nBits = ReadLE32(p + 72);
+    header.nNonce = ReadLE32(p + 76);
+    runOnBehalfOf(
+        batch[i].reactor_, [&]() { batch[i].check_(header, blkHash); });
+  }
+
+  // every share of the batch waited for the whole batch
+  auto completed = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < batch.size(); i++) {
+    observeLatency(LATENCY_VERIFY, started, completed);
+  }
+}
+#endif
+
 void ServerBitcoin::sendAuxSolvedShare2Kafka(
     size_t chainId, const char *data, size_t len) {
   chainsBitcoin_[chainId].kafkaProducerAuxSolvedShare_->produce(data, len);
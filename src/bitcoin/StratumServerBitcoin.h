@@ -28,11 +28,17 @@
 #include "StratumBitcoin.h"
 #include "StratumMiner.h"
 #include <uint256.h>
+#include <crypto/sha256.h>
+
+#include <boost/circular_buffer.hpp>
+
+#include <array>
+#include <mutex>
 
 class CBlockHeader;
 class FoundBlock;
 class JobRepositoryBitcoin;
-class ShareBitcoin;
+struct ShareBitcoinBytesV3;
 class StratumMinerBitcoin;
 class StratumSessionBitcoin;
 
@@ -48,6 +54,24 @@ protected:
   uint32_t extraNonce2Size_ = StratumMiner::kExtraNonce2Size_;
   bool useShareV1_ = false;
 
+#if !defined(CHAIN_TYPE_LTC) && !defined(CHAIN_TYPE_ZEC)
+  // Block headers waiting for the share worker to hash them in a batch.
+  // The PoW of LTC (scrypt) and the headers of ZEC don't fit the batch.
+  // Checks a header with its hash, without allocating for the share closure
+  using HeaderCheck = InlineTask<256, const CBlockHeader &, const uint256 &>;
+  struct PendingHeader {
+    std::array<unsigned char, 80> header_;
+    Reactor *reactor_;
+    // the latencies are observed per share rather than per batch task
+    std::chrono::steady_clock::time_point enqueued_;
+    HeaderCheck check_;
+  };
+  std::mutex pendingHeadersLock_;
+  // grows to the peak of pending headers and never shrinks
+  boost::circular_buffer<PendingHeader> pendingHeaders_;
+  size_t headerHashBatchSize_ = 64;
+#endif
+
 public:
   ServerBitcoin() = default;
   virtual ~ServerBitcoin();
@@ -69,9 +93,9 @@ public:
 
   void checkShare(
       size_t chainId,
-      const ShareBitcoin &share,
+      const ShareBitcoinBytesV3 &share,
       uint32_t extraNonce1,
-      const string &extraNonce2Hex,
+      uint64_t extraNonce2,
       const uint32_t nTime,
       const BitcoinNonceType nonce,
       const uint32_t versionMask,
@@ -92,6 +116,13 @@ protected:
 
   void sendAuxSolvedShare2Kafka(size_t chainId, const char *data, size_t len);
   void sendRskSolvedShare2Kafka(size_t chainId, const char *data, size_t len);
+
+#if !defined(CHAIN_TYPE_LTC) && !defined(CHAIN_TYPE_ZEC)
+  // Queue the header, the check is called with its hash by the share worker,
+  // on behalf of the reactor of the caller
+  void hashBlockHeaderInBatch(const CBlockHeader &header, HeaderCheck check);
+  void hashPendingHeaders();
+#endif
 };
 
 class JobRepositoryBitcoin : public JobRepositoryBase<ServerBitcoin> {
@@ -107,11 +138,17 @@ public:
 };
 
 class StratumJobExBitcoin : public StratumJobEx {
-  void generateCoinbaseTx(
-      std::vector<char> *coinbaseBin,
-      const uint32_t extraNonce1,
-      const string &extraNonce2Hex,
-      string *userCoinbaseInfo = nullptr);
+  uint32_t extraNonce2Size_ = 0;
+#ifndef CHAIN_TYPE_ZEC
+  // Binary coinbase1_ (padded for extraNonce2Size_) and coinbase2, and the
+  // SHA-256 state after coinbase1_, so only the extra nonces and coinbase2
+  // are hashed for a share.
+  std::vector<char> coinbase1Bin_;
+  std::vector<char> coinbase2Bin_;
+  CSHA256 coinbase1Midstate_;
+
+  uint256 getCoinbaseHash(uint32_t extraNonce1, uint64_t extraNonce2) const;
+#endif
 
 public:
   string miningNotify1_;
@@ -119,6 +156,11 @@ public:
   string coinbase1_;
   string miningNotify3_;
   string miningNotify3Clean_;
+  // miningNotify2_ + coinbase1_ + miningNotify3_ (or miningNotify3Clean_),
+  // the part of mining.notify after the job id. It's identical for all
+  // sessions so it's shared by their output buffers without copying.
+  string miningNotifyTail_;
+  string miningNotifyTailClean_;
 
 public:
   StratumJobExBitcoin(
@@ -127,11 +169,17 @@ public:
       bool isClean,
       uint32_t extraNonce2Size);
 
+  // It's only needed for solved shares, the merkle root of a share is
+  // computed from the cached coinbase midstate.
+  void generateCoinbaseTx(
+      std::vector<char> *coinbaseBin,
+      const uint32_t extraNonce1,
+      const uint64_t extraNonce2,
+      string *userCoinbaseInfo = nullptr) const;
   void generateBlockHeader(
       CBlockHeader *header,
-      std::vector<char> *coinbaseBin,
       const uint32_t extraNonce1,
-      const string &extraNonce2Hex,
+      const uint64_t extraNonce2,
       const vector<uint256> &merkleBranch,
       const uint256 &hashPrevBlock,
       const uint32_t nBits,
@@ -139,7 +187,7 @@ public:
       const uint32_t nTime,
       const BitcoinNonceType nonce,
       const uint32_t versionMask,
-      string *userCoinbaseInfo = nullptr);
+      string *userCoinbaseInfo = nullptr) const;
   void init(uint32_t extraNonce2Size);
 };
 
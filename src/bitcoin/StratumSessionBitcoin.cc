@@ -27,6 +27,7 @@
 #include "StratumMessageDispatcher.h"
 #include "StratumMinerBitcoin.h"
 #include "DiffController.h"
+#include "HotRestart.h"
 
 struct StratumMessageExSubmit {
   boost::endian::little_uint8_buf_t magic;
@@ -99,11 +100,8 @@ void StratumSessionBitcoin::sendMiningNotify(
   auto &ljob = addLocalJob(
       exJob->chainId_, sjob->jobId_, allocShortJobId(), sjob->nBits_);
 
-  string notifyStr;
-  notifyStr.reserve(2048);
-
   // notify1
-  notifyStr.append(exJob->miningNotify1_);
+  string notifyStr = exJob->miningNotify1_;
 
   // jobId
   if (isNiceHashClient_) {
@@ -113,26 +111,16 @@ void StratumSessionBitcoin::sendMiningNotify(
     //
     const uint64_t niceHashJobId =
         (uint64_t)time(nullptr) * kMaxNumLocalJobs_ + ljob.shortJobId_;
-    notifyStr.append(Strings::Format("%u", niceHashJobId));
+    notifyStr.append(std::to_string(niceHashJobId));
   } else {
-    notifyStr.append(Strings::Format("%u", ljob.shortJobId_)); // short jobId
+    notifyStr.append(std::to_string(ljob.shortJobId_)); // short jobId
   }
 
-  // notify2
-  notifyStr.append(exJob->miningNotify2_);
-
-  string coinbase1 = exJob->coinbase1_;
-
-  // coinbase1
-  notifyStr.append(coinbase1);
-
-  // notify3
-  if (isFirstJob)
-    notifyStr.append(exJob->miningNotify3Clean_);
-  else
-    notifyStr.append(exJob->miningNotify3_);
-
-  sendData(notifyStr); // send notify string
+  // notify2 + coinbase1 + notify3, shared with other sessions
+  sendDataWithSharedChunk(
+      notifyStr,
+      isFirstJob ? exJob->miningNotifyTailClean_ : exJob->miningNotifyTail_,
+      exJob);
 
   // clear localJobs_
   clearLocalJobs(exJob->isClean_);
@@ -165,10 +153,16 @@ void StratumSessionBitcoin::handleRequest(
 
 void StratumSessionBitcoin::handleRequest_AgentGetCapabilities(
     const string &idStr, const JsonNode &jparams) {
+#ifdef CHAIN_TYPE_ZEC
+  // see StratumMinerBitcoin::handleExSubmit()
+  const char *capabilities = "[\"verrol\"]";
+#else
+  const char *capabilities = BTCAGENT_PROTOCOL_CAPABILITIES;
+#endif
   string s = Strings::Format(
-      "{\"id\":%s,\"result\":{\"capabilities\":" BTCAGENT_PROTOCOL_CAPABILITIES
-      "}}\n",
-      idStr);
+      "{\"id\":%s,\"result\":{\"capabilities\":%s}}\n",
+      idStr,
+      capabilities);
   sendData(s);
 }
 
@@ -497,3 +491,21 @@ void StratumSessionBitcoin::responseError(const string &idStr, int errCode) {
   }
   rpc1ResponseError(idStr, errCode);
 }
+
+bool StratumSessionBitcoin::saveState(SessionState &state) const {
+  if (!saveCommonState(state)) {
+    return false;
+  }
+  state.extra_["version_mask"] = versionMask_;
+  state.extra_["suggested_min_diff"] = suggestedMinDiff_;
+  state.extra_["suggested_diff"] = suggestedDiff_;
+  return true;
+}
+
+bool StratumSessionBitcoin::restoreState(const SessionState &state) {
+  // createMiner() uses them
+  versionMask_ = state.extra("version_mask");
+  suggestedMinDiff_ = state.extra("suggested_min_diff");
+  suggestedDiff_ = state.extra("suggested_diff");
+  return restoreCommonState(state);
+}
@@ -71,6 +71,9 @@ public:
 
   void responseError(const string &idStr, int errCode) override;
 
+  bool saveState(SessionState &state) const override;
+  bool restoreState(const SessionState &state) override;
+
 private:
   uint8_t allocShortJobId();
 
@@ -156,7 +156,7 @@ PoolWatchClient *ClientContainerBitcoin::createPoolWatchClient(
 
 void ClientContainerBitcoin::handleNewStratumJob(const string &str) {
   shared_ptr<StratumJobBitcoin> sjob = std::make_shared<StratumJobBitcoin>();
-  bool res = sjob->unserializeFromJson((const char *)str.data(), str.size());
+  bool res = sjob->unserialize((const char *)str.data(), str.size());
   if (res == false) {
     LOG(ERROR) << "unserialize stratum job fail";
     return;
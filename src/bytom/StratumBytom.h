@@ -131,7 +131,7 @@ public:
         "blkBits: %08x/%d, nonce: %08x, shareDiff: %u, "
         "status: %d/%s)",
         jobid(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -179,7 +179,7 @@ public:
       set_timestamp(share->timestamp_);
       set_sharediff(share->shareDiff_);
       set_blkbits(share->blkBits_);
-      set_ip(share->ip_.toString());
+      setRawIp(share->ip_);
       set_combinedheader(
           &(share->combinedHeader_), sizeof(BytomCombinedHeader));
       set_userid(share->userId_);
@@ -237,6 +237,7 @@ struct StratumTraitsBytom {
     bool operator==(uint8_t shortJobId) const {
       return shortJobId_ == shortJobId;
     }
+    uint8_t key() const { return shortJobId_; }
     uint8_t shortJobId_;
     uint64_t jobDifficulty_;
   };
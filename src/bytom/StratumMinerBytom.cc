@@ -138,7 +138,7 @@ void StratumMinerBytom::handleRequest_Submit(
     return;
   }
 
-  shared_ptr<StratumJobEx> exjob;
+  StratumJobEx *exjob;
   exjob = server.GetJobRepository(localJob->chainId_)
               ->getStratumJobEx(localJob->jobId_);
   if (nullptr == exjob || nullptr == exjob->sjob_) {
@@ -147,7 +147,7 @@ void StratumMinerBytom::handleRequest_Submit(
     return;
   }
 
-  auto sJob = std::static_pointer_cast<StratumJobBytom>(exjob->sjob_);
+  auto sJob = static_cast<StratumJobBytom *>(exjob->sjob_.get());
   if (nullptr == sJob) {
     session.rpc2ResponseBoolean(idStr, false, "Unknown reason");
     LOG(FATAL) << "Code error, casting stratum job bytom failed for job id="
@@ -170,10 +170,13 @@ void StratumMinerBytom::handleRequest_Submit(
 
   //  Check share duplication
   LocalShare localShare(nonce, 0, 0);
-  if (!server.isEnableSimulator_ && !localJob->addLocalShare(localShare)) {
-    session.responseError(idStr, StratumStatus::DUPLICATE_SHARE);
+  const int32_t localShareStatus = server.isEnableSimulator_
+      ? StratumStatus::ACCEPT
+      : localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
+    session.responseError(idStr, localShareStatus);
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(localShareStatus);
     return;
   }
 
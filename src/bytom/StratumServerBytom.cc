@@ -56,7 +56,7 @@ void JobRepositoryBytom::broadcastStratumJob(shared_ptr<StratumJob> sjobBase) {
   }
 
   // insert new job
-  exJobs_[sjob->jobId_] = exJob;
+  addStratumJobEx(sjob->jobId_, exJob);
 
   if (isClean) {
     sendMiningNotify(exJob);
@@ -86,15 +86,15 @@ void StratumMinerCkb::handleRequest_Submit(
   auto &worker = session.getWorker();
   uint32_t sessionId = session.getSessionId();
 
-  shared_ptr<StratumJobEx> exjob = server.GetJobRepository(localJob->chainId_)
-                                       ->getStratumJobEx(localJob->jobId_);
+  StratumJobEx *exjob = server.GetJobRepository(localJob->chainId_)
+                              ->getStratumJobEx(localJob->jobId_);
   // can't find stratum job
-  if (exjob.get() == nullptr) {
+  if (exjob == nullptr) {
     DLOG(WARNING) << "can't find stratum job";
     handleShare(idStr, StratumStatus::JOB_NOT_FOUND, 0, localJob->chainId_);
     return;
   }
-  auto sjob = std::static_pointer_cast<StratumJobCkb>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobCkb *>(exjob->sjob_.get());
 
   auto iter = jobDiffs_.find(localJob);
   if (iter == jobDiffs_.end()) {
@@ -145,14 +145,15 @@ void StratumMinerCkb::handleRequest_Submit(
 
   LocalShare localShare(extraNonce2, sessionId, JobId);
   // can't add local share
-  if (!localJob->addLocalShare(localShare)) {
+  const int32_t localShareStatus = localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
     handleShare(
         idStr,
-        StratumStatus::DUPLICATE_SHARE,
+        localShareStatus,
         jobDiff.currentJobDiff_,
         localJob->chainId_);
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(localShareStatus);
     return;
   }
   DLOG(INFO) << " share received : " << share.toString();
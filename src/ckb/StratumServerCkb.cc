@@ -36,11 +36,11 @@ unique_ptr<StratumSession> StratumServerCkb::createConnection(
 void StratumServerCkb::checkAndUpdateShare(
     size_t chainId,
     ShareCkb &share,
-    shared_ptr<StratumJobEx> exjob,
+    StratumJobEx *exjob,
     const std::set<uint64_t> &jobDiffs,
     const string &workFullName,
     uint256 &blockHash) {
-  auto sjob = std::static_pointer_cast<StratumJobCkb>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobCkb *>(exjob->sjob_.get());
 
   DLOG(INFO) << "checking share nonce: " << std::hex << share.nonce()
              << ", pow_hash: " << sjob->pow_hash_;
@@ -103,10 +103,10 @@ void StratumServerCkb::checkAndUpdateShare(
 void StratumServerCkb::sendSolvedShare2Kafka(
     size_t chainId,
     const ShareCkb &share,
-    shared_ptr<StratumJobEx> exjob,
+    StratumJobEx *exjob,
     const StratumWorker &worker,
     const uint256 &blockHash) {
-  auto sjob = std::static_pointer_cast<StratumJobCkb>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobCkb *>(exjob->sjob_.get());
 
   const BaseConverter &hex2dec = BaseConverter::HexToDecimalConverter();
   vector<char> bin;
@@ -217,7 +217,7 @@ void JobRepositoryCkb::broadcastStratumJob(shared_ptr<StratumJob> sjob) {
     }
 
     // insert new job
-    exJobs_[sjobckb->jobId_] = exJob;
+    addStratumJobEx(sjobckb->jobId_, exJob);
   }
 
   // sending data in lock scope may cause implicit race condition in libevent
@@ -41,7 +41,7 @@ public:
   void checkAndUpdateShare(
       size_t chainId,
       ShareCkb &share,
-      shared_ptr<StratumJobEx> exjob,
+      StratumJobEx *exjob,
       const std::set<uint64_t> &jobDiffs,
       const string &workFullName,
       uint256 &blockHash);
@@ -49,7 +49,7 @@ public:
   void sendSolvedShare2Kafka(
       size_t chainId,
       const ShareCkb &share,
-      shared_ptr<StratumJobEx> exjob,
+      StratumJobEx *exjob,
       const StratumWorker &worker,
       const uint256 &blockHash);
 
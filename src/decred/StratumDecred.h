@@ -97,6 +97,38 @@ public:
   }
 };
 
+// Fixed-layout share record, sent instead of the protobuf message with
+// sserver.use_share_bytes. sserver fills it while checking the share.
+// extUserId_ and bitsReached_ are 0 when not set.
+class ShareDecredBytesV2 {
+public:
+  uint32_t version_ = 0; // 0
+  uint32_t checkSum_ = 0; // 4
+
+  int64_t workerHashId_ = 0; // 8
+  int32_t userId_ = 0; // 16
+  int32_t status_ = 0; // 20
+  int64_t timestamp_ = 0; // 24
+  IpAddress ip_ = 0; // 32
+
+  uint64_t jobId_ = 0; // 48
+  uint64_t shareDiff_ = 0; // 56
+  uint32_t blkBits_ = 0; // 64
+  uint32_t height_ = 0; // 68
+  uint32_t nonce_ = 0; // 72
+  uint32_t sessionId_ = 0; // 76
+  uint32_t network_ = (uint32_t)NetworkDecred::MainNet; // 80
+  uint32_t voters_ = 0; // 84
+  int32_t extUserId_ = 0; // 88
+  uint32_t bitsReached_ = 0; // 92
+
+  uint32_t checkSum() const { return sharebase::BytesCheckSum(*this); }
+  string toString() const;
+};
+
+static_assert(
+    sizeof(ShareDecredBytesV2) == 96, "ShareDecredBytesV2 should be 96 bytes");
+
 // [[[[ IMPORTANT REMINDER! ]]]]
 // Please keep the Share structure forward compatible.
 // That is: don't change it unless you add code so that
@@ -112,6 +144,8 @@ public:
                    // is bytes array
   const static uint32_t CURRENT_VERSION =
       0x00200002u; // first 0020: DCR, second 0002: version 2
+  const static uint32_t BYTES_V2_VERSION =
+      0x00200003u; // first 0020: DCR, second 0003: version 3
 
   ShareDecred() {
     set_version(ShareDecred::CURRENT_VERSION);
@@ -132,7 +166,6 @@ public:
   ShareDecred(
       int64_t workerHashId,
       int32_t userId,
-      uint32_t clientIpInt,
       uint64_t jobId,
       uint64_t jobDifficulty,
       uint32_t blkBits,
@@ -152,9 +185,6 @@ public:
     set_sessionid(extraNonce1);
     set_network((uint32_t)NetworkDecred::MainNet);
     set_voters(0);
-    IpAddress ip;
-    ip.fromIpv4Int(clientIpInt);
-    set_ip(ip.toString());
   }
 
   double score() const {
@@ -201,7 +231,7 @@ public:
         "blkBits: %08x/%f, shareDiff: %u, "
         "voters: %u, status: %d/%s)",
         jobid(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -215,6 +245,30 @@ public:
         StratumStatus::toString(status()));
   }
 
+  // The IP is kept raw, see getIp()
+  void fromBytes(const ShareDecredBytesV2 &share) {
+    set_version(CURRENT_VERSION);
+    set_workerhashid(share.workerHashId_);
+    set_userid(share.userId_);
+    set_status(share.status_);
+    set_timestamp(share.timestamp_);
+    setRawIp(share.ip_);
+    set_jobid(share.jobId_);
+    set_sharediff(share.shareDiff_);
+    set_blkbits(share.blkBits_);
+    set_height(share.height_);
+    set_nonce(share.nonce_);
+    set_sessionid(share.sessionId_);
+    set_network(share.network_);
+    set_voters(share.voters_);
+    if (share.extUserId_ != 0) {
+      set_extuserid(share.extUserId_);
+    }
+    if (share.bitsReached_ != 0) {
+      set_bitsreached(share.bitsReached_);
+    }
+  }
+
   bool UnserializeWithVersion(const uint8_t *data, uint32_t size) {
 
     if (nullptr == data || size <= 0) {
@@ -248,7 +302,7 @@ public:
       set_userid(share->userId_);
       set_status(share->status_);
       set_timestamp(share->timestamp_);
-      set_ip(share->ip_.toString());
+      setRawIp(share->ip_);
       set_jobid(share->jobId_);
       set_sharediff(share->shareDiff_);
       set_blkbits(share->blkBits_);
@@ -258,6 +312,19 @@ public:
       set_network((uint32_t)share->network_);
       set_voters(share->voters_);
 
+    } else if (
+        version == BYTES_V2_VERSION && size == sizeof(ShareDecredBytesV2)) {
+
+      auto share = (const ShareDecredBytesV2 *)payload;
+
+      if (share->checkSum() != share->checkSum_) {
+        DLOG(INFO) << "checkSum mismatched! checkSum_: " << share->checkSum_
+                   << ", checkSum(): " << share->checkSum();
+        return false;
+      }
+
+      fromBytes(*share);
+
     } else {
 
       DLOG(INFO) << "unknow share received! data size: " << size;
@@ -268,6 +335,12 @@ public:
   }
 };
 
+inline string ShareDecredBytesV2::toString() const {
+  ShareDecred share;
+  share.fromBytes(*this);
+  return share.toString();
+}
+
 class StratumJobDecred : public StratumJob {
 public:
   static const size_t CoinBase1Size = offsetof(BlockHeaderDecred, extraData) -
@@ -311,6 +384,7 @@ struct StratumTraitsDecred {
     bool operator==(uint8_t shortJobId) const {
       return shortJobId_ == shortJobId;
     }
+    uint8_t key() const { return shortJobId_; }
     uint8_t shortJobId_;
     uint32_t blkBits_;
   };
@@ -129,7 +129,7 @@ void StratumMinerDecred::handleRequest_Submit(
     return;
   }
 
-  auto sjob = std::static_pointer_cast<StratumJobDecred>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobDecred *>(exjob->sjob_.get());
 
   // 0 means miner use stratum job's default block time
   if (ntime == 0) {
@@ -143,16 +143,21 @@ void StratumMinerDecred::handleRequest_Submit(
     return;
   }
 
-  ShareDecred share(
-      workerId_,
-      worker.userId(localJob->chainId_),
-      session.getClientIp(),
-      localJob->jobId_,
-      iter->second,
-      localJob->blkBits_,
-      sjob->header_.height.value(),
-      nonce,
-      session.getSessionId());
+  // the share is kept in its fixed-layout record until it is sent, the
+  // protobuf message is only built with the protobuf share format
+  ShareDecredBytesV2 share;
+  share.version_ = ShareDecred::BYTES_V2_VERSION;
+  share.workerHashId_ = workerId_;
+  share.userId_ = worker.userId(localJob->chainId_);
+  share.status_ = StratumStatus::REJECT_NO_REASON;
+  share.timestamp_ = time(nullptr);
+  share.jobId_ = localJob->jobId_;
+  share.shareDiff_ = iter->second;
+  share.blkBits_ = localJob->blkBits_;
+  share.height_ = sjob->header_.height.value();
+  share.nonce_ = nonce;
+  share.sessionId_ = session.getSessionId();
+  share.ip_.fromIpv4Int(session.getClientIp());
 
   // we send share to kafka by default, but if there are lots of invalid
   // shares in a short time, we just drop them.
@@ -165,25 +170,26 @@ void StratumMinerDecred::handleRequest_Submit(
       ntime);
 
   // can't find local share
-  if (!localJob->addLocalShare(localShare)) {
-    share.set_status(StratumStatus::DUPLICATE_SHARE);
+  const int32_t localShareStatus = localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
+    share.status_ = localShareStatus;
   } else {
     server.checkAndUpdateShare(
         share, exjob, extraNonce2, ntime, nonce, worker.fullName_);
   }
 
   if (!handleShare(
-          idStr, share.status(), share.sharediff(), localJob->chainId_)) {
+          idStr, share.status_, share.shareDiff_, localJob->chainId_)) {
     // add invalid share to counter
-    invalidSharesCounter_.insert(static_cast<int64_t>(time(nullptr)), 1);
+    countInvalidShare(share.status_);
   }
 
   DLOG(INFO) << share.toString();
 
-  if (!StratumStatus::isAccepted(share.status())) {
+  if (!StratumStatus::isAccepted(share.status_)) {
     // log all rejected share to answer "Why the rejection rate of my miner
     // increased?"
-    LOG(INFO) << "rejected share: " << StratumStatus::toString(share.status())
+    LOG(INFO) << "rejected share: " << StratumStatus::toString(share.status_)
               << ", worker: " << worker.fullName_ << ", " << share.toString();
 
     // check if thers is invalid share spamming
@@ -199,14 +205,23 @@ void StratumMinerDecred::handleRequest_Submit(
 
   if (isSendShareToKafka) {
 
-    std::string message;
-    if (!share.SerializeToStringWithVersion(message)) {
+    if (server.useShareBytes()) {
+      share.checkSum_ = share.checkSum();
+      server.sendShare2Kafka(localJob->chainId_, (char *)&share, sizeof(share));
+      return;
+    }
+
+    ShareDecred message;
+    message.fromBytes(share);
+    message.formatIp();
+    std::string data;
+    if (!message.SerializeToStringWithVersion(data)) {
       LOG(ERROR) << "share SerializeToStringWithVersion failed!"
-                 << share.toString();
+                 << message.toString();
       return;
     }
 
-    server.sendShare2Kafka(localJob->chainId_, message.data(), message.size());
+    server.sendShare2Kafka(localJob->chainId_, data.data(), data.size());
   }
   return;
 }
@@ -102,7 +102,7 @@ void JobRepositoryDecred::broadcastStratumJob(shared_ptr<StratumJob> sjob) {
   }
 
   // insert new job
-  exJobs_[jobDecred->jobId_] = jobEx;
+  addStratumJobEx(jobDecred->jobId_, jobEx);
 
   // We want to update jobs immediately if there are more voters for the same
   // height block
@@ -202,46 +202,46 @@ JobRepository *ServerDecred::createJobRepository(
 }
 
 void ServerDecred::checkAndUpdateShare(
-    ShareDecred &share,
-    shared_ptr<StratumJobEx> exJobPtr,
+    ShareDecredBytesV2 &share,
+    StratumJobEx *exJobPtr,
     const vector<uint8_t> &extraNonce2,
     uint32_t ntime,
     uint32_t nonce,
     const string &workerFullName) {
   if (!exJobPtr) {
-    share.set_status(StratumStatus::JOB_NOT_FOUND);
+    share.status_ = StratumStatus::JOB_NOT_FOUND;
     return;
   }
   if (exJobPtr->isStale()) {
-    share.set_status(StratumStatus::STALE_SHARE);
+    share.status_ = StratumStatus::STALE_SHARE;
     return;
   }
 
-  auto sjob = std::static_pointer_cast<StratumJobDecred>(exJobPtr->sjob_);
-  share.set_network((uint32_t)sjob->network_);
-  share.set_voters(sjob->header_.voters.value());
+  auto sjob = static_cast<StratumJobDecred *>(exJobPtr->sjob_.get());
+  share.network_ = (uint32_t)sjob->network_;
+  share.voters_ = sjob->header_.voters.value();
   if (ntime > sjob->header_.timestamp.value() + 600) {
-    share.set_status(StratumStatus::TIME_TOO_NEW);
+    share.status_ = StratumStatus::TIME_TOO_NEW;
     return;
   }
 
   FoundBlockDecred foundBlock(
-      share.jobid(),
-      share.workerhashid(),
-      share.userid(),
+      share.jobId_,
+      share.workerHashId_,
+      share.userId_,
       workerFullName,
       sjob->header_,
       sjob->network_);
   auto &header = foundBlock.header_;
   header.timestamp = ntime;
   header.nonce = nonce;
-  protocol_->setExtraNonces(header, share.sessionid(), extraNonce2);
+  protocol_->setExtraNonces(header, share.sessionId_, extraNonce2);
 
   uint256 blkHash = header.getHash();
   auto bnBlockHash = UintToArith256(blkHash);
   auto bnNetworkTarget = UintToArith256(sjob->target_);
 
-  share.set_bitsreached(bnBlockHash.GetCompact());
+  share.bitsReached_ = bnBlockHash.GetCompact();
 
   //
   // found new block
@@ -255,7 +255,7 @@ void ServerDecred::checkAndUpdateShare(
     GetJobRepository(exJobPtr->chainId_)->markAllJobsAsStale(sjob->height());
 
     LOG(INFO) << ">>>> found a new block: " << blkHash.ToString()
-              << ", jobId: " << share.jobid() << ", userId: " << share.userid()
+              << ", jobId: " << share.jobId_ << ", userId: " << share.userId_
               << ", by: " << workerFullName << " <<<<";
   }
 
@@ -268,17 +268,17 @@ void ServerDecred::checkAndUpdateShare(
 
   // check share diff
   auto jobTarget =
-      NetworkParamsDecred::get(sjob->network_).powLimit / share.sharediff();
+      NetworkParamsDecred::get(sjob->network_).powLimit / share.shareDiff_;
 
   DLOG(INFO) << "blkHash: " << blkHash.ToString()
              << ", jobTarget: " << jobTarget.ToString()
              << ", networkTarget: " << sjob->target_.ToString();
 
   if (isEnableSimulator_ == false && bnBlockHash > jobTarget) {
-    share.set_status(StratumStatus::LOW_DIFFICULTY);
+    share.status_ = StratumStatus::LOW_DIFFICULTY;
     return;
   }
 
   // reach here means an valid share
-  share.set_status(StratumStatus::ACCEPT);
+  share.status_ = StratumStatus::ACCEPT;
 }
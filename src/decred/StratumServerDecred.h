@@ -57,8 +57,8 @@ public:
       bufferevent *bev, sockaddr *saddr, uint32_t sessionID) override;
 
   void checkAndUpdateShare(
-      ShareDecred &share,
-      shared_ptr<StratumJobEx> exJobPtr,
+      ShareDecredBytesV2 &share,
+      StratumJobEx *exJobPtr,
       const vector<uint8_t> &extraNonce2,
       uint32_t ntime,
       uint32_t nonce,
@@ -83,6 +83,36 @@ public:
   }
 };
 
+// Fixed-layout share record, sent instead of the protobuf message with
+// sserver.use_share_bytes. sserver fills it while checking the share.
+// extUserId_ and bitsReached_ are 0 when not set.
+class ShareEthBytesV2 {
+public:
+  uint32_t version_ = 0; // 0
+  uint32_t checkSum_ = 0; // 4
+
+  int64_t workerHashId_ = 0; // 8
+  int32_t userId_ = 0; // 16
+  int32_t status_ = 0; // 20
+  int64_t timestamp_ = 0; // 24
+  IpAddress ip_ = 0; // 32
+
+  uint64_t headerHash_ = 0; // 48
+  uint64_t shareDiff_ = 0; // 56
+  uint64_t networkDiff_ = 0; // 64
+  uint64_t nonce_ = 0; // 72
+  uint32_t sessionId_ = 0; // 80
+  uint32_t height_ = 0; // 84
+  int32_t extUserId_ = 0; // 88
+  uint32_t bitsReached_ = 0; // 92
+
+  uint32_t checkSum() const { return sharebase::BytesCheckSum(*this); }
+  string toString() const;
+};
+
+static_assert(
+    sizeof(ShareEthBytesV2) == 96, "ShareEthBytesV2 should be 96 bytes");
+
 class ShareEth : public sharebase::Serializable<sharebase::EthMsg> {
 public:
   const static uint32_t CURRENT_VERSION_FOUNDATION =
@@ -93,6 +123,8 @@ public:
       0x00110002u; // first 0011: ETH, second 0002: version 3
   const static uint32_t BYTES_VERSION_CLASSIC =
       0x00160002u; // first 0016: ETC, second 0002: version 3
+  const static uint32_t BYTES_V2_VERSION_FOUNDATION = 0x00110004u;
+  const static uint32_t BYTES_V2_VERSION_CLASSIC = 0x00160004u;
 
   ShareEth() {
     set_version(0);
@@ -115,9 +147,11 @@ public:
     switch (version) {
     case CURRENT_VERSION_FOUNDATION:
     case BYTES_VERSION_FOUNDATION:
+    case BYTES_V2_VERSION_FOUNDATION:
       return EthConsensus::Chain::FOUNDATION;
     case CURRENT_VERSION_CLASSIC:
     case BYTES_VERSION_CLASSIC:
+    case BYTES_V2_VERSION_CLASSIC:
       return EthConsensus::Chain::CLASSIC;
     default:
       return EthConsensus::Chain::UNKNOWN;
@@ -191,7 +225,7 @@ public:
         "sessionId: %08x, status: %d/%s)",
         height(),
         headerhash(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -204,6 +238,33 @@ public:
         StratumStatus::toString(status()));
   }
 
+  inline static uint32_t getBytesVersion(EthConsensus::Chain chain) {
+    return chain == EthConsensus::Chain::CLASSIC ? BYTES_V2_VERSION_CLASSIC
+                                                 : BYTES_V2_VERSION_FOUNDATION;
+  }
+
+  // The IP is kept raw, see getIp()
+  void fromBytes(const ShareEthBytesV2 &share) {
+    set_version(getVersion(getChain(share.version_)));
+    set_workerhashid(share.workerHashId_);
+    set_userid(share.userId_);
+    set_status(share.status_);
+    set_timestamp(share.timestamp_);
+    setRawIp(share.ip_);
+    set_headerhash(share.headerHash_);
+    set_sharediff(share.shareDiff_);
+    set_networkdiff(share.networkDiff_);
+    set_nonce(share.nonce_);
+    set_sessionid(share.sessionId_);
+    set_height(share.height_);
+    if (share.extUserId_ != 0) {
+      set_extuserid(share.extUserId_);
+    }
+    if (share.bitsReached_ != 0) {
+      set_bitsreached(share.bitsReached_);
+    }
+  }
+
   bool UnserializeWithVersion(const uint8_t *data, uint32_t size) {
 
     if (nullptr == data || size <= 0) {
@@ -240,7 +301,7 @@ public:
       set_userid(share->userId_);
       set_status(share->status_);
       set_timestamp(share->timestamp_);
-      set_ip(share->ip_.toString());
+      setRawIp(share->ip_);
       set_headerhash(share->headerHash_);
       set_sharediff(share->shareDiff_);
       set_networkdiff(share->networkDiff_);
@@ -248,6 +309,21 @@ public:
       set_sessionid(share->sessionId_);
       set_height(share->height_);
 
+    } else if (
+        (version == BYTES_V2_VERSION_FOUNDATION ||
+         version == BYTES_V2_VERSION_CLASSIC) &&
+        size == sizeof(ShareEthBytesV2)) {
+
+      auto share = (const ShareEthBytesV2 *)payload;
+
+      if (share->checkSum() != share->checkSum_) {
+        DLOG(INFO) << "checkSum mismatched! checkSum_: " << share->checkSum_
+                   << ", checkSum(): " << share->checkSum();
+        return false;
+      }
+
+      fromBytes(*share);
+
     } else {
 
       DLOG(INFO) << "unknow share received! data size: " << size;
@@ -258,6 +334,12 @@ public:
   }
 };
 
+inline string ShareEthBytesV2::toString() const {
+  ShareEth share;
+  share.fromBytes(*this);
+  return share.toString();
+}
+
 class StratumJobEth : public StratumJob {
 public:
   StratumJobEth();
@@ -318,6 +400,7 @@ struct StratumTraitsEth {
     bool operator==(const std::string &headerHash) const {
       return headerHash_ == headerHash;
     }
+    const std::string &key() const { return headerHash_; }
 
     std::string headerHash_;
   };
@@ -164,13 +164,13 @@ void StratumMinerEth::handleRequest_Submit(
   auto &worker = session.getWorker();
   auto extraNonce1 = session.getSessionId();
 
-  shared_ptr<StratumJobEx> exjob = server.GetJobRepository(localJob->chainId_)
-                                       ->getStratumJobEx(localJob->jobId_);
-  if (exjob.get() == nullptr) {
+  StratumJobEx *exjob = server.GetJobRepository(localJob->chainId_)
+                              ->getStratumJobEx(localJob->jobId_);
+  if (exjob == nullptr) {
     handleShare(idStr, StratumStatus::JOB_NOT_FOUND, 0, localJob->chainId_);
     return;
   }
-  auto sjob = std::static_pointer_cast<StratumJobEth>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobEth *>(exjob->sjob_.get());
 
   if (StratumProtocolEth::NICEHASH_STRATUM == ethProtocol_) {
     if (sNonce.size() != 16) {
@@ -208,32 +208,33 @@ void StratumMinerEth::handleRequest_Submit(
   }
   auto &jobDiff = iter->second;
 
-  ShareEth share;
-  share.set_version(ShareEth::getVersion(chain));
-  share.set_headerhash(headerPrefix);
-  share.set_workerhashid(workerId_);
-  share.set_userid(worker.userId(localJob->chainId_));
-  share.set_sharediff(jobDiff.currentJobDiff_);
-  share.set_networkdiff(networkDiff);
-  share.set_timestamp((uint64_t)time(nullptr));
-  share.set_status(StratumStatus::REJECT_NO_REASON);
-  share.set_height(height);
-  share.set_nonce(nonce);
-  share.set_sessionid(extraNonce1);
-  IpAddress ip;
-  ip.fromIpv4Int(session.getClientIp());
-  share.set_ip(ip.toString());
+  // the share is kept in its fixed-layout record until it is sent, the
+  // protobuf message is only built with the protobuf share format
+  ShareEthBytesV2 share;
+  share.version_ = ShareEth::getBytesVersion(chain);
+  share.headerHash_ = headerPrefix;
+  share.workerHashId_ = workerId_;
+  share.userId_ = worker.userId(localJob->chainId_);
+  share.shareDiff_ = jobDiff.currentJobDiff_;
+  share.networkDiff_ = networkDiff;
+  share.timestamp_ = (uint64_t)time(nullptr);
+  share.status_ = StratumStatus::REJECT_NO_REASON;
+  share.height_ = height;
+  share.nonce_ = nonce;
+  share.sessionId_ = extraNonce1;
+  share.ip_.fromIpv4Int(session.getClientIp());
 
   LocalShare localShare(nonce, 0, 0);
   // can't add local share
-  if (!localJob->addLocalShare(localShare)) {
+  const int32_t localShareStatus = localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
     handleShare(
         idStr,
-        StratumStatus::DUPLICATE_SHARE,
+        localShareStatus,
         jobDiff.currentJobDiff_,
         localJob->chainId_);
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(localShareStatus);
     return;
   }
 
@@ -296,33 +297,41 @@ void StratumMinerEth::handleRequest_Submit(
        &server](int32_t status, uint64_t diff, uint32_t bitsReached) mutable {
         if (StratumStatus::SOLVED == status) {
           // stale shares shall not trigger the following cleanup
-          server.GetJobRepository(chainId)->markAllJobsAsStale(share.height());
+          server.GetJobRepository(chainId)->markAllJobsAsStale(share.height_);
         }
-        share.set_status(status);
+        share.status_ = status;
         if (diff > 0) {
-          share.set_sharediff(diff);
-        }
-        if (bitsReached > 0) {
-          share.set_bitsreached(bitsReached);
+          share.shareDiff_ = diff;
         }
+        share.bitsReached_ = bitsReached;
         if (alive.expired() || handleCheckedShare(idStr, chainId, share)) {
-          std::string message;
-          if (!share.SerializeToStringWithVersion(message)) {
+          if (server.useShareBytes()) {
+            share.checkSum_ = share.checkSum();
+            server.sendShare2Kafka(chainId, (char *)&share, sizeof(share));
+            return;
+          }
+          ShareEth message;
+          message.fromBytes(share);
+          message.formatIp();
+          std::string data;
+          if (!message.SerializeToStringWithVersion(data)) {
             LOG(ERROR) << "share SerializeToStringWithVersion failed!"
-                       << share.toString();
+                       << message.toString();
             return;
           }
-          server.sendShare2Kafka(chainId, message.data(), message.size());
+          server.sendShare2Kafka(chainId, data.data(), data.size());
         }
       });
 }
 
 bool StratumMinerEth::handleCheckedShare(
-    const std::string &idStr, size_t chainId, const ShareEth &share) {
-  if (StratumStatus::isAccepted(share.status())) {
-    DLOG(INFO) << "share reached the diff: " << share.sharediff();
+    const std::string &idStr,
+    size_t chainId,
+    const ShareEthBytesV2 &share) {
+  if (StratumStatus::isAccepted(share.status_)) {
+    DLOG(INFO) << "share reached the diff: " << share.shareDiff_;
   } else {
-    DLOG(INFO) << "share not reached the diff: " << share.sharediff();
+    DLOG(INFO) << "share not reached the diff: " << share.shareDiff_;
   }
 
   auto &session = getSession();
@@ -332,7 +341,7 @@ bool StratumMinerEth::handleCheckedShare(
 
   // we send share to kafka by default, but if there are lots of invalid
   // shares in a short time, we just drop them.
-  if (!handleShare(idStr, share.status(), share.sharediff(), chainId)) {
+  if (!handleShare(idStr, share.status_, share.shareDiff_, chainId)) {
     // check if there is invalid share spamming
     int64_t invalidSharesNum = invalidSharesCounter_.sum(
         time(nullptr), INVALID_SHARE_SLIDING_WINDOWS_SIZE);
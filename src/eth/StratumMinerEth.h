@@ -43,7 +43,9 @@ public:
       const JsonNode &jparams,
       const JsonNode &jroot) override;
   bool handleCheckedShare(
-      const std::string &idStr, size_t chainId, const ShareEth &share);
+      const std::string &idStr,
+      size_t chainId,
+      const ShareEthBytesV2 &share);
 
 private:
   void handleRequest_GetWork(const string &idStr, const JsonNode &jparams);
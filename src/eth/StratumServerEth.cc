@@ -390,7 +390,7 @@ void JobRepositoryEth::broadcastStratumJob(shared_ptr<StratumJob> sjob) {
   }
 
   // insert new job
-  exJobs_[sjobEth->jobId_] = exJob;
+  addStratumJobEx(sjobEth->jobId_, exJob);
 
   if (isClean) {
     // Send the job immediately.
@@ -460,7 +460,7 @@ bool ServerEth::setupInternal(const libconfig::Config &config) {
 
 void ServerEth::checkShareAndUpdateDiff(
     size_t chainId,
-    const ShareEth &share,
+    const ShareEthBytesV2 &share,
     const uint64_t jobId,
     const uint64_t nonce,
     const uint256 &header,
@@ -476,7 +476,7 @@ void ServerEth::checkShareAndUpdateDiff(
     return;
   }
 
-  shared_ptr<StratumJobEx> exJobPtr = jobRepo->getStratumJobEx(jobId);
+  StratumJobEx *exJobPtr = jobRepo->getStratumJobEx(jobId);
   if (nullptr == exJobPtr) {
     returnFn(StratumStatus::JOB_NOT_FOUND, 0, 0);
     return;
@@ -504,11 +504,11 @@ void ServerEth::checkShareAndUpdateDiff(
         if (extraNonce2) {
           extraNonce = fmt::format(
               ",\"extraNonce\":\"0x{:08x}{:08x}\"",
-              share.sessionid(),
+              share.sessionId_,
               *extraNonce2);
         } else {
           extraNonce =
-              fmt::format(",\"extraNonce\":\"0x{:08x}\"", share.sessionid());
+              fmt::format(",\"extraNonce\":\"0x{:08x}\"", share.sessionId_);
         }
       }
       sendSolvedShare2Kafka(
@@ -516,12 +516,12 @@ void ServerEth::checkShareAndUpdateDiff(
           nonce,
           sjob->headerHash_,
           *mixHash,
-          share.height(),
-          share.networkdiff(),
-          share.userid(),
-          share.workerhashid(),
+          share.height_,
+          share.networkDiff_,
+          share.userId_,
+          share.workerHashId_,
           workFullName,
-          share.getChain(),
+          ShareEth::getChain(share.version_),
           extraNonce);
       preliminarySolution = true;
     }
@@ -555,7 +555,7 @@ void ServerEth::checkShareAndUpdateDiff(
     gettimeofday(&start, NULL);
 #endif
 
-    bool ret = jobRepo->compute(share.height(), ethashHeader, nonce, r);
+    bool ret = jobRepo->compute(share.height_, ethashHeader, nonce, r);
 
 #ifndef NDEBUG
     gettimeofday(&end, NULL);
@@ -608,11 +608,11 @@ void ServerEth::checkShareAndUpdateDiff(
           if (extraNonce2) {
             extraNonce = fmt::format(
                 ",\"extraNonce\":\"0x{:08x}{:08x}\"",
-                share.sessionid(),
+                share.sessionId_,
                 *extraNonce2);
           } else {
             extraNonce =
-                fmt::format(",\"extraNonce\":\"0x{:08x}\"", share.sessionid());
+                fmt::format(",\"extraNonce\":\"0x{:08x}\"", share.sessionId_);
           }
         }
         sendSolvedShare2Kafka(
@@ -620,12 +620,12 @@ void ServerEth::checkShareAndUpdateDiff(
             nonce,
             sjob->headerHash_,
             returnedMixHash,
-            share.height(),
-            share.networkdiff(),
-            share.userid(),
-            share.workerhashid(),
+            share.height_,
+            share.networkDiff_,
+            share.userId_,
+            share.workerHashId_,
             workFullName,
-            share.getChain(),
+            ShareEth::getChain(share.version_),
             extraNonce);
       }
 
@@ -39,7 +39,7 @@ public:
   bool setupInternal(const libconfig::Config &config) override;
   void checkShareAndUpdateDiff(
       size_t chainId,
-      const ShareEth &share,
+      const ShareEthBytesV2 &share,
       const uint64_t jobId,
       const uint64_t nonce,
       const uint256 &header,
@@ -27,6 +27,7 @@
 #include "StratumMessageDispatcher.h"
 #include "StratumMinerEth.h"
 #include "DiffController.h"
+#include "HotRestart.h"
 
 #include <libethash/sha3.h>
 
@@ -490,3 +491,30 @@ void StratumSessionEth::checkExtraNonce2(const JsonNode &jroot) {
     }
   }
 }
+
+bool StratumSessionEth::saveState(SessionState &state) const {
+  if (!saveCommonState(state)) {
+    return false;
+  }
+  state.extra_["eth_protocol"] = static_cast<uint64_t>(ethProtocol_);
+  state.extra_["nicehash_last_sent_diff"] = nicehashLastSentDiff_;
+  state.extra_["current_job_diff"] = currentJobDiff_;
+  state.extra_["extra_nonce2"] = extraNonce2_;
+  return true;
+}
+
+bool StratumSessionEth::restoreState(const SessionState &state) {
+  ethProtocol_ = static_cast<StratumProtocolEth>(state.extra("eth_protocol"));
+  nicehashLastSentDiff_ = state.extra("nicehash_last_sent_diff");
+  currentJobDiff_ = state.extra("current_job_diff");
+  extraNonce2_ = state.extra("extra_nonce2") != 0;
+  if (!restoreCommonState(state)) {
+    return false;
+  }
+  if (extraNonce2_ && !isLongTimeout_) {
+    // User with extra nonce 2 is most likely a proxy
+    isLongTimeout_ = true;
+    setReadTimeout(86400 * 7);
+  }
+  return true;
+}
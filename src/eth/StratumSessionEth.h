@@ -68,6 +68,9 @@ public:
   void checkExtraNonce2(const JsonNode &jroot);
   bool hasExtraNonce2() const { return extraNonce2_; }
 
+  bool saveState(SessionState &state) const override;
+  bool restoreState(const SessionState &state) override;
+
 private:
   StratumProtocolEth ethProtocol_;
   // Record the difficulty of the last time sent to the miner in
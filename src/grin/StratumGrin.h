@@ -31,6 +31,41 @@
 
 #include "utilities_js.hpp"
 
+// Fixed-layout share record, sent instead of the protobuf message with
+// sserver.use_share_bytes. sserver fills it while checking the share.
+// extUserId_ and bitsReached_ are 0 when not set.
+struct ShareGrinBytes {
+  uint32_t version_ = 0; // 0
+  uint32_t checkSum_ = 0; // 4
+
+  int64_t workerHashId_ = 0; // 8
+  int32_t userId_ = 0; // 16
+  int32_t status_ = 0; // 20
+  int64_t timestamp_ = 0; // 24
+  IpAddress ip_ = 0; // 32
+
+  uint64_t jobId_ = 0; // 48
+  uint64_t shareDiff_ = 0; // 56
+  uint64_t blockDiff_ = 0; // 64
+  uint64_t height_ = 0; // 72
+  uint64_t nonce_ = 0; // 80
+  uint64_t hashPrefix_ = 0; // 88
+  uint32_t sessionId_ = 0; // 96
+  uint32_t edgeBits_ = 0; // 100
+  uint32_t scaling_ = 0; // 104
+  int32_t extUserId_ = 0; // 108
+  uint32_t bitsReached_ = 0; // 112
+  uint32_t reserved_ = 0; // 116
+
+  uint32_t checkSum() const { return sharebase::BytesCheckSum(*this); }
+  // see ShareGrin::scaledShareDiff()
+  uint32_t scaledShareDiff() const { return shareDiff_ * scaling_; }
+  string toString() const;
+};
+
+static_assert(
+    sizeof(ShareGrinBytes) == 120, "ShareGrinBytes should be 120 bytes");
+
 // [[[[ IMPORTANT REMINDER! ]]]]
 // Please keep the Share structure forward compatible.
 // That is: don't change it unless you add code so that
@@ -45,6 +80,8 @@ class ShareGrin
 public:
   const static uint32_t CURRENT_VERSION =
       0x00400001u; // first 0040: Grin, second 0001: version 1
+  const static uint32_t BYTES_VERSION =
+      0x00400002u; // first 0040: Grin, second 0002: version 2
 
   ShareGrin() {
     set_version(0);
@@ -66,6 +103,48 @@ public:
   ShareGrin(const ShareGrin &r) = default;
   ShareGrin &operator=(const ShareGrin &r) = default;
 
+  // The IP is kept raw, see getIp()
+  void fromBytes(const ShareGrinBytes &share) {
+    set_version(CURRENT_VERSION);
+    set_workerhashid(share.workerHashId_);
+    set_userid(share.userId_);
+    set_status(share.status_);
+    set_timestamp(share.timestamp_);
+    setRawIp(share.ip_);
+    set_jobid(share.jobId_);
+    set_sharediff(share.shareDiff_);
+    set_blockdiff(share.blockDiff_);
+    set_height(share.height_);
+    set_nonce(share.nonce_);
+    set_hashprefix(share.hashPrefix_);
+    set_sessionid(share.sessionId_);
+    set_edgebits(share.edgeBits_);
+    set_scaling(share.scaling_);
+    if (share.extUserId_ != 0) {
+      set_extuserid(share.extUserId_);
+    }
+    if (share.bitsReached_ != 0) {
+      set_bitsreached(share.bitsReached_);
+    }
+  }
+
+  bool UnserializeWithVersion(const uint8_t *data, uint32_t size) {
+    if (nullptr == data || size != sizeof(ShareGrinBytes) ||
+        *reinterpret_cast<const uint32_t *>(data) != BYTES_VERSION) {
+      return Unserializable::UnserializeWithVersion(data, size);
+    }
+
+    auto share = reinterpret_cast<const ShareGrinBytes *>(data);
+    if (share->checkSum() != share->checkSum_) {
+      DLOG(INFO) << "checkSum mismatched! checkSum_: " << share->checkSum_
+                 << ", checkSum(): " << share->checkSum();
+      return false;
+    }
+
+    fromBytes(*share);
+    return true;
+  }
+
   // Grin applies scaling when checking proof hash difficulty, to mitigate the
   // solving cost. The scaling is dynamic and is determined by height, edge bits
   // and secondary scaling field in job pre-PoW.
@@ -108,7 +187,7 @@ public:
         "sessionId: %08x, status: %d/%s)",
         height(),
         jobid(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -122,6 +201,12 @@ public:
   }
 };
 
+inline string ShareGrinBytes::toString() const {
+  ShareGrin share;
+  share.fromBytes(*this);
+  return share.toString();
+}
+
 class StratumJobGrin : public StratumJob {
 public:
   StratumJobGrin();
@@ -155,6 +240,7 @@ struct StratumTraitsGrin {
     bool operator==(uint64_t prePowHash) const {
       return prePowHash_ == prePowHash;
     }
+    uint32_t key() const { return prePowHash_; }
 
     uint32_t prePowHash_;
   };
@@ -98,14 +98,14 @@ void StratumMinerGrin::handleRequest_Submit(
   auto &worker = session.getWorker();
   auto sessionId = session.getSessionId();
 
-  shared_ptr<StratumJobEx> exjob = server.GetJobRepository(localJob->chainId_)
-                                       ->getStratumJobEx(localJob->jobId_);
+  StratumJobEx *exjob = server.GetJobRepository(localJob->chainId_)
+                              ->getStratumJobEx(localJob->jobId_);
   // can't find stratum job
-  if (exjob.get() == nullptr) {
+  if (exjob == nullptr) {
     handleShare(idStr, StratumStatus::JOB_NOT_FOUND, 0, localJob->chainId_);
     return;
   }
-  auto sjob = std::static_pointer_cast<StratumJobGrin>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobGrin *>(exjob->sjob_.get());
 
   auto iter = jobDiffs_.find(localJob);
   if (iter == jobDiffs_.end()) {
@@ -115,32 +115,32 @@ void StratumMinerGrin::handleRequest_Submit(
   }
   uint64_t shareDiff = iter->second;
 
-  ShareGrin share;
-  share.set_version(ShareGrin::CURRENT_VERSION);
-  share.set_jobid(sjob->jobId_);
-  share.set_workerhashid(workerId_);
-  share.set_userid(worker.userId(localJob->chainId_));
-  share.set_timestamp((uint64_t)time(nullptr));
-  share.set_status(StratumStatus::REJECT_NO_REASON);
-  share.set_sharediff(shareDiff);
-  share.set_blockdiff(sjob->difficulty_);
-  share.set_height(height);
-  share.set_nonce(nonce);
-  share.set_sessionid(sessionId);
-  share.set_edgebits(edgeBits);
-  share.set_scaling(
-      PowScalingGrin(height, edgeBits, sjob->prePow_.secondaryScaling.value()));
-  IpAddress ip;
-  ip.fromIpv4Int(session.getClientIp());
-  share.set_ip(ip.toString());
+  // the share is kept in its fixed-layout record until it is sent, the
+  // protobuf message is only built with the protobuf share format
+  ShareGrinBytes share;
+  share.version_ = ShareGrin::BYTES_VERSION;
+  share.jobId_ = sjob->jobId_;
+  share.workerHashId_ = workerId_;
+  share.userId_ = worker.userId(localJob->chainId_);
+  share.timestamp_ = (uint64_t)time(nullptr);
+  share.status_ = StratumStatus::REJECT_NO_REASON;
+  share.shareDiff_ = shareDiff;
+  share.blockDiff_ = sjob->difficulty_;
+  share.height_ = height;
+  share.nonce_ = nonce;
+  share.sessionId_ = sessionId;
+  share.edgeBits_ = edgeBits;
+  share.scaling_ =
+      PowScalingGrin(height, edgeBits, sjob->prePow_.secondaryScaling.value());
+  share.ip_.fromIpv4Int(session.getClientIp());
 
   LocalShare localShare(nonce, boost::hash_value(proofs), edgeBits);
   // can't add local share
-  if (!localJob->addLocalShare(localShare)) {
-    handleShare(
-        idStr, StratumStatus::DUPLICATE_SHARE, shareDiff, localJob->chainId_);
+  const int32_t localShareStatus = localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
+    handleShare(idStr, localShareStatus, shareDiff, localJob->chainId_);
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(localShareStatus);
     return;
   }
 
@@ -148,7 +148,7 @@ void StratumMinerGrin::handleRequest_Submit(
   server.checkAndUpdateShare(
       localJob->chainId_, share, exjob, proofs, worker.fullName_, blockHash);
 
-  if (StratumStatus::isAccepted(share.status())) {
+  if (StratumStatus::isAccepted(share.status_)) {
     DLOG(INFO) << "share reached the diff: " << share.scaledShareDiff();
   } else {
     DLOG(INFO) << "share not reached the diff: " << share.scaledShareDiff();
@@ -157,8 +157,8 @@ void StratumMinerGrin::handleRequest_Submit(
   // we send share to kafka by default, but if there are lots of invalid
   // shares in a short time, we just drop them.
   if (handleShare(
-          idStr, share.status(), share.sharediff(), localJob->chainId_)) {
-    if (StratumStatus::isSolved(share.status())) {
+          idStr, share.status_, share.shareDiff_, localJob->chainId_)) {
+    if (StratumStatus::isSolved(share.status_)) {
       server.sendSolvedShare2Kafka(
           localJob->chainId_, share, exjob, proofs, worker, blockHash);
       // mark jobs as stale
@@ -179,11 +179,20 @@ void StratumMinerGrin::handleRequest_Submit(
 
   DLOG(INFO) << share.toString();
 
-  std::string message;
-  if (!share.SerializeToStringWithVersion(message)) {
+  if (server.useShareBytes()) {
+    share.checkSum_ = share.checkSum();
+    server.sendShare2Kafka(localJob->chainId_, (char *)&share, sizeof(share));
+    return;
+  }
+
+  ShareGrin message;
+  message.fromBytes(share);
+  message.formatIp();
+  std::string data;
+  if (!message.SerializeToStringWithVersion(data)) {
     LOG(ERROR) << "share SerializeToStringWithVersion failed!"
-               << share.toString();
+               << message.toString();
     return;
   }
-  server.sendShare2Kafka(localJob->chainId_, message.data(), message.size());
+  server.sendShare2Kafka(localJob->chainId_, data.data(), data.size());
 }
@@ -37,39 +37,39 @@ unique_ptr<StratumSession> StratumServerGrin::createConnection(
 
 void StratumServerGrin::checkAndUpdateShare(
     size_t chainId,
-    ShareGrin &share,
-    shared_ptr<StratumJobEx> exjob,
+    ShareGrinBytes &share,
+    StratumJobEx *exjob,
     const vector<uint64_t> &proofs,
     const string &workFullName,
     uint256 &blockHash) {
-  auto sjob = std::static_pointer_cast<StratumJobGrin>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobGrin *>(exjob->sjob_.get());
 
-  DLOG(INFO) << "checking share nonce: " << std::hex << share.nonce()
+  DLOG(INFO) << "checking share nonce: " << std::hex << share.nonce_
              << ", pre_pow: " << sjob->prePowStr_
-             << ", edge_bits: " << share.edgebits();
+             << ", edge_bits: " << share.edgeBits_;
 
   if (exjob->isStale()) {
-    share.set_status(StratumStatus::STALE_SHARE);
+    share.status_ = StratumStatus::STALE_SHARE;
     return;
   }
 
   PreProofGrin preProof;
   preProof.prePow = sjob->prePow_;
   preProof.prePow.timestamp =
-      preProof.prePow.timestamp.value() + DiffToShift(share.sharediff());
-  preProof.nonce = share.nonce();
-  bool isValidSolution = VerifyPowGrin(preProof, share.edgebits(), proofs);
+      preProof.prePow.timestamp.value() + DiffToShift(share.shareDiff_);
+  preProof.nonce = share.nonce_;
+  bool isValidSolution = VerifyPowGrin(preProof, share.edgeBits_, proofs);
   if (!isValidSolution && !isEnableSimulator_) {
-    share.set_status(StratumStatus::INVALID_SOLUTION);
+    share.status_ = StratumStatus::INVALID_SOLUTION;
     return;
   }
 
-  blockHash = PowHashGrin(share.edgebits(), proofs);
-  share.set_hashprefix(blockHash.GetCheapHash());
-  share.set_bitsreached(UintToArith256(blockHash).GetCompact());
+  blockHash = PowHashGrin(share.edgeBits_, proofs);
+  share.hashPrefix_ = blockHash.GetCheapHash();
+  share.bitsReached_ = UintToArith256(blockHash).GetCompact();
   uint64_t scaledShareDiff = PowDifficultyGrin(
-      share.height(),
-      share.edgebits(),
+      share.height_,
+      share.edgeBits_,
       preProof.prePow.secondaryScaling.value(),
       proofs);
   DLOG(INFO) << "compare share difficulty: " << scaledShareDiff
@@ -88,7 +88,7 @@ void StratumServerGrin::checkAndUpdateShare(
               << ", network difficulty: " << sjob->difficulty_
               << ", worker: " << workFullName;
 
-    share.set_status(StratumStatus::SOLVED);
+    share.status_ = StratumStatus::SOLVED;
     LOG(INFO) << "solved share: " << share.toString();
     return;
   }
@@ -97,18 +97,18 @@ void StratumServerGrin::checkAndUpdateShare(
              << ", job difficulty: " << share.scaledShareDiff();
 
   if (isEnableSimulator_ || scaledShareDiff >= share.scaledShareDiff()) {
-    share.set_status(StratumStatus::ACCEPT);
+    share.status_ = StratumStatus::ACCEPT;
     return;
   }
 
-  share.set_status(StratumStatus::LOW_DIFFICULTY);
+  share.status_ = StratumStatus::LOW_DIFFICULTY;
   return;
 }
 
 void StratumServerGrin::sendSolvedShare2Kafka(
     size_t chainId,
-    const ShareGrin &share,
-    shared_ptr<StratumJobEx> exjob,
+    const ShareGrinBytes &share,
+    StratumJobEx *exjob,
     const vector<uint64_t> &proofs,
     const StratumWorker &worker,
     const uint256 &blockHash) {
@@ -121,11 +121,11 @@ void StratumServerGrin::sendSolvedShare2Kafka(
         [](string a, int b) { return std::move(a) + "," + std::to_string(b); });
   }
 
-  auto sjob = std::static_pointer_cast<StratumJobGrin>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobGrin *>(exjob->sjob_.get());
   string blockHashStr;
   Bin2Hex(blockHash.begin(), blockHash.size(), blockHashStr);
   string timestampStr;
-  uint64_t shift = DiffToShift(share.sharediff());
+  uint64_t shift = DiffToShift(share.shareDiff_);
   if (shift > 0) {
     timestampStr = Strings::Format(
         ",\"timestamp\":%" PRId64, sjob->prePow_.timestamp.value() + shift);
@@ -140,8 +140,8 @@ void StratumServerGrin::sendSolvedShare2Kafka(
       "%s}",
       sjob->prePowStr_,
       sjob->height_,
-      share.edgebits(),
-      share.nonce(),
+      share.edgeBits_,
+      share.nonce_,
       proofArray,
       worker.userId(chainId),
       worker.workerHashId_,
@@ -219,7 +219,7 @@ void JobRepositoryGrin::broadcastStratumJob(shared_ptr<StratumJob> sjob) {
   }
 
   // insert new job
-  exJobs_[sjobGrin->jobId_] = exJob;
+  addStratumJobEx(sjobGrin->jobId_, exJob);
 
   // sending data in lock scope may cause implicit race condition in libevent
   if (isClean) {
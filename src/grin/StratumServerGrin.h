@@ -29,7 +29,7 @@
 #include "uint256.h"
 
 class JobRepositoryGrin;
-class ShareGrin;
+struct ShareGrinBytes;
 
 class StratumServerGrin : public ServerBase<JobRepositoryGrin> {
 public:
@@ -40,15 +40,15 @@ public:
 
   void checkAndUpdateShare(
       size_t chainId,
-      ShareGrin &share,
-      shared_ptr<StratumJobEx> exjob,
+      ShareGrinBytes &share,
+      StratumJobEx *exjob,
       const vector<uint64_t> &proofs,
       const string &workFullName,
       uint256 &blockHash);
   void sendSolvedShare2Kafka(
       size_t chainId,
-      const ShareGrin &share,
-      shared_ptr<StratumJobEx> exjob,
+      const ShareGrinBytes &share,
+      StratumJobEx *exjob,
       const vector<uint64_t> &proofs,
       const StratumWorker &worker,
       const uint256 &blockHash);
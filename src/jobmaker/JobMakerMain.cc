@@ -196,6 +196,9 @@ createGbtJobMakerDefinition(const Setting &setting) {
       def->vcashmergedMiningNotifyPolicy_,
       true);
 
+  def->binaryJob_ = false;
+  readFromSetting(setting, "job_binary_encoding", def->binaryJob_, true);
+
   readFromSetting(setting, "zookeeper_lock_path", def->zookeeperLockPath_);
   readFromSetting(setting, "file_last_job_time", def->fileLastJobTime_, true);
   readFromSetting(setting, "id", def->serverId_);
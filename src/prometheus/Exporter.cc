@@ -46,6 +46,10 @@ static std::string FormatMetricType(Metric::Type t) {
     return "counter";
   case Metric::Type::Gauge:
     return "gauge";
+  case Metric::Type::Histogram:
+    return "histogram";
+  case Metric::Type::Summary:
+    return "summary";
   default:
     return "untyped";
   }
@@ -133,6 +137,8 @@ void Exporter::handleRequest(struct evhttp_request *req, void *arg) {
 std::string Exporter::exportMetrics() {
   std::string text;
   auto out = std::back_inserter(text);
+  // metrics of the same name share the description
+  std::set<std::string> described;
   for (auto &collector : collectors_) {
     auto metrics = collector->collectMetrics();
     for (auto &metric : metrics) {
@@ -141,22 +147,30 @@ std::string Exporter::exportMetrics() {
         continue;
       }
 
-      auto &help = metric->getHelp();
-      if (!help.empty()) {
-        fmt::format_to(out, "# HELP {} {}\n", name, help);
+      if (described.insert(name).second) {
+        auto &help = metric->getHelp();
+        if (!help.empty()) {
+          fmt::format_to(out, "# HELP {} {}\n", name, help);
+        }
+        fmt::format_to(
+            out, "# TYPE {} {}\n", name, FormatMetricType(metric->getType()));
       }
-      fmt::format_to(
-          out, "# TYPE {} {}\n", name, FormatMetricType(metric->getType()));
-      fmt::format_to(out, "{}", name);
       auto &labels = metric->getLabels();
-      if (!labels.empty()) {
-        fmt::format_to(out, "{{");
-        for (auto &label : labels) {
-          fmt::format_to(out, "{}=\"{}\",", label.first, label.second);
+      for (auto &sample : metric->getSamples()) {
+        fmt::format_to(out, "{}{}", name, sample.suffix_);
+        if (!labels.empty() || !sample.labelName_.empty()) {
+          fmt::format_to(out, "{{");
+          for (auto &label : labels) {
+            fmt::format_to(out, "{}=\"{}\",", label.first, label.second);
+          }
+          if (!sample.labelName_.empty()) {
+            fmt::format_to(
+                out, "{}=\"{}\",", sample.labelName_, sample.labelValue_);
+          }
+          fmt::format_to(out, "}}");
         }
-        fmt::format_to(out, "}}");
+        fmt::format_to(out, " {}\n", sample.value_);
       }
-      fmt::format_to(out, " {}\n", metric->getValue());
     }
   }
   return text;
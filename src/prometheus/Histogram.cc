@@ -0,0 +1,95 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "Histogram.h"
+
+#include <algorithm>
+
+namespace prometheus {
+
+Histogram::Histogram(std::vector<double> bounds)
+  : bounds_{std::move(bounds)}
+  , counts_{new std::atomic<uint64_t>[bounds_.size() + 1]}
+  , sum_{0} {
+  for (size_t i = 0; i <= bounds_.size(); i++) {
+    counts_[i] = 0;
+  }
+}
+
+void Histogram::observe(double value) {
+  // the first bucket of a bound not less than the value
+  size_t i = std::lower_bound(bounds_.begin(), bounds_.end(), value) -
+      bounds_.begin();
+  counts_[i].fetch_add(1, std::memory_order_relaxed);
+
+  double sum = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(
+      sum, sum + value, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snapshot;
+  snapshot.counts_.resize(bounds_.size() + 1);
+  uint64_t count = 0;
+  for (size_t i = 0; i <= bounds_.size(); i++) {
+    count += counts_[i].load(std::memory_order_relaxed);
+    snapshot.counts_[i] = count;
+  }
+  snapshot.sum_ = sum_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+double Histogram::quantile(const Snapshot &snapshot, double q) const {
+  if (snapshot.count() == 0) {
+    return 0;
+  }
+
+  double rank = q * snapshot.count();
+  size_t i = std::lower_bound(
+                 snapshot.counts_.begin(), snapshot.counts_.end(), rank) -
+      snapshot.counts_.begin();
+  if (i >= bounds_.size()) {
+    return bounds_.empty() ? 0 : bounds_.back();
+  }
+
+  double lower = i == 0 ? 0 : bounds_[i - 1];
+  double below = i == 0 ? 0 : snapshot.counts_[i - 1];
+  double inBucket = snapshot.counts_[i] - below;
+  if (inBucket == 0) {
+    return bounds_[i];
+  }
+  return lower + (bounds_[i] - lower) * (rank - below) / inBucket;
+}
+
+std::vector<double>
+Histogram::exponentialBounds(double start, double factor, size_t count) {
+  std::vector<double> bounds;
+  bounds.reserve(count);
+  for (double bound = start; bounds.size() < count; bound *= factor) {
+    bounds.push_back(bound);
+  }
+  return bounds;
+}
+
+} // namespace prometheus
@@ -0,0 +1,70 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace prometheus {
+
+// Observations counted in buckets, thread-safe and lock-free. The observing
+// code owns the histogram, the metrics created by CreateMetricHistogram() and
+// CreateMetricSummary() read it at each scrape.
+class Histogram {
+public:
+  // The upper bounds of the buckets in ascending order, the bucket of +Inf is
+  // implicit
+  explicit Histogram(std::vector<double> bounds);
+
+  void observe(double value);
+
+  struct Snapshot {
+    // cumulative counts of the buckets, the last one is +Inf
+    std::vector<uint64_t> counts_;
+    double sum_;
+
+    uint64_t count() const { return counts_.back(); }
+  };
+  Snapshot snapshot() const;
+
+  const std::vector<double> &bounds() const { return bounds_; }
+
+  // Estimate the q-quantile of the snapshot by linear interpolation in its
+  // bucket, the first bucket starts from 0. Values in the bucket of +Inf are
+  // estimated as the largest bound.
+  double quantile(const Snapshot &snapshot, double q) const;
+
+  // count bounds from start, each one factor times the previous one
+  static std::vector<double>
+  exponentialBounds(double start, double factor, size_t count);
+
+private:
+  std::vector<double> bounds_;
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<double> sum_;
+};
+
+} // namespace prometheus
@@ -28,6 +28,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace prometheus {
 
@@ -36,13 +37,29 @@ public:
   enum class Type {
     Counter,
     Gauge,
+    Histogram,
+    Summary,
   };
+
+  // A line of the exposition. Histograms and summaries have several, with a
+  // suffix of the name (e.g. "_bucket") and a label of their own (e.g.
+  // le="0.5") besides the labels of the metric.
+  struct Sample {
+    std::string suffix_;
+    std::string labelName_;
+    std::string labelValue_;
+    std::string value_;
+  };
+
   virtual ~Metric() = default;
   virtual const std::string &getName() const = 0;
   virtual Type getType() const = 0;
   virtual std::string getValue() const = 0;
   virtual const std::string &getHelp() const = 0;
   virtual const std::map<std::string, std::string> &getLabels() const = 0;
+  virtual std::vector<Sample> getSamples() const {
+    return {{"", "", "", getValue()}};
+  }
 };
 
 } // namespace prometheus
@@ -22,6 +22,8 @@
  THE SOFTWARE.
 */
 
+#include "Histogram.h"
+
 #include "fmt/format.h"
 
 namespace prometheus {
@@ -97,6 +99,84 @@ private:
   std::function<T()> valueFn_;
 };
 
+// The buckets of a histogram, with the sum and the count of the observations
+class MetricHistogram : public MetricBase {
+public:
+  MetricHistogram(
+      const std::string &name,
+      const std::string &help,
+      const std::map<std::string, std::string> &labels,
+      std::shared_ptr<const Histogram> histogram)
+    : MetricBase{name, Metric::Type::Histogram, help, labels}
+    , histogram_{std::move(histogram)} {}
+
+  std::string getValue() const override {
+    return fmt::format("{}", histogram_->snapshot().count());
+  }
+
+  std::vector<Sample> getSamples() const override {
+    auto snapshot = histogram_->snapshot();
+    auto &bounds = histogram_->bounds();
+    std::vector<Sample> samples;
+    samples.reserve(bounds.size() + 3);
+    for (size_t i = 0; i < bounds.size(); i++) {
+      samples.push_back({"_bucket",
+                         "le",
+                         fmt::format("{}", bounds[i]),
+                         fmt::format("{}", snapshot.counts_[i])});
+    }
+    samples.push_back(
+        {"_bucket", "le", "+Inf", fmt::format("{}", snapshot.count())});
+    samples.push_back({"_sum", "", "", fmt::format("{}", snapshot.sum_)});
+    samples.push_back({"_count", "", "", fmt::format("{}", snapshot.count())});
+    return samples;
+  }
+
+private:
+  std::shared_ptr<const Histogram> histogram_;
+};
+
+// Quantiles of the observations since the start, estimated from the buckets
+// of a histogram
+class MetricSummary : public MetricBase {
+public:
+  MetricSummary(
+      const std::string &name,
+      const std::string &help,
+      const std::map<std::string, std::string> &labels,
+      std::shared_ptr<const Histogram> histogram,
+      std::vector<double> quantiles)
+    : MetricBase{name, Metric::Type::Summary, help, labels}
+    , histogram_{std::move(histogram)}
+    , quantiles_{std::move(quantiles)} {}
+
+  std::string getValue() const override {
+    return fmt::format("{}", histogram_->snapshot().count());
+  }
+
+  std::vector<Sample> getSamples() const override {
+    auto snapshot = histogram_->snapshot();
+    std::vector<Sample> samples;
+    samples.reserve(quantiles_.size() + 2);
+    for (double q : quantiles_) {
+      samples.push_back(
+          {"",
+           "quantile",
+           fmt::format("{}", q),
+           snapshot.count() == 0
+               ? "NaN"
+               : fmt::format("{}", histogram_->quantile(snapshot, q))});
+    }
+    samples.push_back({"_sum", "", "", fmt::format("{}", snapshot.sum_)});
+    samples.push_back({"_count", "", "", fmt::format("{}", snapshot.count())});
+    return samples;
+  }
+
+private:
+  std::shared_ptr<const Histogram> histogram_;
+  std::vector<double> quantiles_;
+};
+
 template <typename T>
 std::shared_ptr<Metric> CreateMetricValue(
     const std::string &name,
@@ -118,4 +198,23 @@ std::shared_ptr<Metric> CreateMetricFn(
       name, type, help, labels, std::move(valueFn));
 }
 
+inline std::shared_ptr<Metric> CreateMetricHistogram(
+    const std::string &name,
+    const std::string &help,
+    const std::map<std::string, std::string> &labels,
+    std::shared_ptr<const Histogram> histogram) {
+  return std::make_shared<MetricHistogram>(
+      name, help, labels, std::move(histogram));
+}
+
+inline std::shared_ptr<Metric> CreateMetricSummary(
+    const std::string &name,
+    const std::string &help,
+    const std::map<std::string, std::string> &labels,
+    std::shared_ptr<const Histogram> histogram,
+    std::vector<double> quantiles) {
+  return std::make_shared<MetricSummary>(
+      name, help, labels, std::move(histogram), std::move(quantiles));
+}
+
 } // namespace prometheus
@@ -117,7 +117,7 @@ void StratumMinerSia::handleRequest_Submit(
     return;
   }
 
-  shared_ptr<StratumJobEx> exjob;
+  StratumJobEx *exjob;
   exjob = server.GetJobRepository(localJob->chainId_)
               ->getStratumJobEx(localJob->jobId_);
 
@@ -127,7 +127,7 @@ void StratumMinerSia::handleRequest_Submit(
     return;
   }
 
-  auto sjob = std::static_pointer_cast<StratumJobSia>(exjob->sjob_);
+  auto sjob = static_cast<StratumJobSia *>(exjob->sjob_.get());
   if (nullptr == sjob) {
     session.responseError(idStr, StratumStatus::JOB_NOT_FOUND);
     LOG(ERROR) << "cast sia local job failed " << std::hex << localJob->jobId_;
@@ -136,11 +136,15 @@ void StratumMinerSia::handleRequest_Submit(
 
   uint64_t nonce = *((uint64_t *)(bHeader + 32));
   LocalShare localShare(nonce, 0, 0);
-  if (!server.isEnableSimulator_ && !localJob->addLocalShare(localShare)) {
-    session.responseError(idStr, StratumStatus::DUPLICATE_SHARE);
-    LOG(ERROR) << "duplicated share nonce " << std::hex << nonce;
+  const int32_t localShareStatus = server.isEnableSimulator_
+      ? StratumStatus::ACCEPT
+      : localJob->addLocalShare(localShare);
+  if (localShareStatus != StratumStatus::ACCEPT) {
+    session.responseError(idStr, localShareStatus);
+    LOG(ERROR) << "rejected share nonce " << std::hex << nonce << ": "
+               << StratumStatus::toString(localShareStatus);
     // add invalid share to counter
-    invalidSharesCounter_.insert((int64_t)time(nullptr), 1);
+    countInvalidShare(localShareStatus);
     return;
   }
 
@@ -153,28 +157,27 @@ void StratumMinerSia::handleRequest_Submit(
   auto difficulty = iter->second;
   auto clientIp = session.getClientIp();
 
-  ShareSia share;
-  share.set_jobid(localJob->jobId_);
-  share.set_workerhashid(workerId_);
-  // share.ip_ = clientIp;
-  IpAddress ip;
-  ip.fromIpv4Int(clientIp);
-  share.set_ip(ip.toString());
+  // the protobuf message is only built with the protobuf share format
+  ShareSiaBytesV2 share;
+  share.version_ = ShareSia::BYTES_V2_VERSION;
+  share.jobId_ = localJob->jobId_;
+  share.workerHashId_ = workerId_;
+  share.ip_.fromIpv4Int(clientIp);
 
-  share.set_userid(worker.userId(localJob->chainId_));
-  share.set_sharediff(difficulty);
-  share.set_timestamp((uint32_t)time(nullptr));
-  share.set_status(StratumStatus::REJECT_NO_REASON);
+  share.userId_ = worker.userId(localJob->chainId_);
+  share.shareDiff_ = difficulty;
+  share.timestamp_ = (uint32_t)time(nullptr);
+  share.status_ = StratumStatus::REJECT_NO_REASON;
 
   arith_uint256 shareTarget(str);
   arith_uint256 networkTarget = UintToArith256(sjob->networkTarget_);
-  share.set_bitsreached(shareTarget.GetCompact());
+  share.bitsReached_ = shareTarget.GetCompact();
 
   if (shareTarget < networkTarget) {
     // valid share
     // submit share
     server.sendSolvedShare2Kafka(localJob->chainId_, (const char *)bHeader, 80);
-    diffController_->addShare(share.sharediff());
+    diffController_->addShare(share.shareDiff_);
     // mark jobs as stale
     server.GetJobRepository(localJob->chainId_)
         ->markAllJobsAsStale(sjob->height());
@@ -184,12 +187,21 @@ void StratumMinerSia::handleRequest_Submit(
 
   session.rpc2ResponseTrue(idStr);
 
-  std::string message;
-  if (!share.SerializeToStringWithVersion(message)) {
+  if (server.useShareBytes()) {
+    share.checkSum_ = share.checkSum();
+    server.sendShare2Kafka(localJob->chainId_, (char *)&share, sizeof(share));
+    return;
+  }
+
+  ShareSia message;
+  message.fromBytes(share);
+  message.formatIp();
+  std::string data;
+  if (!message.SerializeToStringWithVersion(data)) {
     LOG(ERROR) << "share SerializeToStringWithVersion failed!"
-               << share.toString();
+               << message.toString();
     return;
   }
 
-  server.sendShare2Kafka(localJob->chainId_, message.data(), message.size());
+  server.sendShare2Kafka(localJob->chainId_, data.data(), data.size());
 }
@@ -68,12 +68,44 @@ public:
   }
 };
 
+// Fixed-layout share record, sent instead of the protobuf message with
+// sserver.use_share_bytes. sserver fills it while checking the share.
+// extUserId_ and bitsReached_ are 0 when not set.
+class ShareSiaBytesV2 {
+public:
+  uint32_t version_ = 0; // 0
+  uint32_t checkSum_ = 0; // 4
+
+  int64_t workerHashId_ = 0; // 8
+  int32_t userId_ = 0; // 16
+  int32_t status_ = 0; // 20
+  int64_t timestamp_ = 0; // 24
+  IpAddress ip_ = 0; // 32
+
+  uint64_t jobId_ = 0; // 48
+  uint64_t shareDiff_ = 0; // 56
+  uint32_t blkBits_ = 0; // 64
+  uint32_t height_ = 0; // 68
+  uint32_t nonce_ = 0; // 72
+  uint32_t sessionId_ = 0; // 76
+  int32_t extUserId_ = 0; // 80
+  uint32_t bitsReached_ = 0; // 84
+
+  uint32_t checkSum() const { return sharebase::BytesCheckSum(*this); }
+  string toString() const;
+};
+
+static_assert(
+    sizeof(ShareSiaBytesV2) == 88, "ShareSiaBytesV2 should be 88 bytes");
+
 class ShareSia : public sharebase::Serializable<sharebase::SiaMsg> {
 public:
   const static uint32_t BYTES_VERSION =
       0x00010003u; // first 0001: bitcoin, second 0003: version 3.
   const static uint32_t CURRENT_VERSION =
       0x00010004u; // first 0001: bitcoin, second 0003: version 4.
+  const static uint32_t BYTES_V2_VERSION =
+      0x00010005u; // first 0001: bitcoin, second 0005: version 5.
 
   // Please pay attention to memory alignment when adding / removing fields.
   // Please note that changing the Share structure will be incompatible with the
@@ -129,7 +161,7 @@ public:
         "blkBits: %08x/%f, shareDiff: %u, "
         "status: %d/%s)",
         jobid(),
-        ip(),
+        getIp().toString(),
         userid(),
         workerhashid(),
         timestamp(),
@@ -142,6 +174,28 @@ public:
         StratumStatus::toString(status()));
   }
 
+  // The IP is kept raw, see getIp()
+  void fromBytes(const ShareSiaBytesV2 &share) {
+    set_version(CURRENT_VERSION);
+    set_workerhashid(share.workerHashId_);
+    set_userid(share.userId_);
+    set_status(share.status_);
+    set_timestamp(share.timestamp_);
+    setRawIp(share.ip_);
+    set_jobid(share.jobId_);
+    set_sharediff(share.shareDiff_);
+    set_blkbits(share.blkBits_);
+    set_height(share.height_);
+    set_nonce(share.nonce_);
+    set_sessionid(share.sessionId_);
+    if (share.extUserId_ != 0) {
+      set_extuserid(share.extUserId_);
+    }
+    if (share.bitsReached_ != 0) {
+      set_bitsreached(share.bitsReached_);
+    }
+  }
+
   bool UnserializeWithVersion(const uint8_t *data, uint32_t size) {
 
     if (nullptr == data || size <= 0) {
@@ -175,7 +229,7 @@ public:
       set_userid(share->userId_);
       set_status(share->status_);
       set_timestamp(share->timestamp_);
-      set_ip(share->ip_.toString());
+      setRawIp(share->ip_);
       set_jobid(share->jobId_);
       set_sharediff(share->shareDiff_);
       set_blkbits(share->blkBits_);
@@ -183,6 +237,19 @@ public:
       set_nonce(share->nonce_);
       set_sessionid(share->sessionId_);
 
+    } else if (
+        version == BYTES_V2_VERSION && size == sizeof(ShareSiaBytesV2)) {
+
+      auto share = (const ShareSiaBytesV2 *)payload;
+
+      if (share->checkSum() != share->checkSum_) {
+        DLOG(INFO) << "checkSum mismatched! checkSum_: " << share->checkSum_
+                   << ", checkSum(): " << share->checkSum();
+        return false;
+      }
+
+      fromBytes(*share);
+
     } else {
 
       DLOG(INFO) << "unknow share received! data size: " << size;
@@ -195,6 +262,12 @@ public:
 
 // static_assert(sizeof(ShareSia) == 80, "ShareBitcoin should be 80 bytes");
 
+inline string ShareSiaBytesV2::toString() const {
+  ShareSia share;
+  share.fromBytes(*this);
+  return share.toString();
+}
+
 class StratumJobSia : public StratumJob {
 public:
   uint32_t nTime_;
@@ -225,6 +298,7 @@ struct StratumTraitsSia {
     bool operator==(uint8_t shortJobId) const {
       return shortJobId_ == shortJobId;
     }
+    uint8_t key() const { return shortJobId_; }
     uint8_t shortJobId_;
     uint64_t jobDifficulty_;
   };
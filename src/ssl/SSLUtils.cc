@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include <pthread.h>
 #include <openssl/opensslv.h>
@@ -178,3 +179,53 @@ get_server_SSL_CTX(const std::string &certFile, const std::string &keyFile) {
 
   return sslCTX;
 }
+
+void set_server_SSL_session_cache(
+    SSL_CTX *sslCTX,
+    long cacheSize,
+    long timeout,
+    bool enableTickets,
+    const std::string &ticketKeyFile) {
+  static const unsigned char sessionIdContext[] = "btcpool-sserver";
+  SSL_CTX_set_session_id_context(
+      sslCTX, sessionIdContext, sizeof(sessionIdContext) - 1);
+  SSL_CTX_set_timeout(sslCTX, timeout);
+
+  if (cacheSize > 0) {
+    SSL_CTX_set_session_cache_mode(sslCTX, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(sslCTX, cacheSize);
+  } else {
+    SSL_CTX_set_session_cache_mode(sslCTX, SSL_SESS_CACHE_OFF);
+  }
+
+  if (!enableTickets) {
+    SSL_CTX_set_options(sslCTX, SSL_OP_NO_TICKET);
+    return;
+  }
+  if (ticketKeyFile.empty()) {
+    // OpenSSL generates random keys, tickets die with the process
+    return;
+  }
+
+  // 48 bytes before OpenSSL 1.1.0, 80 bytes after
+  long keyLength = SSL_CTX_get_tlsext_ticket_keys(sslCTX, nullptr, 0);
+  std::string keys(keyLength, '\0');
+  FILE *file = fopen(ticketKeyFile.c_str(), "rb");
+  if (file == nullptr) {
+    LOG(FATAL) << "Couldn't open '" << ticketKeyFile
+               << "': " << strerror(errno);
+  }
+  size_t size = fread((char *)keys.data(), 1, keys.size(), file);
+  fclose(file);
+
+  if (size != keys.size() ||
+      !SSL_CTX_set_tlsext_ticket_keys(
+          sslCTX, (unsigned char *)keys.data(), keys.size())) {
+    LOG(FATAL) << "Couldn't read " << keyLength
+               << " bytes of ticket keys from '" << ticketKeyFile
+               << "'.\n"
+                  "To generate the keys, run:\n"
+                  "  openssl rand -out "
+               << ticketKeyFile << " " << keyLength;
+  }
+}
@@ -34,3 +34,15 @@ SSL_CTX *get_client_SSL_CTX_With_Cache();
 
 SSL_CTX *
 get_server_SSL_CTX(const std::string &certFile, const std::string &keyFile);
+
+// Enable session resumption of a server context. cacheSize is the number of
+// sessions kept in the server-side cache (0: disabled) and timeout their
+// lifetime in seconds. Session tickets are encrypted with the keys read from
+// ticketKeyFile if it is not empty, so that they stay valid across restarts
+// and are accepted by all servers sharing the file.
+void set_server_SSL_session_cache(
+    SSL_CTX *sslCTX,
+    long cacheSize,
+    long timeout,
+    bool enableTickets,
+    const std::string &ticketKeyFile);
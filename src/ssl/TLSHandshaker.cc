@@ -0,0 +1,212 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "TLSHandshaker.h"
+#include "SSLUtils.h"
+
+#include <openssl/err.h>
+#include <glog/logging.h>
+
+TLSHandshaker::Handshake::Handshake(
+    Loop &loop, evutil_socket_t fd, SSL *ssl, Callback callback)
+  : loop_(loop)
+  , fd_(fd)
+  , ssl_(ssl)
+  , callback_(std::move(callback))
+  , event_(nullptr)
+  , deadline_{0, 0} {
+}
+
+TLSHandshaker::Handshake::~Handshake() {
+  if (event_) {
+    event_free(event_);
+  }
+  if (ssl_) {
+    SSL_free(ssl_);
+  }
+  if (fd_ >= 0) {
+    evutil_closesocket(fd_);
+  }
+}
+
+TLSHandshaker::Loop::Loop(TLSHandshaker &handshaker)
+  : handshaker_(handshaker)
+  , base_(event_base_new()) {
+}
+
+TLSHandshaker::Loop::~Loop() {
+  for (auto handshake : handshakes_) {
+    delete handshake;
+  }
+  if (base_) {
+    event_base_free(base_);
+  }
+}
+
+TLSHandshaker::TLSHandshaker(size_t threads, uint32_t timeoutSeconds)
+  : timeoutSeconds_(timeoutSeconds)
+  , next_(0)
+  , pending_(0) {
+  for (size_t i = 0; i < threads; i++) {
+    loops_.push_back(std::make_unique<Loop>(*this));
+  }
+}
+
+TLSHandshaker::~TLSHandshaker() {
+  stop();
+}
+
+bool TLSHandshaker::start() {
+  for (auto &loop : loops_) {
+    if (loop->base_ == nullptr) {
+      LOG(ERROR) << "TLSHandshaker: cannot create event base";
+      return false;
+    }
+  }
+  for (auto &loop : loops_) {
+    auto base = loop->base_;
+    loop->thread_ = std::thread(
+        [base]() { event_base_loop(base, EVLOOP_NO_EXIT_ON_EMPTY); });
+  }
+  LOG(INFO) << "TLSHandshaker: started " << loops_.size() << " threads";
+  return true;
+}
+
+void TLSHandshaker::stop() {
+  for (auto &loop : loops_) {
+    if (loop->thread_.joinable()) {
+      event_base_loopbreak(loop->base_);
+      loop->thread_.join();
+    }
+  }
+}
+
+void TLSHandshaker::handshake(
+    evutil_socket_t fd, SSL *ssl, Callback callback) {
+  if (!SSL_set_fd(ssl, fd)) {
+    LOG(ERROR) << "TLSHandshaker: SSL_set_fd failed: " << get_ssl_err_string();
+    SSL_free(ssl);
+    evutil_closesocket(fd);
+    callback(false);
+    return;
+  }
+  SSL_set_accept_state(ssl);
+
+  auto &loop = *loops_[next_++ % loops_.size()];
+  auto handshake = new Handshake(loop, fd, ssl, std::move(callback));
+  {
+    std::lock_guard<std::mutex> sl(loop.lock_);
+    loop.handshakes_.insert(handshake);
+  }
+  pending_++;
+
+  // wait for the ClientHello
+  struct timeval now;
+  evutil_gettimeofday(&now, nullptr);
+  handshake->deadline_ = {now.tv_sec + timeoutSeconds_, now.tv_usec};
+  if (!wait(handshake, EV_READ)) {
+    finish(handshake, false);
+  }
+}
+
+bool TLSHandshaker::wait(Handshake *handshake, short what) {
+  struct timeval now, timeout;
+  evutil_gettimeofday(&now, nullptr);
+  evutil_timersub(&handshake->deadline_, &now, &timeout);
+  if (timeout.tv_sec < 0) {
+    DLOG(INFO) << "TLSHandshaker: handshake timeout";
+    return false;
+  }
+
+  // the event is never pending here, it is not persistent
+  if (handshake->event_) {
+    event_assign(
+        handshake->event_,
+        handshake->loop_.base_,
+        handshake->fd_,
+        what,
+        TLSHandshaker::eventCallback,
+        handshake);
+  } else {
+    handshake->event_ = event_new(
+        handshake->loop_.base_,
+        handshake->fd_,
+        what,
+        TLSHandshaker::eventCallback,
+        handshake);
+  }
+  return handshake->event_ != nullptr &&
+      event_add(handshake->event_, &timeout) == 0;
+}
+
+void TLSHandshaker::finish(Handshake *handshake, bool success) {
+  {
+    std::lock_guard<std::mutex> sl(handshake->loop_.lock_);
+    handshake->loop_.handshakes_.erase(handshake);
+  }
+  pending_--;
+
+  auto callback = std::move(handshake->callback_);
+  if (success) {
+    // handed back to the caller
+    handshake->ssl_ = nullptr;
+    handshake->fd_ = -1;
+  }
+  delete handshake;
+  callback(success);
+}
+
+void TLSHandshaker::eventCallback(
+    evutil_socket_t fd, short events, void *context) {
+  auto handshake = static_cast<Handshake *>(context);
+  auto &handshaker = handshake->loop_.handshaker_;
+
+  if (events & EV_TIMEOUT) {
+    DLOG(INFO) << "TLSHandshaker: handshake timeout";
+    handshaker.finish(handshake, false);
+    return;
+  }
+
+  ERR_clear_error();
+  int ret = SSL_accept(handshake->ssl_);
+  if (ret == 1) {
+    handshaker.finish(handshake, true);
+    return;
+  }
+
+  bool waiting = false;
+  switch (SSL_get_error(handshake->ssl_, ret)) {
+  case SSL_ERROR_WANT_READ:
+    waiting = handshaker.wait(handshake, EV_READ);
+    break;
+  case SSL_ERROR_WANT_WRITE:
+    waiting = handshaker.wait(handshake, EV_WRITE);
+    break;
+  default:
+    DLOG(INFO) << "TLSHandshaker: handshake failed: " << get_ssl_err_string();
+    break;
+  }
+  if (!waiting) {
+    handshaker.finish(handshake, false);
+  }
+}
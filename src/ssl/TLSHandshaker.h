@@ -0,0 +1,95 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <event2/event.h>
+#include <openssl/ssl.h>
+
+//
+// Runs the server side of TLS handshakes in dedicated event loop threads, so
+// that the key exchange of a burst of new connections (e.g. all miners
+// reconnecting after a restart) does not stall the reactors serving the
+// established sessions.
+//
+class TLSHandshaker {
+public:
+  // Called in a handshake thread. On success the caller owns the socket and
+  // the SSL again, otherwise both have been freed already.
+  using Callback = std::function<void(bool success)>;
+
+  TLSHandshaker(size_t threads, uint32_t timeoutSeconds);
+  ~TLSHandshaker();
+
+  bool start();
+  // Pending handshakes are aborted without calling their callbacks.
+  void stop();
+
+  // Accept the TLS connection on the non-blocking socket, thread safe.
+  void handshake(evutil_socket_t fd, SSL *ssl, Callback callback);
+
+  size_t pending() const { return pending_; }
+
+private:
+  struct Loop;
+  struct Handshake {
+    Loop &loop_;
+    evutil_socket_t fd_;
+    SSL *ssl_;
+    Callback callback_;
+    struct event *event_;
+    struct timeval deadline_;
+
+    Handshake(Loop &loop, evutil_socket_t fd, SSL *ssl, Callback callback);
+    ~Handshake();
+  };
+  struct Loop {
+    TLSHandshaker &handshaker_;
+    struct event_base *base_;
+    std::thread thread_;
+    // handshakes in progress, to free them on stop
+    std::set<Handshake *> handshakes_;
+    std::mutex lock_;
+
+    explicit Loop(TLSHandshaker &handshaker);
+    ~Loop();
+  };
+
+  uint32_t timeoutSeconds_;
+  std::vector<std::unique_ptr<Loop>> loops_;
+  std::atomic<size_t> next_;
+  std::atomic<size_t> pending_;
+
+  // Wait for the socket to become readable or writable until the deadline.
+  bool wait(Handshake *handshake, short what);
+  void finish(Handshake *handshake, bool success);
+  static void eventCallback(evutil_socket_t fd, short events, void *context);
+};
@@ -0,0 +1,65 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+
+#include "AdmissionController.h"
+
+#include <future>
+
+TEST(AdmissionController, TokenBucket) {
+  TokenBucket unlimited(0, 0);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(unlimited.take(), 0);
+  }
+
+  // a pause until the next token once the burst is used up
+  TokenBucket bucket(10, 3);
+  ASSERT_EQ(bucket.take(), 0);
+  ASSERT_EQ(bucket.take(), 0);
+  double pause = bucket.take();
+  ASSERT_GT(pause, 0.09);
+  ASSERT_LE(pause, 0.1);
+  pause = bucket.take();
+  ASSERT_GT(pause, 0.19);
+  ASSERT_LE(pause, 0.2);
+}
+
+TEST(AdmissionController, Queue) {
+  AdmissionController admission(0, 0, 1000, 1, 1);
+  ASSERT_TRUE(admission.meteringAuthorizations());
+  ASSERT_EQ(admission.accept(), 0);
+
+  // the queue is full before the thread runs
+  std::promise<void> done;
+  ASSERT_TRUE(admission.defer([&done]() { done.set_value(); }));
+  ASSERT_FALSE(admission.defer([]() {}));
+  ASSERT_EQ(admission.rejected(), 1u);
+  ASSERT_EQ(admission.queueSize(), 1u);
+
+  admission.start();
+  done.get_future().wait();
+  admission.stop();
+  ASSERT_EQ(admission.deferred(), 1u);
+  ASSERT_EQ(admission.queueLatency()->snapshot().count(), 1u);
+}
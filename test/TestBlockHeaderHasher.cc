@@ -0,0 +1,147 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2016] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+#include "Common.h"
+
+#include "bitcoin/BlockHeaderHasher.h"
+
+#include "primitives/block.h"
+#include "streams.h"
+#include "version.h"
+
+#include <chrono>
+#include <random>
+
+#ifndef CHAIN_TYPE_ZEC
+
+static void RandomBlockHeaders(
+    size_t count,
+    vector<CBlockHeader> &headers,
+    vector<unsigned char> &headersBin) {
+  std::mt19937_64 random(count);
+  auto randomHash = [&]() {
+    uint256 hash;
+    for (size_t i = 0; i < hash.size(); i += 8) {
+      uint64_t r = random();
+      memcpy(hash.begin() + i, &r, 8);
+    }
+    return hash;
+  };
+
+  headers.clear();
+  headersBin.clear();
+  for (size_t i = 0; i < count; i++) {
+    CBlockHeader header;
+    header.nVersion = (int32_t)random();
+    header.hashPrevBlock = randomHash();
+    header.hashMerkleRoot = randomHash();
+    header.nTime = (uint32_t)random();
+    header.nBits = (uint32_t)random();
+    header.nNonce = (uint32_t)random();
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << header;
+    ASSERT_EQ(ssHeader.size(), BlockHeaderHasher::kHeaderSize);
+    headersBin.insert(headersBin.end(), ssHeader.begin(), ssHeader.end());
+    headers.push_back(header);
+  }
+}
+
+TEST(BlockHeaderHasher, Kernels) {
+  // odd sizes to exercise the remainders of multi-buffer kernels
+  for (size_t count : {1, 3, 7, 8, 9, 17, 1003}) {
+    vector<CBlockHeader> headers;
+    vector<unsigned char> headersBin;
+    RandomBlockHeaders(count, headers, headersBin);
+
+    for (auto kernel : {BlockHeaderHasher::GENERIC,
+                        BlockHeaderHasher::SSE41,
+                        BlockHeaderHasher::AVX2,
+                        BlockHeaderHasher::SHANI}) {
+      if (!BlockHeaderHasher::isSupported(kernel)) {
+        LOG(INFO) << "kernel " << BlockHeaderHasher::kernelName(kernel)
+                  << " is not supported by the CPU, skipped";
+        continue;
+      }
+
+      vector<unsigned char> hashes(count * BlockHeaderHasher::kHashSize);
+      BlockHeaderHasher::hash(kernel, hashes.data(), headersBin.data(), count);
+      for (size_t i = 0; i < count; i++) {
+        uint256 hash;
+        memcpy(
+            hash.begin(),
+            hashes.data() + i * BlockHeaderHasher::kHashSize,
+            BlockHeaderHasher::kHashSize);
+        ASSERT_EQ(hash, headers[i].GetHash())
+            << "kernel: " << BlockHeaderHasher::kernelName(kernel)
+            << ", header " << i << " of " << count;
+      }
+    }
+  }
+  ASSERT_EQ(
+      BlockHeaderHasher::isSupported(BlockHeaderHasher::bestKernel()), true);
+}
+
+// Timing only, the kernels are checked by BlockHeaderHasher.Kernels. Run with
+// --gtest_also_run_disabled_tests
+TEST(BlockHeaderHasher, DISABLED_Benchmark) {
+  const size_t kHeaders = 100000;
+  vector<CBlockHeader> headers;
+  vector<unsigned char> headersBin;
+  RandomBlockHeaders(kHeaders, headers, headersBin);
+  vector<unsigned char> hashes(kHeaders * BlockHeaderHasher::kHashSize);
+
+  auto begin = std::chrono::steady_clock::now();
+  for (const auto &header : headers) {
+    uint256 hash = header.GetHash();
+    hashes[0] ^= *hash.begin();
+  }
+  auto getHashTime = std::chrono::steady_clock::now() - begin;
+  LOG(INFO) << "CBlockHeader::GetHash() x" << kHeaders << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   getHashTime)
+                   .count()
+            << "us";
+
+  for (auto kernel : {BlockHeaderHasher::GENERIC,
+                      BlockHeaderHasher::SSE41,
+                      BlockHeaderHasher::AVX2,
+                      BlockHeaderHasher::SHANI}) {
+    if (!BlockHeaderHasher::isSupported(kernel)) {
+      continue;
+    }
+    begin = std::chrono::steady_clock::now();
+    BlockHeaderHasher::hash(
+        kernel, hashes.data(), headersBin.data(), kHeaders);
+    auto kernelTime = std::chrono::steady_clock::now() - begin;
+    LOG(INFO) << "BlockHeaderHasher " << BlockHeaderHasher::kernelName(kernel)
+              << " x" << kHeaders << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     kernelTime)
+                     .count()
+              << "us";
+  }
+}
+
+#endif // CHAIN_TYPE_ZEC
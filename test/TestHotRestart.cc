@@ -0,0 +1,81 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+
+#include "HotRestart.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+TEST(HotRestart, Channel) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  HotRestartChannel sender(fds[0]), receiver(fds[1]);
+
+  SessionState state;
+  state.sessionId_ = 0x01000002u;
+  state.clientIp_ = 0x0100007fu;
+  state.clientAgent_ = "cgminer/4.10.0";
+  state.userIds_ = {1, 2};
+  state.fullName_ = "user.worker";
+  state.curDiff_ = 16384;
+  state.extra_["version_mask"] = 0x1fffe000u;
+  state.input_ = std::string("{\"id\":1}\n\x7f\x00", 11);
+
+  // the socket is passed along with the message
+  int pipeFds[2];
+  ASSERT_EQ(pipe(pipeFds), 0);
+  ASSERT_TRUE(sender.send(
+      {{"sessions", std::vector<SessionState>{state}}}, {pipeFds[1]}));
+  close(pipeFds[1]);
+
+  nlohmann::json message;
+  std::vector<int> received;
+  ASSERT_TRUE(receiver.receive(message, received));
+  ASSERT_EQ(received.size(), 1u);
+  ASSERT_EQ(write(received[0], "x", 1), 1);
+  close(received[0]);
+  char c;
+  ASSERT_EQ(read(pipeFds[0], &c, 1), 1);
+  ASSERT_EQ(c, 'x');
+  close(pipeFds[0]);
+
+  auto states = message.at("sessions").get<std::vector<SessionState>>();
+  ASSERT_EQ(states.size(), 1u);
+  ASSERT_EQ(states[0].sessionId_, state.sessionId_);
+  ASSERT_EQ(states[0].clientIp_, state.clientIp_);
+  ASSERT_EQ(states[0].clientAgent_, state.clientAgent_);
+  ASSERT_EQ(states[0].userIds_, state.userIds_);
+  ASSERT_EQ(states[0].fullName_, state.fullName_);
+  ASSERT_EQ(states[0].curDiff_, state.curDiff_);
+  ASSERT_EQ(states[0].extra("version_mask"), 0x1fffe000u);
+  ASSERT_EQ(states[0].extra("suggested_diff"), 0u);
+  ASSERT_EQ(states[0].input_, state.input_);
+
+  // a message without sockets
+  ASSERT_TRUE(sender.send({{"done", true}}));
+  ASSERT_TRUE(receiver.receive(message, received));
+  ASSERT_TRUE(received.empty());
+  ASSERT_EQ(message.value("done", false), true);
+}
@@ -0,0 +1,73 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+#include "Kafka.h"
+
+#include <string>
+#include <vector>
+
+static std::vector<std::string> UnpackMessages(const std::string &payload) {
+  std::vector<std::string> messages;
+  KafkaMessageBatch::forEach(
+      payload.data(), payload.size(), [&](const uint8_t *data, size_t len) {
+        messages.emplace_back((const char *)data, len);
+      });
+  return messages;
+}
+
+TEST(Kafka, MessageBatch) {
+  KafkaMessageBatch batch;
+  ASSERT_EQ(batch.count(), 0u);
+  ASSERT_EQ(UnpackMessages(batch.data()).size(), 0u);
+
+  std::vector<std::string> shares = {"share 1", "", std::string(1000, 'x')};
+  for (const auto &share : shares) {
+    batch.add(share.data(), share.size());
+  }
+  ASSERT_EQ(batch.count(), shares.size());
+  ASSERT_EQ(UnpackMessages(batch.data()), shares);
+
+  // not a batch
+  std::string single("\x04\x00\x01\x00share", 9);
+  ASSERT_EQ(UnpackMessages(single), std::vector<std::string>{single});
+  ASSERT_EQ(UnpackMessages("abc"), std::vector<std::string>{"abc"});
+
+  // truncated or with trailing bytes, passed as is
+  std::string truncated = batch.data().substr(0, 100);
+  ASSERT_EQ(UnpackMessages(truncated), std::vector<std::string>{truncated});
+  std::string trailing = batch.data() + "x";
+  ASSERT_EQ(UnpackMessages(trailing), std::vector<std::string>{trailing});
+
+  // a raw share struct whose first field happens to match the magic
+  std::string raw(48, '\x01');
+  const uint32_t magic = KafkaMessageBatch::kMagic;
+  memcpy(&raw[0], &magic, sizeof(magic));
+  ASSERT_FALSE(KafkaMessageBatch::isBatch(raw.data(), raw.size()));
+  ASSERT_EQ(UnpackMessages(raw), std::vector<std::string>{raw});
+  ASSERT_TRUE(KafkaMessageBatch::isBatch(batch.data().data(), batch.size()));
+
+  batch.clear();
+  ASSERT_EQ(batch.count(), 0u);
+  ASSERT_EQ(batch.size(), KafkaMessageBatch::kHeaderSize);
+}
@@ -0,0 +1,87 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+
+#include "prometheus/Metric.h"
+
+TEST(Prometheus, Histogram) {
+  auto histogram = std::make_shared<prometheus::Histogram>(
+      prometheus::Histogram::exponentialBounds(1, 2, 3));
+  ASSERT_EQ(histogram->bounds(), std::vector<double>({1, 2, 4}));
+
+  // a value equal to a bound is in its bucket
+  for (double value : {0.5, 1.0, 1.5, 3.0, 3.0, 10.0}) {
+    histogram->observe(value);
+  }
+  auto snapshot = histogram->snapshot();
+  ASSERT_EQ(snapshot.counts_, std::vector<uint64_t>({2, 3, 5, 6}));
+  ASSERT_EQ(snapshot.count(), 6u);
+  ASSERT_DOUBLE_EQ(snapshot.sum_, 19);
+
+  ASSERT_DOUBLE_EQ(histogram->quantile(snapshot, 0.25), 0.75);
+  ASSERT_DOUBLE_EQ(histogram->quantile(snapshot, 0.5), 2);
+  ASSERT_DOUBLE_EQ(histogram->quantile(snapshot, 0.75), 3.5);
+  ASSERT_DOUBLE_EQ(histogram->quantile(snapshot, 0.99), 4);
+
+  auto metric = prometheus::CreateMetricHistogram(
+      "latency_seconds", "Latency", {{"stage", "verify"}}, histogram);
+  ASSERT_EQ(metric->getType(), prometheus::Metric::Type::Histogram);
+  auto samples = metric->getSamples();
+  ASSERT_EQ(samples.size(), 6u);
+  ASSERT_EQ(samples[1].suffix_, "_bucket");
+  ASSERT_EQ(samples[1].labelName_, "le");
+  ASSERT_EQ(samples[1].labelValue_, "2");
+  ASSERT_EQ(samples[1].value_, "3");
+  ASSERT_EQ(samples[3].labelValue_, "+Inf");
+  ASSERT_EQ(samples[3].value_, "6");
+  ASSERT_EQ(samples[4].suffix_, "_sum");
+  ASSERT_EQ(samples[4].value_, "19");
+  ASSERT_EQ(samples[5].suffix_, "_count");
+  ASSERT_EQ(samples[5].value_, "6");
+}
+
+TEST(Prometheus, Summary) {
+  auto histogram =
+      std::make_shared<prometheus::Histogram>(std::vector<double>{10, 20});
+  auto metric = prometheus::CreateMetricSummary(
+      "latency_seconds", "Latency", {}, histogram, {0.5, 0.9});
+  ASSERT_EQ(metric->getType(), prometheus::Metric::Type::Summary);
+  auto samples = metric->getSamples();
+  ASSERT_EQ(samples.size(), 4u);
+  ASSERT_EQ(samples[0].labelName_, "quantile");
+  ASSERT_EQ(samples[0].labelValue_, "0.5");
+  ASSERT_EQ(samples[0].value_, "NaN");
+
+  for (int i = 1; i <= 10; i++) {
+    histogram->observe(i * 2);
+  }
+  samples = metric->getSamples();
+  ASSERT_EQ(samples[0].value_, "10");
+  ASSERT_EQ(samples[1].labelValue_, "0.9");
+  ASSERT_EQ(samples[1].value_, "18");
+  ASSERT_EQ(samples[2].suffix_, "_sum");
+  ASSERT_EQ(samples[2].value_, "110");
+  ASSERT_EQ(samples[3].suffix_, "_count");
+  ASSERT_EQ(samples[3].value_, "10");
+}
@@ -0,0 +1,195 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+#include "RcuSnapshot.h"
+
+#include <glog/logging.h>
+
+#include <chrono>
+#include <map>
+#include <shared_mutex>
+#include <thread>
+
+TEST(RcuSnapshot, Publish) {
+  RcuSnapshot<int> snapshot(std::make_shared<const int>(1));
+  RcuSnapshot<int> other(std::make_shared<const int>(2));
+  ASSERT_EQ(snapshot.read(), 1);
+  ASSERT_EQ(other.read(), 2);
+
+  std::weak_ptr<const int> first = snapshot.get();
+  snapshot.publish(std::make_shared<const int>(3));
+  ASSERT_EQ(snapshot.read(), 3);
+  ASSERT_EQ(other.read(), 2);
+  // released once no thread caches it
+  ASSERT_TRUE(first.expired());
+
+  // another thread picks up the latest snapshot
+  std::weak_ptr<const int> second = snapshot.get();
+  std::thread([&]() { ASSERT_EQ(snapshot.read(), 3); }).join();
+  snapshot.publish(std::make_shared<const int>(4));
+  std::thread([&]() { ASSERT_EQ(snapshot.read(), 4); }).join();
+  ASSERT_FALSE(second.expired());
+  ASSERT_EQ(snapshot.read(), 4);
+  ASSERT_TRUE(second.expired());
+}
+
+TEST(RcuSnapshot, ManySnapshots) {
+  RcuSnapshot<int> snapshot(std::make_shared<const int>(1));
+  const int &value = snapshot.read();
+  std::weak_ptr<const int> first = snapshot.get();
+
+  // reading many others never drops the latest snapshot of one
+  std::vector<std::unique_ptr<RcuSnapshot<int>>> others;
+  std::vector<std::weak_ptr<const int>> otherValues;
+  for (int i = 0; i < 100; i++) {
+    others.push_back(
+        std::make_unique<RcuSnapshot<int>>(std::make_shared<const int>(i)));
+    ASSERT_EQ(others.back()->read(), i);
+    otherValues.push_back(others.back()->get());
+  }
+  ASSERT_FALSE(first.expired());
+  ASSERT_EQ(value, 1);
+
+  // the snapshots of destroyed ones are dropped by the next read
+  others.clear();
+  ASSERT_FALSE(otherValues[0].expired());
+  ASSERT_EQ(snapshot.read(), 1);
+  for (auto &otherValue : otherValues) {
+    ASSERT_TRUE(otherValue.expired());
+  }
+}
+
+TEST(RcuSnapshot, ReleaseCached) {
+  RcuSnapshot<int> snapshot(std::make_shared<const int>(1));
+  RcuSnapshot<int> other(std::make_shared<const int>(2));
+  ASSERT_EQ(snapshot.read(), 1);
+
+  // a replaced snapshot is dropped by reading another one
+  std::weak_ptr<const int> first = snapshot.get();
+  snapshot.publish(std::make_shared<const int>(3));
+  ASSERT_FALSE(first.expired());
+  ASSERT_EQ(other.read(), 2);
+  ASSERT_TRUE(first.expired());
+
+  // or when the thread releases its cache, e.g. before sleeping
+  ASSERT_EQ(snapshot.read(), 3);
+  std::weak_ptr<const int> second = snapshot.get();
+  snapshot.publish(std::make_shared<const int>(4));
+  ASSERT_FALSE(second.expired());
+  RcuSnapshot<int>::releaseCached();
+  ASSERT_TRUE(second.expired());
+  ASSERT_EQ(snapshot.read(), 4);
+}
+
+TEST(RcuSnapshot, ConcurrentReads) {
+  // readers never see a snapshot older than one they have already read
+  const size_t kThreads = 4;
+  const int kVersions = 200;
+  RcuSnapshot<int> snapshot(std::make_shared<const int>(0));
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < kThreads; t++) {
+    readers.emplace_back([&]() {
+      int last = 0;
+      while (!done.load()) {
+        int value = snapshot.read();
+        ASSERT_GE(value, last);
+        last = value;
+      }
+      ASSERT_EQ(snapshot.read(), kVersions);
+    });
+  }
+  for (int i = 1; i <= kVersions; i++) {
+    snapshot.publish(std::make_shared<const int>(i));
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(RcuSnapshot, DISABLED_JobLookupBenchmark) {
+  // looking up the jobs of shares by 32 share workers, with a job published
+  // every 1000 lookups
+  const size_t kThreads = 32;
+  const size_t kLookups = 100000;
+  using Jobs = std::vector<std::pair<uint64_t, std::shared_ptr<uint64_t>>>;
+
+  auto run = [&](auto lookup, auto publish) {
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; t++) {
+      threads.emplace_back([&, t]() {
+        for (size_t i = 0; i < kLookups; i++) {
+          if (t == 0 && i % 1000 == 0) {
+            publish(i / 1000);
+          }
+          auto job = lookup(i / 1000);
+          ASSERT_TRUE(job == nullptr || *job <= i / 1000);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin);
+  };
+
+  std::map<uint64_t, std::shared_ptr<uint64_t>> jobMap;
+  std::shared_timed_mutex jobMapLock;
+  auto lockTime = run(
+      [&](uint64_t jobId) -> std::shared_ptr<uint64_t> {
+        std::shared_lock<std::shared_timed_mutex> l{jobMapLock};
+        auto itr = jobMap.find(jobId);
+        return itr != jobMap.end() ? itr->second : nullptr;
+      },
+      [&](uint64_t jobId) {
+        std::unique_lock<std::shared_timed_mutex> l{jobMapLock};
+        jobMap[jobId] = std::make_shared<uint64_t>(jobId);
+      });
+
+  Jobs jobs;
+  RcuSnapshot<Jobs> jobTable;
+  auto rcuTime = run(
+      [&](uint64_t jobId) -> std::shared_ptr<uint64_t> {
+        auto &table = jobTable.read();
+        auto itr = std::lower_bound(
+            table.begin(),
+            table.end(),
+            jobId,
+            [](const auto &job, uint64_t id) { return job.first < id; });
+        return itr != table.end() && itr->first == jobId ? itr->second
+                                                          : nullptr;
+      },
+      [&](uint64_t jobId) {
+        jobs.emplace_back(jobId, std::make_shared<uint64_t>(jobId));
+        jobTable.publish(std::make_shared<const Jobs>(jobs));
+      });
+
+  LOG(INFO) << "job lookup x" << kThreads * kLookups << " by " << kThreads
+            << " threads, shared_timed_mutex + std::map: " << lockTime.count()
+            << "us, RcuSnapshot: " << rcuTime.count() << "us";
+}
@@ -0,0 +1,129 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+
+#include "SlabAllocator.h"
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <thread>
+
+TEST(SlabAllocator, Blocks) {
+  auto &slab = SlabAllocator::instance();
+  ASSERT_EQ(SlabAllocator::blockSize(1), 16u);
+  ASSERT_EQ(SlabAllocator::blockSize(100), 112u);
+  ASSERT_EQ(SlabAllocator::blockSize(5000), 5000u);
+
+  // blocks are distinct and aligned, freed blocks are reused
+  std::set<void *> blocks;
+  for (size_t i = 0; i < 10000; i++) {
+    void *block = slab.allocate(100);
+    ASSERT_EQ((uintptr_t)block % SlabAllocator::kAlignment, 0u);
+    ASSERT_EQ(blocks.insert(block).second, true);
+  }
+  for (void *block : blocks) {
+    slab.deallocate(block, 100);
+  }
+  // the last freed block is reused first
+  void *block = slab.allocate(100);
+  ASSERT_EQ(blocks.count(block), 1u);
+  slab.deallocate(block, 100);
+  ASSERT_EQ(slab.allocate(100), block);
+  slab.deallocate(block, 100);
+
+  // larger blocks fall back to operator new
+  void *large = slab.allocate(SlabAllocator::kMaxBlockSize + 1);
+  ASSERT_NE(large, nullptr);
+  slab.deallocate(large, SlabAllocator::kMaxBlockSize + 1);
+
+  // empty arenas are freed but one, once the thread returns its blocks
+  slab.flushThreadCache();
+  for (const auto &usage : slab.usage()) {
+    if (usage.blockSize_ == 112) {
+      ASSERT_EQ(usage.usedBlocks_, 0u);
+      ASSERT_EQ(usage.arenas_, 1u);
+    }
+  }
+}
+
+TEST(SlabAllocator, Threads) {
+  auto &slab = SlabAllocator::instance();
+  const size_t kThreads = 4;
+  const size_t kBlocks = 20000;
+
+  // blocks are freed by another thread than the one allocating them
+  std::vector<std::vector<void *>> blocks(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < kBlocks; i++) {
+        void *block = slab.allocate(200);
+        memset(block, (int)t, 200);
+        blocks[t].push_back(block);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::set<void *> distinct;
+  for (auto &b : blocks) {
+    distinct.insert(b.begin(), b.end());
+  }
+  ASSERT_EQ(distinct.size(), kThreads * kBlocks);
+
+  threads.clear();
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (void *block : blocks[(t + 1) % kThreads]) {
+        slab.deallocate(block, 200);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // the blocks cached by the threads are returned when they exit
+  for (const auto &usage : slab.usage()) {
+    if (usage.blockSize_ == 208) {
+      ASSERT_EQ(usage.usedBlocks_, 0u);
+      ASSERT_EQ(usage.arenas_, 1u);
+    }
+  }
+}
+
+TEST(SlabAllocator, StlAllocator) {
+  using Allocator = SlabStlAllocator<std::pair<const int, int>>;
+  std::map<int, int, std::less<int>, Allocator> m;
+  for (int i = 0; i < 1000; i++) {
+    m[i] = i * 2;
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    m.erase(i);
+  }
+  ASSERT_EQ(m.size(), 500u);
+  ASSERT_EQ(m[999], 1998);
+}
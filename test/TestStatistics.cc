@@ -32,6 +32,8 @@
 #include "eth/StratumEth.h"
 #include "eth/StatisticsEth.h"
 
+#include <random>
+
 ////////////////////////////////  StatsWindow  /////////////////////////////////
 TEST(StatsWindow, clear) {
   int windowSize = 60;
@@ -159,6 +161,85 @@ TEST(StatsWindow, map) {
   ASSERT_EQ(sum, sum3);
 }
 
+TEST(StatsWindow, runningSum) {
+  const int windowSize = 30;
+  StatsWindow<int64_t> sw(windowSize);
+  std::map<int64_t, int64_t> values; // ring idx -> value
+  std::mt19937 random(1);
+
+  int64_t maxIdx = 1000;
+  for (int i = 0; i < 20000; i++) {
+    int64_t idx = maxIdx - random() % windowSize;
+    if (i == 0 || random() % 4 == 0) {
+      maxIdx += random() % (windowSize + 2);
+      idx = maxIdx;
+    }
+    int64_t val = random() % 100;
+    sw.insert(idx, val);
+    values[idx] += val;
+    values.erase(values.begin(), values.upper_bound(maxIdx - windowSize));
+    if (random() % 50 == 0) {
+      sw.mapDivide(2);
+      for (auto &v : values) {
+        v.second /= 2;
+      }
+    }
+
+    int64_t begin = maxIdx + random() % (windowSize + 2);
+    int len = random() % (windowSize + 2);
+    int64_t expected = 0;
+    for (auto &v : values) {
+      if (v.first > begin - std::min(len, windowSize) && v.first <= begin) {
+        expected += v.second;
+      }
+    }
+    ASSERT_EQ(sw.sum(begin, len), expected);
+    ASSERT_EQ(sw.sum(maxIdx), sw.sum(maxIdx, windowSize));
+  }
+}
+
+TEST(StatsWindow, floatingPointSum) {
+  const int windowSize = 10;
+  StatsWindow<double> sw(windowSize);
+
+  // 1.0 is lost in the rounding when added to the running total of 1e17,
+  // the total is summed from the ring again after a rotation
+  sw.insert(0, 1.0);
+  sw.insert(5, 1e17);
+  for (int64_t i = 6; i < 40; i++) {
+    sw.insert(i, 1.0);
+    if (i >= 5 + 2 * windowSize) {
+      ASSERT_EQ(sw.sum(i), windowSize);
+      ASSERT_EQ(sw.sum(i, windowSize - 1), windowSize - 1);
+    }
+  }
+
+  sw.mapMultiply(3.0);
+  ASSERT_EQ(sw.sum(39), 3.0 * windowSize);
+  sw.mapDivide(3.0);
+  ASSERT_EQ(sw.sum(39), windowSize);
+}
+
+TEST(StatsWindow, sumBeforeFilled) {
+  const int windowSize = 60;
+  StatsWindow<int64_t> sw(windowSize);
+  const int64_t val = 5;
+
+  // ring idx 0 .. 4, the ring has not filled once
+  for (int i = 0; i < 5; i++) {
+    sw.insert(i, val);
+  }
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(sw.sum(i), (i + 1) * val);
+    ASSERT_EQ(sw.sum(i, 1), val);
+    ASSERT_EQ(sw.sum(i, windowSize - 1), (i + 1) * val);
+  }
+  ASSERT_EQ(sw.sum(4, 2), 2 * val);
+  ASSERT_EQ(sw.sum(10), 5 * val);
+  ASSERT_EQ(sw.sum(10, 8), 2 * val);
+  ASSERT_EQ(sw.sum(windowSize), 4 * val);
+}
+
 ////////////////////////////////  ShareStatsDay  ///////////////////////////////
 TEST(ShareStatsDay, ShareStatsDay) {
   // using mainnet
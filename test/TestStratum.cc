@@ -32,6 +32,10 @@
 #include "rsk/RskWork.h"
 #include "vcash/VcashWork.h"
 #include "beam/StratumBeam.h"
+#include "decred/StratumDecred.h"
+#include "eth/StratumEth.h"
+#include "grin/StratumGrin.h"
+#include "sia/StratumSia.h"
 
 #include <chainparams.h>
 #include <hash.h>
@@ -44,6 +48,8 @@
 #endif
 
 #include <stdint.h>
+#include <algorithm>
+#include <chrono>
 
 TEST(Stratum, jobId2Time) {
   uint64_t jobId;
@@ -102,6 +108,269 @@ TEST(Stratum, Share2) {
 #endif
 }
 
+TEST(Stratum, ShareBytes) {
+  ShareBitcoinBytesV3 bytes;
+  bytes.version_ = ShareBitcoin::BYTES_V3_VERSION;
+  bytes.jobId_ = 0x5d2d69a600000000ull;
+  bytes.workerHashId_ = -123456789012345ll;
+  bytes.userId_ = 10;
+  bytes.status_ = StratumStatus::ACCEPT;
+  bytes.timestamp_ = 1563257253;
+  bytes.shareDiff_ = 65536;
+  bytes.blkBits_ = 0x1725bb76u;
+  bytes.height_ = 585834;
+  bytes.nonce_ = 0x12345678u;
+  bytes.sessionId_ = 0xff000001u;
+  bytes.versionMask_ = 0x1fffe000u;
+  bytes.extUserId_ = 3;
+  bytes.ip_.fromIpv4Int(htonl(167772161)); // 10.0.0.1
+  bytes.checkSum_ = bytes.checkSum();
+
+  ShareBitcoin r;
+  ASSERT_TRUE(r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+  ASSERT_EQ(r.version(), (uint32_t)ShareBitcoin::CURRENT_VERSION);
+  ASSERT_EQ(r.jobid(), bytes.jobId_);
+  ASSERT_EQ(r.workerhashid(), bytes.workerHashId_);
+  ASSERT_EQ(r.userid(), bytes.userId_);
+  ASSERT_EQ(r.status(), bytes.status_);
+  ASSERT_EQ(r.timestamp(), (uint64_t)bytes.timestamp_);
+  ASSERT_EQ(r.sharediff(), bytes.shareDiff_);
+  ASSERT_EQ(r.blkbits(), bytes.blkBits_);
+  ASSERT_EQ(r.height(), bytes.height_);
+  ASSERT_EQ(r.nonce(), bytes.nonce_);
+  ASSERT_EQ(r.sessionid(), bytes.sessionId_);
+  ASSERT_EQ(r.versionmask(), bytes.versionMask_);
+  ASSERT_TRUE(r.has_extuserid());
+  ASSERT_EQ(r.extuserid(), 3);
+  ASSERT_FALSE(r.has_bitsreached());
+  ASSERT_EQ(r.getIp().toIpv4Int(), bytes.ip_.toIpv4Int());
+
+  // the IP is only formatted for the protobuf message
+  r.formatIp();
+  ASSERT_EQ(r.ip(), "10.0.0.1");
+  string message;
+  ASSERT_TRUE(r.SerializeToStringWithVersion(message));
+  ShareBitcoin m;
+  ASSERT_TRUE(m.UnserializeWithVersion(
+      (const uint8_t *)message.data(), message.size()));
+  ASSERT_EQ(m.jobid(), bytes.jobId_);
+  ASSERT_EQ(m.getIp().toIpv4Int(), bytes.ip_.toIpv4Int());
+
+  // corrupted records are rejected
+  bytes.height_++;
+  ASSERT_FALSE(
+      r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+}
+
+TEST(Stratum, ShareEthBytes) {
+  ShareEthBytesV2 bytes;
+  bytes.version_ = ShareEth::getBytesVersion(EthConsensus::Chain::CLASSIC);
+  bytes.workerHashId_ = -123456789012345ll;
+  bytes.userId_ = 10;
+  bytes.status_ = StratumStatus::ACCEPT;
+  bytes.timestamp_ = 1563257253;
+  bytes.headerHash_ = 0x1122334455667788ull;
+  bytes.shareDiff_ = 4000000000ull;
+  bytes.networkDiff_ = 2000000000000000ull;
+  bytes.nonce_ = 0x8877665544332211ull;
+  bytes.sessionId_ = 0x00ff01u;
+  bytes.height_ = 8600000;
+  bytes.bitsReached_ = 0x1b0404cbu;
+  bytes.ip_.fromIpv4Int(htonl(167772161)); // 10.0.0.1
+  bytes.checkSum_ = bytes.checkSum();
+
+  ShareEth r;
+  ASSERT_TRUE(r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+  ASSERT_EQ(r.version(), (uint32_t)ShareEth::CURRENT_VERSION_CLASSIC);
+  ASSERT_EQ(r.getChain(), EthConsensus::Chain::CLASSIC);
+  ASSERT_EQ(r.workerhashid(), bytes.workerHashId_);
+  ASSERT_EQ(r.userid(), bytes.userId_);
+  ASSERT_EQ(r.status(), bytes.status_);
+  ASSERT_EQ(r.timestamp(), (uint64_t)bytes.timestamp_);
+  ASSERT_EQ(r.headerhash(), bytes.headerHash_);
+  ASSERT_EQ(r.sharediff(), bytes.shareDiff_);
+  ASSERT_EQ(r.networkdiff(), bytes.networkDiff_);
+  ASSERT_EQ(r.nonce(), bytes.nonce_);
+  ASSERT_EQ(r.sessionid(), bytes.sessionId_);
+  ASSERT_EQ(r.height(), bytes.height_);
+  ASSERT_FALSE(r.has_extuserid());
+  ASSERT_EQ(r.bitsreached(), bytes.bitsReached_);
+  ASSERT_EQ(r.getIp().toString(), "10.0.0.1");
+
+  bytes.nonce_++;
+  ASSERT_FALSE(
+      r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+}
+
+TEST(Stratum, ShareSiaBytes) {
+  ShareSiaBytesV2 bytes;
+  bytes.version_ = ShareSia::BYTES_V2_VERSION;
+  bytes.workerHashId_ = -123456789012345ll;
+  bytes.userId_ = 10;
+  bytes.status_ = StratumStatus::REJECT_NO_REASON;
+  bytes.timestamp_ = 1563257253;
+  bytes.jobId_ = 0x5d2d69a600000000ull;
+  bytes.shareDiff_ = 65536;
+  bytes.blkBits_ = 0x1a0a0bf5u;
+  bytes.height_ = 220000;
+  bytes.nonce_ = 0x12345678u;
+  bytes.sessionId_ = 0xff000001u;
+  bytes.extUserId_ = 3;
+  bytes.ip_.fromIpv4Int(htonl(167772161)); // 10.0.0.1
+  bytes.checkSum_ = bytes.checkSum();
+
+  ShareSia r;
+  ASSERT_TRUE(r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+  ASSERT_EQ(r.version(), (uint32_t)ShareSia::CURRENT_VERSION);
+  ASSERT_EQ(r.workerhashid(), bytes.workerHashId_);
+  ASSERT_EQ(r.userid(), bytes.userId_);
+  ASSERT_EQ(r.status(), bytes.status_);
+  ASSERT_EQ(r.timestamp(), (uint64_t)bytes.timestamp_);
+  ASSERT_EQ(r.jobid(), bytes.jobId_);
+  ASSERT_EQ(r.sharediff(), bytes.shareDiff_);
+  ASSERT_EQ(r.blkbits(), bytes.blkBits_);
+  ASSERT_EQ(r.height(), bytes.height_);
+  ASSERT_EQ(r.nonce(), bytes.nonce_);
+  ASSERT_EQ(r.sessionid(), bytes.sessionId_);
+  ASSERT_EQ(r.extuserid(), bytes.extUserId_);
+  ASSERT_FALSE(r.has_bitsreached());
+  ASSERT_EQ(r.getIp().toString(), "10.0.0.1");
+
+  bytes.shareDiff_++;
+  ASSERT_FALSE(
+      r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+}
+
+TEST(Stratum, ShareDecredBytes) {
+  ShareDecredBytesV2 bytes;
+  bytes.version_ = ShareDecred::BYTES_V2_VERSION;
+  bytes.workerHashId_ = -123456789012345ll;
+  bytes.userId_ = 10;
+  bytes.status_ = StratumStatus::ACCEPT;
+  bytes.timestamp_ = 1563257253;
+  bytes.jobId_ = 0x5d2d69a600000000ull;
+  bytes.shareDiff_ = 65536;
+  bytes.blkBits_ = 0x1a0a0bf5u;
+  bytes.height_ = 360000;
+  bytes.nonce_ = 0x12345678u;
+  bytes.sessionId_ = 0xff000001u;
+  bytes.network_ = (uint32_t)NetworkDecred::TestNet;
+  bytes.voters_ = 5;
+  bytes.bitsReached_ = 0x1b0404cbu;
+  bytes.ip_.fromIpv4Int(htonl(167772161)); // 10.0.0.1
+  bytes.checkSum_ = bytes.checkSum();
+
+  ShareDecred r;
+  ASSERT_TRUE(r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+  ASSERT_EQ(r.version(), (uint32_t)ShareDecred::CURRENT_VERSION);
+  ASSERT_EQ(r.workerhashid(), bytes.workerHashId_);
+  ASSERT_EQ(r.userid(), bytes.userId_);
+  ASSERT_EQ(r.status(), bytes.status_);
+  ASSERT_EQ(r.timestamp(), (uint64_t)bytes.timestamp_);
+  ASSERT_EQ(r.jobid(), bytes.jobId_);
+  ASSERT_EQ(r.sharediff(), bytes.shareDiff_);
+  ASSERT_EQ(r.blkbits(), bytes.blkBits_);
+  ASSERT_EQ(r.height(), bytes.height_);
+  ASSERT_EQ(r.nonce(), bytes.nonce_);
+  ASSERT_EQ(r.sessionid(), bytes.sessionId_);
+  ASSERT_EQ(r.network(), bytes.network_);
+  ASSERT_EQ(r.voters(), bytes.voters_);
+  ASSERT_FALSE(r.has_extuserid());
+  ASSERT_EQ(r.bitsreached(), bytes.bitsReached_);
+  ASSERT_EQ(r.getIp().toString(), "10.0.0.1");
+
+  bytes.voters_++;
+  ASSERT_FALSE(
+      r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+}
+
+TEST(Stratum, ShareBeamBytes) {
+  ShareBeamBytes bytes;
+  bytes.version_ = ShareBeam::BYTES_VERSION;
+  bytes.workerHashId_ = -123456789012345ll;
+  bytes.userId_ = 10;
+  bytes.status_ = StratumStatus::ACCEPT;
+  bytes.timestamp_ = 1563257253;
+  bytes.inputPrefix_ = 0x1122334455667788ull;
+  bytes.shareDiff_ = 65536;
+  bytes.blockBits_ = 0x05f1e59bu;
+  bytes.nonce_ = 0x8877665544332211ull;
+  bytes.height_ = 320000;
+  bytes.sessionId_ = 0xff0001u;
+  bytes.outputHash_ = 0xdeadbeefu;
+  bytes.extUserId_ = 3;
+  bytes.bitsReached_ = 0x1b0404cbu;
+  bytes.ip_.fromIpv4Int(htonl(167772161)); // 10.0.0.1
+  bytes.checkSum_ = bytes.checkSum();
+
+  ShareBeam r;
+  ASSERT_TRUE(r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+  ASSERT_EQ(r.version(), (uint32_t)ShareBeam::CURRENT_VERSION);
+  ASSERT_EQ(r.workerhashid(), bytes.workerHashId_);
+  ASSERT_EQ(r.userid(), bytes.userId_);
+  ASSERT_EQ(r.status(), bytes.status_);
+  ASSERT_EQ(r.timestamp(), (uint64_t)bytes.timestamp_);
+  ASSERT_EQ(r.inputprefix(), bytes.inputPrefix_);
+  ASSERT_EQ(r.sharediff(), bytes.shareDiff_);
+  ASSERT_EQ(r.blockbits(), bytes.blockBits_);
+  ASSERT_EQ(r.nonce(), bytes.nonce_);
+  ASSERT_EQ(r.height(), bytes.height_);
+  ASSERT_EQ(r.sessionid(), bytes.sessionId_);
+  ASSERT_EQ(r.outputhash(), bytes.outputHash_);
+  ASSERT_EQ(r.extuserid(), bytes.extUserId_);
+  ASSERT_EQ(r.bitsreached(), bytes.bitsReached_);
+  ASSERT_EQ(r.getIp().toString(), "10.0.0.1");
+
+  bytes.outputHash_++;
+  ASSERT_FALSE(
+      r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+}
+
+TEST(Stratum, ShareGrinBytes) {
+  ShareGrinBytes bytes;
+  bytes.version_ = ShareGrin::BYTES_VERSION;
+  bytes.workerHashId_ = -123456789012345ll;
+  bytes.userId_ = 10;
+  bytes.status_ = StratumStatus::ACCEPT;
+  bytes.timestamp_ = 1563257253;
+  bytes.jobId_ = 0x5d2d69a600000000ull;
+  bytes.shareDiff_ = 4;
+  bytes.blockDiff_ = 2000000000ull;
+  bytes.height_ = 300000;
+  bytes.nonce_ = 0x8877665544332211ull;
+  bytes.hashPrefix_ = 0x1122334455667788ull;
+  bytes.sessionId_ = 0xff000001u;
+  bytes.edgeBits_ = 31;
+  bytes.scaling_ = 7936;
+  bytes.ip_.fromIpv4Int(htonl(167772161)); // 10.0.0.1
+  bytes.checkSum_ = bytes.checkSum();
+
+  ShareGrin r;
+  ASSERT_TRUE(r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+  ASSERT_EQ(r.version(), (uint32_t)ShareGrin::CURRENT_VERSION);
+  ASSERT_EQ(r.workerhashid(), bytes.workerHashId_);
+  ASSERT_EQ(r.userid(), bytes.userId_);
+  ASSERT_EQ(r.status(), bytes.status_);
+  ASSERT_EQ(r.timestamp(), (uint64_t)bytes.timestamp_);
+  ASSERT_EQ(r.jobid(), bytes.jobId_);
+  ASSERT_EQ(r.sharediff(), bytes.shareDiff_);
+  ASSERT_EQ(r.blockdiff(), bytes.blockDiff_);
+  ASSERT_EQ(r.height(), bytes.height_);
+  ASSERT_EQ(r.nonce(), bytes.nonce_);
+  ASSERT_EQ(r.hashprefix(), bytes.hashPrefix_);
+  ASSERT_EQ(r.sessionid(), bytes.sessionId_);
+  ASSERT_EQ(r.edgebits(), bytes.edgeBits_);
+  ASSERT_EQ(r.scaling(), bytes.scaling_);
+  ASSERT_EQ(r.scaledShareDiff(), bytes.scaledShareDiff());
+  ASSERT_FALSE(r.has_extuserid());
+  ASSERT_FALSE(r.has_bitsreached());
+  ASSERT_EQ(r.getIp().toString(), "10.0.0.1");
+
+  bytes.edgeBits_++;
+  ASSERT_FALSE(
+      r.UnserializeWithVersion((const uint8_t *)&bytes, sizeof(bytes)));
+}
+
 TEST(Stratum, StratumWorker) {
   StratumWorker w(3);
   uint64_t u;
@@ -842,7 +1111,116 @@ TEST(Stratum, StratumJobWithRskWork) {
     ASSERT_EQ(sjob.minTime_, 1469001544U);
     ASSERT_EQ(sjob.coinbaseValue_, 312659655);
     ASSERT_GE(time(nullptr), jobId2Time(sjob.jobId_));
+
+    // the binary encoding carries the same job as the JSON one
+    const string jsonStr = sjob.serializeToJson();
+    const string binStr = sjob.serializeToBinary();
+    ASSERT_EQ((uint8_t)binStr[0], StratumJob::kBinaryMagic);
+    ASSERT_LT(binStr.size(), jsonStr.size());
+
+    StratumJobBitcoin sjob2;
+    ASSERT_TRUE(sjob2.unserialize(binStr.data(), binStr.size()));
+    ASSERT_EQ(sjob2.serializeToJson(), jsonStr);
+    ASSERT_EQ(sjob2.networkTarget_, sjob.networkTarget_);
+    ASSERT_EQ(sjob2.nmcNetworkTarget_, sjob.nmcNetworkTarget_);
+
+    StratumJobBitcoin sjob3;
+    ASSERT_TRUE(sjob3.unserialize(jsonStr.data(), jsonStr.size()));
+    ASSERT_EQ(sjob3.serializeToBinary(), binStr);
+
+    // truncated or unknown versions are rejected
+    ASSERT_FALSE(sjob3.unserialize(binStr.data(), 2));
+    string badVersion = binStr;
+    badVersion[1] = StratumJobBitcoin::kBinaryVersion + 1;
+    ASSERT_FALSE(sjob3.unserialize(badVersion.data(), badVersion.size()));
+  }
+}
+#endif
+
+#ifndef CHAIN_TYPE_ZEC
+TEST(Stratum, StratumJobBinaryWithMergedMining) {
+  StratumJobBitcoin sjob;
+  sjob.jobId_ = 6345432447654461441ULL;
+  sjob.gbtHash_ = "0b4e4ba1e2f4ea4f14d4b7fdd7ed5dcd8d19add5";
+  sjob.prevHash_ = uint256S(
+      "000000004f2ea239532b2e77bb46c03b86643caac3fe92959a31fd2d03979c34");
+  sjob.prevHashBeStr_ =
+      "03979c349a31fd2dc3fe929586643caabb46c03b532b2e774f2ea23900000000";
+  sjob.height_ = 898487;
+  sjob.coinbase1_ =
+      "02000000010000000000000000000000000000000000000000000000000000000000"
+      "000000ffffffff1e03b7b50d";
+  sjob.coinbase2_ = "ffffffff0100f2052a01000000000000000000";
+  sjob.merkleBranch_.push_back(uint256S(
+      "bd36bd4fff574b573152e7d4f64adf2bb1c9ab0080a12f8544c351f65aca79ff"));
+  sjob.nVersion_ = 536870912;
+  sjob.nBits_ = 436308706U;
+  sjob.nTime_ = 1469006933U;
+  sjob.minTime_ = 1469001544U;
+  sjob.coinbaseValue_ = 312659655;
+
+  sjob.nmcAuxBlockHash_ = uint256S(
+      "ae8d9c3b5a5a23ec6ee4a1b1b2d3f0ec1c9e3b1ba3b9ca0ac3a8e3f8c3f0b2a1");
+  sjob.nmcAuxBits_ = 0x1b00f339;
+  sjob.nmcHeight_ = 411423;
+  sjob.nmcRpcAddr_ = "http://127.0.0.1:8336";
+  sjob.nmcRpcUserpass_ = "user:pass";
+  sjob.vcashBlockHashForMergedMining_ =
+      "0x2ae4c8f6c9e2bc0ab4f7c4a5e43b2ab2b3ae85d2b0b1c3f1e0dcba4e6c1a8d3f";
+  sjob.vcashHeight_ = 46533;
+  sjob.vcashdRpcAddress_ = "http://127.0.0.1:3413";
+  sjob.vcashdRpcUserPwd_ = "user:pass";
+  sjob.isMergedMiningCleanJob_ = true;
+
+  uint256 nmcTarget;
+  BitsToTarget(sjob.nmcAuxBits_, nmcTarget);
+
+  // the merged mining target is the easier of the nmc and vcash ones
+  const uint256 easierTarget = uint256S(
+      "00000000ffff0000000000000000000000000000000000000000000000000000");
+  const uint256 harderTarget = uint256S(
+      "0000000000000000000ffff00000000000000000000000000000000000000000");
+  for (const auto &vcashTarget : {easierTarget, harderTarget}) {
+    sjob.vcashNetworkTarget_ = vcashTarget;
+
+    const string jsonStr = sjob.serializeToJson();
+    StratumJobBitcoin jsonJob;
+    ASSERT_TRUE(jsonJob.unserialize(jsonStr.data(), jsonStr.size()));
+    ASSERT_EQ(
+        jsonJob.nmcNetworkTarget_,
+        vcashTarget == easierTarget ? easierTarget : nmcTarget);
+
+    const string binStr = jsonJob.serializeToBinary();
+    StratumJobBitcoin binJob;
+    ASSERT_TRUE(binJob.unserialize(binStr.data(), binStr.size()));
+    ASSERT_EQ(binJob.serializeToJson(), jsonStr);
+    ASSERT_EQ(binJob.networkTarget_, jsonJob.networkTarget_);
+    ASSERT_EQ(binJob.nmcNetworkTarget_, jsonJob.nmcNetworkTarget_);
+    ASSERT_EQ(binJob.nmcAuxBlockHash_, sjob.nmcAuxBlockHash_);
+    ASSERT_EQ(binJob.nmcAuxBits_, sjob.nmcAuxBits_);
+    ASSERT_EQ(binJob.vcashNetworkTarget_, vcashTarget);
+    ASSERT_EQ(binJob.vcashHeight_, sjob.vcashHeight_);
   }
+
+  // without merged mining work both encodings leave the target empty
+  StratumJobBitcoin plainJob = sjob;
+  plainJob.nmcAuxBlockHash_.SetNull();
+  plainJob.nmcAuxBits_ = 0;
+  plainJob.vcashBlockHashForMergedMining_.clear();
+  plainJob.vcashNetworkTarget_.SetNull();
+  plainJob.vcashHeight_ = 0;
+
+  const string plainJsonStr = plainJob.serializeToJson();
+  StratumJobBitcoin plainJsonJob;
+  ASSERT_TRUE(
+      plainJsonJob.unserialize(plainJsonStr.data(), plainJsonStr.size()));
+  ASSERT_TRUE(plainJsonJob.nmcNetworkTarget_.IsNull());
+
+  const string plainBinStr = plainJob.serializeToBinary();
+  StratumJobBitcoin plainBinJob;
+  ASSERT_TRUE(plainBinJob.unserialize(plainBinStr.data(), plainBinStr.size()));
+  ASSERT_TRUE(plainBinJob.nmcNetworkTarget_.IsNull());
+  ASSERT_EQ(plainBinJob.serializeToJson(), plainJsonStr);
 }
 #endif
 
@@ -871,3 +1249,140 @@ TEST(Stratum, StratumJobBeam) {
   ASSERT_EQ(sjob.unserializeFromJson(sjobStr.c_str(), sjobStr.size()), true);
   ASSERT_EQ(sjob.serializeToJson(), sjobStr);
 }
+
+TEST(Stratum, StratumSubmitBitcoin) {
+  StratumSubmitBitcoin submit;
+
+  string line =
+      "{\"params\": [\"user.worker\", \"27\", \"0000000012345678\", "
+      "\"5c39a313\", \"07ba7929\"], \"id\": 4, \"method\": "
+      "\"mining.submit\"}\n";
+  ASSERT_TRUE(submit.parse(line.data(), line.data() + line.size()));
+  ASSERT_EQ(submit.idStr_, "4");
+  ASSERT_EQ(submit.jobId_, 27u);
+  ASSERT_EQ(submit.extraNonce2_, 0x12345678u);
+  ASSERT_EQ(submit.nTime_, 0x5c39a313u);
+  ASSERT_EQ(submit.nonce_, 0x07ba7929u);
+  ASSERT_EQ(submit.versionMask_, 0u);
+
+  line =
+      "{\"id\":\"abc\",\"method\":\"mining.submit\",\"params\":[\"u.w\","
+      "\"1547281171000\",\"FFFFFFFFFFFFFFFF\",\"5C39A313\",\"00000000\","
+      "\"1fffe000\"]}\r\n";
+  ASSERT_TRUE(submit.parse(line.data(), line.data() + line.size()));
+  ASSERT_EQ(submit.idStr_, "\"abc\"");
+  ASSERT_EQ(submit.jobId_, 1547281171000u);
+  ASSERT_EQ(submit.extraNonce2_, 0xFFFFFFFFFFFFFFFFu);
+  ASSERT_EQ(submit.nTime_, 0x5c39a313u);
+  ASSERT_EQ(submit.nonce_, 0u);
+  ASSERT_EQ(submit.versionMask_, 0x1fffe000u);
+
+  line =
+      "{\"id\":null,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\","
+      "\"00\",\"5c39a313\",\"07ba7929\"]}";
+  ASSERT_TRUE(submit.parse(line.data(), line.data() + line.size()));
+  ASSERT_EQ(submit.idStr_, "null");
+
+  // Anything unusual should go to the generic parser
+  const vector<string> fallbacks = {
+      // other methods
+      "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[]}",
+      // extra keys
+      "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"mining.submit\",\"params\":"
+      "[\"u.w\",\"1\",\"00\",\"5c39a313\",\"07ba7929\"]}",
+      // too few / too many params
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\",\"00\","
+      "\"5c39a313\"]}",
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\",\"00\","
+      "\"5c39a313\",\"07ba7929\",\"1fffe000\",\"00\"]}",
+      // non-string params
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",1,\"00\","
+      "\"5c39a313\",\"07ba7929\"]}",
+      // escapes
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u\\\\w\",\"1\","
+      "\"00\",\"5c39a313\",\"07ba7929\"]}",
+      // non-hex / too long values
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\","
+      "\"0x00\",\"5c39a313\",\"07ba7929\"]}",
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\",\"00\","
+      "\"5c39a3130\",\"07ba7929\"]}",
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1f\","
+      "\"00\",\"5c39a313\",\"07ba7929\"]}",
+      // float id / minus sign without digits
+      "{\"id\":1.5,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\","
+      "\"00\",\"5c39a313\",\"07ba7929\"]}",
+      "{\"id\":-,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\","
+      "\"00\",\"5c39a313\",\"07ba7929\"]}",
+      // truncated / trailing data
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\",\"00\","
+      "\"5c39a313\",\"07ba7929\"]",
+      "{\"id\":1,\"method\":\"mining.submit\",\"params\":[\"u.w\",\"1\",\"00\","
+      "\"5c39a313\",\"07ba7929\"]}}",
+  };
+  for (const auto &fallback : fallbacks) {
+    ASSERT_FALSE(
+        submit.parse(fallback.data(), fallback.data() + fallback.size()))
+        << fallback;
+  }
+}
+
+// The fast path has to stay well ahead of the generic one, the best of a few
+// runs of each is compared so a preempted run doesn't fail the test.
+TEST(Stratum, StratumSubmitBitcoinBenchmark) {
+  const string line =
+      "{\"params\": [\"user.worker\", \"27\", \"0000000012345678\", "
+      "\"5c39a313\", \"07ba7929\", \"1fffe000\"], \"id\": 4, \"method\": "
+      "\"mining.submit\"}\n";
+  const size_t kRuns = 5;
+  const size_t kRounds = 20000;
+  auto fastPath = std::chrono::steady_clock::duration::max();
+  auto genericPath = std::chrono::steady_clock::duration::max();
+
+  for (size_t run = 0; run < kRuns; run++) {
+    uint64_t checksum1 = 0, checksum2 = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRounds; i++) {
+      StratumSubmitBitcoin submit;
+      submit.parse(line.data(), line.data() + line.size());
+      checksum1 += submit.jobId_ + submit.extraNonce2_ + submit.nTime_ +
+          submit.nonce_ + submit.versionMask_;
+    }
+    fastPath = std::min(fastPath, std::chrono::steady_clock::now() - begin);
+
+    // What StratumSession::handleLine() and
+    // StratumMinerBitcoin::handleRequest_Submit() do without the fast path
+    begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRounds; i++) {
+      JsonNode jnode;
+      JsonNode::parse(line.data(), line.data() + line.size(), jnode);
+      JsonNode jid = jnode["id"];
+      JsonNode jmethod = jnode["method"];
+      JsonNode jparams = jnode["params"];
+      string idStr = jid.str();
+      string method = jmethod.str();
+      if (method == "mining.submit") {
+        checksum2 += (uint8_t)jparams.children()->at(1).uint32() +
+            jparams.children()->at(2).uint64_hex() +
+            jparams.children()->at(3).uint32_hex() +
+            jparams.children()->at(4).uint32_hex() +
+            jparams.children()->at(5).uint32_hex();
+      }
+    }
+    genericPath =
+        std::min(genericPath, std::chrono::steady_clock::now() - begin);
+
+    ASSERT_EQ(checksum1, checksum2);
+  }
+
+  LOG(INFO) << "mining.submit decoding x" << kRounds << ", fast path: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(fastPath)
+                   .count()
+            << "us, generic path: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   genericPath)
+                   .count()
+            << "us";
+  // about 5 times faster when it was added
+  ASSERT_LT(fastPath * 2, genericPath);
+}
@@ -183,6 +183,52 @@ TEST(StratumServer, SessionIDManager8Bits) {
   ASSERT_EQ(m.ifFull(), true);
 }
 
+TEST(StratumServer, SessionIDManagerFragmented) {
+  SessionIDManagerT<24> m(0x01u);
+  uint32_t sessionID;
+
+  // fill all session ids
+  for (uint32_t i = 0; i <= 0x00FFFFFFu; i++) {
+    ASSERT_EQ(m.allocSessionId(&sessionID), true);
+  }
+  ASSERT_EQ(m.ifFull(), true);
+
+  // free scattered ids, they are allocated again from the last allocated one
+  // and then from the beginning
+  const uint32_t kStep = 4099;
+  for (uint32_t i = 0; i <= 0x00FFFFFFu; i += kStep) {
+    m.freeSessionId(0x01000000u | i);
+  }
+  m.freeSessionId(0x01000000u | 0x00FFFFFFu);
+  ASSERT_EQ(m.allocSessionId(&sessionID), true);
+  ASSERT_EQ(sessionID, 0x01FFFFFFu);
+  for (uint32_t i = 0; i <= 0x00FFFFFFu; i += kStep) {
+    ASSERT_EQ(m.allocSessionId(&sessionID), true);
+    ASSERT_EQ(sessionID, 0x01000000u | i);
+  }
+  ASSERT_EQ(m.ifFull(), true);
+  ASSERT_EQ(m.allocSessionId(&sessionID), false);
+}
+
+TEST(StratumServer, SessionIDManagerReserve) {
+  SessionIDManagerT<8> m(0x01u);
+  uint32_t sessionID;
+
+  // ids of other servers and used ids cannot be reserved
+  ASSERT_EQ(m.reserveSessionId(0x0101u), true);
+  ASSERT_EQ(m.reserveSessionId(0x0101u), false);
+  ASSERT_EQ(m.reserveSessionId(0x0201u), false);
+
+  // reserved ids are skipped by the allocation
+  ASSERT_EQ(m.allocSessionId(&sessionID), true);
+  ASSERT_EQ(sessionID, 0x0100u);
+  ASSERT_EQ(m.allocSessionId(&sessionID), true);
+  ASSERT_EQ(sessionID, 0x0102u);
+
+  m.freeSessionId(0x0101u);
+  ASSERT_EQ(m.reserveSessionId(0x0101u), true);
+}
+
 #endif // #ifndef WORK_WITH_STRATUM_SWITCHER
 
 #ifndef CHAIN_TYPE_ZEC
@@ -223,13 +269,11 @@ TEST(StratumServerBitcoin, CheckShare) {
   StratumJobExBitcoin exjob(0, sjob, true, StratumMiner::kExtraNonce2Size_);
 
   CBlockHeader header;
-  std::vector<char> coinbaseBin;
 
   exjob.generateBlockHeader(
       &header,
-      &coinbaseBin,
       0xfe0000c3u,
-      "260103fe60004690",
+      0x260103fe60004690u,
       sjob->merkleBranch_,
       sjob->prevHash_,
       sjob->nBits_,
@@ -241,9 +285,94 @@ TEST(StratumServerBitcoin, CheckShare) {
   uint256 blkHash = uint256S(
       "1028e53e8145994a9ebe4f39eb6a7e3fd4036f2f21a05a5a696e8ac6d0829ef4");
   ASSERT_EQ(blkHash, header.GetHash());
+
+  std::vector<char> coinbaseBin;
+  std::vector<char> expectedCoinbaseBin;
+  exjob.generateCoinbaseTx(&coinbaseBin, 0xfe0000c3u, 0x260103fe60004690u);
+  Hex2Bin(
+      (sjob->coinbase1_ + "fe0000c3260103fe60004690" + sjob->coinbase2_)
+          .c_str(),
+      expectedCoinbaseBin);
+  ASSERT_EQ(coinbaseBin, expectedCoinbaseBin);
+  ASSERT_EQ(
+      ComputeCoinbaseMerkleRoot(coinbaseBin, sjob->merkleBranch_),
+      header.hashMerkleRoot);
+}
+
+TEST(StratumServerBitcoin, CheckShareExtraNonce2Size) {
+  auto sjob = std::make_shared<StratumJobBitcoin>();
+  sjob->coinbase1_ = "0200000001";
+  sjob->coinbase2_ = "ffffffff";
+
+  // coinbase1 is padded with zeros if extraNonce2 is shorter than the job's
+  StratumJobExBitcoin exjob(0, sjob, true, 4);
+  std::vector<char> coinbaseBin;
+  std::vector<char> expectedCoinbaseBin;
+  exjob.generateCoinbaseTx(&coinbaseBin, 0xfe0000c3u, 0x60004690u);
+  Hex2Bin("020000000100000000fe0000c360004690ffffffff", expectedCoinbaseBin);
+  ASSERT_EQ(coinbaseBin, expectedCoinbaseBin);
 }
 #endif
 
+static size_t ResidentSetSize() {
+  size_t pages = 0, residentPages = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm != nullptr) {
+    if (fscanf(statm, "%zu %zu", &pages, &residentPages) != 2) {
+      residentPages = 0;
+    }
+    fclose(statm);
+  }
+  return residentPages * sysconf(_SC_PAGESIZE);
+}
+
+static void TestIdleSessionsMemory(size_t numOfSessions) {
+  ServerBitcoin server;
+  struct event_base *base = event_base_new();
+  vector<unique_ptr<StratumSession>> sessions;
+  sessions.reserve(numOfSessions);
+
+  // don't log every connection
+  int minLogLevel = FLAGS_minloglevel;
+  FLAGS_minloglevel = google::WARNING;
+
+  const size_t rssBegin = ResidentSetSize();
+  for (size_t i = 0; i < numOfSessions; i++) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(0x0a000000u + i);
+    auto bev = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
+    sessions.push_back(
+        server.createConnection(bev, (struct sockaddr *)&addr, i));
+  }
+  const size_t rssEnd = ResidentSetSize();
+
+  size_t memoryUsage = 0;
+  for (const auto &session : sessions) {
+    ASSERT_EQ(string(session->dispatcherType()), "unauthorized");
+    memoryUsage += session->memoryUsage();
+  }
+  LOG(WARNING) << numOfSessions << " idle sessions, RSS: "
+               << (rssEnd - rssBegin) / numOfSessions
+               << " bytes per session (including libevent buffers), "
+               << "accounted: " << memoryUsage / numOfSessions
+               << " bytes per session";
+  ASSERT_GT(memoryUsage, 0u);
+
+  sessions.clear();
+  FLAGS_minloglevel = minLogLevel;
+  event_base_free(base);
+}
+
+TEST(StratumServerBitcoin, IdleSessionsMemory) {
+  TestIdleSessionsMemory(1000);
+}
+
+// Run with --gtest_also_run_disabled_tests
+TEST(StratumServerBitcoin, DISABLED_IdleSessionsMemoryBenchmark) {
+  TestIdleSessionsMemory(1000000);
+}
+
 TEST(StratumServerEth, EthashCalculator) {
 #ifdef NDEBUG
 
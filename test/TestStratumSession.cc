@@ -28,6 +28,9 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <chrono>
+#include <random>
+
 #include "StratumSession.h"
 #include "StratumMessageDispatcher.h"
 #include "StratumMiner.h"
@@ -79,20 +82,244 @@ TEST(StratumSession, LocalJob) {
   {
     LocalShare ls1(
         0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU);
-    ASSERT_EQ(lj.addLocalShare(ls1), true);
+    ASSERT_EQ(lj.addLocalShare(ls1), StratumStatus::ACCEPT);
   }
   {
     LocalShare ls1(
         0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU);
-    ASSERT_EQ(lj.addLocalShare(ls1), false);
+    ASSERT_EQ(lj.addLocalShare(ls1), StratumStatus::DUPLICATE_SHARE);
   }
   {
     LocalShare ls2(0x0ULL, 0x0U, 0x0U, 0x0u);
-    ASSERT_EQ(lj.addLocalShare(ls2), true);
+    ASSERT_EQ(lj.addLocalShare(ls2), StratumStatus::ACCEPT);
   }
   {
     LocalShare ls2(0x0ULL, 0x0U, 0x0U, 0x0u);
-    ASSERT_EQ(lj.addLocalShare(ls2), false);
+    ASSERT_EQ(lj.addLocalShare(ls2), StratumStatus::DUPLICATE_SHARE);
+  }
+}
+
+TEST(StratumSession, LocalShareSet) {
+  const auto INSERTED = LocalShareSet::InsertResult::INSERTED;
+  const auto DUPLICATE = LocalShareSet::InsertResult::DUPLICATE;
+  LocalShareSet shares;
+
+  // shares differ in only one field
+  for (uint32_t i = 0; i < 1000; i++) {
+    ASSERT_EQ(shares.insert(LocalShare(i, 0, 0, 0)), INSERTED);
+    ASSERT_EQ(shares.insert(LocalShare(0, i + 1, 0, 0)), INSERTED);
+    ASSERT_EQ(shares.insert(LocalShare(0, 0, i + 1, 0)), INSERTED);
+    ASSERT_EQ(shares.insert(LocalShare(0, 0, 0, i + 1)), INSERTED);
+  }
+  ASSERT_EQ(shares.size(), 4000u);
+  for (uint32_t i = 0; i < 1000; i++) {
+    ASSERT_EQ(shares.insert(LocalShare(i, 0, 0, 0)), DUPLICATE);
+    ASSERT_EQ(shares.insert(LocalShare(0, i + 1, 0, 0)), DUPLICATE);
+    ASSERT_EQ(shares.insert(LocalShare(0, 0, i + 1, 0)), DUPLICATE);
+    ASSERT_EQ(shares.insert(LocalShare(0, 0, 0, i + 1)), DUPLICATE);
+  }
+  ASSERT_EQ(shares.size(), 4000u);
+}
+
+TEST(StratumSession, LocalShareSetFull) {
+  LocalJob lj(0, 0);
+  for (size_t i = 0; i < LocalShareSet::kMaxSize; i++) {
+    ASSERT_EQ(
+        lj.addLocalShare(LocalShare(i, 0x12345678u, 0x5c39a313u, 0)),
+        StratumStatus::ACCEPT);
+  }
+  ASSERT_EQ(lj.submitShares_.size(), LocalShareSet::kMaxSize);
+
+  // reject new shares once the memory cap is reached, duplicates are still
+  // reported as duplicates
+  ASSERT_EQ(
+      lj.addLocalShare(LocalShare(
+          LocalShareSet::kMaxSize, 0x12345678u, 0x5c39a313u, 0)),
+      StratumStatus::TOO_MANY_SHARES);
+  ASSERT_EQ(
+      lj.addLocalShare(LocalShare(0, 0x12345678u, 0x5c39a313u, 0)),
+      StratumStatus::DUPLICATE_SHARE);
+  ASSERT_EQ(lj.submitShares_.size(), LocalShareSet::kMaxSize);
+}
+
+TEST(StratumSession, LocalShareSetSessionFull) {
+  LocalJobRing<LocalJob> jobs(256);
+  const size_t kSharesPerJob = 4096;
+  const size_t kJobs = LocalShareSet::kMaxSessionSize / kSharesPerJob;
+  for (size_t j = 0; j < kJobs; j++) {
+    auto &job = jobs.emplace_back(0, j);
+    for (size_t i = 0; i < kSharesPerJob; i++) {
+      ASSERT_EQ(
+          job.addLocalShare(LocalShare(i, 0, 0, 0)), StratumStatus::ACCEPT);
+    }
+  }
+  ASSERT_EQ(jobs.shares(), LocalShareSet::kMaxSessionSize);
+
+  // the session is full although the new job is empty
+  auto &job = jobs.emplace_back(0, kJobs);
+  ASSERT_EQ(
+      job.addLocalShare(LocalShare(0, 0, 0, 0)),
+      StratumStatus::TOO_MANY_SHARES);
+  ASSERT_EQ(job.submitShares_.size(), 0u);
+
+  // evicting a job frees its shares for the new jobs
+  jobs.pop_front();
+  ASSERT_EQ(jobs.shares(), LocalShareSet::kMaxSessionSize - kSharesPerJob);
+  ASSERT_EQ(job.addLocalShare(LocalShare(0, 0, 0, 0)), StratumStatus::ACCEPT);
+  ASSERT_EQ(jobs.shares(), LocalShareSet::kMaxSessionSize - kSharesPerJob + 1);
+}
+
+TEST(StratumSession, LocalShareSetLimits) {
+  LocalJobRing<LocalJob> jobs(256);
+  jobs.setShareLimits(100, 150);
+  auto &job1 = jobs.emplace_back(0, 1);
+  for (size_t i = 0; i < 100; i++) {
+    ASSERT_EQ(
+        job1.addLocalShare(LocalShare(i, 0, 0, 0)), StratumStatus::ACCEPT);
+  }
+  // the job is full
+  ASSERT_EQ(
+      job1.addLocalShare(LocalShare(100, 0, 0, 0)),
+      StratumStatus::TOO_MANY_SHARES);
+
+  // the session is full after 50 shares of another job
+  auto &job2 = jobs.emplace_back(0, 2);
+  for (size_t i = 0; i < 50; i++) {
+    ASSERT_EQ(
+        job2.addLocalShare(LocalShare(i, 0, 0, 0)), StratumStatus::ACCEPT);
+  }
+  ASSERT_EQ(
+      job2.addLocalShare(LocalShare(50, 0, 0, 0)),
+      StratumStatus::TOO_MANY_SHARES);
+  ASSERT_EQ(jobs.shares(), 150u);
+
+  // scaled up for an agent of 2 sub-sessions
+  jobs.setShareLimits(200, 300);
+  for (size_t i = 100; i < 200; i++) {
+    ASSERT_EQ(
+        job1.addLocalShare(LocalShare(i, 0, 0, 0)), StratumStatus::ACCEPT);
+  }
+  ASSERT_EQ(
+      job1.addLocalShare(LocalShare(200, 0, 0, 0)),
+      StratumStatus::TOO_MANY_SHARES);
+  ASSERT_EQ(jobs.shares(), 250u);
+
+  // lowered below the shares kept, they are not evicted
+  jobs.setShareLimits(100, 150);
+  ASSERT_EQ(
+      job2.addLocalShare(LocalShare(50, 0, 0, 0)),
+      StratumStatus::TOO_MANY_SHARES);
+  ASSERT_EQ(
+      job2.addLocalShare(LocalShare(0, 0, 0, 0)),
+      StratumStatus::DUPLICATE_SHARE);
+  ASSERT_EQ(jobs.shares(), 250u);
+}
+
+TEST(StratumSession, DISABLED_LocalShareSetBenchmark) {
+  const size_t kShares = 50000;
+  std::mt19937_64 random(1);
+  vector<LocalShare> localShares;
+  localShares.reserve(kShares);
+  for (size_t i = 0; i < kShares; i++) {
+    uint64_t r = random();
+    localShares.emplace_back(
+        random(), (uint32_t)r, 0x5c39a313u + (uint32_t)(r >> 60), 0);
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  std::set<LocalShare> shareTree;
+  for (const auto &share : localShares) {
+    ASSERT_EQ(shareTree.insert(share).second, true);
+  }
+  for (const auto &share : localShares) {
+    ASSERT_EQ(shareTree.insert(share).second, false);
+  }
+  auto treeTime = std::chrono::steady_clock::now() - begin;
+
+  begin = std::chrono::steady_clock::now();
+  LocalShareSet shareSet;
+  for (const auto &share : localShares) {
+    ASSERT_EQ(shareSet.insert(share), LocalShareSet::InsertResult::INSERTED);
+  }
+  for (const auto &share : localShares) {
+    ASSERT_EQ(shareSet.insert(share), LocalShareSet::InsertResult::DUPLICATE);
+  }
+  auto setTime = std::chrono::steady_clock::now() - begin;
+
+  LOG(INFO) << "duplicate share check x" << kShares * 2 << ", std::set: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(treeTime)
+                   .count()
+            << "us, LocalShareSet: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(setTime)
+                   .count()
+            << "us (" << shareSet.memoryUsage() << " bytes)";
+}
+
+namespace {
+struct LocalJobShortId : public LocalJob {
+  LocalJobShortId(size_t chainId, uint64_t jobId, uint8_t shortJobId)
+    : LocalJob(chainId, jobId)
+    , shortJobId_(shortJobId) {}
+  bool operator==(uint8_t shortJobId) const {
+    return shortJobId_ == shortJobId;
+  }
+  uint8_t key() const { return shortJobId_; }
+  uint8_t shortJobId_;
+};
+} // namespace
+
+TEST(StratumSession, LocalJobRingShortJobId) {
+  LocalJobRing<LocalJobShortId> jobs(256);
+  ASSERT_EQ(jobs.find((uint8_t)0), nullptr);
+  // nothing is allocated before the first job
+  ASSERT_EQ(jobs.memoryUsage(), 0u);
+  ASSERT_EQ(jobs.begin() == jobs.end(), true);
+
+  for (uint64_t jobId = 0; jobId < 1000; jobId++) {
+    if (jobs.full()) {
+      jobs.pop_front();
+    }
+    auto &job = jobs.emplace_back(0, jobId, (uint8_t)jobId);
+    ASSERT_EQ(jobs.find((uint8_t)jobId), &job);
+  }
+  ASSERT_EQ(jobs.size(), 256u);
+  ASSERT_GT(jobs.memoryUsage(), 256 * sizeof(LocalJobShortId));
+  for (uint64_t jobId = 1000 - 256; jobId < 1000; jobId++) {
+    auto job = jobs.find((uint8_t)jobId);
+    ASSERT_NE(job, nullptr);
+    ASSERT_EQ(job->jobId_, jobId);
+  }
+
+  while (jobs.size() > 4) {
+    jobs.pop_front();
+  }
+  ASSERT_EQ(jobs.find((uint8_t)(1000 - 5)), nullptr);
+  ASSERT_EQ(jobs.find((uint8_t)(1000 - 4))->jobId_, 1000u - 4);
+}
+
+TEST(StratumSession, LocalJobRingJobId) {
+  LocalJobRing<LocalJob> jobs(256);
+  std::mt19937_64 random(1);
+  std::deque<uint64_t> jobIds;
+
+  for (size_t i = 0; i < 10000; i++) {
+    // evict several jobs at once from time to time, as clean jobs do
+    size_t numOfJobsToKeep = (i % 100 == 99) ? 4 : jobs.capacity() - 1;
+    while (jobs.size() > numOfJobsToKeep) {
+      jobs.pop_front();
+      jobIds.pop_front();
+    }
+    // job ids with the same low bits collide in the table
+    uint64_t jobId = (random() << 12) | (i & 0xf);
+    jobs.emplace_back(0, jobId);
+    jobIds.push_back(jobId);
+
+    for (auto id : jobIds) {
+      auto job = jobs.find(id);
+      ASSERT_NE(job, nullptr);
+      ASSERT_EQ(job->jobId_, id);
+    }
+    ASSERT_EQ(jobs.find(random()), nullptr);
   }
 }
 
@@ -116,6 +343,7 @@ public:
   MOCK_CONST_METHOD0(acceptStale, bool());
   MOCK_CONST_METHOD0(niceHashForced, bool());
   MOCK_CONST_METHOD0(niceHashMinDiff, uint64_t());
+  MOCK_METHOD1(setAgentSessions, void(size_t));
 };
 
 class StratumMinerMock : public StratumMiner {
@@ -133,8 +361,18 @@ public:
       handleRequest,
       void(const string &, const string &, const JsonNode &, const JsonNode &));
   MOCK_METHOD1(handleExMessage, void(const string &));
+  MOCK_METHOD7(
+      handleExSubmit,
+      bool(
+          const string &,
+          uint8_t,
+          uint16_t,
+          uint32_t,
+          uint32_t,
+          uint32_t,
+          uint32_t));
   MOCK_METHOD1(addLocalJob, uint64_t(LocalJob &));
-  MOCK_METHOD1(removeLocalJob, void(LocalJob &));
+  MOCK_METHOD1(removeLocalJobs, void(const vector<LocalJob *> &));
 };
 
 static DiffController diffController(0x4000, 0x4000000000000000, 0x2, 10, 3000);
@@ -492,6 +730,103 @@ TEST(StratumSession, StratumClientAgentHandler_SubmitShare_with_time) {
   // please check ouput log
 }
 
+TEST(StratumSession, StratumClientAgentHandler_SubmitShareBatch) {
+  StratumSessionMock connection;
+  StratumMessageAgentDispatcher agent(connection, diffController);
+
+  //
+  // SUBMIT_SHARE_BATCH:
+  // | magic_number(1) | cmd(1) | len (2) | batch_id(2) | count(2) |
+  // { jobId(1) | session_id(2) | extra_nonce2(4) | nNonce(4) | nTime(4) |
+  // nVersionMask(4) } * count |
+  //
+  const uint16_t sessionId = 0x10;
+  const uint16_t unknownSessionId = 0x20;
+
+  string exMessage;
+  exMessage.resize(1 + 1 + 2 + 2 + 2 + 3 * 19, 0);
+
+  uint8_t *p = (uint8_t *)exMessage.data();
+  *p++ = StratumMessageEx::CMD_MAGIC_NUMBER;
+  *p++ = static_cast<uint8_t>(StratumCommandEx::SUBMIT_SHARE_BATCH);
+  *(uint16_t *)p = (uint16_t)exMessage.size();
+  p += 2;
+  // batch_id
+  *(uint16_t *)p = 0x1234;
+  p += 2;
+  // count
+  *(uint16_t *)p = 3;
+  p += 2;
+  for (uint16_t id : {sessionId, sessionId, unknownSessionId}) {
+    *p++ = 9; // jobId
+    *(uint16_t *)p = id;
+    p += 2;
+    *(uint32_t *)p = 0x12345678u; // extra_nonce2
+    p += 4;
+    *(uint32_t *)p = 0x90abcdefu + id; // nonce
+    p += 4;
+    *(uint32_t *)p = 0; // time
+    p += 4;
+    *(uint32_t *)p = 0x1fffe000u; // version mask
+    p += 4;
+  }
+  ASSERT_EQ((size_t)(p - (uint8_t *)exMessage.data()), exMessage.size());
+
+  //
+  // SUBMIT_SHARE_BATCH_RESULT:
+  // | magic_number(1) | cmd(1) | len (2) | batch_id(2) | count(2) |
+  // accepted(2) | { index(2) | status(4) } * (count - accepted) |
+  //
+  string result;
+  result.resize(1 + 1 + 2 + 2 + 2 + 2 + 2 * 6, 0);
+  p = (uint8_t *)result.data();
+  *p++ = StratumMessageEx::CMD_MAGIC_NUMBER;
+  *p++ = static_cast<uint8_t>(StratumCommandEx::SUBMIT_SHARE_BATCH_RESULT);
+  *(uint16_t *)p = (uint16_t)result.size();
+  p += 2;
+  *(uint16_t *)p = 0x1234;
+  p += 2;
+  *(uint16_t *)p = 3;
+  p += 2;
+  *(uint16_t *)p = 1;
+  p += 2;
+  *(uint16_t *)p = 1;
+  p += 2;
+  *(int32_t *)p = StratumStatus::JOB_NOT_FOUND;
+  p += 4;
+  *(uint16_t *)p = 2;
+  p += 2;
+  *(int32_t *)p = StratumStatus::UNAUTHORIZED;
+  p += 4;
+  ASSERT_EQ((size_t)(p - (uint8_t *)result.data()), result.size());
+
+  InSequence s;
+  DiffController dc(16384, 4000000000000000, 2, 10, 900);
+  string workerName = "__default__";
+  auto workerId = StratumWorker::calcWorkerId(workerName);
+  auto session = new StratumMinerMock(connection, dc, "", workerName, workerId);
+  EXPECT_CALL(connection, createMiner("", workerName, workerId))
+      .WillOnce(Return(ByMove(unique_ptr<StratumMiner>(session))));
+  EXPECT_CALL(connection, addWorker("", workerName, workerId)).Times(1);
+  EXPECT_CALL(
+      *session,
+      handleExSubmit(
+          "0.0", 9, sessionId, 0x12345678u, 0x90abcdffu, 0, 0x1fffe000u))
+      .WillOnce(Return(true));
+  EXPECT_CALL(
+      *session,
+      handleExSubmit(
+          "0.1", 9, sessionId, 0x12345678u, 0x90abcdffu, 0, 0x1fffe000u))
+      .WillOnce(Return(true));
+  EXPECT_CALL(connection, sendData(result)).Times(1);
+  agent.registerWorker(sessionId, "", workerName, workerId);
+  agent.handleExMessage(exMessage);
+  // the results are reported after verifying the shares
+  agent.responseShareAccepted("0.0");
+  agent.responseShareAccepted("null");
+  agent.responseShareError("0.1", StratumStatus::JOB_NOT_FOUND);
+}
+
 TEST(StratumSession, StratumClientAgentHandler_UNREGISTER_WORKER) {
   StratumSessionMock connection;
   StratumMessageAgentDispatcher agent(connection, diffController);
@@ -529,6 +864,78 @@ TEST(StratumSession, StratumClientAgentHandler_UNREGISTER_WORKER) {
   // please check ouput log
 }
 
+TEST(StratumSession, StratumClientAgentHandler_AgentSessions) {
+  StratumSessionMock connection;
+  StratumMessageAgentDispatcher agent(connection, diffController);
+  DiffController dc(16384, 4000000000000000, 2, 10, 900);
+  EXPECT_CALL(connection, createMiner(_, _, _))
+      .WillRepeatedly(InvokeWithoutArgs([&]() {
+        return unique_ptr<StratumMiner>(
+            new StratumMinerMock(connection, dc, "", "__default__", 0));
+      }));
+
+  // the share limits of the session scale with the registered sub-sessions
+  InSequence s;
+  EXPECT_CALL(connection, setAgentSessions(1u)).Times(1);
+  EXPECT_CALL(connection, setAgentSessions(2u)).Times(2);
+  EXPECT_CALL(connection, setAgentSessions(1u)).Times(1);
+  agent.registerWorker(0, "", "__default__", 0);
+  agent.registerWorker(1, "", "__default__", 0);
+  // the session id is reused
+  agent.registerWorker(0, "", "__default__", 0);
+
+  // UNREGISTER_WORKER:
+  // | magic_number(1) | cmd(1) | len(2) | session_id(2) |
+  string exMessage(6, 0);
+  exMessage[0] = StratumMessageEx::CMD_MAGIC_NUMBER;
+  exMessage[1] = static_cast<uint8_t>(StratumCommandEx::UNREGISTER_WORKER);
+  exMessage[2] = 6;
+  exMessage[4] = 1;
+  agent.handleExMessage(exMessage);
+  Mock::VerifyAndClearExpectations(&connection);
+}
+
+class StratumMessageAgentDispatcherTest : public StratumMessageAgentDispatcher {
+public:
+  using StratumMessageAgentDispatcher::findMiner;
+  using StratumMessageAgentDispatcher::StratumMessageAgentDispatcher;
+};
+
+TEST(StratumSession, StratumClientAgentHandler_SparseSessionIds) {
+  StratumSessionMock connection;
+  StratumMessageAgentDispatcherTest agent(connection, diffController);
+  DiffController dc(16384, 4000000000000000, 2, 10, 900);
+  EXPECT_CALL(connection, createMiner(_, _, _))
+      .WillRepeatedly(InvokeWithoutArgs([&]() {
+        return unique_ptr<StratumMiner>(
+            new StratumMinerMock(connection, dc, "", "__default__", 0));
+      }));
+
+  // a high session id doesn't grow the array of miners
+  const size_t usage = agent.memoryUsage();
+  const uint16_t highId = StratumMessageEx::AGENT_MAX_SESSION_ID;
+  agent.registerWorker(highId, "", "__default__", 0);
+  ASSERT_NE(agent.findMiner(highId), nullptr);
+  ASSERT_LT(agent.memoryUsage() - usage, 4096u);
+
+  // the array takes over the miners it reaches
+  agent.registerWorker(100, "", "__default__", 0);
+  for (uint16_t sessionId = 0; sessionId < 100; sessionId++) {
+    ASSERT_EQ(agent.findMiner(sessionId), nullptr);
+    agent.registerWorker(sessionId, "", "__default__", 0);
+  }
+  auto miner = agent.findMiner(100);
+  ASSERT_NE(miner, nullptr);
+  agent.registerWorker(101, "", "__default__", 0);
+  ASSERT_EQ(agent.findMiner(100), miner);
+  ASSERT_NE(agent.findMiner(highId), nullptr);
+
+  agent.unregisterWorker(highId);
+  ASSERT_EQ(agent.findMiner(highId), nullptr);
+  agent.unregisterWorker(100);
+  ASSERT_EQ(agent.findMiner(100), nullptr);
+}
+
 TEST(StratumSession, StratumClientAgentHandler) {
   StratumSessionMock connection;
   StratumMessageAgentDispatcher agent(connection, diffController);
@@ -599,6 +1006,94 @@ TEST(StratumSession, StratumClientAgentHandler) {
   }
 }
 
+namespace {
+// Toggles its diff between 2^10 and 2^11 every 50 jobs
+class FanoutMiner : public StratumMiner {
+public:
+  FanoutMiner(IStratumSession &session, uint16_t sessionId)
+    : StratumMiner(session, diffController, "", "", 0)
+    , sessionId_(sessionId) {
+    curDiff_ = 1024;
+  }
+
+  void handleRequest(
+      const string &idStr,
+      const string &method,
+      const JsonNode &jparams,
+      const JsonNode &jroot) override {}
+  uint64_t addLocalJob(LocalJob &localJob) override {
+    if ((localJob.jobId_ + sessionId_) % 50 == 0) {
+      curDiff_ = curDiff_ == 1024 ? 2048 : 1024;
+    }
+    return curDiff_;
+  }
+  void removeLocalJobs(const vector<LocalJob *> &localJobs) override {}
+
+private:
+  uint16_t sessionId_;
+};
+} // namespace
+
+// Sends kJobs jobs to kSessions agent sessions, kSessions should be a
+// multiple of 50. Returns the time taken by the jobs after the first one.
+static std::chrono::microseconds
+AgentJobFanout(size_t kSessions, size_t kJobs) {
+  NiceMock<StratumSessionMock> connection;
+  StratumMessageAgentDispatcher agent(connection, diffController);
+  uint16_t nextSessionId = 0;
+  ON_CALL(connection, createMiner(_, _, _))
+      .WillByDefault(Invoke([&](const string &, const string &, int64_t) {
+        return unique_ptr<StratumMiner>(
+            new FanoutMiner(connection, nextSessionId++));
+      }));
+  for (size_t i = 0; i < kSessions; i++) {
+    agent.registerWorker(i, "", "", 0);
+  }
+
+  vector<size_t> sent;
+  ON_CALL(connection, sendData(An<const string &>()))
+      .WillByDefault(
+          Invoke([&](const string &data) { sent.push_back(data.size()); }));
+
+  // all the diffs are sent with the first job
+  LocalJob firstJob(0, 1);
+  agent.addLocalJob(firstJob);
+  EXPECT_EQ(sent.size(), 1u);
+  EXPECT_EQ(sent[0], 2 * (1 + 1 + 2 + 1 + 2) + kSessions * 2);
+  sent.clear();
+
+  vector<LocalJob> jobs;
+  jobs.reserve(kJobs);
+  for (size_t i = 0; i < kJobs; i++) {
+    jobs.emplace_back(0, 2 + i);
+  }
+  auto begin = std::chrono::steady_clock::now();
+  for (auto &job : jobs) {
+    agent.addLocalJob(job);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - begin;
+
+  // 1 of 50 sessions changes its diff with every job, only they are sent
+  EXPECT_EQ(sent.size(), kJobs);
+  for (auto size : sent) {
+    EXPECT_EQ(size, 1 + 1 + 2 + 1 + 2 + kSessions / 50 * 2);
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+}
+
+TEST(StratumSession, StratumClientAgentHandler_JobFanout) {
+  AgentJobFanout(100, 60);
+}
+
+// Timing only, run with --gtest_also_run_disabled_tests
+TEST(StratumSession, DISABLED_StratumClientAgentHandler_JobFanoutBenchmark) {
+  const size_t kSessions = 5000;
+  const size_t kJobs = 1000;
+  auto us = AgentJobFanout(kSessions, kJobs);
+  LOG(INFO) << "agent job fan-out x" << kJobs << " to " << kSessions
+            << " sessions: " << us.count() << "us";
+}
+
 TEST(StratumSession, SetDiff) {
   using namespace boost::algorithm;
 
@@ -0,0 +1,127 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+
+#include "ssl/SSLUtils.h"
+#include "ssl/TLSHandshaker.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <future>
+
+#include <event2/thread.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+// A server context with a throwaway self-signed certificate
+static SSL_CTX *newServerCTX() {
+  EVP_PKEY *pkey = nullptr;
+  EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  EVP_PKEY_keygen_init(pctx);
+  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1);
+  EVP_PKEY_keygen(pctx, &pkey);
+  EVP_PKEY_CTX_free(pctx);
+
+  X509 *x509 = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+  X509_gmtime_adj(X509_get_notBefore(x509), 0);
+  X509_gmtime_adj(X509_get_notAfter(x509), 3600);
+  X509_set_pubkey(x509, pkey);
+  X509_NAME *name = X509_get_subject_name(x509);
+  X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+  X509_set_issuer_name(x509, name);
+  X509_sign(x509, pkey, EVP_sha256());
+
+  SSL_CTX *sslCTX = SSL_CTX_new(SSLv23_server_method());
+  SSL_CTX_use_certificate(sslCTX, x509);
+  SSL_CTX_use_PrivateKey(sslCTX, pkey);
+  X509_free(x509);
+  EVP_PKEY_free(pkey);
+  return sslCTX;
+}
+
+TEST(TLSHandshaker, Handshake) {
+  evthread_use_pthreads();
+  SSL_CTX *serverCTX = newServerCTX();
+  set_server_SSL_session_cache(serverCTX, 16, 60, true, "");
+  TLSHandshaker handshaker(2, 10);
+  ASSERT_TRUE(handshaker.start());
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  evutil_make_socket_nonblocking(fds[0]);
+  SSL *ssl = SSL_new(serverCTX);
+  std::promise<bool> done;
+  auto success = done.get_future();
+  handshaker.handshake(
+      fds[0], ssl, [&done](bool success) { done.set_value(success); });
+
+  SSL *client = SSL_new(get_client_SSL_CTX_With_Cache());
+  SSL_set_fd(client, fds[1]);
+  ASSERT_EQ(SSL_connect(client), 1);
+  ASSERT_TRUE(success.get());
+  ASSERT_EQ(handshaker.pending(), 0u);
+
+  // the connection is handed back ready to use
+  ASSERT_EQ(SSL_write(client, "ping", 4), 4);
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) & ~O_NONBLOCK);
+  char buf[4];
+  ASSERT_EQ(SSL_read(ssl, buf, sizeof(buf)), 4);
+  ASSERT_EQ(std::string(buf, 4), "ping");
+
+  SSL_free(client);
+  SSL_free(ssl);
+  close(fds[0]);
+  close(fds[1]);
+  SSL_CTX_free(serverCTX);
+}
+
+TEST(TLSHandshaker, Timeout) {
+  evthread_use_pthreads();
+  SSL_CTX *serverCTX = newServerCTX();
+  TLSHandshaker handshaker(1, 1);
+  ASSERT_TRUE(handshaker.start());
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  evutil_make_socket_nonblocking(fds[0]);
+  std::promise<bool> done;
+  auto success = done.get_future();
+  handshaker.handshake(fds[0], SSL_new(serverCTX), [&done](bool success) {
+    done.set_value(success);
+  });
+  ASSERT_EQ(handshaker.pending(), 1u);
+
+  // the client never says hello, the socket is closed
+  ASSERT_FALSE(success.get());
+  ASSERT_EQ(handshaker.pending(), 0u);
+  char c;
+  ASSERT_EQ(read(fds[1], &c, 1), 0);
+
+  close(fds[1]);
+  SSL_CTX_free(serverCTX);
+}
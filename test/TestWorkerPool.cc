@@ -0,0 +1,214 @@
+/*
+ The MIT License (MIT)
+
+ Copyright (c) [2019] [BTC.COM]
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+ */
+#include "gtest/gtest.h"
+
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(WorkerPool, WorkerTask) {
+  int calls = 0;
+  WorkerTask small([&calls]() { calls++; });
+  ASSERT_EQ((bool)small, true);
+  small();
+  ASSERT_EQ(calls, 1);
+
+  // Closures larger than the inline storage live on the heap
+  auto counter = std::make_shared<int>(0);
+  char padding[WorkerTask::kInlineSize] = {1};
+  WorkerTask large([counter, padding]() { *counter += padding[0]; });
+  ASSERT_EQ(counter.use_count(), 2);
+
+  WorkerTask moved(std::move(large));
+  ASSERT_EQ((bool)large, false);
+  moved();
+  ASSERT_EQ(*counter, 1);
+
+  moved = std::move(small);
+  ASSERT_EQ(counter.use_count(), 1);
+  moved();
+  ASSERT_EQ(calls, 2);
+  moved.reset();
+  ASSERT_EQ((bool)moved, false);
+}
+
+static void TestWorkerPool(IWorkerPool &pool) {
+  const size_t kDispatchers = 4;
+  const size_t kWorks = 20000;
+  std::atomic<size_t> done{0};
+
+  pool.start(3);
+  std::vector<std::thread> dispatchers;
+  for (size_t i = 0; i < kDispatchers; i++) {
+    dispatchers.emplace_back([&]() {
+      for (size_t j = 0; j < kWorks; j++) {
+        pool.dispatch([&done]() { done++; });
+      }
+    });
+  }
+  for (auto &dispatcher : dispatchers) {
+    dispatcher.join();
+  }
+
+  // dispatching blocks while the queue is full, so all works are queued
+  while (done < kDispatchers * kWorks) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(pool.queueDepth(), 0u);
+  pool.stop();
+}
+
+TEST(WorkerPool, Locked) {
+  WorkerPool pool(64);
+  TestWorkerPool(pool);
+  ASSERT_EQ(pool.steals(), 0u);
+}
+
+TEST(WorkerPool, Stealing) {
+  StealingWorkerPool pool(64);
+  TestWorkerPool(pool);
+}
+
+// Wait until the condition holds, or fail after a generous deadline
+template <typename Condition>
+static bool WaitFor(Condition condition) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+// Blocks the works waiting on it until release(), which is also called when
+// a failed assertion returns, so the pool can stop
+struct ParkedWorkers {
+  std::promise<void> release_;
+  std::shared_future<void> released_ = release_.get_future().share();
+  bool isReleased_ = false;
+
+  void release() {
+    if (!isReleased_) {
+      isReleased_ = true;
+      release_.set_value();
+    }
+  }
+  ~ParkedWorkers() { release(); }
+};
+
+TEST(WorkerPool, StealingFromParkedWorker) {
+  StealingWorkerPool pool(64);
+  pool.start(2);
+
+  // park one of the workers
+  ParkedWorkers workers;
+  auto released = workers.released_;
+  std::atomic<std::thread::id> parked{std::thread::id{}};
+  pool.dispatch([&parked, released]() {
+    parked = std::this_thread::get_id();
+    released.wait();
+  });
+  ASSERT_TRUE(WaitFor([&]() { return parked != std::thread::id{}; }));
+
+  // the works are spread among both queues, the ones queued to the parked
+  // worker can only run if the other worker steals them
+  const size_t kWorks = 16;
+  std::atomic<size_t> done{0};
+  std::atomic<size_t> ranOnParked{0};
+  for (size_t i = 0; i < kWorks; i++) {
+    pool.dispatch([&]() {
+      if (std::this_thread::get_id() == parked) {
+        ranOnParked++;
+      }
+      done++;
+    });
+  }
+  ASSERT_TRUE(WaitFor([&]() { return done == kWorks; }));
+  ASSERT_EQ(ranOnParked, 0u);
+  ASSERT_GT(pool.steals(), 0u);
+
+  workers.release();
+  pool.stop();
+}
+
+TEST(WorkerPool, StealingBlocksWhileFull) {
+  // 2 queues of 16 works
+  StealingWorkerPool pool(32);
+  pool.start(2);
+
+  // park both workers, each worker takes one of them
+  ParkedWorkers workers;
+  auto released = workers.released_;
+  std::atomic<size_t> parked{0};
+  for (size_t i = 0; i < 2; i++) {
+    pool.dispatch([&parked, released]() {
+      parked++;
+      released.wait();
+    });
+  }
+  ASSERT_TRUE(WaitFor([&]() { return parked == 2; }));
+
+  std::atomic<size_t> done{0};
+  for (size_t i = 0; i < 32; i++) {
+    pool.dispatch([&done]() { done++; });
+  }
+  ASSERT_EQ(pool.queueDepth(), 32u);
+
+  // all queues are full, the dispatcher blocks until a worker makes room
+  std::atomic<bool> dispatched{false};
+  std::thread dispatcher([&]() {
+    pool.dispatch([&done]() { done++; });
+    dispatched = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(dispatched, false);
+
+  workers.release();
+  dispatcher.join();
+  ASSERT_TRUE(WaitFor([&]() { return done == 33; }));
+  ASSERT_EQ(pool.queueDepth(), 0u);
+  pool.stop();
+}
+
+TEST(WorkerPool, IdleHook) {
+  // declared before the pools, which are stopped when an assertion fails
+  std::atomic<size_t> idles{0};
+  WorkerPool locked(64);
+  StealingWorkerPool stealing(64);
+  for (IWorkerPool *pool : std::vector<IWorkerPool *>{&locked, &stealing}) {
+    idles = 0;
+    pool->setIdleHook([&idles]() { idles++; });
+    pool->start(2);
+    // both workers have nothing to do at first
+    ASSERT_TRUE(WaitFor([&]() { return idles >= 2; }));
+    pool->stop();
+  }
+}
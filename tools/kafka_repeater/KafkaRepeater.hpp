@@ -226,3 +226,25 @@ protected:
   string produceTopic_;
   KafkaProducer producer_;
 };
+
+// Repeat the shares of a kafka message one by one, whether the message is a
+// single share or a batch of shares
+class ShareRepeater : public KafkaRepeater {
+public:
+  // Inherit the constructor of the parent class
+  using KafkaRepeater::KafkaRepeater;
+
+protected:
+  bool repeatMessage(rd_kafka_message_t *rkmessage) override {
+    bool success = true;
+    KafkaMessageBatch::forEach(
+        rkmessage->payload,
+        rkmessage->len,
+        [this, &success](const uint8_t *payload, size_t len) {
+          success = repeatShare(payload, len) && success;
+        });
+    return success;
+  }
+
+  virtual bool repeatShare(const uint8_t *payload, size_t len) = 0;
+};
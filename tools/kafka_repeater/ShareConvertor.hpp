@@ -28,18 +28,18 @@
 #include "shares.hpp"
 
 
-class ShareConvertorBitcoinV2ToV1 : public KafkaRepeater {
+class ShareConvertorBitcoinV2ToV1 : public ShareRepeater {
     // Inherit the constructor of the parent class
-    using KafkaRepeater::KafkaRepeater;
+    using ShareRepeater::ShareRepeater;
 
-    bool repeatMessage(rd_kafka_message_t *rkmessage) override {
-        if (rkmessage->len != sizeof(ShareBitcoinV2)) {
-            LOG(WARNING) << "Wrong ShareBitcoinV2 size: " << rkmessage->len << ", should be " << sizeof(ShareBitcoinV2);
+    bool repeatShare(const uint8_t *payload, size_t len) override {
+        if (len != sizeof(ShareBitcoinV2)) {
+            LOG(WARNING) << "Wrong ShareBitcoinV2 size: " << len << ", should be " << sizeof(ShareBitcoinV2);
             return false;
         }
 
         ShareBitcoinV2 shareV2;
-        memcpy((uint8_t *)&shareV2, (const uint8_t *)rkmessage->payload, rkmessage->len);
+        memcpy((uint8_t *)&shareV2, payload, len);
 
         ShareBitcoinV1 shareV1;
         if (!shareV2.toShareBitcoinV1(shareV1)) {
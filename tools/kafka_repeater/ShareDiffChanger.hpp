@@ -29,10 +29,10 @@
 #include "utilities_js.hpp"
 
 
-class ShareDiffChangerBitcoin : public KafkaRepeater {
+class ShareDiffChangerBitcoin : public ShareRepeater {
 public:
     // Inherit the constructor of the parent class
-    using KafkaRepeater::KafkaRepeater;
+    using ShareRepeater::ShareRepeater;
 
     bool initStratumJobConsumer(const string &jobBrocker, const string &jobTopic, const string &jobGroupId, int64_t jobTimeOffset) {
         jobConsumer_ = new KafkaHighLevelConsumer(jobBrocker.c_str(), jobTopic.c_str(), 0/* patition */, jobGroupId.c_str());
@@ -156,14 +156,14 @@ class ShareDiffChangerBitcoinV1 : public ShareDiffChangerBitcoin {
     // Inherit the constructor of the parent class
     using ShareDiffChangerBitcoin::ShareDiffChangerBitcoin;
 
-    bool repeatMessage(rd_kafka_message_t *rkmessage) override {
-        if (rkmessage->len != sizeof(ShareBitcoinV1)) {
-            LOG(WARNING) << "Wrong ShareBitcoinV1 size: " << rkmessage->len << ", should be " << sizeof(ShareBitcoinV1);
+    bool repeatShare(const uint8_t *payload, size_t len) override {
+        if (len != sizeof(ShareBitcoinV1)) {
+            LOG(WARNING) << "Wrong ShareBitcoinV1 size: " << len << ", should be " << sizeof(ShareBitcoinV1);
             return false;
         }
 
         ShareBitcoinV1 shareV1;
-        memcpy((uint8_t *)&shareV1, (const uint8_t *)rkmessage->payload, rkmessage->len);
+        memcpy((uint8_t *)&shareV1, payload, len);
 
         shareV1.blkBits_ = getBitsByTime(shareV1.timestamp_);
 
@@ -176,14 +176,14 @@ class ShareDiffChangerBitcoinV2ToV1 : public ShareDiffChangerBitcoin {
     // Inherit the constructor of the parent class
     using ShareDiffChangerBitcoin::ShareDiffChangerBitcoin;
 
-    bool repeatMessage(rd_kafka_message_t *rkmessage) override {
-        if (rkmessage->len != sizeof(ShareBitcoinV2)) {
-            LOG(WARNING) << "Wrong ShareBitcoinV2 size: " << rkmessage->len << ", should be " << sizeof(ShareBitcoinV2);
+    bool repeatShare(const uint8_t *payload, size_t len) override {
+        if (len != sizeof(ShareBitcoinV2)) {
+            LOG(WARNING) << "Wrong ShareBitcoinV2 size: " << len << ", should be " << sizeof(ShareBitcoinV2);
             return false;
         }
 
         ShareBitcoinV2 shareV2;
-        memcpy((uint8_t *)&shareV2, (const uint8_t *)rkmessage->payload, rkmessage->len);
+        memcpy((uint8_t *)&shareV2, payload, len);
 
         ShareBitcoinV1 shareV1;
         if (!shareV2.toShareBitcoinV1(shareV1)) {
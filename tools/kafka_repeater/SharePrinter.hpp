@@ -28,18 +28,18 @@
 #include "shares.hpp"
 
 
-class SharePrinterBitcoinV1 : public KafkaRepeater {
+class SharePrinterBitcoinV1 : public ShareRepeater {
     // Inherit the constructor of the parent class
-    using KafkaRepeater::KafkaRepeater;
+    using ShareRepeater::ShareRepeater;
 
-    bool repeatMessage(rd_kafka_message_t *rkmessage) override {
-        if (rkmessage->len != sizeof(ShareBitcoinV1)) {
-            LOG(WARNING) << "Wrong ShareBitcoinV1 size: " << rkmessage->len << ", should be " << sizeof(ShareBitcoinV1);
+    bool repeatShare(const uint8_t *payload, size_t len) override {
+        if (len != sizeof(ShareBitcoinV1)) {
+            LOG(WARNING) << "Wrong ShareBitcoinV1 size: " << len << ", should be " << sizeof(ShareBitcoinV1);
             return false;
         }
 
         ShareBitcoinV1 shareV1;
-        memcpy((uint8_t *)&shareV1, (const uint8_t *)rkmessage->payload, rkmessage->len);
+        memcpy((uint8_t *)&shareV1, payload, len);
         
         LOG(INFO) << shareV1.toString();
         return true;